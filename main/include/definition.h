@@ -16,8 +16,19 @@
 #define GPIO_PIN_I2C_SDA        18
 
 #define I2C_PORT_NUM            0
-#define I2C_MASTER_FREQ         400000
+#define I2C_MASTER_FREQ         400000  // default max clock, selected per device by error rate (CI2CMaster)
+
+/* defaults of the runtime configuration (CConfig), effective values are kept in NVS */
+#define MEASURE_PERIOD_MS       10000
+#define MEASURE_PERIOD_MIN_MS   5000    // single shot measurement takes 5 sec
+#define CO2_MEASURED_VALUE_MIN  400
+#define CO2_MEASURED_VALUE_MAX  5000
 
 #define TASK_STACK_DEPTH        4096
 
+/* matter device/cluster/attribute/command name tables (diagnostic dumps only), define as 0 to strip names from production images */
+#ifndef MATTER_NAME_LOOKUP_ENABLE
+#define MATTER_NAME_LOOKUP_ENABLE   1
+#endif
+
 #endif
\ No newline at end of file
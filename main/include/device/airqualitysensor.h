@@ -19,6 +19,19 @@ typedef enum {
     BQM3        // becquerel per m3
 } eMeasurementUnit;
 
+// manufacturer specific cluster (test vendor prefix) for sensor calibration
+#define CALIBRATION_CLUSTER_ID                  0xFFF1FC10
+#define CALIBRATION_ATTR_FRC_REFERENCE_ID       0x0000  // uint16 (ppm), writing starts forced recalibration
+#define CALIBRATION_ATTR_FRC_STATE_ID           0x0001  // enum8 (eFrcState)
+#define CALIBRATION_ATTR_FRC_RESULT_ID          0x0002  // enum8 (eFrcResult)
+#define CALIBRATION_ATTR_FRC_CORRECTION_ID      0x0003  // int16 (ppm)
+#define CALIBRATION_ATTR_AUTO_CALIBRATION_ID    0x0004  // boolean
+
+// manufacturer specific cluster (test vendor prefix) for channels derived from temperature and humidity
+#define DERIVED_CLUSTER_ID                      0xFFF1FC12
+#define DERIVED_ATTR_DEW_POINT_ID               0x0000  // nullable int16 (0.01 degC)
+#define DERIVED_ATTR_ABSOLUTE_HUMIDITY_ID       0x0001  // nullable uint16 (0.01 g/m3)
+
 class CAirQualitySensor : public CDevice
 {
 public:
@@ -38,6 +51,9 @@ private:
     bool create_temperature_measurement_cluster();
     bool create_relative_humidity_measurement_cluster();
     bool create_carbon_dioxide_concentration_measurement_cluster();
+    bool create_calibration_cluster();
+    bool create_derived_cluster();
+    bool create_boolean_state_cluster();
 
 public:
     bool set_carbon_dioxide_concentration_measurement_min_measured_value(float value);
@@ -47,15 +63,26 @@ public:
     void update_measured_value_co2ppm(float value) override;
     void update_measured_value_temperature(float value) override;
     void update_measured_value_humidity(float value) override;
+    void update_sensor_fault(bool fault) override;
+    void update_calibration_status(uint8_t state, uint8_t result, int16_t correction, bool auto_calibration) override;
+    void update_co2_measured_value_range(float min_value, float max_value) override;
+    void update_temperature_measured_value_range(float min_value, float max_value) override;
+    void update_humidity_measured_value_range(float min_value, float max_value) override;
+    void update_derived_values(int16_t dew_point, uint16_t absolute_humidity) override;
+    void update_alarm_state(bool active) override;
 
 private:
     bool m_matter_update_by_client_clus_co2measure_attr_measureval;
     bool m_matter_update_by_client_clus_tempmeasure_attr_measureval;
     bool m_matter_update_by_client_clus_relhummeasure_attr_measureval;
+    bool m_matter_update_by_client_clus_calibration_attr_autocalib;
 
     void matter_update_clus_co2measure_attr_measureval(bool force_update = false);
     void matter_update_clus_tempmeasure_attr_measureval(bool force_update = false);
     void matter_update_clus_relhummeasure_attr_measureval(bool force_update = false);
+    void matter_update_clus_airquality_attr_airquality(uint8_t value);
+    void matter_update_clus_derived_attr_values(bool force_update = false);
+    void matter_log_event_boolean_state_change(bool state);
 };
 
 #ifdef __cplusplus
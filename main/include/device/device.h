@@ -57,6 +57,13 @@ public:
     virtual void update_measured_value_co2ppm(float value);
     virtual void update_measured_value_temperature(float value);
     virtual void update_measured_value_humidity(float value);
+    virtual void update_sensor_fault(bool fault);
+    virtual void update_calibration_status(uint8_t state, uint8_t result, int16_t correction, bool auto_calibration);
+    virtual void update_co2_measured_value_range(float min_value, float max_value);
+    virtual void update_temperature_measured_value_range(float min_value, float max_value);
+    virtual void update_humidity_measured_value_range(float min_value, float max_value);
+    virtual void update_derived_values(int16_t dew_point, uint16_t absolute_humidity);
+    virtual void update_alarm_state(bool active);
 
 protected:
     float m_measured_value_co2ppm;
@@ -67,6 +74,12 @@ protected:
 
     uint16_t m_measured_value_humidity;
     uint16_t m_measured_value_humidity_prev;
+
+    bool m_derived_valid;
+    int16_t m_derived_dew_point;            // 0.01 degC
+    uint16_t m_derived_absolute_humidity;   // 0.01 g/m3
+
+    bool m_sensor_fault;
 };
 
 #ifdef __cplusplus
@@ -4,11 +4,69 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <atomic>
+#include "histogram.h"
+#include "jsonwriter.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define I2C_STATS_DEVICE_COUNT  4       // devices (addresses) tracked on the bus
+#define I2C_RETRY_COUNT         1       // retries per transaction (after bus recovery on bus fault)
+#define I2C_RETRY_TIMEOUT_MS    50
+#define I2C_BREAKER_THRESHOLD   3       // consecutive failed transactions to open the circuit
+#define I2C_BACKOFF_BASE_MS     1000
+#define I2C_BACKOFF_MAX_MS      60000
+#define I2C_CLOCK_WINDOW        64      // transactions per error rate window
+#define I2C_CLOCK_DOWN_ERRORS   2       // errors in a window to step the clock down
+#define I2C_CLOCK_UP_WINDOWS    16      // error free windows in a row to step the clock up
+#define I2C_CLOCK_MIN_DEFAULT   50000
+#define I2C_SCAN_ADDR_FIRST     0x08    // 0x00~0x07, 0x78~0x7F are reserved addresses
+#define I2C_SCAN_ADDR_LAST      0x77
+#define I2C_SCAN_CLOCK          100000  // standard mode, supported by every device
+#define I2C_PROBE_TIMEOUT_MS    10
+
+typedef enum {
+    I2COpWrite = 0,
+    I2COpRead,
+    I2COpWriteRead,
+    I2COpMax
+} eI2COp;
+
+typedef struct {
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> nack;         // ESP_FAIL (no acknowledge from the device)
+    std::atomic<uint32_t> timeout;      // ESP_ERR_TIMEOUT (bus busy)
+    std::atomic<uint32_t> error;        // other errors
+    CHistogram latency;
+} i2c_op_stats_t;
+
+typedef enum {
+    I2CBreakerClosed = 0,               // normal
+    I2CBreakerOpen,                     // transactions are skipped until retry_at_us
+    I2CBreakerHalfOpen                  // one probe transaction allowed
+} eI2CBreakerState;
+
+typedef struct {
+    std::atomic<uint8_t> address;       // 7 bit address, 0: free slot
+    i2c_op_stats_t op[I2COpMax];
+    std::atomic<uint32_t> retries;
+    std::atomic<uint32_t> skipped;      // transactions skipped while the circuit is open
+    std::atomic<uint8_t> breaker;       // eI2CBreakerState
+    uint32_t failures;                  // consecutive failed transactions
+    uint32_t backoff_ms;
+    int64_t retry_at_us;
+    std::atomic<uint32_t> crc_errors;   // reported by device drivers
+    std::atomic<uint32_t> clock_changes;
+    std::atomic<uint32_t> clk_speed;    // selected SCL clock (Hz)
+    uint32_t clk_min;
+    uint32_t clk_max;
+    uint16_t window_count;
+    uint16_t window_errors;
+    uint16_t clean_windows;
+} i2c_device_stats_t;
+
 class CI2CMaster
 {
 public:
@@ -24,10 +82,60 @@ public:
     bool read_bytes(uint8_t dev_addr, uint8_t *data, size_t data_len, uint32_t timeout_ms = 1000);
     bool write_and_read_bytes(uint8_t dev_addr, uint8_t *data_write, size_t data_write_len, uint8_t *data_read, size_t data_read_len, uint32_t timeout_ms = 1000);
 
+    /**
+     * @brief supported clock range of the device, the clock is negotiated within the range (starts from max_hz if not persisted)
+     */
+    void set_device_clock_range(uint8_t dev_addr, uint32_t min_hz, uint32_t max_hz);
+    void report_crc_error(uint8_t dev_addr);
+
+    /**
+     * @brief address only write (START, address+W, STOP), true if the device acknowledged
+     * @note bypasses statistics and circuit breaker so that empty addresses do not occupy device slots
+     */
+    bool probe(uint8_t dev_addr, uint32_t timeout_ms = I2C_PROBE_TIMEOUT_MS);
+    /**
+     * @brief write without acknowledge check, for commands the device does not acknowledge (e.g. SCD4x wake_up)
+     * @note bypasses statistics, retries, clock tracking and circuit breaker, false only on bus errors
+     */
+    bool write_bytes_no_ack(uint8_t dev_addr, const uint8_t *data, size_t data_len, uint32_t timeout_ms = I2C_PROBE_TIMEOUT_MS);
+    /**
+     * @brief acknowledged write / read for identification of parts not known yet (commands a part may reject)
+     * @note bypasses statistics, retries, clock tracking and circuit breaker, runs at the current bus clock
+     */
+    bool probe_write(uint8_t dev_addr, const uint8_t *data, size_t data_len, uint32_t timeout_ms = I2C_PROBE_TIMEOUT_MS);
+    bool probe_read(uint8_t dev_addr, uint8_t *data, size_t data_len, uint32_t timeout_ms = I2C_PROBE_TIMEOUT_MS);
+    /**
+     * @brief probes I2C_SCAN_ADDR_FIRST ~ I2C_SCAN_ADDR_LAST, returns the number of acknowledged addresses
+     */
+    int scan(uint8_t *found, int max_count);
+
+    void print_stats();
+    void reset_stats();
+    void write_stats_json(CJsonWriter *writer);
+
 private:
     static CI2CMaster *_instance;
     int m_port;
+    int m_gpio_scl;
+    int m_gpio_sda;
+    uint32_t m_clk_speed;           // default max clock of devices
+    uint32_t m_bus_clk_speed;       // currently configured clock
     bool m_initialized;
+    i2c_device_stats_t m_stats[I2C_STATS_DEVICE_COUNT];
+    std::atomic<uint32_t> m_bus_recoveries;
+
+    bool install_driver();
+    bool set_bus_clock(uint32_t clk_speed);
+    void track_clock(i2c_device_stats_t *stats, bool error);
+    void load_device_clock(i2c_device_stats_t *stats);
+    void save_device_clock(i2c_device_stats_t *stats);
+    bool recover_bus();
+    bool is_device_available(uint8_t dev_addr);
+    void update_breaker(i2c_device_stats_t *stats, bool success);
+    int transfer(uint8_t dev_addr, eI2COp op, const uint8_t *data_write, size_t data_write_len, uint8_t *data_read, size_t data_read_len, uint32_t timeout_ms);
+
+    i2c_device_stats_t* get_device_stats(uint8_t dev_addr);
+    void record_transaction(i2c_device_stats_t *stats, eI2COp op, int ret, int64_t elapsed_us);
 };
 
 inline CI2CMaster* GetI2CMaster() {
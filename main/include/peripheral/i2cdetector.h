@@ -0,0 +1,78 @@
+#pragma once
+#ifndef _I2C_DETECTOR_H_
+#define _I2C_DETECTOR_H_
+
+#include "I2CMaster.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define I2C_DETECT_MAX_DEVICES  16
+
+typedef enum {
+    I2CPartUnknown = 0,
+    I2CPartSCD4x,           // Sensirion SCD40/SCD41/SCD43 (CO2)
+    I2CPartSHT3x,           // Sensirion SHT30/31/35 (temperature, humidity)
+    I2CPartSHT4x,           // Sensirion SHT40/41/45 (temperature, humidity)
+    I2CPartBMP180,          // Bosch BMP180 (pressure)
+    I2CPartBMP280,          // Bosch BMP280 (pressure)
+    I2CPartBME280,          // Bosch BME280 (pressure, humidity)
+    I2CPartBME680,          // Bosch BME680 (pressure, humidity, gas)
+    I2CPartMax
+} eI2CPart;
+
+typedef struct {
+    uint8_t address;
+    eI2CPart part;
+    bool identified;        // false: part is guessed from the address only (id command failed)
+    uint16_t variant;       // SCD4x: sensor variant, Bosch: chip id
+    uint64_t id;            // serial number (0 if not supported)
+} i2c_detected_device_t;
+
+/**
+ * @brief 부팅 시 I2C 버스를 스캔하여 연결된 디바이스를 식별
+ * @note address only probe (~0.2 ms per address at 100 kHz) followed by id commands only for known addresses
+ */
+class CI2CDetector
+{
+public:
+    CI2CDetector();
+    virtual ~CI2CDetector();
+    static CI2CDetector* Instance();
+
+public:
+    int detect(CI2CMaster *i2c_master);
+
+    int get_device_count() { return m_device_count; }
+    const i2c_detected_device_t* get_device(int index);
+    const i2c_detected_device_t* find_part(eI2CPart part);
+    static const char* get_part_name(const i2c_detected_device_t *device);
+
+    void print();
+
+private:
+    static CI2CDetector *_instance;
+    CI2CMaster *m_i2c_master;
+    i2c_detected_device_t m_devices[I2C_DETECT_MAX_DEVICES];
+    int m_device_count;
+    int64_t m_elapsed_us;
+
+    bool wakeup_scd4x(const uint8_t *found, int count);
+    void identify(i2c_detected_device_t *device);
+    bool identify_scd4x(i2c_detected_device_t *device);
+    bool identify_sht4x(i2c_detected_device_t *device);
+    bool identify_sht3x(i2c_detected_device_t *device);
+    bool identify_bosch(i2c_detected_device_t *device);
+    bool read_sensirion_words(uint8_t dev_addr, const uint8_t *command, size_t command_len, uint16_t *words, int word_count);
+    static uint8_t calculate_crc(const uint8_t *data, size_t len);
+};
+
+inline CI2CDetector* GetI2CDetector() {
+    return CI2CDetector::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
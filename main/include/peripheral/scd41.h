@@ -8,6 +8,29 @@
 extern "C" {
 #endif
 
+// command execution times, callers passing wait = false should not send the next command before these elapse
+#define SCD4X_STOP_PERIODIC_TIME_MS     500
+#define SCD4X_REINIT_TIME_MS            20
+#define SCD4X_WAKE_UP_TIME_MS           20
+#define SCD4X_SINGLE_SHOT_TIME_MS       5000
+#define SCD4X_SELF_TEST_TIME_MS         10000
+#define SCD4X_FACTORY_RESET_TIME_MS     1200
+#define SCD4X_PERSIST_SETTINGS_TIME_MS  800
+#define SCD4X_FORCED_RECALIB_TIME_MS    400
+#define SCD4X_EEPROM_WRITE_ENDURANCE    2000    // guaranteed persist_settings cycles
+#define SCD4X_TEMPERATURE_OFFSET_TO_RAW(x)  ((uint16_t)((x) * 65536.f / 175.f + 0.5f))
+#define SCD4X_TEMPERATURE_OFFSET_FROM_RAW(x)    ((float)(x) * 175.f / 65536.f)
+// EEPROM settings after perform_factory_reset (FRC and ASC history are erased too)
+#define SCD4X_DEFAULT_TEMPERATURE_OFFSET    4.f
+#define SCD4X_DEFAULT_ALTITUDE              0
+#define SCD4X_DEFAULT_AUTO_CALIBRATION      true
+
+typedef enum {
+    Scd4xPowerIdle = 0,
+    Scd4xPowerPeriodic,     // periodic or low power periodic measurement running
+    Scd4xPowerSleep
+} eScd4xPowerState;
+
 class CScd41Ctrl
 {
 public:
@@ -19,25 +42,50 @@ public:
     bool initialize(CI2CMaster *i2c_master, bool self_test = false);
     bool release();
 
-    bool reinit_module();
-    bool wakeup_module();
+    bool reinit_module(bool wait = true);       // wait = false: periodic measurement should be stopped by the caller
+    bool wakeup_module(bool wait = true);
     bool sleep_module();
     bool perform_self_test();
-    bool perform_factory_reset();
+    bool start_self_test();
+    bool read_self_test_result(bool *passed);
+    bool perform_factory_reset(bool wait = true);
 
     bool start_periodic_measure();
-    bool stop_periodic_measure();
+    bool start_low_power_periodic_measure();
+    bool stop_periodic_measure(bool wait = true);
+    bool perform_forced_recalibration(uint16_t target_co2ppm, int16_t *correction);
+    bool start_forced_recalibration(uint16_t target_co2ppm);
+    bool read_forced_recalibration_result(int16_t *correction);
+    bool set_automatic_self_calibration(bool enabled);
+    bool get_automatic_self_calibration(bool *enabled);
 
-    bool measure_single_shot();
+    // on-chip signal compensation
+    bool set_temperature_offset(uint16_t offset_raw);
+    bool get_temperature_offset(uint16_t *offset_raw);
+    bool set_sensor_altitude(uint16_t altitude);
+    bool get_sensor_altitude(uint16_t *altitude);
+    bool set_ambient_pressure(uint16_t pressure_hpa);
+    bool persist_settings();
+
+    bool measure_single_shot(bool wait = true);
     bool read_measurement(uint16_t *co2ppm, float *temperature, float *humidity);
     bool is_measurement_data_ready();
 
+    eScd4xPowerState get_power_state() { return m_power_state; }
+    bool is_wake_shot() { return m_wake_shot; }
+
 private:
     static CScd41Ctrl *_instance;
     CI2CMaster *m_i2c_master;
+    eScd4xPowerState m_power_state;
+    bool m_wake_pending;        // no single shot issued since wake up
+    bool m_wake_shot;           // data of the pending single shot is the first one after wake up (datasheet: discard it)
 
     bool read_serial_number(uint64_t *serial);
     uint8_t calculate_crc(uint16_t data);
+    bool check_crc(const uint8_t *data, size_t len);
+    bool write_command(uint16_t command, const uint16_t *args, int arg_count, uint32_t exec_time_ms);
+    bool read_words(uint16_t command, uint16_t *words, int word_count, uint32_t exec_time_ms);
 };
 
 inline CScd41Ctrl* GetScd41Ctrl() {
@@ -0,0 +1,70 @@
+#pragma once
+#ifndef _ALARM_H_
+#define _ALARM_H_
+
+#include <stdint.h>
+#include <atomic>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALARM_CO2_THRESHOLD_PPM     1500    // default, 0: disabled
+#define ALARM_CO2_HYSTERESIS_PPM    100     // cleared below threshold - hysteresis
+#define ALARM_HOLD_S                60      // condition must last this long before a transition
+#define ALARM_HOLD_MAX_S            3600
+
+typedef enum {
+    AlarmStateNormal = 0,
+    AlarmStatePendingActive,    // above threshold, hold time not elapsed
+    AlarmStateActive,
+    AlarmStatePendingClear,     // below clear level, hold time not elapsed
+    AlarmStateMax
+} eAlarmState;
+
+/**
+ * @brief CO2 임계값 알람 (threshold, hysteresis, minimum duration)
+ * @note evaluated in the measurement task on every published sample with constant work,
+ *       only transitions are handed to the devices (Boolean State StateValue + StateChange event)
+ */
+class CAlarmEngine
+{
+public:
+    CAlarmEngine();
+    virtual ~CAlarmEngine();
+    static CAlarmEngine* Instance();
+
+public:
+    bool configure(uint16_t threshold_ppm, uint16_t hysteresis_ppm, uint16_t hold_s);
+    bool process(int32_t co2ppm, int64_t now_us);
+    bool is_active() { return m_state == AlarmStateActive || m_state == AlarmStatePendingClear; }
+    bool is_enabled() { return m_threshold_ppm > 0; }
+
+    void print_status();
+    void reset_stats();
+
+private:
+    static CAlarmEngine *_instance;
+    std::atomic<uint16_t> m_threshold_ppm;
+    std::atomic<uint16_t> m_hysteresis_ppm;
+    std::atomic<uint32_t> m_hold_ms;
+
+    std::atomic<eAlarmState> m_state;
+    std::atomic<int64_t> m_pending_since_us;
+    std::atomic<int64_t> m_changed_us;      // last transition
+    std::atomic<int32_t> m_last_value;
+
+    std::atomic<uint32_t> m_samples;
+    std::atomic<uint32_t> m_raised;
+    std::atomic<uint32_t> m_cleared;
+    std::atomic<uint32_t> m_debounced;      // pending transitions cancelled before the hold time
+};
+
+inline CAlarmEngine* GetAlarmEngine() {
+    return CAlarmEngine::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+#ifndef _CALIBRATION_H_
+#define _CALIBRATION_H_
+
+#include <stdint.h>
+#include <atomic>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRC_WARMUP_MS           180000  // periodic measurement required before forced recalibration
+#define FRC_TARGET_MIN_PPM      400
+#define FRC_TARGET_MAX_PPM      2000
+
+typedef enum {
+    FrcStateIdle = 0,
+    FrcStateWarmup,                     // periodic measurement running for FRC_WARMUP_MS
+    FrcStateStopping,                   // waiting for periodic measurement to stop
+    FrcStatePerforming                  // waiting for the recalibration command to complete
+} eFrcState;
+
+typedef enum {
+    FrcResultNone = 0,
+    FrcResultSuccess,
+    FrcResultFailed,
+    FrcResultAborted                    // measurement mode was changed during warmup
+} eFrcResult;
+
+typedef enum {
+    CalibrationActionNone = 0,          // measure as usual
+    CalibrationActionBusy,              // sensor reserved, do not touch it
+    CalibrationActionSetMode            // switch measurement mode to get_requested_mode()
+} eCalibrationAction;
+
+typedef void (*calibration_result_cb_t)(eFrcResult result, int16_t correction, void *arg);
+
+/**
+ * @brief forced recalibration scheduler and automatic self calibration setting
+ * @note process() is stepped by the measurement task and never blocks, outcome of the last FRC is kept in NVS
+ */
+class CCalibration
+{
+public:
+    CCalibration();
+    virtual ~CCalibration();
+    static CCalibration* Instance();
+
+public:
+    bool initialize();
+
+    bool start_frc(uint16_t target_ppm, int current_mode, int64_t now_us);
+    eCalibrationAction process(int current_mode, int64_t now_us);
+    eCalibrationAction report_mode_failure();
+    int get_requested_mode() { return m_requested_mode; }
+    eFrcState get_frc_state() { return m_state; }
+    eFrcResult get_last_result() { return m_last_result; }
+    int16_t get_last_correction() { return m_last_correction; }
+    void set_result_callback(calibration_result_cb_t callback, void *arg);
+
+    bool set_auto_calibration(bool enabled);
+    bool get_auto_calibration() { return m_asc_target; }
+    bool is_work_due();
+    bool apply_pending();
+    void invalidate() { m_asc_valid = false; }
+    void factory_reset_done();
+
+    void print_status();
+
+private:
+    static CCalibration *_instance;
+    bool m_initialized;
+    std::atomic<eFrcState> m_state;
+    uint16_t m_target_ppm;
+    int m_prev_mode;
+    int m_requested_mode;
+    bool m_mode_requested;
+    int64_t m_warmup_start_us;
+    int64_t m_deadline_us;
+    calibration_result_cb_t m_result_callback;
+    void *m_result_callback_arg;
+
+    std::atomic<bool> m_asc_target;
+    bool m_asc_applied;
+    bool m_asc_valid;
+
+    // persisted
+    uint32_t m_frc_count;
+    eFrcResult m_last_result;
+    int16_t m_last_correction;
+    uint16_t m_last_target_ppm;
+
+    eCalibrationAction finish(eFrcResult result, int16_t correction);
+    void load_settings();
+    void save_settings();
+};
+
+inline CCalibration* GetCalibration() {
+    return CCalibration::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef _COMPENSATION_H_
+#define _COMPENSATION_H_
+
+#include <stdint.h>
+#include <atomic>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COMPENSATION_PERSIST_BUDGET         200     // lifetime persist_settings writes (10% of the EEPROM endurance)
+#define COMPENSATION_PERSIST_INTERVAL_MS    3600000 // changes are batched at least this long before persisting
+#define COMPENSATION_TEMPERATURE_OFFSET_MAX 20.f    // degC
+#define COMPENSATION_ALTITUDE_MAX           3000    // m
+#define COMPENSATION_PRESSURE_MIN_HPA       700
+#define COMPENSATION_PRESSURE_MAX_HPA       1200
+#define COMPENSATION_PRESSURE_DEADBAND_HPA  1.f     // command resolution is 1 hPa
+
+typedef float (*pressure_source_cb_t)(void *arg);  // ambient pressure (hPa), <= 0 if not available
+
+/**
+ * @brief 센서 보정값 (temperature offset, altitude, ambient pressure) 관리
+ * @note configured values are cached in NVS and re-applied by the host, sensor EEPROM is written only in batches under a lifetime budget
+ */
+class CCompensation
+{
+public:
+    CCompensation();
+    virtual ~CCompensation();
+    static CCompensation* Instance();
+
+public:
+    bool initialize();
+
+    bool set_temperature_offset(float offset);
+    float get_temperature_offset();
+    bool set_altitude(uint16_t altitude);
+    uint16_t get_altitude();
+    bool set_ambient_pressure(float pressure_hpa);    // fixed ambient pressure, 0: use pressure source or altitude
+    void set_pressure_source(pressure_source_cb_t callback, void *arg);
+
+    bool is_work_due(int64_t now_us);
+    bool apply_pending(int64_t now_us);
+    void feed_ambient_pressure();
+    void invalidate();
+    void factory_reset_done();
+
+    void print_status();
+
+private:
+    static CCompensation *_instance;
+    bool m_initialized;
+    std::atomic<uint16_t> m_target_offset_raw;
+    std::atomic<uint16_t> m_target_altitude;
+    std::atomic<uint16_t> m_fixed_pressure_hpa;
+    uint16_t m_applied_offset_raw;
+    uint16_t m_applied_altitude;
+    uint16_t m_applied_pressure_hpa;
+    bool m_applied_valid;       // false: sensor RAM settings are unknown (reinit, factory reset)
+    uint16_t m_persisted_offset_raw;
+    uint16_t m_persisted_altitude;
+    uint32_t m_persist_count;
+    int64_t m_dirty_since_us;   // first change not persisted yet, 0: none
+    pressure_source_cb_t m_pressure_source;
+    void *m_pressure_source_arg;
+
+    std::atomic<uint32_t> m_apply_writes;
+    std::atomic<uint32_t> m_pressure_writes;
+    std::atomic<uint32_t> m_pressure_skipped;
+
+    bool persist_due(int64_t now_us);
+    void load_settings();
+    void save_settings();
+};
+
+inline CCompensation* GetCompensation() {
+    return CCompensation::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
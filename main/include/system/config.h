@@ -0,0 +1,160 @@
+#pragma once
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONFIG_MAGIC            0x4346  // 'CF'
+#define CONFIG_VERSION          5       // bump whenever fields are appended to system_config_t
+#define CONFIG_UPDATE_MAX_ITEMS 8
+
+// manufacturer specific cluster (test vendor prefix) on the root endpoint, attribute id is the field index (eConfigField)
+#define CONFIG_CLUSTER_ID       0xFFF1FC11
+
+/**
+ * @brief runtime configuration, loaded once at boot and read as a whole by its users
+ * @note fields are only appended (never reordered or removed), older records are migrated by keeping the stored prefix
+ */
+typedef struct {
+    // version 1
+    uint32_t measure_period_ms;     // single shot period when adaptive sampling is off
+    uint8_t measure_mode;           // eMeasureMode
+    uint8_t adaptive_sampling;
+    uint8_t i2c_gpio_scl;
+    uint8_t i2c_gpio_sda;
+    uint32_t i2c_freq;              // default max clock, selected per device by error rate
+    uint32_t adaptive_min_ms;
+    uint32_t adaptive_max_ms;
+    uint16_t co2_min_ppm;           // CarbonDioxideConcentrationMeasurement MinMeasuredValue
+    uint16_t co2_max_ppm;           // CarbonDioxideConcentrationMeasurement MaxMeasuredValue
+    // version 2
+    uint8_t filter_mode;            // eFilterMode
+    uint8_t filter_window;          // median window, odd
+    uint8_t filter_alpha;           // EMA weight of the newest sample (%)
+    uint8_t filter_gate;            // outlier gate (x0.1 MAD), 0: disabled
+    // version 3
+    uint8_t power_mode;             // ePowerMode
+    // version 4
+    uint16_t alarm_co2_ppm;         // CO2 alarm threshold, 0: disabled
+    uint16_t alarm_hyst_ppm;
+    uint16_t alarm_hold_s;          // minimum duration of a crossing
+    // version 5
+    uint8_t range_window;           // 0: Min/MaxMeasuredValue from co2_min/co2_max, else observed over eRollingWindow + 1
+} system_config_t;
+
+typedef struct {
+    uint16_t magic;
+    uint16_t version;
+    uint16_t size;                  // payload size
+    uint16_t reserved;
+    uint32_t crc;                   // crc32 of the payload
+} config_header_t;
+
+typedef enum {
+    ConfigFieldMeasurePeriod = 0,
+    ConfigFieldMeasureMode,
+    ConfigFieldAdaptiveSampling,
+    ConfigFieldAdaptiveMin,
+    ConfigFieldAdaptiveMax,
+    ConfigFieldCo2Min,
+    ConfigFieldCo2Max,
+    ConfigFieldFilterMode,
+    ConfigFieldFilterWindow,
+    ConfigFieldFilterAlpha,
+    ConfigFieldFilterGate,
+    ConfigFieldPowerMode,
+    ConfigFieldAlarmCo2,
+    ConfigFieldAlarmHysteresis,
+    ConfigFieldAlarmHold,
+    ConfigFieldRangeWindow,
+    ConfigFieldI2CScl,              // fields from here are console only (not exposed to matter)
+    ConfigFieldI2CSda,
+    ConfigFieldI2CFreq,
+    ConfigFieldMax
+} eConfigField;
+
+#define CONFIG_MATTER_FIELD_COUNT   ConfigFieldI2CScl
+
+typedef enum {
+    ConfigTypeU8 = 0,
+    ConfigTypeU16,
+    ConfigTypeU32,
+    ConfigTypeBool,
+    ConfigTypeEnum8
+} eConfigType;
+
+typedef struct {
+    const char *name;
+    uint16_t offset;
+    eConfigType type;
+    int32_t min;
+    int32_t max;
+} config_field_t;
+
+typedef struct {
+    eConfigField field;
+    int32_t value;
+} config_item_t;
+
+typedef void (*config_changed_cb_t)(void *arg);
+
+/**
+ * @brief 버전/CRC 가 포함된 NVS blob 형태의 설정 관리
+ * @note update() validates and persists all items at once (single blob write) before the cached copy is replaced,
+ *       changes are applied live by the measurement task (RequestApplyConfig)
+ */
+class CConfig
+{
+public:
+    CConfig();
+    virtual ~CConfig();
+    static CConfig* Instance();
+
+public:
+    bool initialize();
+
+    void get(system_config_t *config);
+    bool update(const config_item_t *items, int count);
+    bool set(eConfigField field, int32_t value);
+    bool reset();
+    void set_changed_callback(config_changed_cb_t callback, void *arg);
+
+    static const config_field_t* get_field(eConfigField field);
+    static bool find_field(const char *name, eConfigField *field);
+    static int32_t get_value(const system_config_t *config, eConfigField field);
+
+    void print();
+
+private:
+    static CConfig *_instance;
+    bool m_initialized;
+    SemaphoreHandle_t m_mutex;
+    system_config_t m_config;
+    uint16_t m_loaded_version;      // version of the record found at boot, 0: none
+    uint32_t m_save_count;
+    config_changed_cb_t m_changed_callback;
+    void *m_changed_callback_arg;
+
+    static void set_value(system_config_t *config, eConfigField field, int32_t value);
+    static void load_defaults(system_config_t *config);
+    static bool validate(const system_config_t *config);
+    bool load();
+    bool save(const system_config_t *config);
+    bool migrate(uint16_t version, const uint8_t *payload, size_t size, system_config_t *config);
+};
+
+inline CConfig* GetConfig() {
+    return CConfig::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
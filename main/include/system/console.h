@@ -0,0 +1,68 @@
+#pragma once
+#ifndef _CONSOLE_H_
+#define _CONSOLE_H_
+
+#include <stdint.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief registers firmware specific commands under the esp_matter console ("matter sensor ...", "matter log ...", "matter i2c ...", "matter config ...")
+ * @note handlers only post requests to the measurement task or read snapshots, they never touch the sensor directly
+ */
+class CConsole
+{
+public:
+    CConsole();
+    virtual ~CConsole();
+    static CConsole* Instance();
+
+public:
+    bool initialize();
+
+private:
+    static CConsole *_instance;
+    bool m_initialized;
+
+    static esp_err_t dispatch_sensor(int argc, char **argv);
+    static esp_err_t handler_period(int argc, char **argv);
+    static esp_err_t handler_mode(int argc, char **argv);
+    static esp_err_t handler_frc(int argc, char **argv);
+    static esp_err_t handler_selftest(int argc, char **argv);
+    static esp_err_t handler_stats(int argc, char **argv);
+    static esp_err_t handler_history(int argc, char **argv);
+    static esp_err_t handler_health(int argc, char **argv);
+    static esp_err_t handler_compensation(int argc, char **argv);
+    static esp_err_t handler_calibration(int argc, char **argv);
+    static esp_err_t handler_adaptive(int argc, char **argv);
+    static esp_err_t handler_filter(int argc, char **argv);
+    static esp_err_t handler_power(int argc, char **argv);
+    static esp_err_t handler_energy(int argc, char **argv);
+    static esp_err_t handler_derived(int argc, char **argv);
+    static esp_err_t handler_alarm(int argc, char **argv);
+    static esp_err_t handler_rolling(int argc, char **argv);
+
+    static esp_err_t dispatch_log(int argc, char **argv);
+    static esp_err_t handler_log_crash(int argc, char **argv);
+
+    static esp_err_t dispatch_i2c(int argc, char **argv);
+    static esp_err_t handler_i2c_stats(int argc, char **argv);
+    static esp_err_t handler_i2c_scan(int argc, char **argv);
+
+    static esp_err_t dispatch_config(int argc, char **argv);
+    static esp_err_t handler_config_show(int argc, char **argv);
+    static esp_err_t handler_config_set(int argc, char **argv);
+    static esp_err_t handler_config_reset(int argc, char **argv);
+};
+
+inline CConsole* GetConsole() {
+    return CConsole::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
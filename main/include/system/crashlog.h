@@ -0,0 +1,69 @@
+#pragma once
+#ifndef _CRASHLOG_H_
+#define _CRASHLOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRASHLOG_RING_SIZE      4096    // RTC slow memory, power of 2
+#define CRASHLOG_MAGIC          0x474C5243  // "CRLG"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t head;              // monotonic write position of the ring
+    uint32_t reset_reason;      // esp_reset_reason_t of the boot that saved the ring (flash copy only)
+    uint32_t boot_count;
+} crashlog_header_t;
+
+/**
+ * @brief keeps the latest log records in a reset-surviving RTC memory ring (RTC_NOINIT)
+ * @note the ring of the previous session is copied to the "crashlog" partition at boot,
+ *       so it is kept after power loss and can be dumped by the console ("matter log crash")
+ */
+class CCrashLog
+{
+public:
+    CCrashLog();
+    virtual ~CCrashLog();
+    static CCrashLog* Instance();
+
+public:
+    bool initialize();
+    bool clear();
+
+    /**
+     * @brief append a log record (lock-free and bounded time, safe to call from any task)
+     * @param[in] type log item type (eLogType | flags)
+     * @param[in] timestamp esp_log_timestamp() at the call
+     * @param[in] data text line or binary record
+     * @param[in] len data length
+     */
+    static void append(uint8_t type, uint32_t timestamp, const void *data, size_t len);
+
+    /**
+     * @brief print records of the previous session (flash copy) or of the current session (RTC ring)
+     * @return number of records
+     */
+    size_t print(bool current);
+
+private:
+    static CCrashLog *_instance;
+    bool m_initialized;
+    const esp_partition_t *m_partition;
+
+    size_t print_ring(const crashlog_header_t *header, const uint8_t *ring);
+};
+
+inline CCrashLog* GetCrashLog() {
+    return CCrashLog::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
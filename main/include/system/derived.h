@@ -0,0 +1,63 @@
+#pragma once
+#ifndef _DERIVED_H_
+#define _DERIVED_H_
+
+#include <stdint.h>
+#include <atomic>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Magnus coefficients over water (Sensirion application note, -45 ~ 60 degC)
+#define DERIVED_MAGNUS_B_Q16            1154744     // 17.62 (Q16)
+#define DERIVED_MAGNUS_C_X100           24312       // 243.12 degC
+#define DERIVED_TEMPERATURE_MIN         -4500       // inputs are clamped to the range of the coefficients (0.01 degC)
+#define DERIVED_TEMPERATURE_MAX         6000
+#define DERIVED_HUMIDITY_MIN            1           // ln(0) is undefined (0.01 %RH)
+#define DERIVED_HUMIDITY_MAX            10000
+#define DERIVED_LUT_BITS                5           // 32 segments per octave, linear interpolation
+
+/**
+ * @brief 온습도에서 이슬점 / 절대습도 파생 채널 계산 (fixed point Magnus, ln / exp2 lookup tables)
+ * @note inputs and outputs in the units published to matter, recomputed only when an input changes
+ *       dew point: 0.01 degC, absolute humidity: 0.01 g/m3
+ */
+class CDerivedChannels
+{
+public:
+    CDerivedChannels();
+    virtual ~CDerivedChannels();
+    static CDerivedChannels* Instance();
+
+public:
+    bool update(int32_t temperature, int32_t humidity);
+    bool is_valid() { return m_valid; }
+    int16_t get_dew_point() { return m_dew_point; }
+    uint16_t get_absolute_humidity() { return m_absolute_humidity; }
+
+    static void calculate(int32_t temperature, int32_t humidity, int16_t *dew_point, uint16_t *absolute_humidity);
+
+    void print_status();
+    void reset_stats();
+
+private:
+    static CDerivedChannels *_instance;
+    std::atomic<bool> m_valid;
+    std::atomic<int32_t> m_temperature;     // inputs of the last computation
+    std::atomic<int32_t> m_humidity;
+    std::atomic<int16_t> m_dew_point;
+    std::atomic<uint16_t> m_absolute_humidity;
+
+    std::atomic<uint32_t> m_computes;
+    std::atomic<uint32_t> m_skips;          // inputs unchanged
+};
+
+inline CDerivedChannels* GetDerivedChannels() {
+    return CDerivedChannels::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef _ENERGY_H_
+#define _ENERGY_H_
+
+#include <stdint.h>
+#include <atomic>
+#include "jsonwriter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ENERGY_SUPPLY_MV            3300
+#define ENERGY_WIFI_TX_REPORT_US    20000   // estimated radio on time per published sample (report to subscribers, ack)
+#define ENERGY_SENSOR_SHOT_MS       5000    // single shot measurement
+
+// energy model of the firmware (CPowerManager battery estimate too), typical currents at 3.3 V (ESP32 module datasheet, SCD41 datasheet)
+// sleep floor: automatic light sleep with Wi-Fi association kept (DTIM wake ups averaged) + sensor idle or asleep
+#define ENERGY_ESP_SLEEP_UA         2500
+#define ENERGY_SENSOR_IDLE_UA       150
+#define ENERGY_SENSOR_SLEEP_UA      1       // 0.5 uA
+
+// default current figures above the sleep floor (uA), configurable from the console
+#define ENERGY_SENSOR_MEASURING_UA  14850   // single shot in progress or periodic measurement (15 mA average)
+#define ENERGY_SENSOR_LOW_POWER_UA  3200    // low power periodic measurement (average)
+#define ENERGY_I2C_BUSY_UA          1400    // pull-ups (2 x 2.2 kohm) with SDA/SCL low half of the time + controller
+#define ENERGY_CPU_AWAKE_UA         37500   // measurement task running, 40 mA with Wi-Fi modem sleep between DTIM beacons
+#define ENERGY_WIFI_TX_UA           180000  // 802.11n TX
+
+typedef enum {
+    EnergySensorMeasuring = 0,
+    EnergySensorLowPower,
+    EnergyI2CBusy,
+    EnergyCpuAwake,
+    EnergyWifiTx,
+    EnergyStateMax
+} eEnergyState;
+
+typedef struct {
+    std::atomic<int64_t> since_us;      // 0: not active
+    std::atomic<int64_t> active_us;
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> current_ua;
+} energy_state_t;
+
+/**
+ * @brief 서브시스템별 active 시간 누적 및 전류값 기반 에너지 추정
+ * @note hooks take no mutex and may be called from any task, 64 bit atomics are not lock-free on the ESP32
+ *       (libatomic wraps them in a short critical section). begin() of an active state and end() of an inactive state are ignored
+ */
+class CEnergyMonitor
+{
+public:
+    CEnergyMonitor();
+    virtual ~CEnergyMonitor();
+    static CEnergyMonitor* Instance();
+
+public:
+    void begin(eEnergyState state, int64_t now_us);
+    void end(eEnergyState state, int64_t now_us);
+    void add(eEnergyState state, int64_t duration_us);
+
+    bool set_current(eEnergyState state, uint32_t current_ua);
+    uint32_t get_current(eEnergyState state) { return m_state[state].current_ua; }
+    int64_t get_since_us() { return m_since_us; }
+    int64_t get_active_us(eEnergyState state, int64_t now_us);
+    double get_charge_mas(eEnergyState state, int64_t now_us);
+    static bool find_state(const char *name, eEnergyState *state);
+
+    void print_report();
+    void write_report_json(CJsonWriter *writer);
+    void reset_stats();
+
+private:
+    static CEnergyMonitor *_instance;
+    energy_state_t m_state[EnergyStateMax];
+    std::atomic<int64_t> m_since_us;
+};
+
+inline CEnergyMonitor* GetEnergyMonitor() {
+    return CEnergyMonitor::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include <stdint.h>
+#include <atomic>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FILTER_WINDOW_MAX       5       // median window, odd
+#define FILTER_REJECT_LIMIT     2       // consecutive outliers accepted as a level change (window opened, sensor moved)
+#define FILTER_MAD_SCALE        1483    // 1.4826 x 1000, MAD to standard deviation of normal noise
+
+typedef enum {
+    FilterModeOff = 0,
+    FilterModeEma,
+    FilterModeKalman
+} eFilterMode;
+
+typedef enum {
+    FilterChannelCo2 = 0,       // ppm
+    FilterChannelTemperature,   // 0.01 degC
+    FilterChannelHumidity,      // 0.01 %RH
+    FilterChannelMax
+} eFilterChannel;
+
+typedef struct {
+    int32_t window[FILTER_WINDOW_MAX];
+    uint8_t count;
+    uint8_t head;
+    uint8_t rejects;            // consecutive outliers
+    bool initialized;
+    int32_t estimate;           // Q8
+    int32_t variance;           // Q8, kalman error covariance
+    int32_t last_raw;
+    int32_t last_output;
+} filter_state_t;
+
+typedef struct {
+    uint8_t mode;               // configuration the states were built with
+    uint8_t window;
+    uint16_t reserved;
+    int32_t alpha;
+    int32_t gate_x10;
+    filter_state_t state[FilterChannelMax];
+} filter_snapshot_t;
+
+/**
+ * @brief acquisition 과 publish 사이의 측정값 필터 (MAD outlier gate -> median -> EMA or 1-D Kalman)
+ * @note integer arithmetic in the units published to matter, constant state per channel
+ *       humidity skips gate and median and follows steps beyond 0.4 %RH at once (channel_params in filter.cpp)
+ */
+class CMeasurementFilter
+{
+public:
+    CMeasurementFilter();
+    virtual ~CMeasurementFilter();
+    static CMeasurementFilter* Instance();
+
+public:
+    void configure(eFilterMode mode, uint8_t window, uint8_t alpha_percent, uint8_t gate_x10);
+    int32_t process(eFilterChannel channel, int32_t value);
+    void reset();
+    void save(filter_snapshot_t *snapshot);
+    bool restore(const filter_snapshot_t *snapshot);
+
+    void print_status();
+    void reset_stats();
+
+private:
+    static CMeasurementFilter *_instance;
+    eFilterMode m_mode;
+    uint8_t m_window;
+    int32_t m_alpha;            // Q16
+    int32_t m_gate_x10;         // 0: gate disabled
+    filter_state_t m_state[FilterChannelMax];
+
+    std::atomic<uint32_t> m_raw_changes[FilterChannelMax];      // updates published without filtering
+    std::atomic<uint32_t> m_output_changes[FilterChannelMax];   // updates published
+    std::atomic<uint32_t> m_outliers[FilterChannelMax];
+    std::atomic<uint32_t> m_level_changes[FilterChannelMax];
+
+    bool is_outlier(eFilterChannel channel, int32_t value);
+    void push(filter_state_t *state, int32_t value);
+    int32_t smooth(eFilterChannel channel, int32_t value);
+    static int32_t median(const int32_t *values, int count);
+};
+
+inline CMeasurementFilter* GetMeasurementFilter() {
+    return CMeasurementFilter::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <stdint.h>
+#include <atomic>
+#include "jsonwriter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HISTOGRAM_BUCKET_COUNT  28  // bucket n counts values in [2^(n-1), 2^n) us, last bucket is open ended (>= 67 sec)
+
+/**
+ * @brief log2 bucketed latency histogram, safe to record from one task while another reads
+ */
+class CHistogram
+{
+public:
+    CHistogram();
+
+public:
+    void record(int64_t value_us);
+    void reset();
+
+    uint32_t get_count();
+    uint32_t get_max();
+    uint32_t get_bucket(int index);
+    uint32_t get_bucket_upper_bound(int index);
+    uint32_t get_percentile(int percent);
+
+    void print(const char *name);
+    void write_json(CJsonWriter *writer, const char *key);
+
+private:
+    std::atomic<uint32_t> m_bucket[HISTOGRAM_BUCKET_COUNT];
+    std::atomic<uint32_t> m_count;
+    std::atomic<uint32_t> m_max;
+};
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,119 @@
+#pragma once
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HISTORY_CHANNEL_COUNT   3   // co2 (ppm), temperature (0.01 degC), humidity (0.01 %RH)
+
+typedef enum {
+    TierRaw = 0,
+    TierMinute,
+    TierHour,
+    TierDay,
+    TierMax
+} eHistoryTier;
+
+typedef struct {
+    uint32_t timestamp;     // seconds
+    uint16_t co2ppm;
+    int16_t temperature;    // 0.01 degC
+    uint16_t humidity;      // 0.01 %RH
+    uint16_t reserved;
+} history_sample_t;
+
+typedef struct {
+    uint32_t timestamp;     // bucket start (seconds)
+    uint32_t count;
+    int32_t min[HISTORY_CHANNEL_COUNT];
+    int32_t max[HISTORY_CHANNEL_COUNT];
+    int32_t mean[HISTORY_CHANNEL_COUNT];
+} history_bucket_t;
+
+typedef bool (*history_sample_cb_t)(const history_sample_t *sample, void *arg);
+typedef bool (*history_bucket_cb_t)(const history_bucket_t *bucket, void *arg);
+
+/**
+ * @brief fixed size record ring on a sector aligned region of the history partition
+ */
+typedef struct {
+    uint32_t offset;            // region start offset in partition
+    uint32_t sector_count;
+    uint32_t record_size;
+    uint32_t records_per_sector;
+    uint32_t capacity;          // records
+    uint32_t head;              // sequence number of next record
+} history_region_t;
+
+/**
+ * @brief open (not yet persisted) rollup bucket
+ */
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+    int32_t min[HISTORY_CHANNEL_COUNT];
+    int32_t max[HISTORY_CHANNEL_COUNT];
+    int64_t sum[HISTORY_CHANNEL_COUNT];
+} history_accumulator_t;
+
+class CHistory
+{
+public:
+    CHistory();
+    virtual ~CHistory();
+    static CHistory* Instance();
+
+public:
+    bool initialize();
+    bool release();
+
+    void append_sample(uint16_t co2ppm, float temperature, float humidity);
+
+    size_t query_samples(uint32_t ts_from, uint32_t ts_to, history_sample_cb_t callback, void *arg);
+    size_t query_buckets(eHistoryTier tier, uint32_t ts_from, uint32_t ts_to, history_bucket_cb_t callback, void *arg);
+
+    uint32_t get_timestamp();
+    uint32_t get_tier_period(eHistoryTier tier);
+    uint32_t get_tier_capacity(eHistoryTier tier);
+    uint32_t get_tier_retention(eHistoryTier tier);
+    void set_tier_retention(eHistoryTier tier, uint32_t retention_sec);
+
+private:
+    static CHistory *_instance;
+    bool m_initialized;
+    const esp_partition_t *m_partition;
+    SemaphoreHandle_t m_mutex;
+    uint32_t m_time_base;
+    history_region_t m_region[TierMax];
+    history_accumulator_t m_accumulator[TierMax];
+    uint32_t m_retention[TierMax];
+
+    bool region_init(history_region_t *region, uint32_t offset, uint32_t sector_count, uint32_t record_size);
+    bool region_append(history_region_t *region, void *record);
+    bool region_read(history_region_t *region, uint32_t seq, void *record);
+    uint32_t region_oldest(history_region_t *region);
+    uint32_t region_lower_bound(eHistoryTier tier, uint32_t ts_from);
+
+    void accumulator_reset(history_accumulator_t *acc, uint32_t start);
+    void accumulator_add(history_accumulator_t *acc, const history_sample_t *sample);
+    void accumulator_to_bucket(const history_accumulator_t *acc, history_bucket_t *bucket);
+    void rollup(eHistoryTier tier, const history_sample_t *sample);
+    void replay();
+};
+
+inline CHistory* GetHistory() {
+    return CHistory::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef _JSON_WRITER_H_
+#define _JSON_WRITER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JSON_WRITER_BUFFER_SIZE     128
+#define JSON_WRITER_MAX_DEPTH       32
+
+typedef void (*json_sink_t)(const char *data, size_t len, void *arg);
+
+/**
+ * @brief streaming JSON writer, emits text to a sink through a small fixed buffer (no heap allocation)
+ */
+class CJsonWriter
+{
+public:
+    CJsonWriter(json_sink_t sink, void *arg);
+    virtual ~CJsonWriter();
+
+public:
+    void begin_object(const char *key = nullptr);
+    void end_object();
+    void begin_array(const char *key = nullptr);
+    void end_array();
+
+    /* array elements */
+    void value_string(const char *value);
+    void value_string(const char *value, size_t len);
+    void value_int(int64_t value);
+    void value_uint(uint64_t value);
+    void value_double(double value);
+    void value_bool(bool value);
+    void value_null();
+
+    /* object members */
+    void add_string(const char *key, const char *value);
+    void add_string(const char *key, const char *value, size_t len);
+    void add_int(const char *key, int64_t value);
+    void add_uint(const char *key, uint64_t value);
+    void add_double(const char *key, double value);
+    void add_bool(const char *key, bool value);
+    void add_null(const char *key);
+
+    void flush();
+    size_t get_written_length() { return m_written + m_length; }
+
+    static void sink_stdout(const char *data, size_t len, void *arg);
+
+private:
+    json_sink_t m_sink;
+    void *m_sink_arg;
+    char m_buffer[JSON_WRITER_BUFFER_SIZE];
+    size_t m_length;
+    size_t m_written;
+    uint32_t m_first;   // bit per nesting level: no element written yet
+    uint8_t m_depth;
+
+    void write(const char *data, size_t len);
+    void write_char(char c);
+    void write_escaped(const char *value, size_t len);
+    void write_key(const char *key);
+    void separator();
+    void begin(char c, const char *key);
+    void end(char c);
+};
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -4,14 +4,52 @@
 
 #include <stdio.h>
 #include <stdarg.h>
-#include <string>
+#include <stdint.h>
 #include <cstring>
+#include <stddef.h>
+#include <type_traits>
+#ifndef UNIT_TEST
+#include "sdkconfig.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define MAXLEN_LOG_MSG  1024
+#define MAXLEN_LOG_MSG              256     // formatted line length (stack buffer of the calling task)
+#define LOG_RING_BUFFER_SIZE        4096
+#define LOG_DRAIN_TASK_STACK_DEPTH  2560
+#define LOG_DRAIN_TASK_PRIORITY     1
+#define LOG_BINARY_MAX_STRING       32      // %s arguments are copied up to this length in binary mode
+
+// binary log mode: only format string address, timestamp and raw arguments are recorded,
+// decode the output with scripts/decode_binlog.py (requires the ELF of the running firmware)
+#ifndef LOGGER_BINARY_ENABLE
+#define LOGGER_BINARY_ENABLE        0
+#endif
+
+// compile-time log level (same scale as esp_log_level_t: 1=error, 2=warning, 3=info, 4=debug)
+#ifndef LOGGER_LEVEL
+#ifdef CONFIG_LOG_MAXIMUM_LEVEL
+#define LOGGER_LEVEL                CONFIG_LOG_MAXIMUM_LEVEL
+#else
+#define LOGGER_LEVEL                4
+#endif
+#endif
+
+// per call site token bucket for Warning / Error / Exception logs (error paths in polling loops)
+#ifndef LOG_RATE_LIMIT_ENABLE
+#define LOG_RATE_LIMIT_ENABLE       1
+#endif
+#define LOG_RATE_TABLE_SIZE         32      // call sites tracked at once (power of 2)
+#define LOG_RATE_BURST              5       // messages
+#define LOG_RATE_REFILL_MS          1000    // one message per period after the burst
+
+// log item type = eLogType | flags (ring buffer and crash log records)
+#define LOG_ITEM_TYPE_MASK          0x0F
+#define LOG_ITEM_WAKEUP             0x20    // ring buffer only, wakes the drain task up
+#define LOG_ITEM_CALLSITE           0x40
+#define LOG_ITEM_BINARY             0x80
 
 typedef enum
 {
@@ -22,75 +60,153 @@ typedef enum
 	Exception
 } eLogType;
 
+/**
+ * @brief 호출 위치 정보를 담는 경량 로거 (호출할 때마다 스택에 생성되며 공유 상태를 변경하지 않음)
+ * @note 포맷된 메시지는 ring buffer에 넣고 우선순위가 낮은 drain 태스크가 UART로 출력한다
+ *       (호출한 태스크는 heap 할당이나 UART 대기를 하지 않음)
+ */
 class CLogger
 {
-public:
-    CLogger();
-    virtual ~CLogger();
-
 public:
     /**
-     * @brief 객체 인스턴스 호출 메서드
      * @param[in] logtype 로그 타입
-     * @param[in] funcname 함수 이름
-     * @param[in] filename 파일 이름
+     * @param[in] funcname 함수 이름 시작 위치 (nullptr이면 메시지만 기록)
+     * @param[in] funclen 함수 이름 길이
+     * @param[in] filename 파일 이름 (디렉터리 제외)
      * @param[in] fileline 라인 넘버
-     * @return CLogger* 
      */
-    static CLogger* Instance(eLogType logtype, const char* funcname, const char* filename, const unsigned long fileline);
+    CLogger(eLogType logtype, const char* funcname, int funclen, const char* filename, const unsigned long fileline)
+        : m_eLogType(logtype), m_funcname(funcname), m_funclen(funclen), m_filename(filename), m_fileline(fileline) {}
 
+public:
     /**
-     * @brief 
+     * @brief 로그 기록 메서드
+     * @param[in] msg 포맷 문자열
+     * @param[in] ... arguments
+     */
+    void Log(const char* msg, ...) const;
+
+    /**
+     * @brief drain 태스크 종료 (이후 로그는 호출한 태스크에서 직접 출력)
      */
     static void Release();
 
     /**
-     * @brief 로그 기록 메서드
-     * @param[in] msg 포맷 문자열
-     * @param[in] ... arguments 
+     * @brief ring buffer가 가득 차서 버려진 메시지 수
+     */
+    static uint32_t GetDroppedCount();
+
+    /**
+     * @brief rate limit에 의해 버려진 메시지 수
+     */
+    static uint32_t GetSuppressedCount();
+
+    /**
+     * @brief 조용해진 호출 위치의 rate limit 요약 출력 ("suppressed N similar messages"), 남은 요약이 있으면 true
+     */
+    static bool FlushSuppressed();
+
+    /**
+     * @brief 텍스트 / 바이너리 레코드 출력 (drain 태스크, crash log 덤프에서 사용)
      */
-    void Log(const char* msg, ...);
+    static void Process(eLogType logtype, uint32_t timestamp, const char* msg);
+    static void ProcessBinary(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t len);
 
 private:
-    bool m_valid_funcinfo;
-    static CLogger* _instance;
     eLogType m_eLogType;
-    std::string m_funcname;
-    std::string m_filename;
+    const char* m_funcname;
+    int m_funclen;
+    const char* m_filename;
     unsigned long m_fileline;
 
-    /**
-     * @brief 실제로 콘솔 등에 로그를 기록하는 메서드
-     * @param[in] msg 
-     */
-    void Process(std::string msg);
+    static bool Start();
+    bool RateLimit(const char* msg, uint32_t* suppressed) const;
+    void Emit(const char* msg, ...) const;
+    void Write(const char* msg, va_list args) const;
+    static void task_drain_function(void *param);
 };
 
 /**
- * @brief 
- * @param logtype 
- * @param funcname 
- * @param filename 
- * @param fileline 
- * @return CLogger* 
+ * @brief __PRETTY_FUNCTION__에서 함수 이름의 끝 위치 (인자 목록 시작 '(')
+ */
+constexpr size_t log_funcname_end(const char* pretty)
+{
+    size_t i = 0;
+    while (pretty[i] && pretty[i] != '(')
+        i++;
+    return i;
+}
+
+/**
+ * @brief __PRETTY_FUNCTION__에서 함수 이름의 시작 위치 (반환 타입 다음, ex: "bool CSystem::initialize()" -> "CSystem::initialize")
+ */
+constexpr size_t log_funcname_begin(const char* pretty)
+{
+    size_t begin = 0;
+    int depth = 0;
+    for (size_t i = 0; i < log_funcname_end(pretty); i++) {
+        if (pretty[i] == '<') {
+            depth++;
+        } else if (pretty[i] == '>') {
+            depth--;
+        } else if (pretty[i] == ' ' && depth == 0) {
+            begin = i + 1;
+        }
+    }
+    return begin;
+}
+
+/**
+ * @brief __FILE__에서 디렉터리를 제외한 파일 이름의 시작 위치
  */
-inline CLogger* _GetLogger(eLogType logtype, const char* funcname, const char* filename, const unsigned long fileline) {
-    return CLogger::Instance(logtype, funcname, filename, fileline);
+constexpr size_t log_basename_begin(const char* path)
+{
+    size_t begin = 0;
+    for (size_t i = 0; path[i]; i++) {
+        if (path[i] == '/' || path[i] == '\\')
+            begin = i + 1;
+    }
+    return begin;
+}
+
+constexpr int log_level(eLogType logtype)
+{
+    return (logtype == eLogType::Error || logtype == eLogType::Exception) ? 1 :
+           (logtype == eLogType::Warning) ? 2 :
+           (logtype == eLogType::Info) ? 3 : 4;
 }
 
 /**
- * @brief 
+ * @brief
+ * @param logger 호출 위치 정보 (임시 객체, 호출 구문이 끝날 때까지 유효)
+ * @return const CLogger*
+ */
+inline const CLogger* _GetLogger(const CLogger& logger) {
+    return &logger;
+}
+
+/**
+ * @brief
  */
 inline void ReleaseLogger() {
     CLogger::Release();
 }
 
-#define GetLoggerBase() _GetLogger(eLogType::Info, __PRETTY_FUNCTION__, __FILE__, __LINE__)
-#define GetLogger(n) _GetLogger(n, __PRETTY_FUNCTION__, __FILE__, __LINE__)
-#define GetLoggerM(n) _GetLogger(n, nullptr, nullptr, 0)
+// forces evaluation at compile time
+#define LOG_CONSTANT(x) std::integral_constant<size_t, (x)>::value
+#define LOG_ENABLED(n) (log_level(n) <= LOGGER_LEVEL)
+#define LOG_CALLSITE(n) CLogger(n, \
+    __PRETTY_FUNCTION__ + LOG_CONSTANT(log_funcname_begin(__PRETTY_FUNCTION__)), \
+    (int)(LOG_CONSTANT(log_funcname_end(__PRETTY_FUNCTION__)) - LOG_CONSTANT(log_funcname_begin(__PRETTY_FUNCTION__))), \
+    __FILE__ + LOG_CONSTANT(log_basename_begin(__FILE__)), __LINE__)
+
+// statement form only: calls below LOGGER_LEVEL (including argument evaluation) are removed by the compiler
+#define GetLoggerBase() if (!LOG_ENABLED(eLogType::Info)) {} else _GetLogger(LOG_CALLSITE(eLogType::Info))
+#define GetLogger(n) if (!LOG_ENABLED(n)) {} else _GetLogger(LOG_CALLSITE(n))
+#define GetLoggerM(n) if (!LOG_ENABLED(n)) {} else _GetLogger(CLogger(n, nullptr, 0, nullptr, 0))
 
 #ifdef __cplusplus
 };
 #endif
 
-#endif
\ No newline at end of file
+#endif
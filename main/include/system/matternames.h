@@ -0,0 +1,19 @@
+#ifndef _MATTER_NAMES_H_
+#define _MATTER_NAMES_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* "?" for unknown ids or when MATTER_NAME_LOOKUP_ENABLE is 0 (definition.h) */
+const char* get_matter_device_name(uint16_t device_id);
+const char* get_matter_cluster_name(uint32_t cluster_id);
+const char* get_matter_attribute_name(uint32_t cluster_id, uint32_t attribute_id);
+const char* get_matter_command_name(uint32_t cluster_id, uint32_t command_id);
+
+#ifdef __cplusplus
+};
+#endif
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+#ifndef _POWER_H_
+#define _POWER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include "esp_pm.h"
+#include "energy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POWER_ACTIVE_WINDOW_MS      300     // awake after each report (ICD active mode duration)
+#define POWER_CPU_FREQ_MIN_MHZ      40      // XTAL, between samples in battery mode
+#define POWER_RETAIN_MAGIC          0x50575254  // "PWRT"
+
+typedef enum {
+    PowerModeAlwaysOn = 0,
+    PowerModeBattery
+} ePowerMode;
+
+/**
+ * @brief battery mode: sensor sleep, automatic light sleep between single shots and retained pipeline state
+ * @note maps to the ICD (Intermittently Connected Device) model: idle mode lasts a sampling period (light sleep,
+ *       the Wi-Fi association and matter sessions are kept), active mode lasts POWER_ACTIVE_WINDOW_MS after each report.
+ *       the sensor is put to sleep only when the period is long enough to pay for the discarded first shot after wake up.
+ *       charges come from the energy model and active times of CEnergyMonitor (energy.h)
+ */
+class CPowerManager
+{
+public:
+    CPowerManager();
+    virtual ~CPowerManager();
+    static CPowerManager* Instance();
+
+public:
+    bool initialize();
+    bool set_mode(ePowerMode mode);
+    ePowerMode get_mode() { return m_mode; }
+
+    void stay_active(uint32_t duration_ms);
+
+    bool should_sleep_sensor(uint32_t period_ms);
+    bool sensor_sleep(int64_t now_us);
+    bool sensor_wake(int64_t now_us);
+    void record_shot() { m_shots++; }
+    void record_sample() { m_samples++; }
+
+    void retain();
+    bool restore();
+
+    void print_status(uint32_t capacity_mah);
+    void reset_stats();
+
+private:
+    static CPowerManager *_instance;
+    std::atomic<ePowerMode> m_mode;
+    esp_pm_lock_handle_t m_pm_lock;
+    bool m_retained_valid;          // retained block of the previous session found at boot
+
+    std::atomic<int64_t> m_sensor_sleep_since_us;   // 0: sensor awake
+    std::atomic<int64_t> m_sensor_sleep_us;
+    std::atomic<uint32_t> m_shots;
+    std::atomic<uint32_t> m_samples;
+    std::atomic<uint32_t> m_sensor_sleeps;
+    std::atomic<uint32_t> m_retains;
+    std::atomic<uint32_t> m_restores;
+};
+
+inline CPowerManager* GetPowerManager() {
+    return CPowerManager::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+#ifndef _ROLLING_H_
+#define _ROLLING_H_
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "filter.h"
+#include "jsonwriter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ROLLING_BUCKETS         12      // per window, the oldest bucket is dropped as a whole (window length +0 ~ -1/12)
+
+typedef enum {
+    RollingWindow5Min = 0,
+    RollingWindow1Hour,
+    RollingWindow24Hour,
+    RollingWindowMax
+} eRollingWindow;
+
+typedef struct {
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+    float mean;                 // Welford accumulators of the bucket
+    float m2;                   // sum of squared deviations from the mean
+} rolling_bucket_t;
+
+typedef struct {
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+    double mean;
+    double stddev;              // sample standard deviation
+    int64_t span_us;            // time covered by the buckets
+} rolling_result_t;
+
+typedef struct {
+    rolling_bucket_t buckets[ROLLING_BUCKETS][FilterChannelMax];
+    uint8_t head;               // bucket of the current sample
+    uint8_t used;               // buckets since reset
+    int64_t bucket_start_us;
+    int32_t min[FilterChannelMax];      // over all buckets, kept per sample and rebuilt on rotation
+    int32_t max[FilterChannelMax];
+} rolling_window_t;
+
+/**
+ * @brief 채널별 rolling 통계 (min/max/mean/stddev, 5 min / 1 h / 24 h)
+ * @note fixed RAM, constant work per sample (Welford update of the current bucket of each window),
+ *       buckets are merged (Chan et al.) only when queried. values in the units published to matter
+ */
+class CRollingStats
+{
+public:
+    CRollingStats();
+    virtual ~CRollingStats();
+    static CRollingStats* Instance();
+
+public:
+    uint32_t add(const int32_t *values, int64_t now_us);
+    bool get(eRollingWindow window, eFilterChannel channel, rolling_result_t *result);
+    bool get_range(eRollingWindow window, eFilterChannel channel, int32_t *min, int32_t *max);
+    void reset();
+
+    static const char* get_window_name(eRollingWindow window);
+    void print_status();
+    void write_report_json(CJsonWriter *writer);
+
+private:
+    static CRollingStats *_instance;
+    SemaphoreHandle_t m_mutex;
+    rolling_window_t m_windows[RollingWindowMax];
+    uint32_t m_queried_rotations;   // windows whose range was rebuilt by get()
+
+    static int64_t bucket_us(eRollingWindow window);
+    static void clear_bucket(rolling_bucket_t *bucket);
+    bool rotate(eRollingWindow window, int64_t now_us);
+    void rebuild_range(eRollingWindow window);
+};
+
+inline CRollingStats* GetRollingStats() {
+    return CRollingStats::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef _SAMPLER_H_
+#define _SAMPLER_H_
+
+#include <stdint.h>
+#include <atomic>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLER_PERIOD_MIN_MS       5000    // single shot measurement takes 5 sec
+#define SAMPLER_PERIOD_MAX_MS       60000
+#define SAMPLER_PERIOD_LIMIT_MS     600000  // upper bound of the configurable max period
+#define SAMPLER_CO2_NOISE_PPM       10.f    // changes below the sensor repeatability are ignored
+#define SAMPLER_CO2_STEP_PPM        30.f    // tolerated CO2 change between two samples
+#define SAMPLER_HUMIDITY_NOISE      0.2f    // %RH
+#define SAMPLER_HUMIDITY_STEP       1.5f    // tolerated humidity change (%RH) between two samples
+#define SAMPLER_BACKOFF_RATIO       1.5f    // period grows at most by this ratio per sample
+#define SAMPLER_RATE_DECAY          0.5f    // weight of the newest rate when the rate is falling
+
+typedef struct {
+    uint32_t period_ms;
+    float co2_rate;
+    float humidity_rate;
+} sampler_snapshot_t;
+
+/**
+ * @brief single shot measurement period controller
+ * @note period is shortened at once when CO2 or humidity changes quickly (occupancy, window opening)
+ *       and grows back gradually towards the max period while the readings are flat
+ */
+class CAdaptiveSampler
+{
+public:
+    CAdaptiveSampler();
+    virtual ~CAdaptiveSampler();
+    static CAdaptiveSampler* Instance();
+
+public:
+    void set_enabled(bool enabled);
+    bool is_enabled() { return m_enabled; }
+    bool set_period_range(uint32_t min_ms, uint32_t max_ms);
+    uint32_t get_period_min_ms() { return m_period_min_ms; }
+    uint32_t get_period_max_ms() { return m_period_max_ms; }
+    uint32_t get_period_ms() { return m_period_ms; }
+
+    uint32_t update(uint16_t co2ppm, float humidity, int64_t now_us);
+    void reset();
+    void save(sampler_snapshot_t *snapshot);
+    void restore(const sampler_snapshot_t *snapshot);
+
+    void print_status();
+    void reset_stats();
+
+private:
+    static CAdaptiveSampler *_instance;
+    std::atomic<bool> m_enabled;
+    std::atomic<uint32_t> m_period_min_ms;
+    std::atomic<uint32_t> m_period_max_ms;
+    std::atomic<uint32_t> m_period_ms;
+
+    bool m_has_prev;
+    uint16_t m_prev_co2ppm;
+    float m_prev_humidity;
+    int64_t m_prev_tick_us;
+    float m_co2_rate;           // ppm/s, filtered
+    float m_humidity_rate;      // %RH/s, filtered
+
+    std::atomic<uint32_t> m_updates;
+    std::atomic<uint32_t> m_updates_at_min;
+    std::atomic<uint32_t> m_updates_at_max;
+    std::atomic<uint32_t> m_speedups;
+
+    static float filter_rate(float rate, float current);
+};
+
+inline CAdaptiveSampler* GetAdaptiveSampler() {
+    return CAdaptiveSampler::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
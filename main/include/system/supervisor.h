@@ -0,0 +1,97 @@
+#pragma once
+#ifndef _SUPERVISOR_H_
+#define _SUPERVISOR_H_
+
+#include <stdint.h>
+#include <atomic>
+#include "histogram.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HEALTH_FAILURE_THRESHOLD    3       // consecutive failed measurements to start recovery
+#define HEALTH_STALE_INTERVALS      3       // data older than this many measurement intervals (+ margin) is stale
+#define HEALTH_STALE_MARGIN_MS      10000
+#define HEALTH_RETRY_MS             600000  // restart the escalation after all steps failed
+
+typedef enum {
+    SensorHealthOk = 0,
+    SensorHealthRecovering,                 // recovery step in progress, measurement paused
+    SensorHealthVerifying,                  // recovery step done, waiting for a valid sample
+    SensorHealthFailed                      // every step failed, retried after HEALTH_RETRY_MS
+} eSensorHealth;
+
+typedef enum {
+    RecoveryReinit = 0,
+    RecoveryWakeup,
+    RecoverySelfTest,
+    RecoveryFactoryReset,
+    RecoveryStepMax
+} eRecoveryStep;
+
+typedef enum {
+    SupervisorIdle = 0,                     // measure as usual
+    SupervisorBusy,                         // do not touch the sensor
+    SupervisorResume                        // recovery step done, restore the measurement mode before measuring
+} eSupervisorAction;
+
+/**
+ * @brief 센서 상태 감시 및 단계적 복구 (reinit -> wakeup -> self test -> factory reset)
+ * @note process() never blocks, command execution times are waited across calls from the measurement task
+ */
+class CHealthSupervisor
+{
+public:
+    CHealthSupervisor();
+    virtual ~CHealthSupervisor();
+    static CHealthSupervisor* Instance();
+
+public:
+    void set_expected_interval_ms(uint32_t interval_ms);
+    void report_success(int64_t now_us);
+    void report_failure(int64_t now_us);
+    eSupervisorAction process(int64_t now_us);
+
+    eSensorHealth get_health() { return m_health; }
+    bool is_fault() { return m_health != SensorHealthOk; }
+    bool take_fault_changed();
+    bool take_factory_reset_done();
+    uint32_t get_worst_case_recovery_ms();
+
+    void print_status();
+    void reset_stats();
+
+private:
+    static CHealthSupervisor *_instance;
+    std::atomic<eSensorHealth> m_health;
+    std::atomic<bool> m_fault_changed;
+    std::atomic<bool> m_factory_reset_done;     // sensor EEPROM settings went back to the defaults
+    uint32_t m_stale_limit_ms;
+    uint32_t m_consecutive_failures;
+    int64_t m_last_success_us;
+    int64_t m_fault_start_us;
+    int64_t m_deadline_us;      // next action (recovering), verification timeout (verifying) or retry (failed)
+    int m_step;
+    int m_action;
+    bool m_self_test_failed;
+
+    std::atomic<uint32_t> m_faults;
+    std::atomic<uint32_t> m_step_runs[RecoveryStepMax];
+    std::atomic<uint32_t> m_step_recoveries[RecoveryStepMax];
+    std::atomic<uint32_t> m_failed_escalations;
+    CHistogram m_hist_recovery;
+
+    void start_recovery(int64_t now_us, const char *reason);
+    void next_step(int64_t now_us);
+    bool run_action(int action, uint32_t *wait_ms);
+};
+
+inline CHealthSupervisor* GetHealthSupervisor() {
+    return CHealthSupervisor::Instance();
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
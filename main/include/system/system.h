@@ -4,16 +4,55 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include <esp_matter.h>
 #include <esp_matter_core.h>
 #include <iot_button.h>
 #include "I2CMaster.h"
 #include "device.h"
+#include "histogram.h"
+#include "calibration.h"
+#include "config.h"
+#include "filter.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef enum {
+    MeasureModeSingleShot = 0,
+    MeasureModePeriodic,
+    MeasureModeLowPowerPeriodic
+} eMeasureMode;
+
+typedef enum {
+    RequestApplyConfig = 0,
+    RequestForcedRecalibration,
+    RequestSelfTest,
+    RequestI2CScan                      // console bus probe, result printed by the measurement task
+} eSystemRequestType;
+
+typedef enum {
+    SelfTestIdle = 0,
+    SelfTestStopping,                   // waiting for periodic measurement to stop
+    SelfTestRunning                     // waiting for the self test to complete (10 s)
+} eSelfTestState;
+
+typedef struct {
+    eSystemRequestType type;
+    int32_t arg;
+} system_request_t;
+
+typedef struct {
+    std::atomic<uint32_t> samples;
+    std::atomic<uint32_t> read_failures;
+    std::atomic<uint32_t> discarded_samples;    // first single shot after sensor wake up
+    std::atomic<uint32_t> ready_timeouts;
+    std::atomic<uint32_t> requests_dropped;
+    std::atomic<uint32_t> self_test_count;
+    std::atomic<int32_t> self_test_result;    // -1: not performed, 0: failed, 1: passed
+} measurement_stats_t;
+
 class CSystem
 {
 public:
@@ -36,10 +75,18 @@ public:
 
     CDevice* find_device_by_endpoint_id(uint16_t endpoint_id);
 
+    bool post_request(eSystemRequestType type, int32_t arg = 0);
+    uint32_t get_measure_period_ms() { return m_measure_period_ms; }
+    uint32_t get_single_shot_period_ms();
+    eMeasureMode get_measure_mode() { return m_measure_mode; }
+    void print_measurement_stats();
+    void reset_measurement_stats();
+
 private:
     static CSystem* _instance;
     bool m_initialized;
     CI2CMaster *m_i2c_master;
+    bool m_co2_sensor_available;
 
     esp_matter::node_t* m_root_node;
     std::vector<CDevice*> m_device_list;
@@ -74,8 +121,36 @@ private:
 private:
     bool m_keepalive;
     TaskHandle_t m_task_timer_handle;
+    QueueHandle_t m_request_queue;
+    uint32_t m_measure_period_ms;
+    eMeasureMode m_measure_mode;
+    eSelfTestState m_self_test_state;
+    eMeasureMode m_self_test_prev_mode;
+    int64_t m_self_test_deadline_us;
+    system_config_t m_config;   // applied configuration, owned by the measurement task
+    measurement_stats_t m_stats;
+    int32_t m_published[FilterChannelMax];     // last published (filtered) values, reports are sent on change
+    CHistogram m_hist_data_ready;
+    CHistogram m_hist_read;
 
     static void task_timer_function(void *param);
+    bool process_requests();
+    void print_i2c_scan();
+    bool apply_config();
+    bool apply_measure_mode(eMeasureMode mode);
+    bool start_self_test(int64_t now_us);
+    bool step_self_test(int64_t now_us);
+    void finish_self_test(int32_t result);
+    bool read_and_publish_measurement();
+    void publish_sensor_fault(bool fault);
+    void publish_calibration_status();
+    void publish_alarm_state();
+    void publish_measured_value_ranges(const system_config_t *config);
+    static void callback_calibration_result(eFrcResult result, int16_t correction, void *arg);
+    static void callback_config_changed(void *arg);
+    bool matter_create_config_cluster();
+    void matter_update_config_attributes();
+    static esp_err_t matter_on_change_config_attribute(esp_matter::attribute::callback_type_t type, uint32_t attribute_id, esp_matter_attr_val_t *val);
 };
 
 inline CSystem* GetSystem() {
@@ -1,12 +1,16 @@
 #include "airqualitysensor.h"
 #include "system.h"
 #include "logger.h"
+#include "calibration.h"
+#include <app/EventLogging.h>
+#include <math.h>
 
 CAirQualitySensor::CAirQualitySensor()
 {
     m_matter_update_by_client_clus_co2measure_attr_measureval = false;
     m_matter_update_by_client_clus_tempmeasure_attr_measureval = false;
     m_matter_update_by_client_clus_relhummeasure_attr_measureval = false;
+    m_matter_update_by_client_clus_calibration_attr_autocalib = false;
 }
 
 bool CAirQualitySensor::matter_init_endpoint()
@@ -52,6 +56,9 @@ bool CAirQualitySensor::matter_config_attributes()
     if (!create_temperature_measurement_cluster()) return false;
     if (!create_relative_humidity_measurement_cluster()) return false;
     if (!create_carbon_dioxide_concentration_measurement_cluster()) return false;
+    if (!create_calibration_cluster()) return false;
+    if (!create_derived_cluster()) return false;
+    if (!create_boolean_state_cluster()) return false;
 
     return true;
 }
@@ -174,6 +181,84 @@ bool CAirQualitySensor::create_carbon_dioxide_concentration_measurement_cluster(
     return true;
 }
 
+bool CAirQualitySensor::create_calibration_cluster()
+{
+    esp_matter::cluster_t *cluster = esp_matter::cluster::get(m_endpoint, CALIBRATION_CLUSTER_ID);
+    if (cluster)
+        return true;
+
+    cluster = esp_matter::cluster::create(m_endpoint, CALIBRATION_CLUSTER_ID, esp_matter::cluster_flags::CLUSTER_FLAG_SERVER);
+    if (!cluster) {
+        GetLogger(eLogType::Error)->Log("Failed to create <Calibration> cluster");
+        return false;
+    }
+    esp_matter::cluster::global::attribute::create_cluster_revision(cluster, 1);
+    esp_matter::cluster::global::attribute::create_feature_map(cluster, 0);
+
+    uint8_t flags = esp_matter::attribute_flags::ATTRIBUTE_FLAG_WRITABLE;
+    if (!esp_matter::attribute::create(cluster, CALIBRATION_ATTR_FRC_REFERENCE_ID, flags, esp_matter_uint16(0)) ||
+        !esp_matter::attribute::create(cluster, CALIBRATION_ATTR_AUTO_CALIBRATION_ID, flags, esp_matter_bool(GetCalibration()->get_auto_calibration()))) {
+        GetLogger(eLogType::Error)->Log("Failed to create <Calibration> writable attributes");
+        return false;
+    }
+    flags = esp_matter::attribute_flags::ATTRIBUTE_FLAG_NONE;
+    if (!esp_matter::attribute::create(cluster, CALIBRATION_ATTR_FRC_STATE_ID, flags, esp_matter_enum8(FrcStateIdle)) ||
+        !esp_matter::attribute::create(cluster, CALIBRATION_ATTR_FRC_RESULT_ID, flags, esp_matter_enum8(FrcResultNone)) ||
+        !esp_matter::attribute::create(cluster, CALIBRATION_ATTR_FRC_CORRECTION_ID, flags, esp_matter_int16(0))) {
+        GetLogger(eLogType::Error)->Log("Failed to create <Calibration> status attributes");
+        return false;
+    }
+
+    return true;
+}
+
+bool CAirQualitySensor::create_derived_cluster()
+{
+    esp_matter::cluster_t *cluster = esp_matter::cluster::get(m_endpoint, DERIVED_CLUSTER_ID);
+    if (cluster)
+        return true;
+
+    cluster = esp_matter::cluster::create(m_endpoint, DERIVED_CLUSTER_ID, esp_matter::cluster_flags::CLUSTER_FLAG_SERVER);
+    if (!cluster) {
+        GetLogger(eLogType::Error)->Log("Failed to create <Derived Channels> cluster");
+        return false;
+    }
+    esp_matter::cluster::global::attribute::create_cluster_revision(cluster, 1);
+    esp_matter::cluster::global::attribute::create_feature_map(cluster, 0);
+
+    uint8_t flags = esp_matter::attribute_flags::ATTRIBUTE_FLAG_NULLABLE;
+    if (!esp_matter::attribute::create(cluster, DERIVED_ATTR_DEW_POINT_ID, flags, esp_matter_nullable_int16(nullable<int16_t>())) ||
+        !esp_matter::attribute::create(cluster, DERIVED_ATTR_ABSOLUTE_HUMIDITY_ID, flags, esp_matter_nullable_uint16(nullable<uint16_t>()))) {
+        GetLogger(eLogType::Error)->Log("Failed to create <Derived Channels> attributes");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief StateValue is true while the CO2 alarm is active (CAlarmEngine), StateChange is emitted on each transition
+ */
+bool CAirQualitySensor::create_boolean_state_cluster()
+{
+    esp_matter::cluster_t *cluster = esp_matter::cluster::get(m_endpoint, chip::app::Clusters::BooleanState::Id);
+    if (cluster)
+        return true;
+
+    esp_matter::cluster::boolean_state::config_t cfg_boolstate_cluster;
+    cluster = esp_matter::cluster::boolean_state::create(m_endpoint, &cfg_boolstate_cluster, esp_matter::cluster_flags::CLUSTER_FLAG_SERVER);
+    if (!cluster) {
+        GetLogger(eLogType::Error)->Log("Failed to create <Boolean State> cluster");
+        return false;
+    }
+    if (!esp_matter::cluster::boolean_state::event::create_state_change(cluster)) {
+        GetLogger(eLogType::Error)->Log("Failed to create <State Change> event");
+        return false;
+    }
+
+    return true;
+}
+
 bool CAirQualitySensor::set_carbon_dioxide_concentration_measurement_min_measured_value(float value)
 {
     esp_matter::cluster_t *cluster = esp_matter::cluster::get(m_endpoint, chip::app::Clusters::CarbonDioxideConcentrationMeasurement::Id);
@@ -259,6 +344,17 @@ void CAirQualitySensor::matter_on_change_attribute_value(esp_matter::attribute::
                 m_matter_update_by_client_clus_relhummeasure_attr_measureval = false;
             }
         }
+    } else if (cluster_id == CALIBRATION_CLUSTER_ID && type == esp_matter::attribute::PRE_UPDATE) {
+        // handed over to the measurement task, never run sensor commands in the matter context
+        if (attribute_id == CALIBRATION_ATTR_FRC_REFERENCE_ID) {
+            GetSystem()->post_request(RequestForcedRecalibration, (int32_t)value->val.u16);
+        } else if (attribute_id == CALIBRATION_ATTR_AUTO_CALIBRATION_ID) {
+            if (m_matter_update_by_client_clus_calibration_attr_autocalib) {
+                m_matter_update_by_client_clus_calibration_attr_autocalib = false;
+            } else {
+                GetCalibration()->set_auto_calibration(value->val.b);
+            }
+        }
     }
 }
 
@@ -267,6 +363,7 @@ void CAirQualitySensor::matter_update_all_attribute_values()
     matter_update_clus_co2measure_attr_measureval();
     matter_update_clus_tempmeasure_attr_measureval();
     matter_update_clus_relhummeasure_attr_measureval();
+    matter_update_clus_derived_attr_values();
 }
 
 void CAirQualitySensor::update_measured_value_co2ppm(float value)
@@ -281,7 +378,7 @@ void CAirQualitySensor::update_measured_value_co2ppm(float value)
 
 void CAirQualitySensor::update_measured_value_temperature(float value)
 {
-    m_measured_value_temperature = (int16_t)(value * 100.f);
+    m_measured_value_temperature = (int16_t)lroundf(value * 100.f);
     if (m_measured_value_temperature_prev != m_measured_value_temperature) {
         GetLogger(eLogType::Info)->Log("Update measured temperature value as %g", value);
         matter_update_clus_tempmeasure_attr_measureval();
@@ -291,7 +388,7 @@ void CAirQualitySensor::update_measured_value_temperature(float value)
 
 void CAirQualitySensor::update_measured_value_humidity(float value)
 {
-    m_measured_value_humidity = (uint16_t)(value * 100.f);
+    m_measured_value_humidity = (uint16_t)lroundf(value * 100.f);
     if (m_measured_value_humidity_prev != m_measured_value_humidity) {
         GetLogger(eLogType::Info)->Log("Update measured relative humidity value as %g", value);
         matter_update_clus_relhummeasure_attr_measureval();
@@ -299,9 +396,112 @@ void CAirQualitySensor::update_measured_value_humidity(float value)
     m_measured_value_humidity_prev = m_measured_value_humidity;
 }
 
+/**
+ * @brief measured values are reported as null while the sensor is faulty, air quality as Unknown
+ */
+void CAirQualitySensor::update_sensor_fault(bool fault)
+{
+    if (m_sensor_fault == fault)
+        return;
+    m_sensor_fault = fault;
+    GetLogger(eLogType::Info)->Log("Update sensor fault as %d", fault);
+
+    matter_update_clus_co2measure_attr_measureval(true);
+    matter_update_clus_tempmeasure_attr_measureval(true);
+    matter_update_clus_relhummeasure_attr_measureval(true);
+    matter_update_clus_derived_attr_values(true);
+    matter_update_clus_airquality_attr_airquality(fault ? 0 : 1);   // Unknown : Good
+}
+
+void CAirQualitySensor::update_calibration_status(uint8_t state, uint8_t result, int16_t correction, bool auto_calibration)
+{
+    bool updating = false;
+
+    matter_update_cluster_attribute_common(m_endpoint_id, CALIBRATION_CLUSTER_ID, CALIBRATION_ATTR_FRC_STATE_ID, esp_matter_enum8(state), &updating);
+    matter_update_cluster_attribute_common(m_endpoint_id, CALIBRATION_CLUSTER_ID, CALIBRATION_ATTR_FRC_RESULT_ID, esp_matter_enum8(result), &updating);
+    matter_update_cluster_attribute_common(m_endpoint_id, CALIBRATION_CLUSTER_ID, CALIBRATION_ATTR_FRC_CORRECTION_ID, esp_matter_int16(correction), &updating);
+    matter_update_cluster_attribute_common(m_endpoint_id, CALIBRATION_CLUSTER_ID, CALIBRATION_ATTR_AUTO_CALIBRATION_ID, esp_matter_bool(auto_calibration),
+        &m_matter_update_by_client_clus_calibration_attr_autocalib);
+}
+
+void CAirQualitySensor::update_co2_measured_value_range(float min_value, float max_value)
+{
+    bool updating = false;
+    uint32_t cluster_id = chip::app::Clusters::CarbonDioxideConcentrationMeasurement::Id;
+
+    GetLogger(eLogType::Info)->Log("Update CO2 measured value range as %g ~ %g", min_value, max_value);
+    matter_update_cluster_attribute_common(m_endpoint_id, cluster_id, chip::app::Clusters::CarbonDioxideConcentrationMeasurement::Attributes::MinMeasuredValue::Id,
+        esp_matter_nullable_float(min_value), &updating);
+    matter_update_cluster_attribute_common(m_endpoint_id, cluster_id, chip::app::Clusters::CarbonDioxideConcentrationMeasurement::Attributes::MaxMeasuredValue::Id,
+        esp_matter_nullable_float(max_value), &updating);
+}
+
+/**
+ * @brief NAN: null (unknown)
+ */
+void CAirQualitySensor::update_temperature_measured_value_range(float min_value, float max_value)
+{
+    bool updating = false;
+    uint32_t cluster_id = chip::app::Clusters::TemperatureMeasurement::Id;
+    esp_matter_attr_val_t min_val = isnan(min_value) ? esp_matter_nullable_int16(nullable<int16_t>()) : esp_matter_nullable_int16((int16_t)lroundf(min_value * 100.f));
+    esp_matter_attr_val_t max_val = isnan(max_value) ? esp_matter_nullable_int16(nullable<int16_t>()) : esp_matter_nullable_int16((int16_t)lroundf(max_value * 100.f));
+
+    matter_update_cluster_attribute_common(m_endpoint_id, cluster_id, chip::app::Clusters::TemperatureMeasurement::Attributes::MinMeasuredValue::Id, min_val, &updating);
+    matter_update_cluster_attribute_common(m_endpoint_id, cluster_id, chip::app::Clusters::TemperatureMeasurement::Attributes::MaxMeasuredValue::Id, max_val, &updating);
+}
+
+/**
+ * @brief NAN: null (unknown)
+ */
+void CAirQualitySensor::update_humidity_measured_value_range(float min_value, float max_value)
+{
+    bool updating = false;
+    uint32_t cluster_id = chip::app::Clusters::RelativeHumidityMeasurement::Id;
+    esp_matter_attr_val_t min_val = isnan(min_value) ? esp_matter_nullable_uint16(nullable<uint16_t>()) : esp_matter_nullable_uint16((uint16_t)lroundf(min_value * 100.f));
+    esp_matter_attr_val_t max_val = isnan(max_value) ? esp_matter_nullable_uint16(nullable<uint16_t>()) : esp_matter_nullable_uint16((uint16_t)lroundf(max_value * 100.f));
+
+    matter_update_cluster_attribute_common(m_endpoint_id, cluster_id, chip::app::Clusters::RelativeHumidityMeasurement::Attributes::MinMeasuredValue::Id, min_val, &updating);
+    matter_update_cluster_attribute_common(m_endpoint_id, cluster_id, chip::app::Clusters::RelativeHumidityMeasurement::Attributes::MaxMeasuredValue::Id, max_val, &updating);
+}
+
+/**
+ * @brief called only when a derived value changed (CDerivedChannels::update)
+ */
+void CAirQualitySensor::update_derived_values(int16_t dew_point, uint16_t absolute_humidity)
+{
+    m_derived_valid = true;
+    m_derived_dew_point = dew_point;
+    m_derived_absolute_humidity = absolute_humidity;
+    GetLogger(eLogType::Info)->Log("Update dew point as %d, absolute humidity as %u", dew_point, absolute_humidity);
+    matter_update_clus_derived_attr_values();
+}
+
+void CAirQualitySensor::update_alarm_state(bool active)
+{
+    bool updating = false;
+
+    GetLogger(eLogType::Info)->Log("Update CO2 alarm state as %d", active);
+    matter_update_cluster_attribute_common(m_endpoint_id, chip::app::Clusters::BooleanState::Id,
+        chip::app::Clusters::BooleanState::Attributes::StateValue::Id, esp_matter_bool(active), &updating);
+    matter_log_event_boolean_state_change(active);
+}
+
+void CAirQualitySensor::matter_update_clus_airquality_attr_airquality(uint8_t value)
+{
+    bool updating = false;
+    esp_matter_attr_val_t target_value = esp_matter_enum8(value);
+    matter_update_cluster_attribute_common(
+        m_endpoint_id,
+        chip::app::Clusters::AirQuality::Id,
+        chip::app::Clusters::AirQuality::Attributes::AirQuality::Id,
+        target_value,
+        &updating
+    );
+}
+
 void CAirQualitySensor::matter_update_clus_co2measure_attr_measureval(bool force_update/*=false*/)
 {
-    esp_matter_attr_val_t target_value = esp_matter_nullable_float(m_measured_value_co2ppm);
+    esp_matter_attr_val_t target_value = m_sensor_fault ? esp_matter_nullable_float(nullable<float>()) : esp_matter_nullable_float(m_measured_value_co2ppm);
     matter_update_cluster_attribute_common(
         m_endpoint_id,
         chip::app::Clusters::CarbonDioxideConcentrationMeasurement::Id,
@@ -314,7 +514,7 @@ void CAirQualitySensor::matter_update_clus_co2measure_attr_measureval(bool force
 
 void CAirQualitySensor::matter_update_clus_tempmeasure_attr_measureval(bool force_update/*=false*/)
 {
-    esp_matter_attr_val_t target_value = esp_matter_nullable_int16(m_measured_value_temperature);
+    esp_matter_attr_val_t target_value = m_sensor_fault ? esp_matter_nullable_int16(nullable<int16_t>()) : esp_matter_nullable_int16(m_measured_value_temperature);
     matter_update_cluster_attribute_common(
         m_endpoint_id,
         chip::app::Clusters::TemperatureMeasurement::Id,
@@ -327,7 +527,7 @@ void CAirQualitySensor::matter_update_clus_tempmeasure_attr_measureval(bool forc
 
 void CAirQualitySensor::matter_update_clus_relhummeasure_attr_measureval(bool force_update/*=false*/)
 {
-    esp_matter_attr_val_t target_value = esp_matter_nullable_uint16(m_measured_value_humidity);
+    esp_matter_attr_val_t target_value = m_sensor_fault ? esp_matter_nullable_uint16(nullable<uint16_t>()) : esp_matter_nullable_uint16(m_measured_value_humidity);
     matter_update_cluster_attribute_common(
         m_endpoint_id,
         chip::app::Clusters::RelativeHumidityMeasurement::Id,
@@ -336,4 +536,33 @@ void CAirQualitySensor::matter_update_clus_relhummeasure_attr_measureval(bool fo
         &m_matter_update_by_client_clus_relhummeasure_attr_measureval,
         force_update
     );
+}
+
+void CAirQualitySensor::matter_update_clus_derived_attr_values(bool force_update/*=false*/)
+{
+    bool updating = false;
+    bool null_value = m_sensor_fault || !m_derived_valid;
+    esp_matter_attr_val_t dew_point = null_value ? esp_matter_nullable_int16(nullable<int16_t>()) : esp_matter_nullable_int16(m_derived_dew_point);
+    esp_matter_attr_val_t absolute_humidity = null_value ? esp_matter_nullable_uint16(nullable<uint16_t>()) : esp_matter_nullable_uint16(m_derived_absolute_humidity);
+
+    matter_update_cluster_attribute_common(m_endpoint_id, DERIVED_CLUSTER_ID, DERIVED_ATTR_DEW_POINT_ID, dew_point, &updating, force_update);
+    matter_update_cluster_attribute_common(m_endpoint_id, DERIVED_CLUSTER_ID, DERIVED_ATTR_ABSOLUTE_HUMIDITY_ID, absolute_humidity, &updating, force_update);
+}
+
+void CAirQualitySensor::matter_log_event_boolean_state_change(bool state)
+{
+    chip::app::Clusters::BooleanState::Events::StateChange::Type event;
+    chip::EventNumber event_number;
+    event.stateValue = state;
+
+    // called from the measurement task, the event log belongs to the matter stack
+    if (esp_matter::lock::chip_stack_lock(portMAX_DELAY) != esp_matter::lock::SUCCESS) {
+        GetLogger(eLogType::Error)->Log("Failed to lock matter stack");
+        return;
+    }
+    CHIP_ERROR err = chip::app::LogEvent(event, m_endpoint_id, event_number);
+    esp_matter::lock::chip_stack_unlock();
+    if (err != CHIP_NO_ERROR) {
+        GetLogger(eLogType::Error)->Log("Failed to log <State Change> event (err: %" CHIP_ERROR_FORMAT ")", err.Format());
+    }
 }
\ No newline at end of file
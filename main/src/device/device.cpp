@@ -1,6 +1,7 @@
 #include "device.h"
 #include "logger.h"
 #include "system.h"
+#include <math.h>
 
 CDevice::CDevice()
 {
@@ -12,6 +13,10 @@ CDevice::CDevice()
     m_measured_value_temperature_prev = 0;
     m_measured_value_humidity = 0;
     m_measured_value_humidity_prev = 0;
+    m_derived_valid = false;
+    m_derived_dew_point = 0;
+    m_derived_absolute_humidity = 0;
+    m_sensor_fault = false;
 }
 
 CDevice::~CDevice()
@@ -211,10 +216,39 @@ void CDevice::update_measured_value_co2ppm(float value)
 
 void CDevice::update_measured_value_temperature(float value)
 {
-    m_measured_value_temperature = (int16_t)(value * 100.f);
+    m_measured_value_temperature = (int16_t)lroundf(value * 100.f);
 }
 
 void CDevice::update_measured_value_humidity(float value)
 {
-    m_measured_value_humidity = (uint16_t)(value * 100.f);
+    m_measured_value_humidity = (uint16_t)lroundf(value * 100.f);
+}
+
+void CDevice::update_sensor_fault(bool fault)
+{
+    m_sensor_fault = fault;
+}
+
+void CDevice::update_calibration_status(uint8_t state, uint8_t result, int16_t correction, bool auto_calibration)
+{
+}
+
+void CDevice::update_co2_measured_value_range(float min_value, float max_value)
+{
+}
+
+void CDevice::update_temperature_measured_value_range(float min_value, float max_value)
+{
+}
+
+void CDevice::update_humidity_measured_value_range(float min_value, float max_value)
+{
+}
+
+void CDevice::update_derived_values(int16_t dew_point, uint16_t absolute_humidity)
+{
+}
+
+void CDevice::update_alarm_state(bool active)
+{
 }
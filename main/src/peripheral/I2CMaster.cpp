@@ -1,6 +1,20 @@
 #include "I2CMaster.h"
 #include "driver/i2c.h"
+#include "driver/gpio.h"
 #include "logger.h"
+#include "energy.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "definition.h"
+#include "nvs.h"
+#include <inttypes.h>
+
+static const char *op_names[I2COpMax] = {"write", "read", "write_read"};
+static const char *breaker_names[] = {"closed", "open", "half-open"};
+static const uint32_t clock_ladder[] = {50000, 100000, 200000, 400000, 1000000};
+static const int clock_ladder_count = sizeof(clock_ladder) / sizeof(clock_ladder[0]);
+
+#define I2C_CLOCK_NVS_NAMESPACE     "i2c_clock"
 
 CI2CMaster* CI2CMaster::_instance = nullptr;
 
@@ -8,6 +22,24 @@ CI2CMaster::CI2CMaster()
 {
     m_initialized = false;
     m_port = 0;
+    m_gpio_scl = -1;
+    m_gpio_sda = -1;
+    m_clk_speed = 0;
+    m_bus_clk_speed = 0;
+    for (int i = 0; i < I2C_STATS_DEVICE_COUNT; i++) {
+        m_stats[i].address = 0;
+        m_stats[i].breaker = I2CBreakerClosed;
+        m_stats[i].failures = 0;
+        m_stats[i].backoff_ms = 0;
+        m_stats[i].retry_at_us = 0;
+        m_stats[i].clk_speed = 0;
+        m_stats[i].clk_min = 0;
+        m_stats[i].clk_max = 0;
+        m_stats[i].window_count = 0;
+        m_stats[i].window_errors = 0;
+        m_stats[i].clean_windows = 0;
+    }
+    reset_stats();
 }
 
 CI2CMaster::~CI2CMaster()
@@ -25,18 +57,32 @@ CI2CMaster* CI2CMaster::Instance()
 
 bool CI2CMaster::initialize(int port, int gpio_scl, int gpio_sda, uint32_t clk_speed)
 {
-    esp_err_t ret;
-    
     m_initialized = false;
 
     m_port = port;
+    m_gpio_scl = gpio_scl;
+    m_gpio_sda = gpio_sda;
+    m_clk_speed = clk_speed;
+    m_bus_clk_speed = clk_speed;
+    if (!install_driver()) {
+        return false;
+    }
+    m_initialized = true;
+    GetLogger(eLogType::Info)->Log("Initialized (port num: %d, gpio scl: %d, gpio sda: %d, clock: %u)", m_port, gpio_scl, gpio_sda, clk_speed);
+    return true;
+}
+
+bool CI2CMaster::install_driver()
+{
+    esp_err_t ret;
+
     i2c_config_t i2c_conf;
     i2c_conf.mode = I2C_MODE_MASTER;
-    i2c_conf.sda_io_num = gpio_sda;
-    i2c_conf.scl_io_num = gpio_scl;
+    i2c_conf.sda_io_num = m_gpio_sda;
+    i2c_conf.scl_io_num = m_gpio_scl;
     i2c_conf.sda_pullup_en = GPIO_PULLUP_ENABLE,
     i2c_conf.scl_pullup_en = GPIO_PULLUP_ENABLE,
-    i2c_conf.master.clk_speed = clk_speed,
+    i2c_conf.master.clk_speed = m_bus_clk_speed,
     i2c_conf.clk_flags = 0;
 
     ret = i2c_param_config((i2c_port_t)m_port, &i2c_conf);
@@ -49,11 +95,270 @@ bool CI2CMaster::initialize(int port, int gpio_scl, int gpio_sda, uint32_t clk_s
         GetLogger(eLogType::Error)->Log("Failed to install i2c driver (ret: %d)", ret);
         return false;
     }
-    m_initialized = true;
-    GetLogger(eLogType::Info)->Log("Initialized (port num: %d, gpio scl: %d, gpio sda: %d, clock: %u)", m_port, gpio_scl, gpio_sda, clk_speed);
+
     return true;
 }
 
+bool CI2CMaster::set_bus_clock(uint32_t clk_speed)
+{
+    if (clk_speed == m_bus_clk_speed)
+        return true;
+
+    i2c_config_t i2c_conf;
+    i2c_conf.mode = I2C_MODE_MASTER;
+    i2c_conf.sda_io_num = m_gpio_sda;
+    i2c_conf.scl_io_num = m_gpio_scl;
+    i2c_conf.sda_pullup_en = GPIO_PULLUP_ENABLE,
+    i2c_conf.scl_pullup_en = GPIO_PULLUP_ENABLE,
+    i2c_conf.master.clk_speed = clk_speed,
+    i2c_conf.clk_flags = 0;
+
+    // only bus timing registers are changed, the driver stays installed
+    esp_err_t ret = i2c_param_config((i2c_port_t)m_port, &i2c_conf);
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to change clock to %u Hz (ret: %d)", clk_speed, ret);
+        return false;
+    }
+    m_bus_clk_speed = clk_speed;
+    return true;
+}
+
+void CI2CMaster::set_device_clock_range(uint8_t dev_addr, uint32_t min_hz, uint32_t max_hz)
+{
+    i2c_device_stats_t *stats = get_device_stats(dev_addr);
+    if (!stats)
+        return;
+
+    stats->clk_min = min_hz;
+    stats->clk_max = max_hz;
+    uint32_t clk_speed = stats->clk_speed;
+    if (clk_speed < min_hz || clk_speed > max_hz) {
+        stats->clk_speed = clk_speed < min_hz ? min_hz : max_hz;
+    }
+}
+
+void CI2CMaster::report_crc_error(uint8_t dev_addr)
+{
+    i2c_device_stats_t *stats = get_device_stats(dev_addr);
+    if (!stats)
+        return;
+
+    stats->crc_errors++;
+    track_clock(stats, true);
+}
+
+/**
+ * @brief step the device clock down on intermittent errors, up again after long error free periods
+ * @note errors count only when followed by a success, an outage (device unplugged or powered down) does not change the clock
+ */
+void CI2CMaster::track_clock(i2c_device_stats_t *stats, bool error)
+{
+    uint32_t clk_speed = stats->clk_speed;
+    uint32_t next = clk_speed;
+
+    stats->window_count++;
+    if (error) {
+        stats->window_errors++;
+    }
+
+    if (!error && stats->window_errors >= I2C_CLOCK_DOWN_ERRORS) {
+        for (int i = clock_ladder_count - 1; i >= 0; i--) {
+            if (clock_ladder[i] < clk_speed && clock_ladder[i] >= stats->clk_min) {
+                next = clock_ladder[i];
+                break;
+            }
+        }
+        stats->clean_windows = 0;
+    } else if (stats->window_count >= I2C_CLOCK_WINDOW) {
+        stats->clean_windows = stats->window_errors ? 0 : stats->clean_windows + 1;
+        if (stats->clean_windows >= I2C_CLOCK_UP_WINDOWS) {
+            for (int i = 0; i < clock_ladder_count; i++) {
+                if (clock_ladder[i] > clk_speed && clock_ladder[i] <= stats->clk_max) {
+                    next = clock_ladder[i];
+                    break;
+                }
+            }
+            stats->clean_windows = 0;
+        }
+    } else {
+        return;
+    }
+
+    stats->window_count = 0;
+    stats->window_errors = 0;
+    if (next != clk_speed) {
+        stats->clk_speed = next;
+        stats->clock_changes++;
+        save_device_clock(stats);
+        GetLogger(eLogType::Info)->Log("Device 0x%02X clock %u -> %u Hz", stats->address.load(), clk_speed, next);
+    }
+}
+
+void CI2CMaster::load_device_clock(i2c_device_stats_t *stats)
+{
+    nvs_handle_t handle;
+    char key[8];
+    uint32_t value = 0;
+
+    stats->clk_min = MIN(I2C_CLOCK_MIN_DEFAULT, m_clk_speed);
+    stats->clk_max = m_clk_speed;
+    stats->clk_speed = m_clk_speed;
+    snprintf(key, sizeof(key), "dev_%02x", stats->address.load());
+    if (nvs_open(I2C_CLOCK_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        if (nvs_get_u32(handle, key, &value) == ESP_OK && value >= stats->clk_min && value <= stats->clk_max) {
+            stats->clk_speed = value;
+        }
+        nvs_close(handle);
+    }
+}
+
+void CI2CMaster::save_device_clock(i2c_device_stats_t *stats)
+{
+    nvs_handle_t handle;
+    char key[8];
+    esp_err_t ret;
+
+    snprintf(key, sizeof(key), "dev_%02x", stats->address.load());
+    ret = nvs_open(I2C_CLOCK_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to open nvs (ret: %d)", ret);
+        return;
+    }
+    ret = nvs_set_u32(handle, key, stats->clk_speed);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to save clock (ret: %d)", ret);
+    }
+    nvs_close(handle);
+}
+
+/**
+ * @brief free a bus held by a slave (SDA stuck low): clock out SCL up to 9 times, generate STOP and reinstall the driver
+ */
+bool CI2CMaster::recover_bus()
+{
+    m_bus_recoveries++;
+    i2c_driver_delete((i2c_port_t)m_port);
+
+    gpio_config_t io_conf = {};
+    io_conf.pin_bit_mask = (1ULL << m_gpio_scl) | (1ULL << m_gpio_sda);
+    io_conf.mode = GPIO_MODE_INPUT_OUTPUT_OD;
+    io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
+    gpio_config(&io_conf);
+    gpio_set_level((gpio_num_t)m_gpio_sda, 1);
+    gpio_set_level((gpio_num_t)m_gpio_scl, 1);
+    esp_rom_delay_us(5);
+
+    int pulses = 0;
+    while (pulses < 9 && gpio_get_level((gpio_num_t)m_gpio_sda) == 0) {
+        gpio_set_level((gpio_num_t)m_gpio_scl, 0);
+        esp_rom_delay_us(5);
+        gpio_set_level((gpio_num_t)m_gpio_scl, 1);
+        esp_rom_delay_us(5);
+        pulses++;
+    }
+    // STOP condition (SDA rising while SCL high)
+    gpio_set_level((gpio_num_t)m_gpio_scl, 0);
+    gpio_set_level((gpio_num_t)m_gpio_sda, 0);
+    esp_rom_delay_us(5);
+    gpio_set_level((gpio_num_t)m_gpio_scl, 1);
+    esp_rom_delay_us(5);
+    gpio_set_level((gpio_num_t)m_gpio_sda, 1);
+    esp_rom_delay_us(5);
+    bool released = gpio_get_level((gpio_num_t)m_gpio_sda) == 1;
+
+    bool result = install_driver();
+    GetLogger(eLogType::Warning)->Log("Bus recovery (clock pulses: %d, sda released: %d, driver: %d)", pulses, released, result);
+    return result && released;
+}
+
+bool CI2CMaster::probe(uint8_t dev_addr, uint32_t timeout_ms/*=I2C_PROBE_TIMEOUT_MS*/)
+{
+    if (!m_initialized)
+        return false;
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if (!cmd)
+        return false;
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin((i2c_port_t)m_port, cmd, MAX(timeout_ms / portTICK_PERIOD_MS, 1));
+    i2c_cmd_link_delete(cmd);
+
+    return ret == ESP_OK;
+}
+
+bool CI2CMaster::write_bytes_no_ack(uint8_t dev_addr, const uint8_t *data, size_t data_len, uint32_t timeout_ms/*=I2C_PROBE_TIMEOUT_MS*/)
+{
+    if (!m_initialized)
+        return false;
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if (!cmd)
+        return false;
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, false);
+    i2c_master_write(cmd, data, data_len, false);
+    i2c_master_stop(cmd);
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = i2c_master_cmd_begin((i2c_port_t)m_port, cmd, MAX(timeout_ms / portTICK_PERIOD_MS, 1));
+    GetEnergyMonitor()->add(EnergyI2CBusy, esp_timer_get_time() - start_us);
+    i2c_cmd_link_delete(cmd);
+
+    return ret == ESP_OK;
+}
+
+bool CI2CMaster::probe_write(uint8_t dev_addr, const uint8_t *data, size_t data_len, uint32_t timeout_ms/*=I2C_PROBE_TIMEOUT_MS*/)
+{
+    if (!m_initialized)
+        return false;
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = i2c_master_write_to_device((i2c_port_t)m_port, dev_addr, data, data_len, MAX(timeout_ms / portTICK_PERIOD_MS, 1));
+    GetEnergyMonitor()->add(EnergyI2CBusy, esp_timer_get_time() - start_us);
+
+    return ret == ESP_OK;
+}
+
+bool CI2CMaster::probe_read(uint8_t dev_addr, uint8_t *data, size_t data_len, uint32_t timeout_ms/*=I2C_PROBE_TIMEOUT_MS*/)
+{
+    if (!m_initialized)
+        return false;
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = i2c_master_read_from_device((i2c_port_t)m_port, dev_addr, data, data_len, MAX(timeout_ms / portTICK_PERIOD_MS, 1));
+    GetEnergyMonitor()->add(EnergyI2CBusy, esp_timer_get_time() - start_us);
+
+    return ret == ESP_OK;
+}
+
+int CI2CMaster::scan(uint8_t *found, int max_count)
+{
+    if (!m_initialized) {
+        GetLogger(eLogType::Error)->Log("Not initialized");
+        return 0;
+    }
+
+    // device clocks are not known yet, transactions after the scan switch to the device clock again
+    set_bus_clock(I2C_SCAN_CLOCK);
+    int count = 0;
+    int64_t start_us = esp_timer_get_time();
+    for (uint8_t addr = I2C_SCAN_ADDR_FIRST; addr <= I2C_SCAN_ADDR_LAST; addr++) {
+        if (!probe(addr))
+            continue;
+        if (count < max_count) {
+            found[count] = addr;
+        }
+        count++;
+    }
+    GetLogger(eLogType::Info)->Log("Bus scan found %d device(s) (%" PRId64 " us)", count, esp_timer_get_time() - start_us);
+
+    return MIN(count, max_count);
+}
+
 bool CI2CMaster::release()
 {
     esp_err_t ret;
@@ -76,14 +381,11 @@ bool CI2CMaster::write_bytes(uint8_t dev_addr, uint8_t *data, size_t data_len, u
         return false;
     }
 
-    esp_err_t ret;
-    ret = i2c_master_write_to_device(
-        (i2c_port_t)m_port, 
-        dev_addr, 
-        data, 
-        data_len, 
-        timeout_ms / portTICK_PERIOD_MS
-    );
+    if (!is_device_available(dev_addr)) {
+        return false;
+    }
+
+    int ret = transfer(dev_addr, I2COpWrite, data, data_len, nullptr, 0, timeout_ms);
     if (ret != ESP_OK) {
         GetLogger(eLogType::Error)->Log("Failed to write (ret: %d)", ret);
         return false;
@@ -99,14 +401,11 @@ bool CI2CMaster::read_bytes(uint8_t dev_addr, uint8_t *data, size_t data_len, ui
         return false;
     }
 
-    esp_err_t ret;
-    ret = i2c_master_read_from_device(
-        (i2c_port_t)m_port, 
-        dev_addr, 
-        data, 
-        data_len, 
-        timeout_ms / portTICK_PERIOD_MS
-    );
+    if (!is_device_available(dev_addr)) {
+        return false;
+    }
+
+    int ret = transfer(dev_addr, I2COpRead, nullptr, 0, data, data_len, timeout_ms);
     if (ret != ESP_OK) {
         GetLogger(eLogType::Error)->Log("Failed to read (ret: %d)", ret);
         return false;
@@ -122,19 +421,210 @@ bool CI2CMaster::write_and_read_bytes(uint8_t dev_addr, uint8_t *data_write, siz
         return false;
     }
 
-    esp_err_t ret;
-    ret = i2c_master_write_read_device(
-        (i2c_port_t)m_port, 
-        dev_addr, 
-        data_write, 
-        data_write_len, 
-        data_read,
-        data_read_len, 
-        timeout_ms / portTICK_PERIOD_MS
-    );
+    if (!is_device_available(dev_addr)) {
+        return false;
+    }
+
+    int ret = transfer(dev_addr, I2COpWriteRead, data_write, data_write_len, data_read, data_read_len, timeout_ms);
     if (ret != ESP_OK) {
         GetLogger(eLogType::Error)->Log("Failed to write and read (ret: %d)", ret);
         return false;
     }
     return true;
-}
\ No newline at end of file
+}
+
+i2c_device_stats_t* CI2CMaster::get_device_stats(uint8_t dev_addr)
+{
+    for (int i = 0; i < I2C_STATS_DEVICE_COUNT; i++) {
+        uint8_t address = m_stats[i].address.load(std::memory_order_relaxed);
+        if (address == dev_addr)
+            return &m_stats[i];
+        if (address == 0) {
+            // claim free slot (another task may claim it first for another device)
+            if (m_stats[i].address.compare_exchange_strong(address, dev_addr)) {
+                load_device_clock(&m_stats[i]);
+                return &m_stats[i];
+            }
+            if (address == dev_addr)
+                return &m_stats[i];
+        }
+    }
+    return nullptr;
+}
+
+bool CI2CMaster::is_device_available(uint8_t dev_addr)
+{
+    i2c_device_stats_t *stats = get_device_stats(dev_addr);
+    if (!stats || stats->breaker != I2CBreakerOpen)
+        return true;
+
+    if (esp_timer_get_time() >= stats->retry_at_us) {
+        stats->breaker = I2CBreakerHalfOpen;
+        return true;
+    }
+    stats->skipped++;
+    return false;
+}
+
+void CI2CMaster::update_breaker(i2c_device_stats_t *stats, bool success)
+{
+    if (success) {
+        if (stats->breaker != I2CBreakerClosed) {
+            GetLogger(eLogType::Info)->Log("Device 0x%02X recovered", stats->address.load());
+        }
+        stats->breaker = I2CBreakerClosed;
+        stats->failures = 0;
+        stats->backoff_ms = 0;
+        return;
+    }
+
+    stats->failures++;
+    if (stats->breaker == I2CBreakerHalfOpen || stats->failures >= I2C_BREAKER_THRESHOLD) {
+        stats->backoff_ms = stats->backoff_ms ? MIN(stats->backoff_ms * 2, (uint32_t)I2C_BACKOFF_MAX_MS) : I2C_BACKOFF_BASE_MS;
+        stats->retry_at_us = esp_timer_get_time() + (int64_t)stats->backoff_ms * 1000;
+        stats->breaker = I2CBreakerOpen;
+        stats->window_count = 0;
+        stats->window_errors = 0;
+        GetLogger(eLogType::Warning)->Log("Device 0x%02X not responding (failures: %u), skipped for %u ms", stats->address.load(), stats->failures, stats->backoff_ms);
+    }
+}
+
+int CI2CMaster::transfer(uint8_t dev_addr, eI2COp op, const uint8_t *data_write, size_t data_write_len, uint8_t *data_read, size_t data_read_len, uint32_t timeout_ms)
+{
+    i2c_device_stats_t *stats = get_device_stats(dev_addr);
+    esp_err_t ret = ESP_FAIL;
+
+    for (int attempt = 0; attempt <= I2C_RETRY_COUNT; attempt++) {
+        if (attempt > 0) {
+            if (stats) {
+                stats->retries++;
+            }
+            // bus fault (timeout, bus busy): a slave may hold SDA low
+            if (ret == ESP_ERR_TIMEOUT || ret == ESP_ERR_INVALID_STATE) {
+                recover_bus();
+            }
+            // keep the worst case blocking time bounded
+            timeout_ms = MIN(timeout_ms, (uint32_t)I2C_RETRY_TIMEOUT_MS);
+        }
+
+        if (stats) {
+            set_bus_clock(stats->clk_speed);
+        }
+        int64_t start_us = esp_timer_get_time();
+        if (op == I2COpWrite) {
+            ret = i2c_master_write_to_device((i2c_port_t)m_port, dev_addr, data_write, data_write_len, timeout_ms / portTICK_PERIOD_MS);
+        } else if (op == I2COpRead) {
+            ret = i2c_master_read_from_device((i2c_port_t)m_port, dev_addr, data_read, data_read_len, timeout_ms / portTICK_PERIOD_MS);
+        } else {
+            ret = i2c_master_write_read_device((i2c_port_t)m_port, dev_addr, data_write, data_write_len, data_read, data_read_len, timeout_ms / portTICK_PERIOD_MS);
+        }
+        int64_t elapsed_us = esp_timer_get_time() - start_us;
+        GetEnergyMonitor()->add(EnergyI2CBusy, elapsed_us);
+        if (stats) {
+            record_transaction(stats, op, ret, elapsed_us);
+            track_clock(stats, ret != ESP_OK);
+        }
+        if (ret == ESP_OK)
+            break;
+    }
+
+    if (stats) {
+        update_breaker(stats, ret == ESP_OK);
+    }
+    return ret;
+}
+
+void CI2CMaster::record_transaction(i2c_device_stats_t *stats, eI2COp op, int ret, int64_t elapsed_us)
+{
+    i2c_op_stats_t *op_stats = &stats->op[op];
+    op_stats->count.fetch_add(1, std::memory_order_relaxed);
+    op_stats->latency.record(elapsed_us);
+    if (ret == ESP_FAIL) {
+        op_stats->nack.fetch_add(1, std::memory_order_relaxed);
+    } else if (ret == ESP_ERR_TIMEOUT) {
+        op_stats->timeout.fetch_add(1, std::memory_order_relaxed);
+    } else if (ret != ESP_OK) {
+        op_stats->error.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void CI2CMaster::reset_stats()
+{
+    for (int i = 0; i < I2C_STATS_DEVICE_COUNT; i++) {
+        for (int j = 0; j < I2COpMax; j++) {
+            i2c_op_stats_t *op_stats = &m_stats[i].op[j];
+            op_stats->count = 0;
+            op_stats->nack = 0;
+            op_stats->timeout = 0;
+            op_stats->error = 0;
+            op_stats->latency.reset();
+        }
+        m_stats[i].retries = 0;
+        m_stats[i].skipped = 0;
+        m_stats[i].crc_errors = 0;
+        m_stats[i].clock_changes = 0;
+    }
+    m_bus_recoveries = 0;
+}
+
+void CI2CMaster::print_stats()
+{
+    char name[32];
+
+    printf("port: %d, clock: %" PRIu32 " Hz, bus recoveries: %" PRIu32 "\n", m_port, m_bus_clk_speed, m_bus_recoveries.load());
+    for (int i = 0; i < I2C_STATS_DEVICE_COUNT; i++) {
+        uint8_t address = m_stats[i].address.load(std::memory_order_relaxed);
+        if (!address)
+            continue;
+        printf("0x%02x: clock=%" PRIu32 " Hz (changes: %" PRIu32 "), breaker=%s, retries=%" PRIu32 ", skipped=%" PRIu32 ", crc errors=%" PRIu32 "\n",
+            address, m_stats[i].clk_speed.load(), m_stats[i].clock_changes.load(), breaker_names[m_stats[i].breaker],
+            m_stats[i].retries.load(), m_stats[i].skipped.load(), m_stats[i].crc_errors.load());
+        for (int j = 0; j < I2COpMax; j++) {
+            i2c_op_stats_t *op_stats = &m_stats[i].op[j];
+            if (!op_stats->count)
+                continue;
+            printf("0x%02x %s: count=%" PRIu32 ", nack=%" PRIu32 ", timeout=%" PRIu32 ", error=%" PRIu32 "\n",
+                address, op_names[j], op_stats->count.load(), op_stats->nack.load(), op_stats->timeout.load(), op_stats->error.load());
+            snprintf(name, sizeof(name), "0x%02x %s latency", address, op_names[j]);
+            op_stats->latency.print(name);
+        }
+    }
+}
+
+void CI2CMaster::write_stats_json(CJsonWriter *writer)
+{
+    char address_str[8];
+
+    writer->begin_object();
+    writer->add_int("port", m_port);
+    writer->add_uint("clock", m_bus_clk_speed);
+    writer->add_uint("bus_recoveries", m_bus_recoveries.load());
+    writer->begin_array("devices");
+    for (int i = 0; i < I2C_STATS_DEVICE_COUNT; i++) {
+        uint8_t address = m_stats[i].address.load(std::memory_order_relaxed);
+        if (!address)
+            continue;
+        snprintf(address_str, sizeof(address_str), "0x%02x", address);
+        writer->begin_object();
+        writer->add_string("address", address_str);
+        writer->add_string("breaker", breaker_names[m_stats[i].breaker]);
+        writer->add_uint("retries", m_stats[i].retries.load());
+        writer->add_uint("skipped", m_stats[i].skipped.load());
+        writer->add_uint("crc_errors", m_stats[i].crc_errors.load());
+        writer->add_uint("clock", m_stats[i].clk_speed.load());
+        writer->add_uint("clock_changes", m_stats[i].clock_changes.load());
+        for (int j = 0; j < I2COpMax; j++) {
+            i2c_op_stats_t *op_stats = &m_stats[i].op[j];
+            writer->begin_object(op_names[j]);
+            writer->add_uint("count", op_stats->count.load());
+            writer->add_uint("nack", op_stats->nack.load());
+            writer->add_uint("timeout", op_stats->timeout.load());
+            writer->add_uint("error", op_stats->error.load());
+            op_stats->latency.write_json(writer, "latency_us");
+            writer->end_object();
+        }
+        writer->end_object();
+    }
+    writer->end_array();
+    writer->end_object();
+}
@@ -0,0 +1,295 @@
+#include "i2cdetector.h"
+#include "logger.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+#include <inttypes.h>
+
+#define I2C_DETECT_TIMEOUT_MS       20
+#define SENSIRION_CRC8_INIT         0xFF
+#define SENSIRION_CRC8_POLYNOMIAL   0x31
+#define SENSIRION_EXEC_TIME_US      1000    // command execution time before the result can be read
+#define SCD4X_I2C_ADDR              0x62
+#define SCD4X_WAKE_UP               0x36F6  // not acknowledged by the sensor
+#define SCD4X_WAKE_UP_TIME_MS       30
+#define SCD4X_STOP_PERIODIC         0x3F86  // still running after an ESP reset, id commands are rejected meanwhile
+#define SCD4X_STOP_PERIODIC_TIME_MS 500
+#define SCD4X_GET_SERIAL_NUMBER     0x3682
+#define SCD4X_GET_SENSOR_VARIANT    0x202F  // not supported by early firmware
+#define SCD4X_VARIANT_UNKNOWN       0xFFFF
+#define SHT4X_READ_SERIAL_NUMBER    0x89
+#define SHT3X_READ_SERIAL_NUMBER    0x3780  // clock stretching disabled
+#define BOSCH_REG_CHIP_ID           0xD0
+#define BOSCH_CHIP_ID_BMP180        0x55
+#define BOSCH_CHIP_ID_BMP280        0x58
+#define BOSCH_CHIP_ID_BME280        0x60
+#define BOSCH_CHIP_ID_BME680        0x61
+
+static const char *part_names[I2CPartMax] = {"unknown", "SCD4x", "SHT3x", "SHT4x", "BMP180", "BMP280", "BME280", "BME680"};
+
+CI2CDetector* CI2CDetector::_instance = nullptr;
+
+CI2CDetector::CI2CDetector()
+{
+    m_i2c_master = nullptr;
+    m_device_count = 0;
+    m_elapsed_us = 0;
+}
+
+CI2CDetector::~CI2CDetector()
+{
+}
+
+CI2CDetector* CI2CDetector::Instance()
+{
+    if (!_instance) {
+        _instance = new CI2CDetector();
+    }
+
+    return _instance;
+}
+
+int CI2CDetector::detect(CI2CMaster *i2c_master)
+{
+    uint8_t found[I2C_DETECT_MAX_DEVICES];
+    int64_t start_us = esp_timer_get_time();
+
+    m_i2c_master = i2c_master;
+    m_device_count = m_i2c_master->scan(found, I2C_DETECT_MAX_DEVICES);
+    if (m_device_count < I2C_DETECT_MAX_DEVICES && wakeup_scd4x(found, m_device_count)) {
+        found[m_device_count++] = SCD4X_I2C_ADDR;
+    }
+    for (int i = 0; i < m_device_count; i++) {
+        memset(&m_devices[i], 0, sizeof(i2c_detected_device_t));
+        m_devices[i].address = found[i];
+        identify(&m_devices[i]);
+    }
+    m_elapsed_us = esp_timer_get_time() - start_us;
+
+    for (int i = 0; i < m_device_count; i++) {
+        GetLogger(eLogType::Info)->Log("Detected 0x%02X: %s%s", m_devices[i].address, get_part_name(&m_devices[i]), m_devices[i].identified ? "" : " (not identified)");
+    }
+    GetLogger(eLogType::Info)->Log("Detection done (%d device(s), %" PRId64 " us)", m_device_count, m_elapsed_us);
+
+    return m_device_count;
+}
+
+const i2c_detected_device_t* CI2CDetector::get_device(int index)
+{
+    if (index < 0 || index >= m_device_count)
+        return nullptr;
+    return &m_devices[index];
+}
+
+const i2c_detected_device_t* CI2CDetector::find_part(eI2CPart part)
+{
+    for (int i = 0; i < m_device_count; i++) {
+        if (m_devices[i].part == part)
+            return &m_devices[i];
+    }
+    return nullptr;
+}
+
+const char* CI2CDetector::get_part_name(const i2c_detected_device_t *device)
+{
+    if (device->part == I2CPartSCD4x) {
+        switch (device->variant >> 12) {
+        case 0: return "SCD40";
+        case 1: return "SCD41";
+        case 5: return "SCD43";
+        default: break;
+        }
+    }
+    if (device->part >= I2CPartMax)
+        return part_names[I2CPartUnknown];
+    return part_names[device->part];
+}
+
+void CI2CDetector::print()
+{
+    printf("%d device(s), detection took %" PRId64 " us\n", m_device_count, m_elapsed_us);
+    for (int i = 0; i < m_device_count; i++) {
+        const i2c_detected_device_t *device = &m_devices[i];
+        printf("  0x%02X: %-8s", device->address, get_part_name(device));
+        if (device->part != I2CPartUnknown) {
+            if (!device->identified) {
+                printf(" (guessed from address)");
+            } else if (device->id) {
+                printf(" serial: 0x%" PRIX64, device->id);
+            } else {
+                printf(" chip id: 0x%02X", device->variant);
+            }
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * @brief SCD4x in sleep mode does not acknowledge its address, wake it up if it was not found by the scan
+ */
+bool CI2CDetector::wakeup_scd4x(const uint8_t *found, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (found[i] == SCD4X_I2C_ADDR)
+            return false;
+    }
+
+    uint8_t command[2] = {
+        (uint8_t)(SCD4X_WAKE_UP >> 8),
+        (uint8_t)(SCD4X_WAKE_UP & 0xFF)
+    };
+    m_i2c_master->write_bytes_no_ack(SCD4X_I2C_ADDR, command, sizeof(command), I2C_DETECT_TIMEOUT_MS);
+    vTaskDelay(pdMS_TO_TICKS(SCD4X_WAKE_UP_TIME_MS));
+    return m_i2c_master->probe(SCD4X_I2C_ADDR);
+}
+
+void CI2CDetector::identify(i2c_detected_device_t *device)
+{
+    switch (device->address) {
+    case SCD4X_I2C_ADDR:
+        device->part = I2CPartSCD4x;
+        device->identified = identify_scd4x(device);
+        break;
+    case 0x44:
+    case 0x45:
+    case 0x46:
+        device->identified = identify_sht4x(device) || (device->address != 0x46 && identify_sht3x(device));
+        break;
+    case 0x76:
+    case 0x77:
+        device->identified = identify_bosch(device);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief SCD4x is the only part on 0x62, it is kept as SCD4x even if the id command is rejected
+ * @note serial number can not be read during periodic measurement, it is stopped first (not acknowledged when idle)
+ */
+bool CI2CDetector::identify_scd4x(i2c_detected_device_t *device)
+{
+    uint8_t command[2];
+    uint16_t words[3];
+
+    device->variant = SCD4X_VARIANT_UNKNOWN;
+    command[0] = (uint8_t)(SCD4X_STOP_PERIODIC >> 8);
+    command[1] = (uint8_t)(SCD4X_STOP_PERIODIC & 0xFF);
+    m_i2c_master->write_bytes_no_ack(device->address, command, sizeof(command), I2C_DETECT_TIMEOUT_MS);
+    vTaskDelay(pdMS_TO_TICKS(SCD4X_STOP_PERIODIC_TIME_MS));
+
+    command[0] = (uint8_t)(SCD4X_GET_SERIAL_NUMBER >> 8);
+    command[1] = (uint8_t)(SCD4X_GET_SERIAL_NUMBER & 0xFF);
+    if (!read_sensirion_words(device->address, command, sizeof(command), words, 3))
+        return false;
+    device->id = ((uint64_t)words[0] << 32) | ((uint64_t)words[1] << 16) | (uint64_t)words[2];
+
+    command[0] = (uint8_t)(SCD4X_GET_SENSOR_VARIANT >> 8);
+    command[1] = (uint8_t)(SCD4X_GET_SENSOR_VARIANT & 0xFF);
+    if (read_sensirion_words(device->address, command, sizeof(command), words, 1)) {
+        device->variant = words[0];
+    }
+    return true;
+}
+
+bool CI2CDetector::identify_sht4x(i2c_detected_device_t *device)
+{
+    uint8_t command = SHT4X_READ_SERIAL_NUMBER;
+    uint16_t words[2];
+
+    if (!read_sensirion_words(device->address, &command, 1, words, 2))
+        return false;
+    device->part = I2CPartSHT4x;
+    device->id = ((uint64_t)words[0] << 16) | (uint64_t)words[1];
+    return true;
+}
+
+bool CI2CDetector::identify_sht3x(i2c_detected_device_t *device)
+{
+    uint8_t command[2] = {
+        (uint8_t)(SHT3X_READ_SERIAL_NUMBER >> 8),
+        (uint8_t)(SHT3X_READ_SERIAL_NUMBER & 0xFF)
+    };
+    uint16_t words[2];
+
+    if (!read_sensirion_words(device->address, command, sizeof(command), words, 2))
+        return false;
+    device->part = I2CPartSHT3x;
+    device->id = ((uint64_t)words[0] << 16) | (uint64_t)words[1];
+    return true;
+}
+
+bool CI2CDetector::identify_bosch(i2c_detected_device_t *device)
+{
+    uint8_t reg = BOSCH_REG_CHIP_ID;
+    uint8_t chip_id = 0;
+
+    if (!m_i2c_master->write_and_read_bytes(device->address, &reg, 1, &chip_id, 1, I2C_DETECT_TIMEOUT_MS))
+        return false;
+    device->variant = chip_id;
+    switch (chip_id) {
+    case BOSCH_CHIP_ID_BMP180:
+        device->part = I2CPartBMP180;
+        break;
+    case 0x56:  // BMP280 engineering samples
+    case 0x57:
+    case BOSCH_CHIP_ID_BMP280:
+        device->part = I2CPartBMP280;
+        break;
+    case BOSCH_CHIP_ID_BME280:
+        device->part = I2CPartBME280;
+        break;
+    case BOSCH_CHIP_ID_BME680:
+        device->part = I2CPartBME680;
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief sensirion command + response of (16 bit word, crc8) pairs
+ * @note untracked transfers, a rejected id command must not step down the device clock or open its breaker
+ */
+bool CI2CDetector::read_sensirion_words(uint8_t dev_addr, const uint8_t *command, size_t command_len, uint16_t *words, int word_count)
+{
+    uint8_t data_read[9];
+
+    if (word_count * 3 > (int)sizeof(data_read))
+        return false;
+    if (!m_i2c_master->probe_write(dev_addr, command, command_len, I2C_DETECT_TIMEOUT_MS))
+        return false;
+    esp_rom_delay_us(SENSIRION_EXEC_TIME_US);
+    if (!m_i2c_master->probe_read(dev_addr, data_read, word_count * 3, I2C_DETECT_TIMEOUT_MS))
+        return false;
+
+    for (int i = 0; i < word_count; i++) {
+        if (calculate_crc(&data_read[i * 3], 2) != data_read[i * 3 + 2]) {
+            m_i2c_master->report_crc_error(dev_addr);
+            return false;
+        }
+        words[i] = ((uint16_t)data_read[i * 3] << 8) | (uint16_t)data_read[i * 3 + 1];
+    }
+    return true;
+}
+
+uint8_t CI2CDetector::calculate_crc(const uint8_t *data, size_t len)
+{
+    uint8_t crc = SENSIRION_CRC8_INIT;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            if (crc & 0x80) {
+                crc = (crc << 1) ^ SENSIRION_CRC8_POLYNOMIAL;
+            } else {
+                crc <<= 1;
+            }
+        }
+    }
+    return crc;
+}
@@ -1,7 +1,10 @@
 #include "scd41.h"
 #include "logger.h"
+#include "energy.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_rom_sys.h"
 #include <inttypes.h>
 
 #define SCD4X_I2C_ADDR                      0x62    /**< SCD4X I2C address */
@@ -10,6 +13,8 @@
 #define SCD4X_SERIAL_NUMBER_WORD2           0x3BFB  /**< SCD4X serial number 2 */
 #define SCD4X_CRC8_INIT                     0xFF
 #define SCD4X_CRC8_POLYNOMIAL               0x31
+#define SCD4X_I2C_CLOCK_MIN                 50000
+#define SCD4X_I2C_CLOCK_MAX                 400000  /**< fast mode */
 /* SCD4X Basic Commands */
 #define SCD4X_START_PERIODIC_MEASURE        0x21B1  /**< start periodic measurement, signal update interval is 5 seconds. */
 #define SCD4X_READ_MEASUREMENT              0xEC05  /**< read measurement */
@@ -44,6 +49,9 @@ CScd41Ctrl* CScd41Ctrl::_instance = nullptr;
 CScd41Ctrl::CScd41Ctrl()
 {
     m_i2c_master = nullptr;
+    m_power_state = Scd4xPowerIdle;
+    m_wake_pending = false;
+    m_wake_shot = false;
 }
 
 CScd41Ctrl::~CScd41Ctrl()
@@ -63,6 +71,7 @@ CScd41Ctrl* CScd41Ctrl::Instance()
 bool CScd41Ctrl::initialize(CI2CMaster *i2c_master, bool self_test/*=false*/)
 {
     m_i2c_master = i2c_master;
+    m_i2c_master->set_device_clock_range(SCD4X_I2C_ADDR, SCD4X_I2C_CLOCK_MIN, SCD4X_I2C_CLOCK_MAX);
 
     wakeup_module();
     stop_periodic_measure();
@@ -126,6 +135,21 @@ bool CScd41Ctrl::read_serial_number(uint64_t *serial)
 }
 
 bool CScd41Ctrl::perform_self_test()
+{
+    bool passed = false;
+
+    if (!start_self_test()) {
+        return false;
+    }
+    vTaskDelay(SCD4X_SELF_TEST_TIME_MS / portTICK_PERIOD_MS);
+    if (!read_self_test_result(&passed)) {
+        return false;
+    }
+
+    return passed;
+}
+
+bool CScd41Ctrl::start_self_test()
 {
     if (!m_i2c_master) {
         GetLogger(eLogType::Error)->Log("I2C Controller is null");
@@ -139,30 +163,42 @@ bool CScd41Ctrl::perform_self_test()
     if (!m_i2c_master->write_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write))) {
         return false;
     }
-    vTaskDelay(10000 / portTICK_PERIOD_MS);
+
+    return true;
+}
+
+bool CScd41Ctrl::read_self_test_result(bool *passed)
+{
+    if (!m_i2c_master) {
+        GetLogger(eLogType::Error)->Log("I2C Controller is null");
+        return false;
+    }
 
     uint8_t data_read[3] = {0,};
     if (!m_i2c_master->read_bytes(SCD4X_I2C_ADDR, data_read, sizeof(data_read))) {
         return false;
     }
-
-    if (data_read[0] != 0) {
-        GetLogger(eLogType::Error)->Log("Malfunction detected (%02X)", data_read[0]);
+    if (!check_crc(data_read, sizeof(data_read))) {
         return false;
     }
 
-    GetLogger(eLogType::Info)->Log("Passed self test (no malfunction detected)");
+    *passed = data_read[0] == 0 && data_read[1] == 0;
+    if (!*passed) {
+        GetLogger(eLogType::Error)->Log("Malfunction detected (%02X%02X)", data_read[0], data_read[1]);
+    } else {
+        GetLogger(eLogType::Info)->Log("Passed self test (no malfunction detected)");
+    }
     return true;
 }
 
-bool CScd41Ctrl::reinit_module()
+bool CScd41Ctrl::reinit_module(bool wait/*=true*/)
 {
     if (!m_i2c_master) {
         GetLogger(eLogType::Error)->Log("I2C Controller is null");
         return false;
     }
 
-    if (!stop_periodic_measure()) {
+    if (wait && !stop_periodic_measure()) {
         return false;
     }
 
@@ -173,12 +209,14 @@ bool CScd41Ctrl::reinit_module()
     if (!m_i2c_master->write_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write))) {
         return false;
     }
-    vTaskDelay(20 / portTICK_PERIOD_MS);
+    if (wait) {
+        vTaskDelay(SCD4X_REINIT_TIME_MS / portTICK_PERIOD_MS);
+    }
 
     return true;
 }
 
-bool CScd41Ctrl::wakeup_module()
+bool CScd41Ctrl::wakeup_module(bool wait/*=true*/)
 {
     if (!m_i2c_master) {
         GetLogger(eLogType::Error)->Log("I2C Controller is null");
@@ -189,10 +227,18 @@ bool CScd41Ctrl::wakeup_module()
         (uint8_t)(SCD4X_WAKE_UP >> 8),
         (uint8_t)(SCD4X_WAKE_UP & 0xFF)
     };
-    if (!m_i2c_master->write_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write))) {
+    // wake_up is not acknowledged by the sensor, sent without ack check so that the expected NACK is neither
+    // retried nor counted as an error (clock tracking, circuit breaker). assume idle mode after the command
+    bool result = m_i2c_master->write_bytes_no_ack(SCD4X_I2C_ADDR, data_write, sizeof(data_write));
+    m_power_state = Scd4xPowerIdle;
+    m_wake_pending = true;
+    m_wake_shot = false;
+    if (!result) {
         return false;
     }
-    vTaskDelay(20 / portTICK_PERIOD_MS);
+    if (wait) {
+        vTaskDelay(SCD4X_WAKE_UP_TIME_MS / portTICK_PERIOD_MS);
+    }
 
     return true;
 }
@@ -203,6 +249,10 @@ bool CScd41Ctrl::sleep_module()
         GetLogger(eLogType::Error)->Log("I2C Controller is null");
         return false;
     }
+    if (m_power_state == Scd4xPowerPeriodic) {
+        GetLogger(eLogType::Error)->Log("Power down is accepted only in idle mode");
+        return false;
+    }
 
     uint8_t data_write[2] = {
         (uint8_t)(SCD4X_POWER_DOWN >> 8),
@@ -211,11 +261,15 @@ bool CScd41Ctrl::sleep_module()
     if (!m_i2c_master->write_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write))) {
         return false;
     }
+    m_power_state = Scd4xPowerSleep;
+    GetEnergyMonitor()->end(EnergySensorMeasuring, esp_timer_get_time());
+    m_wake_pending = false;
+    m_wake_shot = false;
 
     return true;
 }
 
-bool CScd41Ctrl::perform_factory_reset()
+bool CScd41Ctrl::perform_factory_reset(bool wait/*=true*/)
 {
     if (!m_i2c_master) {
         GetLogger(eLogType::Error)->Log("I2C Controller is null");
@@ -229,7 +283,9 @@ bool CScd41Ctrl::perform_factory_reset()
     if (!m_i2c_master->write_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write))) {
         return false;
     }
-    vTaskDelay(1200 / portTICK_PERIOD_MS);
+    if (wait) {
+        vTaskDelay(SCD4X_FACTORY_RESET_TIME_MS / portTICK_PERIOD_MS);
+    }
 
     return true;
 }
@@ -248,11 +304,37 @@ bool CScd41Ctrl::start_periodic_measure()
     if (!m_i2c_master->write_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write))) {
         return false;
     }
+    m_power_state = Scd4xPowerPeriodic;
+    m_wake_pending = false;
+    m_wake_shot = false;
+    GetEnergyMonitor()->begin(EnergySensorMeasuring, esp_timer_get_time());
+
+    return true;
+}
+
+bool CScd41Ctrl::start_low_power_periodic_measure()
+{
+    if (!m_i2c_master) {
+        GetLogger(eLogType::Error)->Log("I2C Controller is null");
+        return false;
+    }
+
+    uint8_t data_write[2] = {
+        (uint8_t)(SCD4X_START_LOW_POWER_MEASURE >> 8),
+        (uint8_t)(SCD4X_START_LOW_POWER_MEASURE & 0xFF)
+    };
+    if (!m_i2c_master->write_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write))) {
+        return false;
+    }
+    m_power_state = Scd4xPowerPeriodic;
+    m_wake_pending = false;
+    m_wake_shot = false;
+    GetEnergyMonitor()->begin(EnergySensorLowPower, esp_timer_get_time());
 
     return true;
 }
 
-bool CScd41Ctrl::stop_periodic_measure()
+bool CScd41Ctrl::stop_periodic_measure(bool wait/*=true*/)
 {
     if (!m_i2c_master) {
         GetLogger(eLogType::Error)->Log("I2C Controller is null");
@@ -266,12 +348,166 @@ bool CScd41Ctrl::stop_periodic_measure()
     if (!m_i2c_master->write_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write))) {
         return false;
     }
-    vTaskDelay(500 / portTICK_PERIOD_MS);
+    if (m_power_state == Scd4xPowerPeriodic) {
+        m_power_state = Scd4xPowerIdle;
+    }
+    GetEnergyMonitor()->end(EnergySensorMeasuring, esp_timer_get_time());
+    GetEnergyMonitor()->end(EnergySensorLowPower, esp_timer_get_time());
+    if (wait) {
+        vTaskDelay(SCD4X_STOP_PERIODIC_TIME_MS / portTICK_PERIOD_MS);
+    }
 
     return true;
 }
 
-bool CScd41Ctrl::measure_single_shot()
+bool CScd41Ctrl::perform_forced_recalibration(uint16_t target_co2ppm, int16_t *correction)
+{
+    // sensor should be in idle mode (periodic measurement stopped)
+    if (!start_forced_recalibration(target_co2ppm)) {
+        return false;
+    }
+    vTaskDelay(SCD4X_FORCED_RECALIB_TIME_MS / portTICK_PERIOD_MS);
+
+    return read_forced_recalibration_result(correction);
+}
+
+bool CScd41Ctrl::start_forced_recalibration(uint16_t target_co2ppm)
+{
+    return write_command(SCD4X_PERFORM_FORCED_RECALIB, &target_co2ppm, 1, 0);
+}
+
+bool CScd41Ctrl::read_forced_recalibration_result(int16_t *correction)
+{
+    if (!m_i2c_master) {
+        GetLogger(eLogType::Error)->Log("I2C Controller is null");
+        return false;
+    }
+
+    uint8_t data_read[3] = {0, };
+    if (!m_i2c_master->read_bytes(SCD4X_I2C_ADDR, data_read, sizeof(data_read))) {
+        return false;
+    }
+    if (!check_crc(data_read, sizeof(data_read))) {
+        return false;
+    }
+    uint16_t result = ((uint16_t)data_read[0] << 8) | (uint16_t)data_read[1];
+    if (result == 0xFFFF) {
+        GetLogger(eLogType::Error)->Log("Forced recalibration failed");
+        return false;
+    }
+
+    if (correction) {
+        *correction = (int16_t)((int32_t)result - 0x8000);
+    }
+    GetLogger(eLogType::Info)->Log("Forced recalibration done (correction: %d ppm)", (int)((int32_t)result - 0x8000));
+    return true;
+}
+
+bool CScd41Ctrl::set_automatic_self_calibration(bool enabled)
+{
+    // sensor should be in idle mode (periodic measurement stopped)
+    uint16_t value = enabled ? 1 : 0;
+    return write_command(SCD4X_SET_AUTOMATIC_CALIB, &value, 1, 1);
+}
+
+bool CScd41Ctrl::get_automatic_self_calibration(bool *enabled)
+{
+    uint16_t value = 0;
+    if (!read_words(SCD4X_GET_AUTOMATIC_CALIB, &value, 1, 1))
+        return false;
+    *enabled = value != 0;
+    return true;
+}
+
+bool CScd41Ctrl::set_temperature_offset(uint16_t offset_raw)
+{
+    // sensor should be in idle mode (periodic measurement stopped)
+    return write_command(SCD4X_SET_TEMPERATURE_OFFSET, &offset_raw, 1, 1);
+}
+
+bool CScd41Ctrl::get_temperature_offset(uint16_t *offset_raw)
+{
+    return read_words(SCD4X_GET_TEMPERATURE_OFFSET, offset_raw, 1, 1);
+}
+
+bool CScd41Ctrl::set_sensor_altitude(uint16_t altitude)
+{
+    // sensor should be in idle mode (periodic measurement stopped)
+    return write_command(SCD4X_SET_SENSOR_ALTITUDE, &altitude, 1, 1);
+}
+
+bool CScd41Ctrl::get_sensor_altitude(uint16_t *altitude)
+{
+    return read_words(SCD4X_GET_SENSOR_ALTITUDE, altitude, 1, 1);
+}
+
+bool CScd41Ctrl::set_ambient_pressure(uint16_t pressure_hpa)
+{
+    // can be sent during periodic measurement, overrides altitude compensation
+    return write_command(SCD4X_SET_AMBIENT_PRESSURE, &pressure_hpa, 1, 1);
+}
+
+bool CScd41Ctrl::persist_settings()
+{
+    // sensor should be in idle mode, writes EEPROM (limited write endurance)
+    if (!write_command(SCD4X_PERSIST_SETTINGS, nullptr, 0, SCD4X_PERSIST_SETTINGS_TIME_MS))
+        return false;
+    GetLogger(eLogType::Info)->Log("Settings persisted");
+    return true;
+}
+
+/**
+ * @brief command followed by argument words (each with crc), waits for the execution time
+ */
+bool CScd41Ctrl::write_command(uint16_t command, const uint16_t *args, int arg_count, uint32_t exec_time_ms)
+{
+    if (!m_i2c_master) {
+        GetLogger(eLogType::Error)->Log("I2C Controller is null");
+        return false;
+    }
+
+    uint8_t data_write[2 + 3 * 2];
+    size_t len = 0;
+    if (arg_count > 2)
+        return false;
+    data_write[len++] = (uint8_t)(command >> 8);
+    data_write[len++] = (uint8_t)(command & 0xFF);
+    for (int i = 0; i < arg_count; i++) {
+        data_write[len++] = (uint8_t)(args[i] >> 8);
+        data_write[len++] = (uint8_t)(args[i] & 0xFF);
+        data_write[len++] = calculate_crc(args[i]);
+    }
+    if (!m_i2c_master->write_bytes(SCD4X_I2C_ADDR, data_write, len)) {
+        return false;
+    }
+    if (exec_time_ms < portTICK_PERIOD_MS) {
+        esp_rom_delay_us(exec_time_ms * 1000);
+    } else {
+        vTaskDelay(exec_time_ms / portTICK_PERIOD_MS);
+    }
+
+    return true;
+}
+
+bool CScd41Ctrl::read_words(uint16_t command, uint16_t *words, int word_count, uint32_t exec_time_ms)
+{
+    uint8_t data_read[9] = {0, };
+    if (word_count > 3)
+        return false;
+    if (!write_command(command, nullptr, 0, exec_time_ms))
+        return false;
+    if (!m_i2c_master->read_bytes(SCD4X_I2C_ADDR, data_read, word_count * 3))
+        return false;
+    if (!check_crc(data_read, word_count * 3))
+        return false;
+
+    for (int i = 0; i < word_count; i++) {
+        words[i] = ((uint16_t)data_read[i * 3] << 8) | (uint16_t)data_read[i * 3 + 1];
+    }
+    return true;
+}
+
+bool CScd41Ctrl::measure_single_shot(bool wait/*=true*/)
 {
     if (!m_i2c_master) {
         GetLogger(eLogType::Error)->Log("I2C Controller is null");
@@ -285,7 +521,12 @@ bool CScd41Ctrl::measure_single_shot()
     if (!m_i2c_master->write_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write))) {
         return false;
     }
-    vTaskDelay(5000 / portTICK_PERIOD_MS);
+    m_wake_shot = m_wake_pending;
+    m_wake_pending = false;
+    GetEnergyMonitor()->begin(EnergySensorMeasuring, esp_timer_get_time());
+    if (wait) {
+        vTaskDelay(SCD4X_SINGLE_SHOT_TIME_MS / portTICK_PERIOD_MS);
+    }
 
     return true;
 }
@@ -303,7 +544,14 @@ bool CScd41Ctrl::read_measurement(uint16_t *co2ppm, float *temperature, float *h
     uint8_t data_read[9] = {0, };
     if (!m_i2c_master->write_and_read_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write), data_read, sizeof(data_read)))
         return false;
-    
+    if (!check_crc(data_read, sizeof(data_read)))
+        return false;
+    m_wake_shot = false;
+    if (m_power_state == Scd4xPowerIdle) {
+        // single shot completed
+        GetEnergyMonitor()->end(EnergySensorMeasuring, esp_timer_get_time());
+    }
+
     if (co2ppm) {
         *co2ppm = ((uint16_t)data_read[0] << 8) | (uint16_t)data_read[1];
     }
@@ -335,6 +583,8 @@ bool CScd41Ctrl::is_measurement_data_ready()
     uint8_t data_read[3] = {0, };
     if (!m_i2c_master->write_and_read_bytes(SCD4X_I2C_ADDR, data_write, sizeof(data_write), data_read, sizeof(data_read)))
         return false;
+    if (!check_crc(data_read, sizeof(data_read)))
+        return false;
 
     uint16_t result = ((uint16_t)data_read[0] << 8) | (uint16_t)data_read[1];
     if ((result & 0x07FF) == 0x0000)
@@ -363,4 +613,21 @@ uint8_t CScd41Ctrl::calculate_crc(uint16_t data)
     }
     
     return result;
-}
\ No newline at end of file
+}
+/**
+ * @brief check crc of each word (2 bytes data + 1 byte crc), mismatch is reported to the i2c master (clock negotiation)
+ */
+bool CScd41Ctrl::check_crc(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i + 2 < len; i += 3) {
+        uint16_t word = ((uint16_t)data[i] << 8) | (uint16_t)data[i + 1];
+        uint8_t crc_expected = calculate_crc(word);
+        if (crc_expected != data[i + 2]) {
+            GetLogger(eLogType::Error)->Log("CRC mismatch (%02X - %02X)", crc_expected, data[i + 2]);
+            m_i2c_master->report_crc_error(SCD4X_I2C_ADDR);
+            return false;
+        }
+    }
+
+    return true;
+}
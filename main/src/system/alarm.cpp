@@ -0,0 +1,126 @@
+#include "alarm.h"
+#include "logger.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+CAlarmEngine* CAlarmEngine::_instance = nullptr;
+
+CAlarmEngine::CAlarmEngine()
+{
+    m_threshold_ppm = ALARM_CO2_THRESHOLD_PPM;
+    m_hysteresis_ppm = ALARM_CO2_HYSTERESIS_PPM;
+    m_hold_ms = ALARM_HOLD_S * 1000;
+    m_state = AlarmStateNormal;
+    m_pending_since_us = 0;
+    m_changed_us = 0;
+    m_last_value = 0;
+    reset_stats();
+}
+
+CAlarmEngine::~CAlarmEngine()
+{
+}
+
+CAlarmEngine* CAlarmEngine::Instance()
+{
+    if (!_instance) {
+        _instance = new CAlarmEngine();
+    }
+
+    return _instance;
+}
+
+/**
+ * @brief returns true when the alarm was cleared by disabling it, pending transitions restart with the new settings
+ */
+bool CAlarmEngine::configure(uint16_t threshold_ppm, uint16_t hysteresis_ppm, uint16_t hold_s)
+{
+    bool was_active = is_active();
+
+    m_threshold_ppm = threshold_ppm;
+    m_hysteresis_ppm = hysteresis_ppm < threshold_ppm ? hysteresis_ppm : 0;
+    m_hold_ms = (uint32_t)(hold_s < ALARM_HOLD_MAX_S ? hold_s : ALARM_HOLD_MAX_S) * 1000;
+    m_state = was_active ? AlarmStateActive : AlarmStateNormal;
+    m_pending_since_us = 0;
+    GetLogger(eLogType::Info)->Log("Configured (threshold: %u ppm, hysteresis: %u ppm, hold: %u s)", threshold_ppm, m_hysteresis_ppm.load(), hold_s);
+
+    if (was_active && threshold_ppm == 0) {
+        m_state = AlarmStateNormal;
+        m_changed_us = esp_timer_get_time();
+        m_cleared++;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief returns true on a transition (raised or cleared), is_active() gives the new state
+ */
+bool CAlarmEngine::process(int32_t co2ppm, int64_t now_us)
+{
+    uint16_t threshold = m_threshold_ppm;
+    eAlarmState state = m_state;
+    bool transition = false;
+
+    m_samples++;
+    m_last_value = co2ppm;
+    if (threshold == 0) {
+        return false;
+    }
+
+    bool above = co2ppm >= threshold;
+    bool below = co2ppm < threshold - m_hysteresis_ppm;
+    bool active = state == AlarmStateActive || state == AlarmStatePendingClear;
+    bool leaving = active ? below : above;
+
+    if (!leaving) {
+        if (state == AlarmStatePendingActive || state == AlarmStatePendingClear) {
+            m_debounced++;
+        }
+        state = active ? AlarmStateActive : AlarmStateNormal;
+    } else {
+        if (state == AlarmStateNormal || state == AlarmStateActive) {
+            m_pending_since_us = now_us;
+            state = active ? AlarmStatePendingClear : AlarmStatePendingActive;
+        }
+        if (now_us - m_pending_since_us >= (int64_t)m_hold_ms * 1000) {
+            state = active ? AlarmStateNormal : AlarmStateActive;
+            m_changed_us = now_us;
+            if (active) {
+                m_cleared++;
+            } else {
+                m_raised++;
+            }
+            transition = true;
+            GetLogger(eLogType::Info)->Log("CO2 alarm %s (%" PRId32 " ppm, threshold: %u ppm)", active ? "cleared" : "raised", co2ppm, threshold);
+        }
+    }
+    m_state = state;
+
+    return transition;
+}
+
+void CAlarmEngine::print_status()
+{
+    static const char *state_names[AlarmStateMax] = {"normal", "pending active", "active", "pending clear"};
+    int64_t changed_us = m_changed_us;
+
+    if (!is_enabled()) {
+        printf("co2 alarm: disabled (set with 'matter config set alarm_co2 <ppm>')\n");
+    } else {
+        printf("co2 alarm: %s, threshold: %u ppm, clear below: %u ppm, hold: %" PRIu32 " s, last: %" PRId32 " ppm\n",
+            state_names[m_state], m_threshold_ppm.load(), m_threshold_ppm - m_hysteresis_ppm, m_hold_ms / 1000, m_last_value.load());
+    }
+    printf("samples: %" PRIu32 ", raised: %" PRIu32 ", cleared: %" PRIu32 ", debounced: %" PRIu32 ", last change: %" PRId64 " s ago\n",
+        m_samples.load(), m_raised.load(), m_cleared.load(), m_debounced.load(),
+        changed_us > 0 ? (esp_timer_get_time() - changed_us) / 1000000 : (int64_t)-1);
+}
+
+void CAlarmEngine::reset_stats()
+{
+    m_samples = 0;
+    m_raised = 0;
+    m_cleared = 0;
+    m_debounced = 0;
+}
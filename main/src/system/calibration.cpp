@@ -0,0 +1,292 @@
+#include "calibration.h"
+#include "system.h"
+#include "scd41.h"
+#include "logger.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+#define CALIBRATION_NVS_NAMESPACE   "calibration"
+
+static const char *state_names[] = {"idle", "warmup", "stopping", "performing"};
+static const char *result_names[] = {"none", "success", "failed", "aborted"};
+
+CCalibration* CCalibration::_instance = nullptr;
+
+CCalibration::CCalibration()
+{
+    m_initialized = false;
+    m_state = FrcStateIdle;
+    m_target_ppm = 0;
+    m_prev_mode = MeasureModeSingleShot;
+    m_requested_mode = MeasureModeSingleShot;
+    m_mode_requested = false;
+    m_warmup_start_us = 0;
+    m_deadline_us = 0;
+    m_result_callback = nullptr;
+    m_result_callback_arg = nullptr;
+    m_asc_target = false;
+    m_asc_applied = false;
+    m_asc_valid = false;
+    m_frc_count = 0;
+    m_last_result = FrcResultNone;
+    m_last_correction = 0;
+    m_last_target_ppm = 0;
+}
+
+CCalibration::~CCalibration()
+{
+}
+
+CCalibration* CCalibration::Instance()
+{
+    if (!_instance) {
+        _instance = new CCalibration();
+    }
+
+    return _instance;
+}
+
+/**
+ * @brief should be called while the sensor is idle
+ */
+bool CCalibration::initialize()
+{
+    bool enabled = false;
+
+    if (GetScd41Ctrl()->get_automatic_self_calibration(&enabled)) {
+        m_asc_applied = enabled;
+        m_asc_valid = true;
+    }
+    m_asc_target = enabled;
+    load_settings();
+
+    m_initialized = true;
+    GetLogger(eLogType::Info)->Log("Initialized (asc: %d, last frc: %s, correction: %d ppm)", m_asc_target.load(), result_names[m_last_result], m_last_correction);
+    return true;
+}
+
+bool CCalibration::start_frc(uint16_t target_ppm, int current_mode, int64_t now_us)
+{
+    if (!m_initialized || m_state != FrcStateIdle) {
+        GetLogger(eLogType::Warning)->Log("Forced recalibration is not available (state: %s)", state_names[m_state]);
+        return false;
+    }
+    if (target_ppm < FRC_TARGET_MIN_PPM || target_ppm > FRC_TARGET_MAX_PPM) {
+        GetLogger(eLogType::Error)->Log("Invalid reference concentration (%u)", target_ppm);
+        return false;
+    }
+
+    m_target_ppm = target_ppm;
+    m_prev_mode = current_mode;
+    m_mode_requested = false;
+    m_warmup_start_us = now_us;
+    m_state = FrcStateWarmup;
+    GetLogger(eLogType::Info)->Log("Forced recalibration scheduled (target: %u ppm, warmup: %d ms)", target_ppm, FRC_WARMUP_MS);
+    return true;
+}
+
+eCalibrationAction CCalibration::process(int current_mode, int64_t now_us)
+{
+    CScd41Ctrl *sensor = GetScd41Ctrl();
+    int16_t correction = 0;
+
+    switch (m_state.load()) {
+    case FrcStateIdle:
+        return CalibrationActionNone;
+    case FrcStateWarmup:
+        if (current_mode != MeasureModePeriodic) {
+            if (m_mode_requested) {
+                // changed by the user while warming up
+                return finish(FrcResultAborted, 0);
+            }
+            m_mode_requested = true;
+            m_requested_mode = MeasureModePeriodic;
+            m_warmup_start_us = now_us;
+            return CalibrationActionSetMode;
+        }
+        if (now_us - m_warmup_start_us < (int64_t)FRC_WARMUP_MS * 1000)
+            return CalibrationActionNone;
+        if (!sensor->stop_periodic_measure(false))
+            return finish(FrcResultFailed, 0);
+        m_state = FrcStateStopping;
+        m_deadline_us = now_us + (int64_t)SCD4X_STOP_PERIODIC_TIME_MS * 1000;
+        return CalibrationActionBusy;
+    case FrcStateStopping:
+        if (now_us < m_deadline_us)
+            return CalibrationActionBusy;
+        if (!sensor->start_forced_recalibration(m_target_ppm))
+            return finish(FrcResultFailed, 0);
+        m_state = FrcStatePerforming;
+        m_deadline_us = now_us + (int64_t)SCD4X_FORCED_RECALIB_TIME_MS * 1000;
+        return CalibrationActionBusy;
+    case FrcStatePerforming:
+        if (now_us < m_deadline_us)
+            return CalibrationActionBusy;
+        if (!sensor->read_forced_recalibration_result(&correction))
+            return finish(FrcResultFailed, 0);
+        return finish(FrcResultSuccess, correction);
+    }
+
+    return CalibrationActionNone;
+}
+
+/**
+ * @brief the mode requested by CalibrationActionSetMode could not be applied (sensor did not accept the command),
+ *        warmup without periodic measurement would make the recalibration meaningless so the FRC fails
+ */
+eCalibrationAction CCalibration::report_mode_failure()
+{
+    if (m_state != FrcStateWarmup || !m_mode_requested)
+        return CalibrationActionNone;
+    return finish(FrcResultFailed, 0);
+}
+
+eCalibrationAction CCalibration::finish(eFrcResult result, int16_t correction)
+{
+    eFrcState state = m_state;
+
+    m_state = FrcStateIdle;
+    m_frc_count++;
+    m_last_result = result;
+    m_last_correction = correction;
+    m_last_target_ppm = m_target_ppm;
+    save_settings();
+    GetLogger(result == FrcResultSuccess ? eLogType::Info : eLogType::Warning)->Log("Forced recalibration %s (target: %u ppm, correction: %d ppm)",
+        result_names[result], m_target_ppm, correction);
+
+    calibration_result_cb_t callback = m_result_callback;
+    if (callback) {
+        callback(result, correction, m_result_callback_arg);
+    }
+    if (result == FrcResultAborted)
+        return CalibrationActionNone;
+    // periodic measurement was stopped by us (or warmup was started by us), go back to the mode before the request
+    if (state != FrcStateWarmup || m_mode_requested) {
+        m_requested_mode = m_prev_mode;
+        return CalibrationActionSetMode;
+    }
+    return CalibrationActionNone;
+}
+
+void CCalibration::set_result_callback(calibration_result_cb_t callback, void *arg)
+{
+    m_result_callback_arg = arg;
+    m_result_callback = callback;
+}
+
+bool CCalibration::set_auto_calibration(bool enabled)
+{
+    m_asc_target = enabled;
+    save_settings();
+    return true;
+}
+
+/**
+ * @brief the factory reset erased the FRC correction and set ASC to the default, the last result no longer applies
+ * @note a FRC in flight keeps its state, its outcome is the one reported next
+ */
+void CCalibration::factory_reset_done()
+{
+    m_asc_applied = SCD4X_DEFAULT_AUTO_CALIBRATION;
+    m_asc_valid = true;
+    if (m_state == FrcStateIdle) {
+        m_last_result = FrcResultNone;
+        m_last_correction = 0;
+    }
+    save_settings();
+    GetLogger(eLogType::Info)->Log("Forced recalibration erased by factory reset (asc: %d, pending: %d)", m_asc_applied, m_asc_applied != m_asc_target);
+}
+
+bool CCalibration::is_work_due()
+{
+    return m_initialized && (!m_asc_valid || m_asc_applied != m_asc_target);
+}
+
+/**
+ * @brief the sensor should be idle (periodic measurement stopped)
+ */
+bool CCalibration::apply_pending()
+{
+    if (!m_initialized)
+        return false;
+
+    bool enabled = m_asc_target;
+    if (m_asc_valid && m_asc_applied == enabled)
+        return true;
+    if (!GetScd41Ctrl()->set_automatic_self_calibration(enabled))
+        return false;
+    m_asc_applied = enabled;
+    m_asc_valid = true;
+    GetLogger(eLogType::Info)->Log("Automatic self calibration %s", enabled ? "enabled" : "disabled");
+    return true;
+}
+
+void CCalibration::load_settings()
+{
+    nvs_handle_t handle;
+    uint32_t value;
+
+    if (nvs_open(CALIBRATION_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+        return;
+    if (nvs_get_u32(handle, "asc", &value) == ESP_OK) {
+        m_asc_target = value != 0;
+    }
+    if (nvs_get_u32(handle, "frc_count", &value) == ESP_OK) {
+        m_frc_count = value;
+    }
+    if (nvs_get_u32(handle, "frc_result", &value) == ESP_OK && value <= FrcResultAborted) {
+        m_last_result = (eFrcResult)value;
+    }
+    if (nvs_get_u32(handle, "frc_corr", &value) == ESP_OK) {
+        m_last_correction = (int16_t)value;
+    }
+    if (nvs_get_u32(handle, "frc_target", &value) == ESP_OK) {
+        m_last_target_ppm = (uint16_t)value;
+    }
+    nvs_close(handle);
+}
+
+void CCalibration::save_settings()
+{
+    nvs_handle_t handle;
+    esp_err_t ret;
+
+    ret = nvs_open(CALIBRATION_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to open nvs (ret: %d)", ret);
+        return;
+    }
+    ret = nvs_set_u32(handle, "asc", m_asc_target ? 1 : 0);
+    if (ret == ESP_OK) {
+        ret = nvs_set_u32(handle, "frc_count", m_frc_count);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_set_u32(handle, "frc_result", (uint32_t)m_last_result);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_set_u32(handle, "frc_corr", (uint32_t)(uint16_t)m_last_correction);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_set_u32(handle, "frc_target", m_last_target_ppm);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to save calibration settings (ret: %d)", ret);
+    }
+    nvs_close(handle);
+}
+
+void CCalibration::print_status()
+{
+    printf("automatic self calibration: %s%s\n", m_asc_target ? "enabled" : "disabled",
+        m_asc_valid && m_asc_applied == m_asc_target ? "" : " (pending)");
+    printf("forced recalibration: %s", state_names[m_state]);
+    if (m_state == FrcStateWarmup) {
+        printf(" (target: %u ppm)", m_target_ppm);
+    }
+    printf("\nlast forced recalibration: %s (target: %u ppm, correction: %d ppm, count: %" PRIu32 ")\n",
+        result_names[m_last_result], m_last_target_ppm, m_last_correction, m_frc_count);
+}
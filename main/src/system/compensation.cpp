@@ -0,0 +1,292 @@
+#include "compensation.h"
+#include "scd41.h"
+#include "logger.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <math.h>
+#include <inttypes.h>
+
+#define COMPENSATION_NVS_NAMESPACE  "compensation"
+
+CCompensation* CCompensation::_instance = nullptr;
+
+CCompensation::CCompensation()
+{
+    m_initialized = false;
+    m_target_offset_raw = 0;
+    m_target_altitude = 0;
+    m_fixed_pressure_hpa = 0;
+    m_applied_offset_raw = 0;
+    m_applied_altitude = 0;
+    m_applied_pressure_hpa = 0;
+    m_applied_valid = false;
+    m_persisted_offset_raw = 0;
+    m_persisted_altitude = 0;
+    m_persist_count = 0;
+    m_dirty_since_us = 0;
+    m_pressure_source = nullptr;
+    m_pressure_source_arg = nullptr;
+    m_apply_writes = 0;
+    m_pressure_writes = 0;
+    m_pressure_skipped = 0;
+}
+
+CCompensation::~CCompensation()
+{
+}
+
+CCompensation* CCompensation::Instance()
+{
+    if (!_instance) {
+        _instance = new CCompensation();
+    }
+
+    return _instance;
+}
+
+/**
+ * @brief should be called while the sensor is idle, values read at boot are the ones persisted in the sensor EEPROM
+ */
+bool CCompensation::initialize()
+{
+    uint16_t offset_raw = 0;
+    uint16_t altitude = 0;
+
+    if (!GetScd41Ctrl()->get_temperature_offset(&offset_raw) || !GetScd41Ctrl()->get_sensor_altitude(&altitude)) {
+        GetLogger(eLogType::Error)->Log("Failed to read compensation settings from sensor");
+        return false;
+    }
+    m_applied_offset_raw = m_persisted_offset_raw = offset_raw;
+    m_applied_altitude = m_persisted_altitude = altitude;
+    m_applied_valid = true;
+    m_target_offset_raw = offset_raw;
+    m_target_altitude = altitude;
+    load_settings();
+
+    m_initialized = true;
+    GetLogger(eLogType::Info)->Log("Initialized (temperature offset: %g, altitude: %u, persisted: %" PRIu32 "/%d)",
+        get_temperature_offset(), get_altitude(), m_persist_count, COMPENSATION_PERSIST_BUDGET);
+    return true;
+}
+
+bool CCompensation::set_temperature_offset(float offset)
+{
+    if (offset < 0.f || offset > COMPENSATION_TEMPERATURE_OFFSET_MAX) {
+        GetLogger(eLogType::Error)->Log("Invalid temperature offset (%g)", offset);
+        return false;
+    }
+    m_target_offset_raw = SCD4X_TEMPERATURE_OFFSET_TO_RAW(offset);
+    save_settings();
+    return true;
+}
+
+float CCompensation::get_temperature_offset()
+{
+    return SCD4X_TEMPERATURE_OFFSET_FROM_RAW(m_target_offset_raw.load());
+}
+
+bool CCompensation::set_altitude(uint16_t altitude)
+{
+    if (altitude > COMPENSATION_ALTITUDE_MAX) {
+        GetLogger(eLogType::Error)->Log("Invalid altitude (%u)", altitude);
+        return false;
+    }
+    m_target_altitude = altitude;
+    save_settings();
+    return true;
+}
+
+uint16_t CCompensation::get_altitude()
+{
+    return m_target_altitude;
+}
+
+bool CCompensation::set_ambient_pressure(float pressure_hpa)
+{
+    if (pressure_hpa != 0.f && (pressure_hpa < COMPENSATION_PRESSURE_MIN_HPA || pressure_hpa > COMPENSATION_PRESSURE_MAX_HPA)) {
+        GetLogger(eLogType::Error)->Log("Invalid ambient pressure (%g)", pressure_hpa);
+        return false;
+    }
+    m_fixed_pressure_hpa = (uint16_t)lroundf(pressure_hpa);
+    return true;
+}
+
+void CCompensation::set_pressure_source(pressure_source_cb_t callback, void *arg)
+{
+    m_pressure_source_arg = arg;
+    m_pressure_source = callback;
+}
+
+/**
+ * @brief true if the sensor has to be idle for a while (pending deltas or a due persist)
+ */
+bool CCompensation::is_work_due(int64_t now_us)
+{
+    if (!m_initialized)
+        return false;
+    if (!m_applied_valid || m_applied_offset_raw != m_target_offset_raw || m_applied_altitude != m_target_altitude)
+        return true;
+    return persist_due(now_us);
+}
+
+/**
+ * @brief sends only the changed settings, the sensor should be idle (periodic measurement stopped)
+ */
+bool CCompensation::apply_pending(int64_t now_us)
+{
+    if (!m_initialized)
+        return false;
+
+    CScd41Ctrl *sensor = GetScd41Ctrl();
+    uint16_t offset_raw = m_target_offset_raw;
+    uint16_t altitude = m_target_altitude;
+    if (!m_applied_valid || m_applied_offset_raw != offset_raw) {
+        if (!sensor->set_temperature_offset(offset_raw))
+            return false;
+        m_applied_offset_raw = offset_raw;
+        m_apply_writes++;
+    }
+    if (!m_applied_valid || m_applied_altitude != altitude) {
+        if (!sensor->set_sensor_altitude(altitude))
+            return false;
+        m_applied_altitude = altitude;
+        m_apply_writes++;
+    }
+    m_applied_valid = true;
+
+    if (m_applied_offset_raw == m_persisted_offset_raw && m_applied_altitude == m_persisted_altitude) {
+        m_dirty_since_us = 0;
+    } else if (m_dirty_since_us == 0) {
+        m_dirty_since_us = now_us;
+    }
+    if (persist_due(now_us)) {
+        if (!sensor->persist_settings()) {
+            m_dirty_since_us = now_us;  // retry after another batching interval
+            return false;
+        }
+        m_persisted_offset_raw = m_applied_offset_raw;
+        m_persisted_altitude = m_applied_altitude;
+        m_persist_count++;
+        m_dirty_since_us = 0;
+        save_settings();
+        if (m_persist_count >= COMPENSATION_PERSIST_BUDGET) {
+            GetLogger(eLogType::Warning)->Log("Persist budget exhausted, settings are re-applied from NVS on boot");
+        }
+    }
+
+    return true;
+}
+
+bool CCompensation::persist_due(int64_t now_us)
+{
+    if (m_dirty_since_us == 0 || m_persist_count >= COMPENSATION_PERSIST_BUDGET)
+        return false;
+    return now_us - m_dirty_since_us >= (int64_t)COMPENSATION_PERSIST_INTERVAL_MS * 1000;
+}
+
+/**
+ * @brief called on every sample, the command is sent only when the pressure moves out of the deadband
+ * @note disabling the pressure keeps the last value in the sensor until it is reinitialized
+ */
+void CCompensation::feed_ambient_pressure()
+{
+    if (!m_initialized)
+        return;
+
+    float pressure_hpa = m_fixed_pressure_hpa;
+    pressure_source_cb_t source = m_pressure_source;
+    if (pressure_hpa <= 0.f && source) {
+        pressure_hpa = source(m_pressure_source_arg);
+    }
+    if (pressure_hpa < COMPENSATION_PRESSURE_MIN_HPA || pressure_hpa > COMPENSATION_PRESSURE_MAX_HPA)
+        return;
+
+    // deadband of a full step keeps a reading around x.5 hPa from toggling the command every sample
+    if (m_applied_pressure_hpa && fabsf(pressure_hpa - m_applied_pressure_hpa) < COMPENSATION_PRESSURE_DEADBAND_HPA) {
+        m_pressure_skipped++;
+        return;
+    }
+    uint16_t value = (uint16_t)lroundf(pressure_hpa);
+    if (GetScd41Ctrl()->set_ambient_pressure(value)) {
+        m_applied_pressure_hpa = value;
+        m_pressure_writes++;
+    }
+}
+
+/**
+ * @brief sensor RAM settings are reset to the EEPROM values (reinit, factory reset, power cycle), send everything again
+ */
+void CCompensation::invalidate()
+{
+    m_applied_valid = false;
+    m_applied_pressure_hpa = 0;
+}
+
+/**
+ * @brief the sensor EEPROM holds the defaults again, the targets are applied and persisted once more
+ */
+void CCompensation::factory_reset_done()
+{
+    m_persisted_offset_raw = SCD4X_TEMPERATURE_OFFSET_TO_RAW(SCD4X_DEFAULT_TEMPERATURE_OFFSET);
+    m_persisted_altitude = SCD4X_DEFAULT_ALTITUDE;
+    m_dirty_since_us = 0;
+    invalidate();
+    GetLogger(eLogType::Info)->Log("Sensor settings reset to defaults, targets are applied again");
+}
+
+void CCompensation::load_settings()
+{
+    nvs_handle_t handle;
+    uint32_t value;
+
+    if (nvs_open(COMPENSATION_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+        return;
+    if (nvs_get_u32(handle, "temp_offset", &value) == ESP_OK) {
+        m_target_offset_raw = (uint16_t)value;
+    }
+    if (nvs_get_u32(handle, "altitude", &value) == ESP_OK && value <= COMPENSATION_ALTITUDE_MAX) {
+        m_target_altitude = (uint16_t)value;
+    }
+    if (nvs_get_u32(handle, "persist_cnt", &value) == ESP_OK) {
+        m_persist_count = value;
+    }
+    nvs_close(handle);
+}
+
+void CCompensation::save_settings()
+{
+    nvs_handle_t handle;
+    esp_err_t ret;
+
+    ret = nvs_open(COMPENSATION_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to open nvs (ret: %d)", ret);
+        return;
+    }
+    ret = nvs_set_u32(handle, "temp_offset", m_target_offset_raw);
+    if (ret == ESP_OK) {
+        ret = nvs_set_u32(handle, "altitude", m_target_altitude);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_set_u32(handle, "persist_cnt", m_persist_count);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to save compensation settings (ret: %d)", ret);
+    }
+    nvs_close(handle);
+}
+
+void CCompensation::print_status()
+{
+    printf("temperature offset: %.2f degC (applied: %.2f, persisted: %.2f)\n", get_temperature_offset(),
+        SCD4X_TEMPERATURE_OFFSET_FROM_RAW(m_applied_offset_raw), SCD4X_TEMPERATURE_OFFSET_FROM_RAW(m_persisted_offset_raw));
+    printf("altitude: %u m (applied: %u, persisted: %u)\n", get_altitude(), m_applied_altitude, m_persisted_altitude);
+    printf("ambient pressure: %u hPa (%s, applied: %u)\n", m_fixed_pressure_hpa.load(),
+        m_fixed_pressure_hpa ? "fixed" : (m_pressure_source ? "source" : "off"), m_applied_pressure_hpa);
+    printf("sensor writes: %" PRIu32 ", pressure writes: %" PRIu32 " (unchanged: %" PRIu32 ")\n",
+        m_apply_writes.load(), m_pressure_writes.load(), m_pressure_skipped.load());
+    printf("persisted: %" PRIu32 "/%d%s\n", m_persist_count, COMPENSATION_PERSIST_BUDGET, m_dirty_since_us ? " (pending)" : "");
+}
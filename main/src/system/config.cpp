@@ -0,0 +1,368 @@
+#include "config.h"
+#include "definition.h"
+#include "sampler.h"
+#include "filter.h"
+#include "power.h"
+#include "alarm.h"
+#include "rolling.h"
+#include "logger.h"
+#include "nvs.h"
+#include <esp_rom_crc.h>
+#include <driver/gpio.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define CONFIG_NVS_NAMESPACE    "config"
+#define CONFIG_NVS_KEY          "system"
+#define CONFIG_PAYLOAD_MAX      256     // records of future versions larger than this are rejected
+
+#define FIELD(name, member, type, min, max) {name, (uint16_t)offsetof(system_config_t, member), type, min, max}
+
+static const config_field_t config_fields[ConfigFieldMax] = {
+    FIELD("period",         measure_period_ms,  ConfigTypeU32,   MEASURE_PERIOD_MIN_MS, 3600000),
+    FIELD("mode",           measure_mode,       ConfigTypeEnum8, 0, 2),     // eMeasureMode
+    FIELD("adaptive",       adaptive_sampling,  ConfigTypeBool,  0, 1),
+    FIELD("adaptive_min",   adaptive_min_ms,    ConfigTypeU32,   SAMPLER_PERIOD_MIN_MS, SAMPLER_PERIOD_LIMIT_MS),
+    FIELD("adaptive_max",   adaptive_max_ms,    ConfigTypeU32,   SAMPLER_PERIOD_MIN_MS, SAMPLER_PERIOD_LIMIT_MS),
+    FIELD("co2_min",        co2_min_ppm,        ConfigTypeU16,   0, 40000),
+    FIELD("co2_max",        co2_max_ppm,        ConfigTypeU16,   0, 40000),
+    FIELD("filter",         filter_mode,        ConfigTypeEnum8, 0, FilterModeKalman),
+    FIELD("filter_window",  filter_window,      ConfigTypeU8,    1, FILTER_WINDOW_MAX),
+    FIELD("filter_alpha",   filter_alpha,       ConfigTypeU8,    1, 100),
+    FIELD("filter_gate",    filter_gate,        ConfigTypeU8,    0, 100),
+    FIELD("power",          power_mode,         ConfigTypeEnum8, 0, PowerModeBattery),
+    FIELD("alarm_co2",      alarm_co2_ppm,      ConfigTypeU16,   0, 40000),
+    FIELD("alarm_hyst",     alarm_hyst_ppm,     ConfigTypeU16,   0, 5000),
+    FIELD("alarm_hold",     alarm_hold_s,       ConfigTypeU16,   0, ALARM_HOLD_MAX_S),
+    FIELD("range_window",   range_window,       ConfigTypeEnum8, 0, RollingWindowMax),  // 0: off, 1: 5 min, 2: 1 h, 3: 24 h
+    FIELD("i2c_scl",        i2c_gpio_scl,       ConfigTypeU8,    0, GPIO_NUM_MAX - 1),
+    FIELD("i2c_sda",        i2c_gpio_sda,       ConfigTypeU8,    0, GPIO_NUM_MAX - 1),
+    FIELD("i2c_freq",       i2c_freq,           ConfigTypeU32,   10000, 1000000),
+};
+
+CConfig* CConfig::_instance = nullptr;
+
+CConfig::CConfig()
+{
+    m_initialized = false;
+    m_mutex = xSemaphoreCreateMutex();
+    load_defaults(&m_config);
+    m_loaded_version = 0;
+    m_save_count = 0;
+    m_changed_callback = nullptr;
+    m_changed_callback_arg = nullptr;
+}
+
+CConfig::~CConfig()
+{
+    if (m_mutex) {
+        vSemaphoreDelete(m_mutex);
+    }
+}
+
+CConfig* CConfig::Instance()
+{
+    if (!_instance) {
+        _instance = new CConfig();
+    }
+
+    return _instance;
+}
+
+/**
+ * @brief should be called after nvs_flash_init(), falls back to the compile time defaults if no valid record is found
+ */
+bool CConfig::initialize()
+{
+    if (!load()) {
+        load_defaults(&m_config);
+        GetLogger(eLogType::Info)->Log("No valid configuration record, defaults are used");
+    }
+
+    m_initialized = true;
+    GetLogger(eLogType::Info)->Log("Initialized (version: %u, period: %" PRIu32 " ms, mode: %u, i2c: %u/%u %" PRIu32 " Hz)",
+        m_loaded_version, m_config.measure_period_ms, m_config.measure_mode, m_config.i2c_gpio_scl, m_config.i2c_gpio_sda, m_config.i2c_freq);
+    return true;
+}
+
+void CConfig::get(system_config_t *config)
+{
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    *config = m_config;
+    xSemaphoreGive(m_mutex);
+}
+
+/**
+ * @brief all items are applied or none, the record is written to NVS before the cached copy is replaced
+ */
+bool CConfig::update(const config_item_t *items, int count)
+{
+    if (count <= 0 || count > CONFIG_UPDATE_MAX_ITEMS) {
+        return false;
+    }
+
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    system_config_t config = m_config;
+    for (int i = 0; i < count; i++) {
+        const config_field_t *field = get_field(items[i].field);
+        if (!field || items[i].value < field->min || items[i].value > field->max) {
+            xSemaphoreGive(m_mutex);
+            GetLogger(eLogType::Error)->Log("Invalid configuration value (%s: %" PRId32 ")", field ? field->name : "?", items[i].value);
+            return false;
+        }
+        set_value(&config, items[i].field, items[i].value);
+    }
+    if (!validate(&config)) {
+        xSemaphoreGive(m_mutex);
+        GetLogger(eLogType::Error)->Log("Inconsistent configuration, update rejected");
+        return false;
+    }
+    if (memcmp(&config, &m_config, sizeof(system_config_t)) == 0) {
+        xSemaphoreGive(m_mutex);
+        return true;
+    }
+    if (!save(&config)) {
+        xSemaphoreGive(m_mutex);
+        return false;
+    }
+    m_config = config;
+    xSemaphoreGive(m_mutex);
+
+    if (m_changed_callback) {
+        m_changed_callback(m_changed_callback_arg);
+    }
+    return true;
+}
+
+bool CConfig::set(eConfigField field, int32_t value)
+{
+    config_item_t item = {field, value};
+    return update(&item, 1);
+}
+
+bool CConfig::reset()
+{
+    system_config_t config;
+    load_defaults(&config);
+
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    bool result = save(&config);
+    if (result) {
+        m_config = config;
+    }
+    xSemaphoreGive(m_mutex);
+
+    if (result && m_changed_callback) {
+        m_changed_callback(m_changed_callback_arg);
+    }
+    return result;
+}
+
+void CConfig::set_changed_callback(config_changed_cb_t callback, void *arg)
+{
+    m_changed_callback = callback;
+    m_changed_callback_arg = arg;
+}
+
+const config_field_t* CConfig::get_field(eConfigField field)
+{
+    if (field < 0 || field >= ConfigFieldMax) {
+        return nullptr;
+    }
+    return &config_fields[field];
+}
+
+bool CConfig::find_field(const char *name, eConfigField *field)
+{
+    for (int i = 0; i < ConfigFieldMax; i++) {
+        if (strcmp(config_fields[i].name, name) == 0) {
+            *field = (eConfigField)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int32_t CConfig::get_value(const system_config_t *config, eConfigField field)
+{
+    const uint8_t *ptr = (const uint8_t *)config + config_fields[field].offset;
+
+    switch (config_fields[field].type) {
+    case ConfigTypeU16:
+        return *(const uint16_t *)ptr;
+    case ConfigTypeU32:
+        return (int32_t)*(const uint32_t *)ptr;
+    default:
+        return *ptr;
+    }
+}
+
+void CConfig::set_value(system_config_t *config, eConfigField field, int32_t value)
+{
+    uint8_t *ptr = (uint8_t *)config + config_fields[field].offset;
+
+    switch (config_fields[field].type) {
+    case ConfigTypeU16:
+        *(uint16_t *)ptr = (uint16_t)value;
+        break;
+    case ConfigTypeU32:
+        *(uint32_t *)ptr = (uint32_t)value;
+        break;
+    default:
+        *ptr = (uint8_t)value;
+        break;
+    }
+}
+
+void CConfig::load_defaults(system_config_t *config)
+{
+    memset(config, 0, sizeof(system_config_t));
+    config->measure_period_ms = MEASURE_PERIOD_MS;
+    config->measure_mode = 0;   // single shot
+    config->adaptive_sampling = 0;  // opt-in, trades CO2 accuracy on fast changes for fewer shots
+    config->i2c_gpio_scl = GPIO_PIN_I2C_SCL;
+    config->i2c_gpio_sda = GPIO_PIN_I2C_SDA;
+    config->i2c_freq = I2C_MASTER_FREQ;
+    config->adaptive_min_ms = SAMPLER_PERIOD_MIN_MS;
+    config->adaptive_max_ms = SAMPLER_PERIOD_MAX_MS;
+    config->co2_min_ppm = CO2_MEASURED_VALUE_MIN;
+    config->co2_max_ppm = CO2_MEASURED_VALUE_MAX;
+    config->filter_mode = FilterModeEma;
+    config->filter_window = 3;
+    config->filter_alpha = 50;
+    config->filter_gate = 30;
+    config->power_mode = PowerModeAlwaysOn;
+    config->alarm_co2_ppm = ALARM_CO2_THRESHOLD_PPM;
+    config->alarm_hyst_ppm = ALARM_CO2_HYSTERESIS_PPM;
+    config->alarm_hold_s = ALARM_HOLD_S;
+    config->range_window = 0;
+}
+
+bool CConfig::validate(const system_config_t *config)
+{
+    for (int i = 0; i < ConfigFieldMax; i++) {
+        int32_t value = get_value(config, (eConfigField)i);
+        if (value < config_fields[i].min || value > config_fields[i].max) {
+            return false;
+        }
+    }
+
+    return config->adaptive_min_ms <= config->adaptive_max_ms &&
+        config->co2_min_ppm < config->co2_max_ppm &&
+        (config->filter_window & 1) &&
+        (config->power_mode == PowerModeAlwaysOn || config->measure_mode == 0) &&     // battery mode sleeps between single shots
+        (config->alarm_co2_ppm == 0 || config->alarm_hyst_ppm < config->alarm_co2_ppm) &&
+        config->i2c_gpio_scl != config->i2c_gpio_sda;
+}
+
+bool CConfig::load()
+{
+    nvs_handle_t handle;
+    uint8_t buffer[sizeof(config_header_t) + CONFIG_PAYLOAD_MAX];
+    size_t length = sizeof(buffer);
+    config_header_t header;
+    system_config_t config;
+
+    if (nvs_open(CONFIG_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+        return false;
+    esp_err_t ret = nvs_get_blob(handle, CONFIG_NVS_KEY, buffer, &length);
+    nvs_close(handle);
+    if (ret != ESP_OK) {
+        if (ret != ESP_ERR_NVS_NOT_FOUND) {
+            GetLogger(eLogType::Error)->Log("Failed to read configuration record (ret: %d)", ret);
+        }
+        return false;
+    }
+
+    memcpy(&header, buffer, MIN(length, sizeof(config_header_t)));
+    if (length < sizeof(config_header_t) || header.magic != CONFIG_MAGIC || header.size != length - sizeof(config_header_t)) {
+        GetLogger(eLogType::Error)->Log("Configuration record is malformed (length: %u)", (unsigned)length);
+        return false;
+    }
+    const uint8_t *payload = buffer + sizeof(config_header_t);
+    if (esp_rom_crc32_le(0, payload, header.size) != header.crc) {
+        GetLogger(eLogType::Error)->Log("Configuration record CRC mismatch");
+        return false;
+    }
+    if (!migrate(header.version, payload, header.size, &config) || !validate(&config)) {
+        GetLogger(eLogType::Error)->Log("Configuration record (version %u) is invalid", header.version);
+        return false;
+    }
+
+    m_config = config;
+    m_loaded_version = header.version;
+    if (header.version < CONFIG_VERSION) {
+        GetLogger(eLogType::Info)->Log("Configuration record migrated (version %u -> %u)", header.version, CONFIG_VERSION);
+        save(&config);
+    }
+    return true;
+}
+
+/**
+ * @brief fields are append only: the stored prefix is kept, fields added later start from their defaults
+ * @note fields whose meaning changes between versions should be converted here, per stored version
+ */
+bool CConfig::migrate(uint16_t version, const uint8_t *payload, size_t size, system_config_t *config)
+{
+    if (version == 0) {
+        return false;
+    }
+    load_defaults(config);
+    if (version < 4) {
+        // version 3 ends in struct padding where the alarm fields start
+        size = MIN(size, offsetof(system_config_t, alarm_co2_ppm));
+    }
+    memcpy(config, payload, MIN(size, sizeof(system_config_t)));
+    if (version > CONFIG_VERSION) {
+        GetLogger(eLogType::Warning)->Log("Configuration record from a newer firmware (version %u), unknown fields are ignored", version);
+    }
+
+    return true;
+}
+
+bool CConfig::save(const system_config_t *config)
+{
+    nvs_handle_t handle;
+    esp_err_t ret;
+    uint8_t buffer[sizeof(config_header_t) + sizeof(system_config_t)];
+    config_header_t header;
+
+    header.magic = CONFIG_MAGIC;
+    header.version = CONFIG_VERSION;
+    header.size = sizeof(system_config_t);
+    header.reserved = 0;
+    header.crc = esp_rom_crc32_le(0, (const uint8_t *)config, sizeof(system_config_t));
+    memcpy(buffer, &header, sizeof(config_header_t));
+    memcpy(buffer + sizeof(config_header_t), config, sizeof(system_config_t));
+
+    ret = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to open nvs (ret: %d)", ret);
+        return false;
+    }
+    // a single blob write, the previous record stays valid until the commit succeeds
+    ret = nvs_set_blob(handle, CONFIG_NVS_KEY, buffer, sizeof(buffer));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to save configuration record (ret: %d)", ret);
+        return false;
+    }
+    m_save_count++;
+
+    return true;
+}
+
+void CConfig::print()
+{
+    system_config_t config;
+    get(&config);
+
+    printf("version: %d (stored: %u), saves: %" PRIu32 "\n", CONFIG_VERSION, m_loaded_version, m_save_count);
+    for (int i = 0; i < ConfigFieldMax; i++) {
+        printf("%-14s %" PRId32 "\n", config_fields[i].name, get_value(&config, (eConfigField)i));
+    }
+}
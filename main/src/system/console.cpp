@@ -0,0 +1,738 @@
+#include "console.h"
+#include "system.h"
+#include "history.h"
+#include "crashlog.h"
+#include "supervisor.h"
+#include "compensation.h"
+#include "calibration.h"
+#include "sampler.h"
+#include "config.h"
+#include "filter.h"
+#include "power.h"
+#include "energy.h"
+#include "derived.h"
+#include "alarm.h"
+#include "rolling.h"
+#include "I2CMaster.h"
+#include "i2cdetector.h"
+#include "logger.h"
+#include <esp_matter_console.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+CConsole* CConsole::_instance = nullptr;
+static esp_matter::console::engine sensor_console;
+static esp_matter::console::engine log_console;
+static esp_matter::console::engine i2c_console;
+static esp_matter::console::engine config_console;
+
+typedef enum {
+    ExportCsv = 0,
+    ExportBinary
+} eExportFormat;
+
+static bool parse_long(const char *str, long *value)
+{
+    char *end = nullptr;
+    errno = 0;
+    long result = strtol(str, &end, 0);
+    // values are passed on as int32_t (config items, request arguments), long is 64 bit on the host
+    if (!str[0] || *end != '\0' || errno == ERANGE || result < INT32_MIN || result > INT32_MAX)
+        return false;
+    *value = result;
+    return true;
+}
+
+static void print_hex(const void *data, size_t len)
+{
+    const uint8_t *ptr = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        printf("%02x", ptr[i]);
+    }
+    printf("\n");
+}
+
+static bool export_sample(const history_sample_t *sample, void *arg)
+{
+    if (*(eExportFormat *)arg == ExportBinary) {
+        print_hex(sample, sizeof(history_sample_t));
+    } else {
+        printf("%" PRIu32 ",%u,%.2f,%.2f\n", sample->timestamp, sample->co2ppm, sample->temperature / 100.f, sample->humidity / 100.f);
+    }
+    return true;
+}
+
+static bool export_bucket(const history_bucket_t *bucket, void *arg)
+{
+    if (*(eExportFormat *)arg == ExportBinary) {
+        print_hex(bucket, sizeof(history_bucket_t));
+    } else {
+        printf("%" PRIu32 ",%" PRIu32 ",%" PRId32 ",%" PRId32 ",%" PRId32 ",%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", bucket->timestamp, bucket->count,
+            bucket->min[0], bucket->max[0], bucket->mean[0],
+            bucket->min[1] / 100.f, bucket->max[1] / 100.f, bucket->mean[1] / 100.f,
+            bucket->min[2] / 100.f, bucket->max[2] / 100.f, bucket->mean[2] / 100.f);
+    }
+    return true;
+}
+
+static esp_err_t print_description(const esp_matter::console::command_t *command, void *arg)
+{
+    printf("\t%-16s %s\n", command->name, command->description);
+    return ESP_OK;
+}
+
+CConsole::CConsole()
+{
+    m_initialized = false;
+}
+
+CConsole::~CConsole()
+{
+}
+
+CConsole* CConsole::Instance()
+{
+    if (!_instance) {
+        _instance = new CConsole();
+    }
+
+    return _instance;
+}
+
+bool CConsole::initialize()
+{
+    esp_err_t ret;
+
+    if (m_initialized)
+        return true;
+
+    static const esp_matter::console::command_t commands[] = {
+        {
+            .name = "sensor",
+            .description = "Sensor pipeline commands. Usage: matter sensor <command>",
+            .handler = dispatch_sensor,
+        },
+        {
+            .name = "log",
+            .description = "Logger commands. Usage: matter log <command>",
+            .handler = dispatch_log,
+        },
+        {
+            .name = "i2c",
+            .description = "I2C bus diagnostics. Usage: matter i2c <command>",
+            .handler = dispatch_i2c,
+        },
+        {
+            .name = "config",
+            .description = "Persistent runtime configuration. Usage: matter config <command>",
+            .handler = dispatch_config,
+        },
+    };
+    static const esp_matter::console::command_t sensor_commands[] = {
+        {
+            .name = "period",
+            .description = "Get/set fixed single shot measurement period (disables adaptive sampling, saved). Usage: period [milliseconds]",
+            .handler = handler_period,
+        },
+        {
+            .name = "mode",
+            .description = "Get/set measurement mode (saved). Usage: mode [single|periodic|lowpower]",
+            .handler = handler_mode,
+        },
+        {
+            .name = "frc",
+            .description = "Schedule forced recalibration after 3 min of periodic measurement (asynchronous). Usage: frc <reference ppm>",
+            .handler = handler_frc,
+        },
+        {
+            .name = "selftest",
+            .description = "Perform sensor self test (asynchronous). Usage: selftest",
+            .handler = handler_selftest,
+        },
+        {
+            .name = "stats",
+            .description = "Dump measurement statistics and latency histograms. Usage: stats [reset]",
+            .handler = handler_stats,
+        },
+        {
+            .name = "history",
+            .description = "Export measurement history. Usage: history <raw|minute|hour|day> [seconds] [csv|bin]",
+            .handler = handler_history,
+        },
+        {
+            .name = "health",
+            .description = "Dump sensor health and recovery statistics. Usage: health [reset]",
+            .handler = handler_health,
+        },
+        {
+            .name = "comp",
+            .description = "Get/set signal compensation (applied when the sensor is idle). Usage: comp [offset <degC>|altitude <m>|pressure <hPa|off>]",
+            .handler = handler_compensation,
+        },
+        {
+            .name = "calib",
+            .description = "Get calibration status, enable/disable automatic self calibration. Usage: calib [asc <on|off>]",
+            .handler = handler_calibration,
+        },
+        {
+            .name = "adaptive",
+            .description = "Get/set adaptive single shot sampling driven by CO2/humidity rate of change (saved). Usage: adaptive [on|off|reset|range <min ms> <max ms>]",
+            .handler = handler_adaptive,
+        },
+        {
+            .name = "filter",
+            .description = "Dump measurement filter statistics (published vs unfiltered updates, outliers), settings via 'matter config set filter*'. Usage: filter [reset]",
+            .handler = handler_filter,
+        },
+        {
+            .name = "power",
+            .description = "Dump power mode and energy model estimate (mA.s per sample, battery life), mode via 'matter config set power'. Usage: power [reset|<battery mAh>]",
+            .handler = handler_power,
+        },
+        {
+            .name = "energy",
+            .description = "Dump active time and estimated energy per subsystem (sensor, i2c, cpu, wifi_tx), set current figures. Usage: energy [json|reset|current <state> <uA>]",
+            .handler = handler_energy,
+        },
+        {
+            .name = "derived",
+            .description = "Dump dew point and absolute humidity derived from the published temperature/humidity. Usage: derived [reset]",
+            .handler = handler_derived,
+        },
+        {
+            .name = "alarm",
+            .description = "Dump CO2 alarm state and transition counters, settings via 'matter config set alarm_co2|alarm_hyst|alarm_hold'. Usage: alarm [reset]",
+            .handler = handler_alarm,
+        },
+        {
+            .name = "rolling",
+            .description = "Dump min/max/mean/stddev of the published values over the last 5 min, 1 h and 24 h, Min/MaxMeasuredValue via 'matter config set range_window'. Usage: rolling [json|reset]",
+            .handler = handler_rolling,
+        },
+    };
+
+    static const esp_matter::console::command_t log_commands[] = {
+        {
+            .name = "crash",
+            .description = "Dump logs of the previous session (saved at boot) or of the current session. Usage: crash [current|clear]",
+            .handler = handler_log_crash,
+        },
+    };
+
+    static const esp_matter::console::command_t config_commands[] = {
+        {
+            .name = "show",
+            .description = "Dump configuration fields. Usage: show",
+            .handler = handler_config_show,
+        },
+        {
+            .name = "set",
+            .description = "Validate, save and apply fields at once. Usage: set <field> <value> [<field> <value> ...]",
+            .handler = handler_config_set,
+        },
+        {
+            .name = "reset",
+            .description = "Restore and apply default configuration. Usage: reset",
+            .handler = handler_config_reset,
+        },
+    };
+
+    static const esp_matter::console::command_t i2c_commands[] = {
+        {
+            .name = "stats",
+            .description = "Dump per device transaction counters and latency histograms. Usage: stats [json|reset]",
+            .handler = handler_i2c_stats,
+        },
+        {
+            .name = "scan",
+            .description = "Print devices detected at boot, or probe the bus again (address only). Usage: scan [probe]",
+            .handler = handler_i2c_scan,
+        },
+    };
+
+    ret = sensor_console.register_commands(sensor_commands, sizeof(sensor_commands) / sizeof(esp_matter::console::command_t));
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to register sensor commands (ret: %d)", ret);
+        return false;
+    }
+    ret = log_console.register_commands(log_commands, sizeof(log_commands) / sizeof(esp_matter::console::command_t));
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to register log commands (ret: %d)", ret);
+        return false;
+    }
+    ret = i2c_console.register_commands(i2c_commands, sizeof(i2c_commands) / sizeof(esp_matter::console::command_t));
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to register i2c commands (ret: %d)", ret);
+        return false;
+    }
+    ret = config_console.register_commands(config_commands, sizeof(config_commands) / sizeof(esp_matter::console::command_t));
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to register config commands (ret: %d)", ret);
+        return false;
+    }
+    ret = esp_matter::console::add_commands(commands, sizeof(commands) / sizeof(esp_matter::console::command_t));
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to add console commands (ret: %d)", ret);
+        return false;
+    }
+
+    esp_matter::console::diagnostics_register_commands();
+    esp_matter::console::init();
+
+    m_initialized = true;
+    GetLogger(eLogType::Info)->Log("Initialized");
+    return true;
+}
+
+esp_err_t CConsole::dispatch_sensor(int argc, char **argv)
+{
+    if (argc <= 0) {
+        sensor_console.for_each_command(print_description, nullptr);
+        return ESP_OK;
+    }
+    return sensor_console.exec_command(argc, argv);
+}
+
+esp_err_t CConsole::handler_period(int argc, char **argv)
+{
+    long value;
+
+    if (argc == 0) {
+        printf("period: %" PRIu32 " ms%s\n", GetSystem()->get_single_shot_period_ms(),
+            GetAdaptiveSampler()->is_enabled() ? " (adaptive)" : "");
+        return ESP_OK;
+    }
+    if (argc != 1 || !parse_long(argv[0], &value) || value <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    config_item_t items[] = {
+        {ConfigFieldMeasurePeriod, (int32_t)value},
+        {ConfigFieldAdaptiveSampling, 0},
+    };
+
+    return GetConfig()->update(items, 2) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t CConsole::handler_mode(int argc, char **argv)
+{
+    static const char *mode_names[] = {"single", "periodic", "lowpower"};
+
+    if (argc == 0) {
+        printf("mode: %s\n", mode_names[GetSystem()->get_measure_mode()]);
+        return ESP_OK;
+    }
+    if (argc != 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < (int)(sizeof(mode_names) / sizeof(mode_names[0])); i++) {
+        if (strcmp(argv[0], mode_names[i]) == 0) {
+            return GetConfig()->set(ConfigFieldMeasureMode, i) ? ESP_OK : ESP_FAIL;
+        }
+    }
+
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t CConsole::handler_frc(int argc, char **argv)
+{
+    long value;
+
+    if (argc != 1 || !parse_long(argv[0], &value) || value < 400 || value > 2000) {
+        printf("reference concentration should be in range 400 ~ 2000 ppm\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!GetSystem()->post_request(RequestForcedRecalibration, (int32_t)value)) {
+        return ESP_FAIL;
+    }
+    printf("forced recalibration requested, check 'matter sensor calib' for the result\n");
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_selftest(int argc, char **argv)
+{
+    if (!GetSystem()->post_request(RequestSelfTest)) {
+        return ESP_FAIL;
+    }
+    printf("self test requested (takes about 10 seconds), check 'matter sensor stats' for the result\n");
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_stats(int argc, char **argv)
+{
+    if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        GetSystem()->reset_measurement_stats();
+        return ESP_OK;
+    }
+    GetSystem()->print_measurement_stats();
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_history(int argc, char **argv)
+{
+    static const char *tier_names[TierMax] = {"raw", "minute", "hour", "day"};
+    eHistoryTier tier = TierMax;
+    eExportFormat format = ExportCsv;
+    long duration = 3600;
+
+    if (argc < 1 || argc > 3) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < TierMax; i++) {
+        if (strcmp(argv[0], tier_names[i]) == 0) {
+            tier = (eHistoryTier)i;
+        }
+    }
+    if (tier == TierMax) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (argc >= 2 && (!parse_long(argv[1], &duration) || duration <= 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (argc == 3) {
+        if (strcmp(argv[2], "bin") == 0) {
+            format = ExportBinary;
+        } else if (strcmp(argv[2], "csv") != 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    uint32_t ts_to = GetHistory()->get_timestamp();
+    uint32_t ts_from = ts_to > (uint32_t)duration ? ts_to - (uint32_t)duration : 0;
+    size_t count;
+    if (tier == TierRaw) {
+        if (format == ExportCsv) {
+            printf("timestamp,co2,temperature,humidity\n");
+        }
+        count = GetHistory()->query_samples(ts_from, ts_to, export_sample, &format);
+    } else {
+        if (format == ExportCsv) {
+            printf("timestamp,count,co2_min,co2_max,co2_mean,temp_min,temp_max,temp_mean,hum_min,hum_max,hum_mean\n");
+        }
+        count = GetHistory()->query_buckets(tier, ts_from, ts_to, export_bucket, &format);
+    }
+    printf("# %u records\n", (unsigned)count);
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_health(int argc, char **argv)
+{
+    if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        GetHealthSupervisor()->reset_stats();
+        return ESP_OK;
+    }
+    GetHealthSupervisor()->print_status();
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_compensation(int argc, char **argv)
+{
+    if (argc == 0) {
+        GetCompensation()->print_status();
+        return ESP_OK;
+    }
+    if (argc != 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char *end = nullptr;
+    float value = strtof(argv[1], &end);
+    bool valid = *end == '\0';
+    bool result = false;
+    if (strcmp(argv[0], "pressure") == 0 && strcmp(argv[1], "off") == 0) {
+        result = GetCompensation()->set_ambient_pressure(0.f);
+    } else if (!valid) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (strcmp(argv[0], "offset") == 0) {
+        result = GetCompensation()->set_temperature_offset(value);
+    } else if (strcmp(argv[0], "altitude") == 0) {
+        result = value >= 0.f && GetCompensation()->set_altitude((uint16_t)value);
+    } else if (strcmp(argv[0], "pressure") == 0) {
+        result = GetCompensation()->set_ambient_pressure(value);
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return result ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t CConsole::handler_calibration(int argc, char **argv)
+{
+    if (argc == 0) {
+        GetCalibration()->print_status();
+        return ESP_OK;
+    }
+    if (argc != 2 || strcmp(argv[0], "asc") != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strcmp(argv[1], "on") == 0) {
+        GetCalibration()->set_auto_calibration(true);
+    } else if (strcmp(argv[1], "off") == 0) {
+        GetCalibration()->set_auto_calibration(false);
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_adaptive(int argc, char **argv)
+{
+    long min_ms, max_ms;
+
+    if (argc == 0) {
+        GetAdaptiveSampler()->print_status();
+        return ESP_OK;
+    }
+    if (argc == 1 && strcmp(argv[0], "on") == 0) {
+        return GetConfig()->set(ConfigFieldAdaptiveSampling, 1) ? ESP_OK : ESP_FAIL;
+    } else if (argc == 1 && strcmp(argv[0], "off") == 0) {
+        return GetConfig()->set(ConfigFieldAdaptiveSampling, 0) ? ESP_OK : ESP_FAIL;
+    } else if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        GetAdaptiveSampler()->reset_stats();
+    } else if (argc == 3 && strcmp(argv[0], "range") == 0) {
+        if (!parse_long(argv[1], &min_ms) || !parse_long(argv[2], &max_ms) || min_ms <= 0 || max_ms <= 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        config_item_t items[] = {
+            {ConfigFieldAdaptiveMin, (int32_t)min_ms},
+            {ConfigFieldAdaptiveMax, (int32_t)max_ms},
+        };
+        if (!GetConfig()->update(items, 2)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_filter(int argc, char **argv)
+{
+    if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        GetMeasurementFilter()->reset_stats();
+        return ESP_OK;
+    }
+    if (argc != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    GetMeasurementFilter()->print_status();
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_power(int argc, char **argv)
+{
+    long capacity = 0;
+
+    if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        GetPowerManager()->reset_stats();
+        return ESP_OK;
+    }
+    if (argc > 1 || (argc == 1 && (!parse_long(argv[0], &capacity) || capacity <= 0))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    GetPowerManager()->print_status((uint32_t)capacity);
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_energy(int argc, char **argv)
+{
+    eEnergyState state;
+    long current;
+
+    if (argc == 0) {
+        GetEnergyMonitor()->print_report();
+    } else if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        GetEnergyMonitor()->reset_stats();
+    } else if (argc == 1 && strcmp(argv[0], "json") == 0) {
+        CJsonWriter writer(CJsonWriter::sink_stdout, nullptr);
+        GetEnergyMonitor()->write_report_json(&writer);
+        writer.flush();
+        printf("\n");
+    } else if (argc == 3 && strcmp(argv[0], "current") == 0) {
+        if (!CEnergyMonitor::find_state(argv[1], &state) || !parse_long(argv[2], &current) || current < 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        GetEnergyMonitor()->set_current(state, (uint32_t)current);
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_derived(int argc, char **argv)
+{
+    if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        GetDerivedChannels()->reset_stats();
+        return ESP_OK;
+    }
+    if (argc != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    GetDerivedChannels()->print_status();
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_alarm(int argc, char **argv)
+{
+    if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        GetAlarmEngine()->reset_stats();
+        return ESP_OK;
+    }
+    if (argc != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    GetAlarmEngine()->print_status();
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_rolling(int argc, char **argv)
+{
+    if (argc == 0) {
+        GetRollingStats()->print_status();
+    } else if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        GetRollingStats()->reset();
+    } else if (argc == 1 && strcmp(argv[0], "json") == 0) {
+        CJsonWriter writer(CJsonWriter::sink_stdout, nullptr);
+        GetRollingStats()->write_report_json(&writer);
+        writer.flush();
+        printf("\n");
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::dispatch_config(int argc, char **argv)
+{
+    if (argc <= 0) {
+        config_console.for_each_command(print_description, nullptr);
+        return ESP_OK;
+    }
+    return config_console.exec_command(argc, argv);
+}
+
+esp_err_t CConsole::handler_config_show(int argc, char **argv)
+{
+    GetConfig()->print();
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_config_set(int argc, char **argv)
+{
+    config_item_t items[CONFIG_UPDATE_MAX_ITEMS];
+    long value;
+
+    if (argc == 0 || argc % 2 != 0 || argc / 2 > CONFIG_UPDATE_MAX_ITEMS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < argc / 2; i++) {
+        if (!CConfig::find_field(argv[i * 2], &items[i].field)) {
+            printf("unknown field: %s\n", argv[i * 2]);
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (!parse_long(argv[i * 2 + 1], &value)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        items[i].value = (int32_t)value;
+    }
+
+    return GetConfig()->update(items, argc / 2) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t CConsole::handler_config_reset(int argc, char **argv)
+{
+    return GetConfig()->reset() ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t CConsole::dispatch_log(int argc, char **argv)
+{
+    if (argc <= 0) {
+        log_console.for_each_command(print_description, nullptr);
+        return ESP_OK;
+    }
+    return log_console.exec_command(argc, argv);
+}
+
+esp_err_t CConsole::handler_log_crash(int argc, char **argv)
+{
+    if (argc > 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (argc == 1 && strcmp(argv[0], "clear") == 0) {
+        return GetCrashLog()->clear() ? ESP_OK : ESP_FAIL;
+    }
+    if (argc == 1 && strcmp(argv[0], "current") != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t count = GetCrashLog()->print(argc == 1);
+    printf("# %u records\n", (unsigned)count);
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::dispatch_i2c(int argc, char **argv)
+{
+    if (argc <= 0) {
+        i2c_console.for_each_command(print_description, nullptr);
+        return ESP_OK;
+    }
+    return i2c_console.exec_command(argc, argv);
+}
+
+esp_err_t CConsole::handler_i2c_stats(int argc, char **argv)
+{
+    if (argc == 0) {
+        GetI2CMaster()->print_stats();
+        return ESP_OK;
+    }
+    if (argc != 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strcmp(argv[0], "reset") == 0) {
+        GetI2CMaster()->reset_stats();
+    } else if (strcmp(argv[0], "json") == 0) {
+        CJsonWriter writer(CJsonWriter::sink_stdout, nullptr);
+        GetI2CMaster()->write_stats_json(&writer);
+        writer.flush();
+        printf("\n");
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t CConsole::handler_i2c_scan(int argc, char **argv)
+{
+    if (argc == 0) {
+        GetI2CDetector()->print();
+        return ESP_OK;
+    }
+    if (argc != 1 || strcmp(argv[0], "probe") != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // the measurement task owns the bus, the scan runs there once the current single shot is read
+    if (!GetSystem()->post_request(RequestI2CScan)) {
+        return ESP_FAIL;
+    }
+    printf("bus probe requested, found addresses are printed by the measurement task\n");
+
+    return ESP_OK;
+}
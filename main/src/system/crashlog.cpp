@@ -0,0 +1,222 @@
+#include "crashlog.h"
+#include "logger.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include <atomic>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#define CRASHLOG_PARTITION_LABEL    "crashlog"
+#define CRASHLOG_PARTITION_SUBTYPE  0x41
+#define CRASHLOG_RING_MASK          (CRASHLOG_RING_SIZE - 1)
+#define CRASHLOG_RECORD_MARKER      0xA5
+#define CRASHLOG_RECORD_OVERHEAD    (sizeof(crashlog_record_header_t) + 1)  // + checksum
+
+static_assert((CRASHLOG_RING_SIZE & CRASHLOG_RING_MASK) == 0, "CRASHLOG_RING_SIZE should be power of 2");
+
+typedef struct __attribute__((packed)) {
+    uint8_t marker;
+    uint8_t type;
+    uint16_t length;            // payload length
+    uint32_t timestamp;
+} crashlog_record_header_t;
+
+typedef struct {
+    crashlog_header_t header;
+    uint8_t ring[CRASHLOG_RING_SIZE];
+} crashlog_rtc_t;
+
+RTC_NOINIT_ATTR static crashlog_rtc_t rtc_crashlog;
+// reservation counter and committed head live in DRAM (atomic instructions are not available on RTC memory)
+static std::atomic<uint32_t> write_pos(0);
+static std::atomic<uint32_t> committed_head(0);     // highest end of a copied record, mirrored to rtc_crashlog.header.head
+static std::atomic<bool> ring_ready(false);
+
+CCrashLog* CCrashLog::_instance = nullptr;
+
+static uint8_t checksum(uint8_t sum, const void *data, size_t len)
+{
+    const uint8_t *ptr = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        sum += ptr[i];
+    }
+    return sum;
+}
+
+static void ring_write(uint32_t pos, const void *data, size_t len)
+{
+    uint32_t offset = pos & CRASHLOG_RING_MASK;
+    size_t first = CRASHLOG_RING_SIZE - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&rtc_crashlog.ring[offset], data, first);
+    memcpy(&rtc_crashlog.ring[0], (const uint8_t *)data + first, len - first);
+}
+
+static void ring_read(const uint8_t *ring, uint32_t pos, void *data, size_t len)
+{
+    uint32_t offset = pos & CRASHLOG_RING_MASK;
+    size_t first = CRASHLOG_RING_SIZE - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(data, &ring[offset], first);
+    memcpy((uint8_t *)data + first, &ring[0], len - first);
+}
+
+CCrashLog::CCrashLog()
+{
+    m_initialized = false;
+    m_partition = nullptr;
+}
+
+CCrashLog::~CCrashLog()
+{
+}
+
+CCrashLog* CCrashLog::Instance()
+{
+    if (!_instance) {
+        _instance = new CCrashLog();
+    }
+
+    return _instance;
+}
+
+bool CCrashLog::initialize()
+{
+    esp_err_t ret;
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool valid = rtc_crashlog.header.magic == CRASHLOG_MAGIC && reason != ESP_RST_POWERON;
+    uint32_t boot_count = valid ? rtc_crashlog.header.boot_count + 1 : 0;
+
+    m_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)CRASHLOG_PARTITION_SUBTYPE, CRASHLOG_PARTITION_LABEL);
+    if (!m_partition) {
+        GetLogger(eLogType::Warning)->Log("Cannot find crashlog partition, previous session logs are not kept");
+    } else if (valid && rtc_crashlog.header.head) {
+        // keep the ring of the previous session before it is overwritten by this session
+        rtc_crashlog.header.reset_reason = (uint32_t)reason;
+        ret = esp_partition_erase_range(m_partition, 0, (sizeof(crashlog_rtc_t) + 4095) & ~4095);
+        if (ret == ESP_OK) {
+            ret = esp_partition_write(m_partition, 0, &rtc_crashlog, sizeof(crashlog_rtc_t));
+        }
+        if (ret != ESP_OK) {
+            GetLogger(eLogType::Error)->Log("Failed to save previous session logs (ret: %d)", ret);
+        }
+    }
+
+    memset(&rtc_crashlog, 0, sizeof(rtc_crashlog));
+    rtc_crashlog.header.magic = CRASHLOG_MAGIC;
+    rtc_crashlog.header.boot_count = boot_count;
+    write_pos = 0;
+    committed_head = 0;
+    ring_ready = true;
+
+    m_initialized = true;
+    GetLogger(eLogType::Info)->Log("Initialized (reset reason: %d, boot count: %u)", reason, boot_count);
+    return true;
+}
+
+bool CCrashLog::clear()
+{
+    if (!m_partition)
+        return false;
+
+    esp_err_t ret = esp_partition_erase_range(m_partition, 0, (sizeof(crashlog_rtc_t) + 4095) & ~4095);
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to erase crashlog partition (ret: %d)", ret);
+        return false;
+    }
+
+    return true;
+}
+
+void CCrashLog::append(uint8_t type, uint32_t timestamp, const void *data, size_t len)
+{
+    if (!ring_ready.load(std::memory_order_acquire) || len > CRASHLOG_RING_SIZE / 2)
+        return;
+
+    crashlog_record_header_t record;
+    record.marker = CRASHLOG_RECORD_MARKER;
+    record.type = type;
+    record.length = (uint16_t)len;
+    record.timestamp = timestamp;
+    uint8_t sum = checksum(checksum(0, &record, sizeof(record)), data, len);
+
+    // reserve space first, concurrent writers copy into disjoint ranges
+    uint32_t pos = write_pos.fetch_add(sizeof(record) + len + 1, std::memory_order_relaxed);
+    ring_write(pos, &record, sizeof(record));
+    ring_write(pos + sizeof(record), data, len);
+    ring_write(pos + sizeof(record) + len, &sum, 1);
+
+    // writers finish out of order: raise the head with an atomic max so that it never moves backwards
+    uint32_t end = pos + sizeof(record) + len + 1;
+    uint32_t head = committed_head.load(std::memory_order_relaxed);
+    while ((int32_t)(end - head) > 0 && !committed_head.compare_exchange_weak(head, end, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    // the mirror is a plain store, a writer preempted between load and store may write a stale value: store again until it holds
+    do {
+        head = committed_head.load(std::memory_order_acquire);
+        rtc_crashlog.header.head = head;
+    } while (committed_head.load(std::memory_order_acquire) != head);
+}
+
+size_t CCrashLog::print(bool current)
+{
+    if (current) {
+        crashlog_header_t header = rtc_crashlog.header;
+        header.head = committed_head.load(std::memory_order_acquire);
+        return print_ring(&header, rtc_crashlog.ring);
+    }
+
+    if (!m_partition)
+        return 0;
+
+    crashlog_rtc_t *saved = new crashlog_rtc_t;
+    size_t count = 0;
+    if (esp_partition_read(m_partition, 0, saved, sizeof(crashlog_rtc_t)) == ESP_OK && saved->header.magic == CRASHLOG_MAGIC) {
+        printf("# boot count: %" PRIu32 ", reset reason: %" PRIu32 "\n", saved->header.boot_count, saved->header.reset_reason);
+        count = print_ring(&saved->header, saved->ring);
+    }
+    delete saved;
+
+    return count;
+}
+
+size_t CCrashLog::print_ring(const crashlog_header_t *header, const uint8_t *ring)
+{
+    uint8_t payload[MAXLEN_LOG_MSG + 1];
+    crashlog_record_header_t record;
+    uint8_t sum;
+    size_t count = 0;
+    uint32_t end = header->head;
+    uint32_t pos = end > CRASHLOG_RING_SIZE ? end - CRASHLOG_RING_SIZE : 0;
+
+    // records overwritten partially or torn by a reset fail the checksum and are skipped byte by byte
+    while (pos + CRASHLOG_RECORD_OVERHEAD <= end) {
+        ring_read(ring, pos, &record, sizeof(record));
+        if (record.marker != CRASHLOG_RECORD_MARKER || record.length > MAXLEN_LOG_MSG || pos + CRASHLOG_RECORD_OVERHEAD + record.length > end) {
+            pos++;
+            continue;
+        }
+        ring_read(ring, pos + sizeof(record), payload, record.length);
+        ring_read(ring, pos + sizeof(record) + record.length, &sum, 1);
+        if (checksum(checksum(0, &record, sizeof(record)), payload, record.length) != sum) {
+            pos++;
+            continue;
+        }
+
+        if (record.type & LOG_ITEM_BINARY) {
+            CLogger::ProcessBinary(record.type, record.timestamp, payload, record.length);
+        } else {
+            payload[record.length] = '\0';
+            CLogger::Process((eLogType)(record.type & LOG_ITEM_TYPE_MASK), record.timestamp, (const char *)payload);
+        }
+        pos += CRASHLOG_RECORD_OVERHEAD + record.length;
+        count++;
+    }
+
+    return count;
+}
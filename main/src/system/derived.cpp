@@ -0,0 +1,144 @@
+#include "derived.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+#define LN2_Q16             45426       // ln(2)
+#define INV_LN2_Q16         94548       // 1 / ln(2)
+#define LN_10000_Q16        603609      // ln(100 %RH in 0.01 %RH)
+#define ABS_HUMIDITY_K      13244704    // 216.7 x 6.112 hPa (x 10000), g K / m3 per hPa
+
+// ln(1 + i / 32) and 2^(i / 32) in Q16, generated by scripts/simulate_derived.py --tables
+static const int32_t ln_table[(1 << DERIVED_LUT_BITS) + 1] = {
+    0, 2017, 3973, 5873, 7719, 9515, 11262, 12965, 14624, 16242, 17821, 19364, 20870, 22343, 23783, 25193, 26573,
+    27924, 29248, 30546, 31818, 33067, 34292, 35494, 36675, 37835, 38975, 40095, 41196, 42280, 43345, 44394, 45426,
+};
+static const int32_t exp2_table[(1 << DERIVED_LUT_BITS) + 1] = {
+    65536, 66971, 68438, 69936, 71468, 73032, 74632, 76266, 77936, 79642, 81386, 83169, 84990, 86851, 88752, 90696,
+    92682, 94711, 96785, 98905, 101070, 103283, 105545, 107856, 110218, 112631, 115098, 117618, 120194, 122825,
+    125515, 128263, 131072,
+};
+
+CDerivedChannels* CDerivedChannels::_instance = nullptr;
+
+static int64_t div_round(int64_t num, int64_t den)
+{
+    return num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+/**
+ * @brief interpolated table value at frac (Q16, 0 ~ 65535)
+ */
+static int32_t lookup(const int32_t *table, uint32_t frac)
+{
+    const int shift = 16 - DERIVED_LUT_BITS;
+    uint32_t idx = frac >> shift;
+    int32_t rem = (int32_t)(frac & ((1u << shift) - 1));
+
+    return table[idx] + (((table[idx + 1] - table[idx]) * rem + (1 << (shift - 1))) >> shift);
+}
+
+/**
+ * @brief ln(x) in Q16, x = 2^e x m (1 <= m < 2)
+ */
+static int32_t ln_q16(uint32_t x)
+{
+    int e = 31 - __builtin_clz(x);
+    uint32_t m_q16 = (x << 16) >> e;    // x <= 10000, no overflow
+
+    return e * LN2_Q16 + lookup(ln_table, m_q16 - 65536);
+}
+
+CDerivedChannels::CDerivedChannels()
+{
+    m_valid = false;
+    m_temperature = 0;
+    m_humidity = 0;
+    m_dew_point = 0;
+    m_absolute_humidity = 0;
+    reset_stats();
+}
+
+CDerivedChannels::~CDerivedChannels()
+{
+}
+
+CDerivedChannels* CDerivedChannels::Instance()
+{
+    if (!_instance) {
+        _instance = new CDerivedChannels();
+    }
+
+    return _instance;
+}
+
+/**
+ * @brief Magnus: gamma = ln(RH / 100) + b T / (c + T), Td = c gamma / (b - gamma)
+ *        absolute humidity = 216.7 x RH / 100 x 6.112 x exp(b T / (c + T)) / (273.15 + T)
+ */
+void CDerivedChannels::calculate(int32_t temperature, int32_t humidity, int16_t *dew_point, uint16_t *absolute_humidity)
+{
+    int32_t t = temperature < DERIVED_TEMPERATURE_MIN ? DERIVED_TEMPERATURE_MIN : (temperature > DERIVED_TEMPERATURE_MAX ? DERIVED_TEMPERATURE_MAX : temperature);
+    int32_t rh = humidity < DERIVED_HUMIDITY_MIN ? DERIVED_HUMIDITY_MIN : (humidity > DERIVED_HUMIDITY_MAX ? DERIVED_HUMIDITY_MAX : humidity);
+
+    // b T / (c + T) in Q16, shared by both channels
+    int32_t f_q16 = (int32_t)div_round((int64_t)DERIVED_MAGNUS_B_Q16 * t, DERIVED_MAGNUS_C_X100 + t);
+
+    int32_t gamma_q16 = ln_q16((uint32_t)rh) - LN_10000_Q16 + f_q16;
+    *dew_point = (int16_t)div_round((int64_t)DERIVED_MAGNUS_C_X100 * gamma_q16, DERIVED_MAGNUS_B_Q16 - gamma_q16);
+
+    // exp(f) = 2^k x 2^(frac / 65536)
+    int32_t log2_q16 = (int32_t)(((int64_t)f_q16 * INV_LN2_Q16) >> 16);
+    int k = log2_q16 >> 16;     // floor
+    int64_t num = (int64_t)ABS_HUMIDITY_K * rh * lookup(exp2_table, (uint32_t)log2_q16 & 0xFFFF);
+    int64_t den = (int64_t)10000 * 65536 * (27315 + t);
+    if (k >= 0) {
+        num <<= k;
+    } else {
+        den <<= -k;
+    }
+    *absolute_humidity = (uint16_t)div_round(num, den);
+}
+
+/**
+ * @brief returns true when the derived values changed
+ */
+bool CDerivedChannels::update(int32_t temperature, int32_t humidity)
+{
+    if (m_valid && temperature == m_temperature && humidity == m_humidity) {
+        m_skips++;
+        return false;
+    }
+    int16_t dew_point;
+    uint16_t absolute_humidity;
+    calculate(temperature, humidity, &dew_point, &absolute_humidity);
+    m_computes++;
+    m_temperature = temperature;
+    m_humidity = humidity;
+
+    bool changed = !m_valid || dew_point != m_dew_point || absolute_humidity != m_absolute_humidity;
+    m_dew_point = dew_point;
+    m_absolute_humidity = absolute_humidity;
+    m_valid = true;
+
+    return changed;
+}
+
+void CDerivedChannels::print_status()
+{
+    int16_t dew_point = m_dew_point;
+    uint16_t absolute_humidity = m_absolute_humidity;
+
+    if (m_valid) {
+        printf("dew point: %.2f degC, absolute humidity: %.2f g/m3 (temperature: %.2f degC, humidity: %.2f %%RH)\n",
+            dew_point / 100.0, absolute_humidity / 100.0, m_temperature / 100.0, m_humidity / 100.0);
+    } else {
+        printf("dew point: -, absolute humidity: -\n");
+    }
+    printf("computed: %" PRIu32 ", skipped (inputs unchanged): %" PRIu32 "\n", m_computes.load(), m_skips.load());
+}
+
+void CDerivedChannels::reset_stats()
+{
+    m_computes = 0;
+    m_skips = 0;
+}
@@ -0,0 +1,169 @@
+#include "energy.h"
+#include "logger.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char *state_names[EnergyStateMax] = {"sensor", "sensor_lp", "i2c", "cpu", "wifi_tx"};
+static const uint32_t default_currents[EnergyStateMax] = {
+    ENERGY_SENSOR_MEASURING_UA,
+    ENERGY_SENSOR_LOW_POWER_UA,
+    ENERGY_I2C_BUSY_UA,
+    ENERGY_CPU_AWAKE_UA,
+    ENERGY_WIFI_TX_UA,
+};
+
+CEnergyMonitor* CEnergyMonitor::_instance = nullptr;
+
+CEnergyMonitor::CEnergyMonitor()
+{
+    for (int i = 0; i < EnergyStateMax; i++) {
+        m_state[i].since_us = 0;
+        m_state[i].current_ua = default_currents[i];
+    }
+    reset_stats();
+}
+
+CEnergyMonitor::~CEnergyMonitor()
+{
+}
+
+CEnergyMonitor* CEnergyMonitor::Instance()
+{
+    if (!_instance) {
+        _instance = new CEnergyMonitor();
+    }
+
+    return _instance;
+}
+
+void CEnergyMonitor::begin(eEnergyState state, int64_t now_us)
+{
+    int64_t idle = 0;
+    if (m_state[state].since_us.compare_exchange_strong(idle, now_us > 0 ? now_us : 1)) {
+        m_state[state].count++;
+    }
+}
+
+void CEnergyMonitor::end(eEnergyState state, int64_t now_us)
+{
+    int64_t since_us = m_state[state].since_us.exchange(0);
+    if (since_us > 0 && now_us > since_us) {
+        m_state[state].active_us += now_us - since_us;
+    }
+}
+
+/**
+ * @brief account an interval measured by the caller (I2C transaction) or an estimated one (Wi-Fi report)
+ */
+void CEnergyMonitor::add(eEnergyState state, int64_t duration_us)
+{
+    if (duration_us > 0) {
+        m_state[state].active_us += duration_us;
+        m_state[state].count++;
+    }
+}
+
+bool CEnergyMonitor::set_current(eEnergyState state, uint32_t current_ua)
+{
+    if (state >= EnergyStateMax) {
+        return false;
+    }
+    m_state[state].current_ua = current_ua;
+    GetLogger(eLogType::Info)->Log("Current of %s set as %" PRIu32 " uA", state_names[state], current_ua);
+    return true;
+}
+
+bool CEnergyMonitor::find_state(const char *name, eEnergyState *state)
+{
+    for (int i = 0; i < EnergyStateMax; i++) {
+        if (strcmp(name, state_names[i]) == 0) {
+            *state = (eEnergyState)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int64_t CEnergyMonitor::get_active_us(eEnergyState state, int64_t now_us)
+{
+    int64_t since_us = m_state[state].since_us;
+    return m_state[state].active_us + (since_us > 0 && now_us > since_us ? now_us - since_us : 0);
+}
+
+/**
+ * @brief charge above the sleep floor since reset_stats()
+ */
+double CEnergyMonitor::get_charge_mas(eEnergyState state, int64_t now_us)
+{
+    return (double)get_active_us(state, now_us) / 1e6 * m_state[state].current_ua / 1000.0;
+}
+
+void CEnergyMonitor::print_report()
+{
+    int64_t now_us = esp_timer_get_time();
+    double elapsed_s = (double)(now_us - m_since_us) / 1e6;
+    double total_mas = 0.0;
+
+    if (elapsed_s <= 0.0) {
+        return;
+    }
+    printf("elapsed: %.0f s, supply: %d mV\n", elapsed_s, ENERGY_SUPPLY_MV);
+    printf("%-10s %12s %8s %8s %10s %12s %10s %10s\n", "state", "active (s)", "duty", "count", "current", "charge", "per hour", "per hour");
+    for (int i = 0; i < EnergyStateMax; i++) {
+        double active_s = (double)get_active_us((eEnergyState)i, now_us) / 1e6;
+        double charge_mas = get_charge_mas((eEnergyState)i, now_us);
+        double per_hour_mah = charge_mas / elapsed_s;     // mA.s per s == mAh per hour
+        total_mas += charge_mas;
+        printf("%-10s %12.3f %7.3f%% %8" PRIu32 " %7" PRIu32 " uA %7.1f mA.s %6.3f mAh %6.2f mWh\n", state_names[i], active_s,
+            active_s * 100.0 / elapsed_s, m_state[i].count.load(), m_state[i].current_ua.load(), charge_mas, per_hour_mah,
+            per_hour_mah * ENERGY_SUPPLY_MV / 1000.0);
+    }
+    printf("total: %.1f mA.s, %.3f mAh / %.2f mWh per hour (above sleep floor)\n", total_mas, total_mas / elapsed_s,
+        total_mas / elapsed_s * ENERGY_SUPPLY_MV / 1000.0);
+}
+
+void CEnergyMonitor::write_report_json(CJsonWriter *writer)
+{
+    int64_t now_us = esp_timer_get_time();
+    int64_t elapsed_us = now_us - m_since_us;
+    double total_mas = 0.0;
+
+    writer->begin_object();
+    writer->add_int("elapsed_us", elapsed_us);
+    writer->add_uint("supply_mv", ENERGY_SUPPLY_MV);
+    writer->begin_array("states");
+    for (int i = 0; i < EnergyStateMax; i++) {
+        int64_t active_us = get_active_us((eEnergyState)i, now_us);
+        double charge_mas = get_charge_mas((eEnergyState)i, now_us);
+        total_mas += charge_mas;
+        writer->begin_object();
+        writer->add_string("name", state_names[i]);
+        writer->add_int("active_us", active_us);
+        writer->add_uint("count", m_state[i].count.load());
+        writer->add_uint("current_ua", m_state[i].current_ua.load());
+        writer->add_double("charge_mas", charge_mas);
+        writer->add_double("mah_per_hour", elapsed_us > 0 ? charge_mas * 1e6 / elapsed_us : 0.0);
+        writer->end_object();
+    }
+    writer->end_array();
+    writer->add_double("charge_mas", total_mas);
+    writer->add_double("mah_per_hour", elapsed_us > 0 ? total_mas * 1e6 / elapsed_us : 0.0);
+    writer->add_double("mwh_per_hour", elapsed_us > 0 ? total_mas * 1e6 / elapsed_us * ENERGY_SUPPLY_MV / 1000.0 : 0.0);
+    writer->end_object();
+}
+
+void CEnergyMonitor::reset_stats()
+{
+    int64_t now_us = esp_timer_get_time();
+    m_since_us = now_us;
+    for (int i = 0; i < EnergyStateMax; i++) {
+        // running intervals restart now
+        if (m_state[i].since_us != 0) {
+            m_state[i].since_us = now_us;
+        }
+        m_state[i].active_us = 0;
+        m_state[i].count = 0;
+    }
+}
@@ -0,0 +1,260 @@
+#include "filter.h"
+#include "logger.h"
+#include "definition.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define Q8(x)   ((int32_t)(x) * 256)
+
+typedef struct {
+    const char *name;
+    int32_t gate_min_dev;   // deviations below this are never rejected (flat readings give MAD 0)
+    int32_t kalman_q;       // process noise per sample, Q8 of unit^2
+    int32_t kalman_r;       // measurement noise, Q8 of unit^2
+    bool median;            // outlier gate + median, off for slow sensors without spikes (a median lags ramps by a sample)
+    int32_t follow_dev;     // 0: disabled, samples this far from the estimate are taken as is (ramp, shower)
+} filter_channel_param_t;
+
+static const filter_channel_param_t channel_params[FilterChannelMax] = {
+    {"co2",         50,  Q8(4),   Q8(100),  true,  0},      // ppm, repeatability +-10 ppm
+    {"temperature", 100, Q8(4),   Q8(100),  true,  0},      // 0.01 degC, +-0.1 degC
+    {"humidity",    500, Q8(100), Q8(2500), false, 40},     // 0.01 %RH, +-0.5 %RH, noise 0.1 %RH
+};
+
+CMeasurementFilter* CMeasurementFilter::_instance = nullptr;
+
+CMeasurementFilter::CMeasurementFilter()
+{
+    m_mode = FilterModeOff;
+    m_window = 1;
+    m_alpha = 65536;
+    m_gate_x10 = 0;
+    reset();
+    reset_stats();
+}
+
+CMeasurementFilter::~CMeasurementFilter()
+{
+}
+
+CMeasurementFilter* CMeasurementFilter::Instance()
+{
+    if (!_instance) {
+        _instance = new CMeasurementFilter();
+    }
+
+    return _instance;
+}
+
+/**
+ * @brief should be called from the measurement task, filter state restarts from the next sample
+ */
+void CMeasurementFilter::configure(eFilterMode mode, uint8_t window, uint8_t alpha_percent, uint8_t gate_x10)
+{
+    if (window < 1) {
+        window = 1;
+    } else if (window > FILTER_WINDOW_MAX) {
+        window = FILTER_WINDOW_MAX;
+    }
+    if (alpha_percent < 1) {
+        alpha_percent = 1;
+    } else if (alpha_percent > 100) {
+        alpha_percent = 100;
+    }
+    m_mode = mode;
+    m_window = window | 1;
+    m_alpha = ((int32_t)alpha_percent * 65536 + 50) / 100;
+    m_gate_x10 = gate_x10;
+    reset();
+    GetLogger(eLogType::Info)->Log("Configured (mode: %d, window: %u, alpha: %u%%, gate: %u.%u MAD)",
+        mode, m_window, alpha_percent, gate_x10 / 10, gate_x10 % 10);
+}
+
+int32_t CMeasurementFilter::process(eFilterChannel channel, int32_t value)
+{
+    filter_state_t *state = &m_state[channel];
+    int32_t output;
+
+    if (!state->initialized) {
+        push(state, value);
+        state->estimate = Q8(value);
+        state->variance = channel_params[channel].kalman_r;
+        state->last_raw = value;
+        state->last_output = value;
+        state->initialized = true;
+        m_raw_changes[channel]++;
+        m_output_changes[channel]++;
+        return value;
+    }
+
+    if (value != state->last_raw) {
+        m_raw_changes[channel]++;
+    }
+    state->last_raw = value;
+
+    if (m_mode == FilterModeOff) {
+        output = value;
+    } else if (!channel_params[channel].median) {
+        output = smooth(channel, value);
+    } else if (is_outlier(channel, value)) {
+        if (++state->rejects < FILTER_REJECT_LIMIT) {
+            m_outliers[channel]++;
+            return state->last_output;
+        }
+        // persistent deviation is a real change, restart from it
+        m_level_changes[channel]++;
+        state->count = 0;
+        state->head = 0;
+        state->rejects = 0;
+        push(state, value);
+        state->estimate = Q8(value);
+        state->variance = channel_params[channel].kalman_r;
+        output = value;
+    } else {
+        state->rejects = 0;
+        push(state, value);
+        output = smooth(channel, median(state->window, state->count));
+    }
+
+    if (output != state->last_output) {
+        m_output_changes[channel]++;
+    }
+    state->last_output = output;
+    return output;
+}
+
+/**
+ * @brief forget the previous samples (configuration change, sensor recovery)
+ */
+void CMeasurementFilter::reset()
+{
+    memset(m_state, 0, sizeof(m_state));
+}
+
+void CMeasurementFilter::save(filter_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(filter_snapshot_t));
+    snapshot->mode = (uint8_t)m_mode;
+    snapshot->window = m_window;
+    snapshot->alpha = m_alpha;
+    snapshot->gate_x10 = m_gate_x10;
+    memcpy(snapshot->state, m_state, sizeof(m_state));
+}
+
+/**
+ * @brief continue from retained states (battery mode), rejected when they were built with another configuration
+ */
+bool CMeasurementFilter::restore(const filter_snapshot_t *snapshot)
+{
+    if (snapshot->mode != (uint8_t)m_mode || snapshot->window != m_window || snapshot->alpha != m_alpha || snapshot->gate_x10 != m_gate_x10) {
+        return false;
+    }
+    for (int i = 0; i < FilterChannelMax; i++) {
+        if (snapshot->state[i].count > m_window || snapshot->state[i].head >= m_window) {
+            return false;
+        }
+    }
+    memcpy(m_state, snapshot->state, sizeof(m_state));
+    return true;
+}
+
+bool CMeasurementFilter::is_outlier(eFilterChannel channel, int32_t value)
+{
+    filter_state_t *state = &m_state[channel];
+    int32_t deviations[FILTER_WINDOW_MAX];
+
+    if (m_gate_x10 == 0 || state->count < 3) {
+        return false;
+    }
+    int32_t center = median(state->window, state->count);
+    for (int i = 0; i < state->count; i++) {
+        deviations[i] = abs(state->window[i] - center);
+    }
+    int32_t mad = median(deviations, state->count);
+    int32_t threshold = (int32_t)(((int64_t)m_gate_x10 * mad * FILTER_MAD_SCALE) / 10000);
+    if (threshold < channel_params[channel].gate_min_dev) {
+        threshold = channel_params[channel].gate_min_dev;
+    }
+
+    return abs(value - center) > threshold;
+}
+
+void CMeasurementFilter::push(filter_state_t *state, int32_t value)
+{
+    state->window[state->head] = value;
+    state->head = (state->head + 1) % m_window;
+    if (state->count < m_window) {
+        state->count++;
+    }
+}
+
+int32_t CMeasurementFilter::smooth(eFilterChannel channel, int32_t value)
+{
+    filter_state_t *state = &m_state[channel];
+    int32_t error = Q8(value) - state->estimate;
+    int32_t follow_dev = channel_params[channel].follow_dev;
+
+    if (follow_dev && abs(error) > Q8(follow_dev)) {
+        m_level_changes[channel]++;
+        state->estimate = Q8(value);
+        state->variance = channel_params[channel].kalman_r;
+        return value;
+    }
+    if (m_mode == FilterModeKalman) {
+        int32_t p = state->variance + channel_params[channel].kalman_q;
+        // innovation far beyond the expected spread is a real change (ramp), the estimate follows it instead of lagging
+        int64_t innovation = ((int64_t)error * error) >> 8;
+        if (innovation > 9 * (int64_t)(p + channel_params[channel].kalman_r)) {
+            p = (int32_t)MIN(innovation, (int64_t)INT32_MAX / 2);
+        }
+        int32_t gain = (int32_t)(((int64_t)p << 16) / (p + channel_params[channel].kalman_r));     // Q16
+        state->estimate += (int32_t)(((int64_t)error * gain) >> 16);
+        state->variance = (int32_t)(((int64_t)p * (65536 - gain)) >> 16);
+    } else {
+        state->estimate += (int32_t)(((int64_t)error * m_alpha) >> 16);
+    }
+
+    return (state->estimate + 128) >> 8;
+}
+
+int32_t CMeasurementFilter::median(const int32_t *values, int count)
+{
+    int32_t sorted[FILTER_WINDOW_MAX];
+
+    for (int i = 0; i < count; i++) {
+        int32_t v = values[i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = v;
+    }
+    if (count & 1) {
+        return sorted[count / 2];
+    }
+    return (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+}
+
+void CMeasurementFilter::print_status()
+{
+    static const char *mode_names[] = {"off", "ema", "kalman"};
+    printf("mode: %s, window: %u, alpha: %" PRId32 "%%, gate: %" PRId32 ".%" PRId32 " MAD\n", mode_names[m_mode], m_window,
+        (m_alpha * 100 + 32768) / 65536, m_gate_x10 / 10, m_gate_x10 % 10);
+    for (int i = 0; i < FilterChannelMax; i++) {
+        printf("%-12s updates: %" PRIu32 " (unfiltered: %" PRIu32 "), outliers: %" PRIu32 ", level changes: %" PRIu32 ", last: %" PRId32 " (raw: %" PRId32 ")\n",
+            channel_params[i].name, m_output_changes[i].load(), m_raw_changes[i].load(), m_outliers[i].load(), m_level_changes[i].load(),
+            m_state[i].last_output, m_state[i].last_raw);
+    }
+}
+
+void CMeasurementFilter::reset_stats()
+{
+    for (int i = 0; i < FilterChannelMax; i++) {
+        m_raw_changes[i] = 0;
+        m_output_changes[i] = 0;
+        m_outliers[i] = 0;
+        m_level_changes[i] = 0;
+    }
+}
@@ -0,0 +1,117 @@
+#include "histogram.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+CHistogram::CHistogram()
+{
+    reset();
+}
+
+void CHistogram::record(int64_t value_us)
+{
+    uint32_t value = value_us < 0 ? 0 : (value_us > UINT32_MAX ? UINT32_MAX : (uint32_t)value_us);
+    int index = value ? 32 - __builtin_clz(value) : 0;
+    if (index >= HISTOGRAM_BUCKET_COUNT) {
+        index = HISTOGRAM_BUCKET_COUNT - 1;
+    }
+
+    m_bucket[index].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    uint32_t prev = m_max.load(std::memory_order_relaxed);
+    while (value > prev && !m_max.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+    }
+}
+
+void CHistogram::reset()
+{
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+        m_bucket[i].store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+uint32_t CHistogram::get_count()
+{
+    return m_count.load(std::memory_order_relaxed);
+}
+
+uint32_t CHistogram::get_max()
+{
+    return m_max.load(std::memory_order_relaxed);
+}
+
+uint32_t CHistogram::get_bucket(int index)
+{
+    if (index < 0 || index >= HISTOGRAM_BUCKET_COUNT)
+        return 0;
+    return m_bucket[index].load(std::memory_order_relaxed);
+}
+
+uint32_t CHistogram::get_bucket_upper_bound(int index)
+{
+    if (index >= HISTOGRAM_BUCKET_COUNT - 1)
+        return UINT32_MAX;
+    return (uint32_t)1 << index;
+}
+
+uint32_t CHistogram::get_percentile(int percent)
+{
+    uint32_t count = get_count();
+    if (count == 0)
+        return 0;
+
+    uint64_t target = ((uint64_t)count * percent + 99) / 100;
+    uint64_t accum = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+        accum += get_bucket(i);
+        if (accum >= target) {
+            uint32_t bound = get_bucket_upper_bound(i);
+            return bound < get_max() ? bound : get_max();
+        }
+    }
+    return get_max();
+}
+
+void CHistogram::print(const char *name)
+{
+    printf("%s: count=%" PRIu32 ", p50<=%" PRIu32 " us, p90<=%" PRIu32 " us, p99<=%" PRIu32 " us, max=%" PRIu32 " us\n",
+        name, get_count(), get_percentile(50), get_percentile(90), get_percentile(99), get_max());
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+        uint32_t count = get_bucket(i);
+        if (count == 0)
+            continue;
+        if (i == HISTOGRAM_BUCKET_COUNT - 1) {
+            printf("  [%8" PRIu32 " us, ...        ) %" PRIu32 "\n", i ? get_bucket_upper_bound(i - 1) : (uint32_t)0, count);
+        } else {
+            printf("  [%8" PRIu32 " us, %8" PRIu32 " us) %" PRIu32 "\n", i ? get_bucket_upper_bound(i - 1) : (uint32_t)0, get_bucket_upper_bound(i), count);
+        }
+    }
+}
+
+void CHistogram::write_json(CJsonWriter *writer, const char *key)
+{
+    writer->begin_object(key);
+    writer->add_uint("count", get_count());
+    writer->add_uint("p50", get_percentile(50));
+    writer->add_uint("p90", get_percentile(90));
+    writer->add_uint("p99", get_percentile(99));
+    writer->add_uint("max", get_max());
+    // [upper bound, count] pairs of non empty buckets, last bucket upper bound is null (open ended)
+    writer->begin_array("buckets");
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+        uint32_t count = get_bucket(i);
+        if (count == 0)
+            continue;
+        writer->begin_array();
+        if (i == HISTOGRAM_BUCKET_COUNT - 1) {
+            writer->value_null();
+        } else {
+            writer->value_uint(get_bucket_upper_bound(i));
+        }
+        writer->value_uint(count);
+        writer->end_array();
+    }
+    writer->end_array();
+    writer->end_object();
+}
@@ -0,0 +1,474 @@
+#include "history.h"
+#include "logger.h"
+#include "definition.h"
+#include "esp_timer.h"
+#include <time.h>
+#include <string.h>
+#include <math.h>
+
+#define HISTORY_PARTITION_LABEL     "history"
+#define HISTORY_PARTITION_SUBTYPE   0x40
+#define HISTORY_SECTOR_SIZE         4096
+#define HISTORY_SEQ_ERASED          0xFFFFFFFF
+#define HISTORY_VALID_EPOCH         1704067200  // 2024-01-01 00:00:00 UTC, wall clock is not set before this
+
+/* sectors per tier (partition: 128 sectors) */
+#define HISTORY_SECTORS_RAW         96          // 24576 samples, ~2.8 days at 10 sec period
+#define HISTORY_SECTORS_MINUTE      16          // 1360 buckets, ~22 hours
+#define HISTORY_SECTORS_HOUR        10          // 850 buckets, ~35 days
+#define HISTORY_SECTORS_DAY         5           // 425 buckets, ~14 months
+
+typedef struct {
+    uint32_t seq;
+    history_sample_t sample;
+} history_raw_record_t;
+
+typedef struct {
+    uint32_t seq;
+    history_bucket_t bucket;
+} history_bucket_record_t;
+
+static const uint32_t tier_period_sec[TierMax] = {0, 60, 3600, 86400};
+static const uint32_t tier_retention_default_sec[TierMax] = {
+    2 * 86400,      // raw
+    20 * 3600,      // minute
+    31 * 86400,     // hour
+    365 * 86400     // day
+};
+
+CHistory* CHistory::_instance = nullptr;
+
+CHistory::CHistory()
+{
+    m_initialized = false;
+    m_partition = nullptr;
+    m_mutex = xSemaphoreCreateMutex();
+    m_time_base = 0;
+    memset(m_region, 0, sizeof(m_region));
+    memset(m_accumulator, 0, sizeof(m_accumulator));
+    for (int i = 0; i < TierMax; i++) {
+        m_retention[i] = tier_retention_default_sec[i];
+    }
+}
+
+CHistory::~CHistory()
+{
+    if (m_mutex) {
+        vSemaphoreDelete(m_mutex);
+    }
+}
+
+CHistory* CHistory::Instance()
+{
+    if (!_instance) {
+        _instance = new CHistory();
+    }
+
+    return _instance;
+}
+
+bool CHistory::initialize()
+{
+    m_initialized = false;
+
+    m_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)HISTORY_PARTITION_SUBTYPE, HISTORY_PARTITION_LABEL);
+    if (!m_partition) {
+        GetLogger(eLogType::Error)->Log("Cannot find history partition");
+        return false;
+    }
+
+    uint32_t offset = 0;
+    const uint32_t sectors[TierMax] = {HISTORY_SECTORS_RAW, HISTORY_SECTORS_MINUTE, HISTORY_SECTORS_HOUR, HISTORY_SECTORS_DAY};
+    const uint32_t record_size[TierMax] = {
+        sizeof(history_raw_record_t),
+        sizeof(history_bucket_record_t),
+        sizeof(history_bucket_record_t),
+        sizeof(history_bucket_record_t)
+    };
+    for (int i = 0; i < TierMax; i++) {
+        if (offset + sectors[i] * HISTORY_SECTOR_SIZE > m_partition->size) {
+            GetLogger(eLogType::Error)->Log("History partition too small (size: %u)", m_partition->size);
+            return false;
+        }
+        if (!region_init(&m_region[i], offset, sectors[i], record_size[i])) {
+            return false;
+        }
+        offset += sectors[i] * HISTORY_SECTOR_SIZE;
+    }
+
+    replay();
+
+    m_initialized = true;
+    GetLogger(eLogType::Info)->Log("Initialized (raw: %u, minute: %u, hour: %u, day: %u records)",
+        m_region[TierRaw].head - region_oldest(&m_region[TierRaw]),
+        m_region[TierMinute].head - region_oldest(&m_region[TierMinute]),
+        m_region[TierHour].head - region_oldest(&m_region[TierHour]),
+        m_region[TierDay].head - region_oldest(&m_region[TierDay]));
+    return true;
+}
+
+bool CHistory::release()
+{
+    m_initialized = false;
+    return true;
+}
+
+uint32_t CHistory::get_timestamp()
+{
+    time_t now = time(nullptr);
+    if (now >= HISTORY_VALID_EPOCH) {
+        return (uint32_t)now;
+    }
+    // no wall clock: continue from the last persisted record so that timestamps stay monotonic across reboots
+    return m_time_base + (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+uint32_t CHistory::get_tier_period(eHistoryTier tier)
+{
+    return tier_period_sec[tier];
+}
+
+uint32_t CHistory::get_tier_capacity(eHistoryTier tier)
+{
+    return m_region[tier].capacity;
+}
+
+uint32_t CHistory::get_tier_retention(eHistoryTier tier)
+{
+    return m_retention[tier];
+}
+
+void CHistory::set_tier_retention(eHistoryTier tier, uint32_t retention_sec)
+{
+    m_retention[tier] = retention_sec;
+}
+
+void CHistory::append_sample(uint16_t co2ppm, float temperature, float humidity)
+{
+    if (!m_initialized)
+        return;
+
+    history_raw_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.sample.timestamp = get_timestamp();
+    record.sample.co2ppm = co2ppm;
+    // rounded, truncation biased every stored value low by up to 0.01
+    record.sample.temperature = (int16_t)lroundf(temperature * 100.f);
+    record.sample.humidity = (uint16_t)lroundf(humidity * 100.f);
+
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    if (!region_append(&m_region[TierRaw], &record)) {
+        GetLogger(eLogType::Error)->Log("Failed to append raw sample");
+    }
+    for (int i = TierMinute; i < TierMax; i++) {
+        rollup((eHistoryTier)i, &record.sample);
+    }
+    xSemaphoreGive(m_mutex);
+}
+
+size_t CHistory::query_samples(uint32_t ts_from, uint32_t ts_to, history_sample_cb_t callback, void *arg)
+{
+    if (!m_initialized || !callback)
+        return 0;
+
+    history_raw_record_t record;
+    size_t count = 0;
+    uint32_t now = get_timestamp();
+    if (now > m_retention[TierRaw] && ts_from < now - m_retention[TierRaw]) {
+        ts_from = now - m_retention[TierRaw];
+    }
+
+    for (uint32_t seq = region_lower_bound(TierRaw, ts_from); ; seq++) {
+        xSemaphoreTake(m_mutex, portMAX_DELAY);
+        bool valid = seq < m_region[TierRaw].head && region_read(&m_region[TierRaw], seq, &record);
+        xSemaphoreGive(m_mutex);
+        if (!valid || record.sample.timestamp > ts_to)
+            break;
+        if (record.sample.timestamp < ts_from)
+            continue;
+        count++;
+        if (!callback(&record.sample, arg))
+            break;
+    }
+
+    return count;
+}
+
+size_t CHistory::query_buckets(eHistoryTier tier, uint32_t ts_from, uint32_t ts_to, history_bucket_cb_t callback, void *arg)
+{
+    if (!m_initialized || !callback || tier == TierRaw || tier >= TierMax)
+        return 0;
+
+    history_bucket_record_t record;
+    size_t count = 0;
+    uint32_t now = get_timestamp();
+    if (now > m_retention[tier] && ts_from < now - m_retention[tier]) {
+        ts_from = now - m_retention[tier];
+    }
+
+    for (uint32_t seq = region_lower_bound(tier, ts_from); ; seq++) {
+        xSemaphoreTake(m_mutex, portMAX_DELAY);
+        bool valid = seq < m_region[tier].head && region_read(&m_region[tier], seq, &record);
+        xSemaphoreGive(m_mutex);
+        if (!valid || record.bucket.timestamp > ts_to)
+            break;
+        if (record.bucket.timestamp < ts_from)
+            continue;
+        count++;
+        if (!callback(&record.bucket, arg))
+            return count;
+    }
+
+    // currently open bucket
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    bool open = m_accumulator[tier].count > 0 && m_accumulator[tier].start >= ts_from && m_accumulator[tier].start <= ts_to;
+    if (open) {
+        accumulator_to_bucket(&m_accumulator[tier], &record.bucket);
+    }
+    xSemaphoreGive(m_mutex);
+    if (open) {
+        count++;
+        callback(&record.bucket, arg);
+    }
+
+    return count;
+}
+
+bool CHistory::region_init(history_region_t *region, uint32_t offset, uint32_t sector_count, uint32_t record_size)
+{
+    esp_err_t ret;
+    uint32_t seq;
+    uint32_t head_sector = 0;
+    uint32_t head_seq = HISTORY_SEQ_ERASED;
+    bool corrupted = false;
+
+    region->offset = offset;
+    region->sector_count = sector_count;
+    region->record_size = record_size;
+    region->records_per_sector = HISTORY_SECTOR_SIZE / record_size;
+    region->capacity = region->records_per_sector * sector_count;
+    region->head = 0;
+
+    // find the sector holding the newest record (first record of every written sector carries a sequence number)
+    for (uint32_t i = 0; i < sector_count; i++) {
+        ret = esp_partition_read(m_partition, offset + i * HISTORY_SECTOR_SIZE, &seq, sizeof(seq));
+        if (ret != ESP_OK) {
+            GetLogger(eLogType::Error)->Log("Failed to read history partition (ret: %d)", ret);
+            return false;
+        }
+        if (seq == HISTORY_SEQ_ERASED)
+            continue;
+        if (seq % region->capacity != i * region->records_per_sector) {
+            corrupted = true;
+            break;
+        }
+        if (head_seq == HISTORY_SEQ_ERASED || seq > head_seq) {
+            head_seq = seq;
+            head_sector = i;
+        }
+    }
+
+    if (corrupted) {
+        GetLogger(eLogType::Warning)->Log("History region at 0x%X is corrupted, erasing", offset);
+        ret = esp_partition_erase_range(m_partition, offset, sector_count * HISTORY_SECTOR_SIZE);
+        if (ret != ESP_OK) {
+            GetLogger(eLogType::Error)->Log("Failed to erase history region (ret: %d)", ret);
+            return false;
+        }
+        return true;
+    }
+
+    if (head_seq == HISTORY_SEQ_ERASED)
+        return true;
+
+    // scan the newest sector for its last record
+    uint32_t sector_offset = offset + head_sector * HISTORY_SECTOR_SIZE;
+    region->head = head_seq + 1;
+    for (uint32_t i = 1; i < region->records_per_sector; i++) {
+        ret = esp_partition_read(m_partition, sector_offset + i * record_size, &seq, sizeof(seq));
+        if (ret != ESP_OK || seq != head_seq + i)
+            break;
+        region->head = seq + 1;
+    }
+
+    return true;
+}
+
+bool CHistory::region_append(history_region_t *region, void *record)
+{
+    esp_err_t ret;
+    uint32_t seq = region->head;
+    uint32_t slot = seq % region->capacity;
+    uint32_t sector = slot / region->records_per_sector;
+    uint32_t address = region->offset + sector * HISTORY_SECTOR_SIZE + (slot % region->records_per_sector) * region->record_size;
+
+    if (slot % region->records_per_sector == 0) {
+        ret = esp_partition_erase_range(m_partition, region->offset + sector * HISTORY_SECTOR_SIZE, HISTORY_SECTOR_SIZE);
+        if (ret != ESP_OK) {
+            GetLogger(eLogType::Error)->Log("Failed to erase history sector (ret: %d)", ret);
+            return false;
+        }
+    }
+
+    // every record starts with its sequence number
+    memcpy(record, &seq, sizeof(seq));
+    ret = esp_partition_write(m_partition, address, record, region->record_size);
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Error)->Log("Failed to write history record (ret: %d)", ret);
+        return false;
+    }
+    region->head = seq + 1;
+
+    return true;
+}
+
+bool CHistory::region_read(history_region_t *region, uint32_t seq, void *record)
+{
+    uint32_t slot = seq % region->capacity;
+    uint32_t address = region->offset + (slot / region->records_per_sector) * HISTORY_SECTOR_SIZE + (slot % region->records_per_sector) * region->record_size;
+
+    if (esp_partition_read(m_partition, address, record, region->record_size) != ESP_OK)
+        return false;
+
+    // record was overwritten or never written
+    return *(uint32_t *)record == seq;
+}
+
+uint32_t CHistory::region_oldest(history_region_t *region)
+{
+    if (region->head == 0)
+        return 0;
+
+    // the sector holding the newest record was erased as a whole, so one sector worth of capacity is lost
+    uint32_t newest = region->head - 1;
+    uint32_t sector_start = newest - newest % region->records_per_sector;
+    uint32_t span = region->capacity - region->records_per_sector;
+    return sector_start >= span ? sector_start - span : 0;
+}
+
+uint32_t CHistory::region_lower_bound(eHistoryTier tier, uint32_t ts_from)
+{
+    history_region_t *region = &m_region[tier];
+    union {
+        history_raw_record_t raw;
+        history_bucket_record_t bucket;
+    } record;
+    uint32_t timestamp;
+    bool valid;
+
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    uint32_t lo = region_oldest(region);
+    uint32_t hi = region->head;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        valid = region_read(region, mid, &record);
+        timestamp = tier == TierRaw ? record.raw.sample.timestamp : record.bucket.bucket.timestamp;
+        if (!valid || timestamp < ts_from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    xSemaphoreGive(m_mutex);
+
+    return lo;
+}
+
+void CHistory::accumulator_reset(history_accumulator_t *acc, uint32_t start)
+{
+    acc->start = start;
+    acc->count = 0;
+    for (int i = 0; i < HISTORY_CHANNEL_COUNT; i++) {
+        acc->min[i] = INT32_MAX;
+        acc->max[i] = INT32_MIN;
+        acc->sum[i] = 0;
+    }
+}
+
+void CHistory::accumulator_add(history_accumulator_t *acc, const history_sample_t *sample)
+{
+    const int32_t values[HISTORY_CHANNEL_COUNT] = {
+        (int32_t)sample->co2ppm,
+        (int32_t)sample->temperature,
+        (int32_t)sample->humidity
+    };
+
+    for (int i = 0; i < HISTORY_CHANNEL_COUNT; i++) {
+        acc->min[i] = MIN(acc->min[i], values[i]);
+        acc->max[i] = MAX(acc->max[i], values[i]);
+        acc->sum[i] += values[i];
+    }
+    acc->count++;
+}
+
+void CHistory::accumulator_to_bucket(const history_accumulator_t *acc, history_bucket_t *bucket)
+{
+    bucket->timestamp = acc->start;
+    bucket->count = acc->count;
+    for (int i = 0; i < HISTORY_CHANNEL_COUNT; i++) {
+        bucket->min[i] = acc->min[i];
+        bucket->max[i] = acc->max[i];
+        bucket->mean[i] = acc->count ? (int32_t)(acc->sum[i] / (int64_t)acc->count) : 0;
+    }
+}
+
+void CHistory::rollup(eHistoryTier tier, const history_sample_t *sample)
+{
+    history_accumulator_t *acc = &m_accumulator[tier];
+    uint32_t start = sample->timestamp - sample->timestamp % tier_period_sec[tier];
+
+    if (acc->count > 0 && acc->start != start) {
+        // bucket closed, persist it
+        history_bucket_record_t record;
+        memset(&record, 0, sizeof(record));
+        accumulator_to_bucket(acc, &record.bucket);
+        if (!region_append(&m_region[tier], &record)) {
+            GetLogger(eLogType::Error)->Log("Failed to append rollup bucket (tier: %d)", tier);
+        }
+    }
+    if (acc->count == 0 || acc->start != start) {
+        accumulator_reset(acc, start);
+    }
+    accumulator_add(acc, sample);
+}
+
+void CHistory::replay()
+{
+    history_raw_record_t raw;
+    history_bucket_record_t record;
+    uint32_t closed_end[TierMax] = {0, };
+    uint32_t replay_from = UINT32_MAX;
+
+    for (int i = 0; i < TierMax; i++) {
+        accumulator_reset(&m_accumulator[i], 0);
+    }
+
+    // resume the fallback clock from the newest raw sample
+    history_region_t *region = &m_region[TierRaw];
+    if (region->head == 0)
+        return;
+    if (region_read(region, region->head - 1, &raw)) {
+        m_time_base = raw.sample.timestamp + 1;
+    }
+
+    // open buckets are lost on reset; rebuild them from the raw samples not yet covered by a closed bucket
+    for (int i = TierMinute; i < TierMax; i++) {
+        if (m_region[i].head > 0 && region_read(&m_region[i], m_region[i].head - 1, &record)) {
+            closed_end[i] = record.bucket.timestamp + tier_period_sec[i];
+        }
+        replay_from = MIN(replay_from, closed_end[i]);
+    }
+
+    uint32_t replayed = 0;
+    for (uint32_t seq = region_lower_bound(TierRaw, replay_from); seq < region->head; seq++) {
+        if (!region_read(region, seq, &raw))
+            continue;
+        for (int i = TierMinute; i < TierMax; i++) {
+            if (raw.sample.timestamp >= closed_end[i]) {
+                rollup((eHistoryTier)i, &raw.sample);
+            }
+        }
+        replayed++;
+    }
+    GetLogger(eLogType::Info)->Log("Replayed %u raw samples into open buckets", replayed);
+}
@@ -0,0 +1,238 @@
+#include "jsonwriter.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+CJsonWriter::CJsonWriter(json_sink_t sink, void *arg)
+{
+    m_sink = sink;
+    m_sink_arg = arg;
+    m_length = 0;
+    m_written = 0;
+    m_first = 1;
+    m_depth = 0;
+}
+
+CJsonWriter::~CJsonWriter()
+{
+    flush();
+}
+
+void CJsonWriter::sink_stdout(const char *data, size_t len, void *arg)
+{
+    fwrite(data, 1, len, stdout);
+}
+
+void CJsonWriter::flush()
+{
+    if (m_length && m_sink) {
+        m_sink(m_buffer, m_length, m_sink_arg);
+    }
+    m_written += m_length;
+    m_length = 0;
+}
+
+void CJsonWriter::write(const char *data, size_t len)
+{
+    while (len) {
+        size_t chunk = sizeof(m_buffer) - m_length;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(&m_buffer[m_length], data, chunk);
+        m_length += chunk;
+        data += chunk;
+        len -= chunk;
+        if (m_length == sizeof(m_buffer)) {
+            flush();
+        }
+    }
+}
+
+void CJsonWriter::write_char(char c)
+{
+    if (m_length == sizeof(m_buffer)) {
+        flush();
+    }
+    m_buffer[m_length++] = c;
+}
+
+void CJsonWriter::write_escaped(const char *value, size_t len)
+{
+    char temp[8];
+
+    write_char('"');
+    for (size_t i = 0; i < len && value[i]; i++) {
+        unsigned char c = (unsigned char)value[i];
+        switch (c) {
+        case '"':  write("\\\"", 2); break;
+        case '\\': write("\\\\", 2); break;
+        case '\b': write("\\b", 2); break;
+        case '\f': write("\\f", 2); break;
+        case '\n': write("\\n", 2); break;
+        case '\r': write("\\r", 2); break;
+        case '\t': write("\\t", 2); break;
+        default:
+            if (c < 0x20) {
+                int n = snprintf(temp, sizeof(temp), "\\u%04x", c);
+                write(temp, n);
+            } else {
+                write_char((char)c);
+            }
+            break;
+        }
+    }
+    write_char('"');
+}
+
+void CJsonWriter::separator()
+{
+    uint32_t bit = (uint32_t)1 << m_depth;
+    if (m_first & bit) {
+        m_first &= ~bit;
+    } else {
+        write_char(',');
+    }
+}
+
+void CJsonWriter::write_key(const char *key)
+{
+    separator();
+    if (key) {
+        write_escaped(key, strlen(key));
+        write_char(':');
+    }
+}
+
+void CJsonWriter::begin(char c, const char *key)
+{
+    write_key(key);
+    write_char(c);
+    if (m_depth < JSON_WRITER_MAX_DEPTH - 1) {
+        m_depth++;
+        m_first |= (uint32_t)1 << m_depth;
+    }
+}
+
+void CJsonWriter::end(char c)
+{
+    if (m_depth > 0) {
+        m_depth--;
+    }
+    write_char(c);
+}
+
+void CJsonWriter::begin_object(const char *key/*=nullptr*/)
+{
+    begin('{', key);
+}
+
+void CJsonWriter::end_object()
+{
+    end('}');
+}
+
+void CJsonWriter::begin_array(const char *key/*=nullptr*/)
+{
+    begin('[', key);
+}
+
+void CJsonWriter::end_array()
+{
+    end(']');
+}
+
+void CJsonWriter::value_string(const char *value)
+{
+    value_string(value, value ? strlen(value) : 0);
+}
+
+void CJsonWriter::value_string(const char *value, size_t len)
+{
+    add_string(nullptr, value, len);
+}
+
+void CJsonWriter::value_int(int64_t value)
+{
+    add_int(nullptr, value);
+}
+
+void CJsonWriter::value_uint(uint64_t value)
+{
+    add_uint(nullptr, value);
+}
+
+void CJsonWriter::value_double(double value)
+{
+    add_double(nullptr, value);
+}
+
+void CJsonWriter::value_bool(bool value)
+{
+    add_bool(nullptr, value);
+}
+
+void CJsonWriter::value_null()
+{
+    add_null(nullptr);
+}
+
+void CJsonWriter::add_string(const char *key, const char *value)
+{
+    add_string(key, value, value ? strlen(value) : 0);
+}
+
+void CJsonWriter::add_string(const char *key, const char *value, size_t len)
+{
+    write_key(key);
+    if (!value) {
+        write("null", 4);
+        return;
+    }
+    write_escaped(value, len);
+}
+
+void CJsonWriter::add_int(const char *key, int64_t value)
+{
+    char temp[24];
+    int n = snprintf(temp, sizeof(temp), "%" PRId64, value);
+    write_key(key);
+    write(temp, n);
+}
+
+void CJsonWriter::add_uint(const char *key, uint64_t value)
+{
+    char temp[24];
+    int n = snprintf(temp, sizeof(temp), "%" PRIu64, value);
+    write_key(key);
+    write(temp, n);
+}
+
+void CJsonWriter::add_double(const char *key, double value)
+{
+    char temp[32];
+    write_key(key);
+    if (isnan(value) || isinf(value)) {
+        write("null", 4);
+        return;
+    }
+    int n = snprintf(temp, sizeof(temp), "%.15g", value);
+    write(temp, n);
+}
+
+void CJsonWriter::add_bool(const char *key, bool value)
+{
+    write_key(key);
+    if (value) {
+        write("true", 4);
+    } else {
+        write("false", 5);
+    }
+}
+
+void CJsonWriter::add_null(const char *key)
+{
+    write_key(key);
+    write("null", 4);
+}
@@ -1,150 +1,521 @@
 #include "logger.h"
-#ifndef UNIT_TEST
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#ifndef UNIT_TEST
 #include "esp_log.h"
+#include "crashlog.h"
 #endif
-#include <vector>
+#include <atomic>
 #include <cstdarg>
+#ifdef UNIT_TEST
+#include <chrono>
+#endif
+
+typedef struct {
+    uint32_t timestamp;
+    uint8_t type;
+    char text[];
+} log_item_t;
+
+typedef enum {
+    DrainStopped = 0,
+    DrainStarting,
+    DrainRunning
+} eDrainState;
+
+static std::atomic<int> drain_state(DrainStopped);
+static std::atomic<uint32_t> dropped_count(0);
+static std::atomic<uint32_t> suppressed_count(0);
+
+#if LOG_RATE_LIMIT_ENABLE
+typedef struct {
+    uintptr_t key;              // format string address ^ line
+    uint32_t last_ms;
+    uint32_t tokens;            // 1/1000 message
+    uint32_t suppressed;
+    uint8_t type;               // eLogType of the call site, for the summary
+    const char *filename;
+    unsigned long fileline;
+} log_rate_entry_t;
+
+#define LOG_RATE_PROBE_COUNT    4
+static_assert((LOG_RATE_TABLE_SIZE & (LOG_RATE_TABLE_SIZE - 1)) == 0, "LOG_RATE_TABLE_SIZE should be power of 2");
 
-CLogger* CLogger::_instance;
+static log_rate_entry_t rate_table[LOG_RATE_TABLE_SIZE];
+static portMUX_TYPE rate_lock = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<bool> suppressed_pending(false);     // a summary is owed by FlushSuppressed()
+#endif
+
+#ifndef UNIT_TEST
 static const char *TAG = "logger";
+#endif
+static RingbufHandle_t ring_handle = nullptr;
+static StaticRingbuffer_t ring_struct;
+static uint8_t ring_storage[LOG_RING_BUFFER_SIZE];
+static StaticTask_t drain_task_struct;
+static StackType_t drain_task_stack[LOG_DRAIN_TASK_STACK_DEPTH];
+static TaskHandle_t drain_task_handle = nullptr;
+
+#if !LOGGER_BINARY_ENABLE || defined(UNIT_TEST)
+static size_t clamp_length(int written, size_t remain)
+{
+    if (written < 0)
+        return 0;
+    return (size_t)written < remain ? (size_t)written : (remain ? remain - 1 : 0);
+}
+#endif
+
+static uint32_t now_ms()
+{
+#ifndef UNIT_TEST
+    return esp_log_timestamp();
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
 
-CLogger::CLogger()
+uint32_t CLogger::GetDroppedCount()
 {
-    m_eLogType = eLogType::Info;
-    m_funcname = "";
-    m_filename = "";
-    m_fileline = 0;
-    m_valid_funcinfo = false;
+    return dropped_count.load(std::memory_order_relaxed);
 }
 
-CLogger::~CLogger()
+uint32_t CLogger::GetSuppressedCount()
 {
-    
+    return suppressed_count.load(std::memory_order_relaxed);
 }
 
-CLogger* CLogger::Instance(eLogType logtype, const char* funcname, const char* filename, const unsigned long fileline)
+bool CLogger::Start()
 {
-    if (!_instance) {
-        _instance = new CLogger();
+    int expected = DrainStopped;
+    if (!drain_state.compare_exchange_strong(expected, DrainStarting))
+        return expected == DrainRunning;
+
+    // static storage only: the logger must not allocate
+    ring_handle = xRingbufferCreateStatic(sizeof(ring_storage), RINGBUF_TYPE_NOSPLIT, ring_storage, &ring_struct);
+    if (!ring_handle) {
+        drain_state = DrainStopped;
+        return false;
     }
+    drain_task_handle = xTaskCreateStatic(task_drain_function, "TASK_LOG", LOG_DRAIN_TASK_STACK_DEPTH, nullptr, LOG_DRAIN_TASK_PRIORITY, drain_task_stack, &drain_task_struct);
+    if (!drain_task_handle) {
+        drain_state = DrainStopped;
+        return false;
+    }
+    drain_state = DrainRunning;
+    return true;
+}
+
+void CLogger::Release()
+{
+    int expected = DrainRunning;
+    if (drain_state.compare_exchange_strong(expected, DrainStarting)) {
+        vTaskDelete(drain_task_handle);
+        drain_task_handle = nullptr;
+        // storage is static, Start() recreates the ring buffer in place
+        vRingbufferDelete(ring_handle);
+        ring_handle = nullptr;
+        drain_state = DrainStopped;
+    }
+}
 
-    _instance->m_eLogType = logtype;
+#if LOGGER_BINARY_ENABLE
+static void put_bytes(uint8_t *out, size_t cap, size_t *pos, const void *data, size_t len)
+{
+    if (*pos + len > cap) {
+        *pos = cap;
+        return;
+    }
+    memcpy(&out[*pos], data, len);
+    *pos += len;
+}
+
+static void put_u32(uint8_t *out, size_t cap, size_t *pos, uint32_t value)
+{
+    put_bytes(out, cap, pos, &value, sizeof(value));
+}
+
+/**
+ * @brief 바이너리 레코드 생성 (포맷 문자열 주소, 호출 위치, 포맷 문자열의 변환 지정자 순서대로 raw argument)
+ * @note 텍스트 포맷팅 없이 변환 지정자의 타입/길이만 확인한다 (%s는 LOG_BINARY_MAX_STRING까지 복사)
+ */
+static size_t encode_binary(uint8_t *out, size_t cap, const char *fmt, const char *funcname, const char *filename, unsigned long fileline, va_list args)
+{
+    size_t pos = 0;
+
+    put_u32(out, cap, &pos, (uint32_t)(uintptr_t)fmt);
     if (funcname) {
-        _instance->m_valid_funcinfo = true;
-        _instance->m_funcname.assign(funcname, strlen(funcname));
-        _instance->m_fileline = fileline;
-
-        std::string temp;
-        temp.assign(filename, strlen(filename));
-        size_t pos = temp.rfind("/");
-        if (pos != std::string::npos) {
-            _instance->m_filename.assign(temp.substr(pos + 1, temp.length()));
-        } else {
-            _instance->m_filename.assign("?");
+        uint16_t line = (uint16_t)fileline;
+        put_u32(out, cap, &pos, (uint32_t)(uintptr_t)funcname);
+        put_u32(out, cap, &pos, (uint32_t)(uintptr_t)filename);
+        put_bytes(out, cap, &pos, &line, sizeof(line));
+    }
+
+    for (const char *p = fmt; *p && pos < cap; p++) {
+        if (*p != '%')
+            continue;
+        p++;
+        if (*p == '%')
+            continue;
+        while (*p && strchr("-+ #0", *p))
+            p++;
+        // width and precision given as '*' are int arguments
+        while (*p && (strchr("0123456789.", *p) || *p == '*')) {
+            if (*p == '*')
+                put_u32(out, cap, &pos, (uint32_t)va_arg(args, int));
+            p++;
+        }
+        int length = 0;     // 0: int, 1: long, 2: long long/intmax_t, 3: size_t, 4: long double
+        while (*p && strchr("hljztL", *p)) {
+            if (*p == 'l')
+                length++;
+            else if (*p == 'j')
+                length = 2;
+            else if (*p == 'z' || *p == 't')
+                length = 3;
+            else if (*p == 'L')
+                length = 4;
+            p++;
+        }
+        if (!*p)
+            break;
+
+        switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            if (length == 2) {
+                long long value = va_arg(args, long long);
+                put_bytes(out, cap, &pos, &value, sizeof(value));
+            } else if (length == 1) {
+                put_u32(out, cap, &pos, (uint32_t)va_arg(args, long));
+            } else if (length == 3) {
+                put_u32(out, cap, &pos, (uint32_t)va_arg(args, size_t));
+            } else {
+                put_u32(out, cap, &pos, (uint32_t)va_arg(args, int));
+            }
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            double value = (length == 4) ? (double)va_arg(args, long double) : va_arg(args, double);
+            put_bytes(out, cap, &pos, &value, sizeof(value));
+            break;
+        }
+        case 's': {
+            const char *str = va_arg(args, const char *);
+            if (!str)
+                str = "(null)";
+            size_t len = strnlen(str, LOG_BINARY_MAX_STRING);
+            put_bytes(out, cap, &pos, str, len);
+            put_bytes(out, cap, &pos, "", 1);
+            break;
+        }
+        case 'p': case 'n':
+            put_u32(out, cap, &pos, (uint32_t)(uintptr_t)va_arg(args, void *));
+            break;
+        default:
+            break;
+        }
+    }
+
+    return pos;
+}
+#endif
+
+/**
+ * @return false if the message should be suppressed
+ * @note suppressed: number of messages suppressed at this call site since the last one passed
+ */
+bool CLogger::RateLimit(const char* msg, uint32_t* suppressed) const
+{
+    *suppressed = 0;
+#if LOG_RATE_LIMIT_ENABLE
+    if (m_eLogType == eLogType::Info || m_eLogType == eLogType::Debug)
+        return true;
+
+    const uintptr_t key = (uintptr_t)msg ^ (uintptr_t)m_fileline;
+    const uint32_t now = now_ms();
+    uint32_t index = (uint32_t)((key >> 2) * 2654435761u) & (LOG_RATE_TABLE_SIZE - 1);
+    bool pass = true;
+
+    portENTER_CRITICAL_SAFE(&rate_lock);
+    log_rate_entry_t *entry = nullptr;
+    log_rate_entry_t *oldest = &rate_table[index];
+    for (uint32_t i = 0; i < LOG_RATE_PROBE_COUNT; i++) {
+        log_rate_entry_t *probe = &rate_table[(index + i) & (LOG_RATE_TABLE_SIZE - 1)];
+        if (probe->key == key) {
+            entry = probe;
+            break;
+        }
+        if (!probe->key || (int32_t)(probe->last_ms - oldest->last_ms) < 0) {
+            oldest = probe;
+        }
+    }
+    if (!entry) {
+        // evict the least recently used call site in the probe window
+        entry = oldest;
+        entry->key = key;
+        entry->tokens = LOG_RATE_BURST * 1000;
+        entry->suppressed = 0;
+        entry->type = (uint8_t)m_eLogType;
+        entry->filename = m_filename;
+        entry->fileline = m_fileline;
+    } else {
+        uint32_t elapsed = now - entry->last_ms;
+        if (elapsed > LOG_RATE_BURST * LOG_RATE_REFILL_MS) {
+            elapsed = LOG_RATE_BURST * LOG_RATE_REFILL_MS;
+        }
+        entry->tokens += elapsed * 1000 / LOG_RATE_REFILL_MS;
+        if (entry->tokens > LOG_RATE_BURST * 1000) {
+            entry->tokens = LOG_RATE_BURST * 1000;
         }
+    }
+    entry->last_ms = now;
+
+    if (entry->tokens >= 1000) {
+        entry->tokens -= 1000;
+        *suppressed = entry->suppressed;
+        entry->suppressed = 0;
     } else {
-        _instance->m_valid_funcinfo = false;
+        entry->suppressed++;
+        pass = false;
     }
+    portEXIT_CRITICAL_SAFE(&rate_lock);
 
-    return _instance;
+    if (!pass) {
+        suppressed_count.fetch_add(1, std::memory_order_relaxed);
+        if (!suppressed_pending.exchange(true, std::memory_order_relaxed) && drain_state.load(std::memory_order_acquire) == DrainRunning) {
+            // the drain task may be waiting without timeout, wake it up to schedule the summary
+            log_item_t item = {};
+            item.type = LOG_ITEM_WAKEUP;
+            xRingbufferSend(ring_handle, &item, sizeof(item), 0);
+        }
+    }
+    return pass;
+#else
+    return true;
+#endif
 }
 
-void CLogger::Release()
+/**
+ * @brief summary of call sites that went quiet while suppressed (their next message would carry it, but may never come)
+ * @note called by the drain task, returns true while summaries are still owed
+ */
+bool CLogger::FlushSuppressed()
 {
-    if (_instance) {
-        delete _instance;
-        _instance = nullptr;
+#if LOG_RATE_LIMIT_ENABLE
+    // cleared first, a call site suppressed during the scan sets it again
+    if (!suppressed_pending.exchange(false, std::memory_order_relaxed))
+        return false;
+
+    const uint32_t now = now_ms();
+    bool pending = false;
+    for (uint32_t i = 0; i < LOG_RATE_TABLE_SIZE; i++) {
+        log_rate_entry_t *entry = &rate_table[i];
+        uint32_t suppressed = 0;
+        eLogType type = eLogType::Warning;
+        const char *filename = nullptr;
+        unsigned long fileline = 0;
+
+        portENTER_CRITICAL_SAFE(&rate_lock);
+        if (entry->suppressed) {
+            if ((int32_t)(now - entry->last_ms) >= LOG_RATE_REFILL_MS) {
+                suppressed = entry->suppressed;
+                entry->suppressed = 0;
+                type = (eLogType)entry->type;
+                filename = entry->filename;
+                fileline = entry->fileline;
+            } else {
+                pending = true;
+            }
+        }
+        portEXIT_CRITICAL_SAFE(&rate_lock);
+
+        if (suppressed) {
+            CLogger(type, nullptr, 0, nullptr, 0).Emit("suppressed %u similar messages [%s:%lu]", (unsigned)suppressed,
+                filename ? filename : "?", fileline);
+        }
+    }
+    if (pending) {
+        suppressed_pending.store(true, std::memory_order_relaxed);
     }
+    return suppressed_pending.load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
 }
 
-void CLogger::Log(const char* msg, ...)
+void CLogger::Log(const char* msg, ...) const
 {
+    uint32_t suppressed;
+    if (!RateLimit(msg, &suppressed))
+        return;
+
     va_list vaArgs;
     va_start(vaArgs, msg);
+    Write(msg, vaArgs);
+    va_end(vaArgs);
 
-    va_list vaArgsCopy;
-    va_copy(vaArgsCopy, vaArgs);
-    const int len = vsnprintf(nullptr, 0, msg, vaArgsCopy);
-    va_end(vaArgsCopy);
+    if (suppressed) {
+        Emit("suppressed %u similar messages", (unsigned)suppressed);
+    }
+}
 
-    std::vector<char> zc(len + 1);
-    vsnprintf(zc.data(), zc.size(), msg, vaArgs);
+void CLogger::Emit(const char* msg, ...) const
+{
+    va_list vaArgs;
+    va_start(vaArgs, msg);
+    Write(msg, vaArgs);
     va_end(vaArgs);
-
-    Process(std::string(zc.data(), len));
 }
 
-void CLogger::Process(std::string msg)
+void CLogger::Write(const char* msg, va_list args) const
 {
-    std::string fullmsg;
-    std::string funcname;
-    size_t colons, begin, end;
-    char szlog[256]{0,};
+    union {
+        log_item_t item;
+        char raw[sizeof(log_item_t) + MAXLEN_LOG_MSG];
+    } buffer;
+    char *line = buffer.item.text;
+    size_t len = 0;
 
-    if (m_valid_funcinfo) {
-        colons = m_funcname.find("::");
-        if (colons != std::string::npos) {
-            begin = m_funcname.substr(0, colons).rfind(" ") + 1;
-            end = m_funcname.rfind("(") - begin;
-        } else {
-            begin = m_funcname.substr(0, colons).find(" ") + 1;
-            end = m_funcname.rfind("(") - begin;
+#if LOGGER_BINARY_ENABLE && !defined(UNIT_TEST)
+    len = encode_binary((uint8_t *)line, MAXLEN_LOG_MSG, msg, m_funcname, m_filename, m_fileline, args);
+    buffer.item.type = (uint8_t)m_eLogType | LOG_ITEM_BINARY | (m_funcname ? LOG_ITEM_CALLSITE : 0);
+#else
+    if (m_funcname) {
+        len += clamp_length(snprintf(line, MAXLEN_LOG_MSG, "[%.*s] ", m_funclen, m_funcname), MAXLEN_LOG_MSG);
+    }
+
+    len += clamp_length(vsnprintf(line + len, MAXLEN_LOG_MSG - len, msg, args), MAXLEN_LOG_MSG - len);
+
+    if (m_funcname) {
+        len += clamp_length(snprintf(line + len, MAXLEN_LOG_MSG - len, " [%s:%lu]", m_filename, m_fileline), MAXLEN_LOG_MSG - len);
+    }
+    line[len++] = '\0';
+    buffer.item.type = (uint8_t)m_eLogType;
+#endif
+
+    buffer.item.timestamp = now_ms();
+#ifndef UNIT_TEST
+    CCrashLog::append(buffer.item.type, buffer.item.timestamp, line, len);
+#endif
+    if (drain_state.load(std::memory_order_acquire) == DrainRunning || Start()) {
+        // never wait for space, a full ring drops the message
+        if (xRingbufferSend(ring_handle, &buffer.item, sizeof(log_item_t) + len, 0) != pdTRUE) {
+            dropped_count.fetch_add(1, std::memory_order_relaxed);
         }
+        return;
+    }
+    if (buffer.item.type & LOG_ITEM_BINARY) {
+        ProcessBinary(buffer.item.type, buffer.item.timestamp, (const uint8_t *)line, len);
+    } else {
+        Process(m_eLogType, buffer.item.timestamp, line);
+    }
+}
+
+void CLogger::task_drain_function(void *param)
+{
+    size_t size;
+    uint32_t dropped_reported = 0;
 
-        if (begin != std::string::npos && end != std::string::npos) {
-            funcname = m_funcname.substr(begin, end);
+    while (true) {
+        // wake up once per refill period only while suppressed call sites owe a summary (no periodic wake up otherwise)
+        log_item_t *item = (log_item_t *)xRingbufferReceive(ring_handle, &size, FlushSuppressed() ? pdMS_TO_TICKS(LOG_RATE_REFILL_MS) : portMAX_DELAY);
+        if (!item)
+            continue;
+        if (item->type & LOG_ITEM_WAKEUP) {
+            // no content
+        } else if (item->type & LOG_ITEM_BINARY) {
+            ProcessBinary(item->type, item->timestamp, (const uint8_t *)item->text, size - sizeof(log_item_t));
         } else {
-            funcname = m_funcname;
+            Process((eLogType)(item->type & LOG_ITEM_TYPE_MASK), item->timestamp, item->text);
         }
+        vRingbufferReturnItem(ring_handle, item);
 
-        snprintf(szlog, sizeof(szlog), "[%s] %s [%s:%lu]", funcname.c_str(), msg.c_str(), m_filename.c_str(), m_fileline);
-    } else {
-        snprintf(szlog, sizeof(szlog), "%s", msg.c_str());
+        uint32_t dropped = dropped_count.load(std::memory_order_relaxed);
+        if (dropped != dropped_reported) {
+#ifndef UNIT_TEST
+            ESP_LOGW(TAG, "%u log messages dropped (ring buffer full)", dropped - dropped_reported);
+#else
+            printf("[W] %u log messages dropped (ring buffer full)\n", (unsigned)(dropped - dropped_reported));
+#endif
+            dropped_reported = dropped;
+        }
     }
-    
-    switch (m_eLogType) {
+}
+
+void CLogger::Process(eLogType logtype, uint32_t timestamp, const char* msg)
+{
+    switch (logtype) {
 	case eLogType::Info:
 #ifndef UNIT_TEST
-		ESP_LOGI(TAG, "%s", szlog);
+        esp_log_write(ESP_LOG_INFO, TAG, LOG_FORMAT(I, "%s"), timestamp, TAG, msg);
 #else
-        printf("[I] %s\n", szlog);
+        printf("[I] %s\n", msg);
 #endif
 		break;
 	case eLogType::Warning:
 #ifndef UNIT_TEST
-        ESP_LOGW(TAG, "%s", szlog);
+        esp_log_write(ESP_LOG_WARN, TAG, LOG_FORMAT(W, "%s"), timestamp, TAG, msg);
 #else
-        printf("[W] %s\n", szlog);
+        printf("[W] %s\n", msg);
 #endif
 		break;
 	case eLogType::Error:
 #ifndef UNIT_TEST
-        ESP_LOGE(TAG, "%s", szlog);
+        esp_log_write(ESP_LOG_ERROR, TAG, LOG_FORMAT(E, "%s"), timestamp, TAG, msg);
 #else
-        printf("[E] %s\n", szlog);
+        printf("[E] %s\n", msg);
 #endif
 		break;
 	case eLogType::Debug:
 #ifndef UNIT_TEST
-        ESP_LOGD(TAG, "%s", szlog);
+        esp_log_write(ESP_LOG_DEBUG, TAG, LOG_FORMAT(D, "%s"), timestamp, TAG, msg);
 #else
-        printf("[D] %s\n", szlog);
+        printf("[D] %s\n", msg);
 #endif
 		break;
 	case eLogType::Exception:
 #ifndef UNIT_TEST
-        ESP_LOGE(TAG, "%s", szlog);
+        esp_log_write(ESP_LOG_ERROR, TAG, LOG_FORMAT(E, "%s"), timestamp, TAG, msg);
 #else
-        printf("[E] %s\n", szlog);
+        printf("[E] %s\n", msg);
 #endif
 		break;
     default:
 #ifndef UNIT_TEST
-        ESP_LOGI(TAG, "%s", szlog);
+        esp_log_write(ESP_LOG_INFO, TAG, LOG_FORMAT(I, "%s"), timestamp, TAG, msg);
 #else
-        printf("[I] %s\n", szlog);
+        printf("[I] %s\n", msg);
 #endif
         break;
 	}
 }
+
+/**
+ * @brief 바이너리 레코드를 한 줄의 hex 문자열로 출력 ("#B" + type(1) + timestamp(4) + record)
+ */
+void CLogger::ProcessBinary(uint8_t type, uint32_t timestamp, const uint8_t* data, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    char line[2 + 2 * (1 + sizeof(timestamp) + MAXLEN_LOG_MSG) + 1];
+    size_t pos = 0;
+
+    line[pos++] = '#';
+    line[pos++] = 'B';
+    line[pos++] = hex[type >> 4];
+    line[pos++] = hex[type & 0x0F];
+    for (size_t i = 0; i < sizeof(timestamp); i++) {
+        uint8_t byte = (uint8_t)(timestamp >> (8 * i));
+        line[pos++] = hex[byte >> 4];
+        line[pos++] = hex[byte & 0x0F];
+    }
+    for (size_t i = 0; i < len && i < MAXLEN_LOG_MSG; i++) {
+        line[pos++] = hex[data[i] >> 4];
+        line[pos++] = hex[data[i] & 0x0F];
+    }
+    line[pos] = '\0';
+
+#ifndef UNIT_TEST
+    esp_log_write((esp_log_level_t)log_level((eLogType)(type & LOG_ITEM_TYPE_MASK)), TAG, "%s\n", line);
+#else
+    printf("%s\n", line);
+#endif
+}
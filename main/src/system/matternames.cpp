@@ -0,0 +1,476 @@
+#include "matternames.h"
+#include "definition.h"
+#include <stddef.h>
+
+#if MATTER_NAME_LOOKUP_ENABLE
+typedef struct {
+    uint32_t key;
+    const char *name;
+} matter_name_t;
+
+static constexpr uint32_t name_key(uint32_t cluster_id, uint32_t id)
+{
+    return (cluster_id << 16) | id;
+}
+
+template <size_t N>
+static constexpr bool is_sorted_by_key(const matter_name_t (&table)[N])
+{
+    for (size_t i = 1; i < N; i++) {
+        if (table[i - 1].key >= table[i].key)
+            return false;
+    }
+    return true;
+}
+
+template <size_t N>
+static const char* find_name(const matter_name_t (&table)[N], uint32_t key)
+{
+    size_t lo = 0;
+    size_t hi = N;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (table[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo < N && table[lo].key == key) ? table[lo].name : nullptr;
+}
+
+static constexpr matter_name_t matter_device_names[] = {
+    {0x000A, "Door Lock"},
+    {0x000B, "Door Lock Controller"},
+    {0x000E, "Aggregator"},
+    {0x000F, "Generic Switch"},
+    {0x0011, "Power Source"},
+    {0x0012, "OTA Requestor"},
+    {0x0013, "Bridged Node"},
+    {0x0014, "OTA Provider"},
+    {0x0015, "Contact Sensor"},
+    {0x0016, "Root Node"},
+    {0x0022, "Speaker"},
+    {0x0023, "Casting Video Player"},
+    {0x0024, "Content App"},
+    {0x0027, "Mode Select"},
+    {0x0028, "Basic Video Player"},
+    {0x0029, "Casting Video Client"},
+    {0x002A, "Video Remote Control"},
+    {0x002B, "Fan"},
+    {0x0100, "On/Off Light"},
+    {0x0101, "Dimmable Light"},
+    {0x0103, "On/Off Light Switch"},
+    {0x0104, "Dimmer Switch"},
+    {0x0105, "Color Dimmer Switch"},
+    {0x0106, "Light Sensor"},
+    {0x0107, "Occupancy Sensor"},
+    {0x010A, "On/Off Plug-in Unit"},
+    {0x010B, "Dimmable Plug-In Unit"},
+    {0x010C, "Color Temperature Light"},
+    {0x010D, "Extended Color Light"},
+    {0x0202, "Window Covering"},
+    {0x0203, "Window Covering Controller"},
+    {0x0300, "Heating/Cooling Unit"},
+    {0x0301, "Thermostat"},
+    {0x0302, "Temperature Sensor"},
+    {0x0303, "Pump"},
+    {0x0304, "Pump Controller"},
+    {0x0305, "Pressure Sensor"},
+    {0x0306, "Flow Sensor"},
+    {0x0307, "Humidity Sensor"},
+    {0x0840, "Control Bridge"},
+    {0x0850, "On/Off Sensor"},
+};
+static_assert(is_sorted_by_key(matter_device_names), "matter_device_names should be sorted by key");
+
+static constexpr matter_name_t matter_cluster_names[] = {
+    {0x0003, "Identify"},
+    {0x0004, "Groups"},
+    {0x0005, "Scenes"},
+    {0x0006, "On/Off"},
+    {0x0008, "Level Control"},
+    {0x0009, "Alarms"},
+    {0x000A, "Time"},
+    {0x001D, "Descriptor"},
+    {0x001E, "Binding"},
+    {0x001F, "Access Control"},
+    {0x0020, "Poll Control"},
+    {0x0028, "Basic Information"},
+    {0x0029, "OTA Software Update Provider"},
+    {0x002A, "OTA Software Update Requestor"},
+    {0x002B, "Localization Configuration"},
+    {0x002C, "Time Format Localization"},
+    {0x002D, "Unit Localization"},
+    {0x002E, "Power Source Configuration"},
+    {0x002F, "Power Source"},
+    {0x0030, "General Commisioning"},
+    {0x0031, "Network Commisioning"},
+    {0x0032, "diagnostic Logs"},
+    {0x0033, "General Diagnostics"},
+    {0x0034, "Software Diagnostics"},
+    {0x0035, "Thread Network Diagnostics"},
+    {0x0036, "Wi-Fi Network Diagnostics"},
+    {0x0037, "Ethernet Network Diagnostics"},
+    {0x0038, "Time Synchronization"},
+    {0x0039, "Bridged Device Basic Information"},
+    {0x003B, "Switch"},
+    {0x003C, "Administrator Commisioning"},
+    {0x003E, "Node Operational Credentials"},
+    {0x003F, "Group Key Management"},
+    {0x0040, "Fixed Label"},
+    {0x0041, "User Label"},
+    {0x0045, "Boolean State"},
+    {0x0050, "Mode Select"},
+    {0x0101, "Door Lock"},
+    {0x0102, "Window Covering"},
+    {0x0200, "Pump Configuration and Control"},
+    {0x0201, "Thermostat"},
+    {0x0202, "Fan Control"},
+    {0x0204, "Thermostat User Interface Configuration"},
+    {0x0300, "Color Control"},
+    {0x0400, "Illuminance Measurement"},
+    {0x0402, "Temperature Measurement"},
+    {0x0403, "Pressure Measurement"},
+    {0x0404, "Flow Measurement"},
+    {0x0405, "Relative Humidity Measurement"},
+    {0x0406, "Occupancy Sensing"},
+    {0x0503, "Wake On LAN"},
+    {0x0504, "Channel"},
+    {0x0505, "Target Navigator"},
+    {0x0506, "Media Playback"},
+    {0x0507, "Media Input"},
+    {0x0508, "Low Power"},
+    {0x0509, "Keypad Input"},
+    {0x050A, "Content Launcher"},
+    {0x050B, "Audio Output"},
+    {0x050C, "Application Launcher"},
+    {0x050D, "Application Basic"},
+    {0x050E, "Account Login"},
+};
+static_assert(is_sorted_by_key(matter_cluster_names), "matter_cluster_names should be sorted by key");
+
+/* global attributes (any cluster) */
+static constexpr matter_name_t matter_global_attribute_names[] = {
+    {0x00FE, "FabricIndex"},
+    {0xFFF8, "GeneratedCommandList"},
+    {0xFFF9, "AcceptedCommandList"},
+    {0xFFFA, "EventList"},
+    {0xFFFB, "AttributeList"},
+    {0xFFFC, "FeatureMap"},
+    {0xFFFD, "ClusterRevision"},
+};
+static_assert(is_sorted_by_key(matter_global_attribute_names), "matter_global_attribute_names should be sorted by key");
+
+static constexpr matter_name_t matter_attribute_names[] = {
+    /* Identify */
+    {name_key(0x0003, 0x0000), "IdentifyTime"},
+    {name_key(0x0003, 0x0001), "IdentifyType"},
+    /* Groups */
+    {name_key(0x0004, 0x0000), "NameSupport"},
+    /* Scenes */
+    {name_key(0x0005, 0x0000), "SceneCount"},
+    {name_key(0x0005, 0x0001), "CurrentScene"},
+    {name_key(0x0005, 0x0002), "CurrentGroup"},
+    {name_key(0x0005, 0x0003), "SceneValid"},
+    {name_key(0x0005, 0x0004), "NameSupport"},
+    {name_key(0x0005, 0x0005), "LastConfiguredBy"},
+    /* On/Off */
+    {name_key(0x0006, 0x0000), "OnOff"},
+    {name_key(0x0006, 0x4000), "GlobalSceneControl"},
+    {name_key(0x0006, 0x4001), "OnTime"},
+    {name_key(0x0006, 0x4002), "OffWaitTime"},
+    {name_key(0x0006, 0x4003), "StartUpOnOff"},
+    /* Level Control */
+    {name_key(0x0008, 0x0000), "CurrentLevel"},
+    {name_key(0x0008, 0x0001), "RemainingTime"},
+    {name_key(0x0008, 0x0002), "MinLevel"},
+    {name_key(0x0008, 0x0003), "MaxLevel"},
+    {name_key(0x0008, 0x0004), "CurrentFrequency"},
+    {name_key(0x0008, 0x0005), "MinFrequency"},
+    {name_key(0x0008, 0x0006), "MaxFrequency"},
+    {name_key(0x0008, 0x000F), "Options"},
+    {name_key(0x0008, 0x0010), "OnOffTransitionTime"},
+    {name_key(0x0008, 0x0011), "OnLevel"},
+    {name_key(0x0008, 0x0012), "OnTransitionTime"},
+    {name_key(0x0008, 0x0013), "OffTransitionTime"},
+    {name_key(0x0008, 0x0014), "DefaultMoveRate"},
+    {name_key(0x0008, 0x4000), "StartUpCurrentLevel"},
+    /* Descriptor */
+    {name_key(0x001D, 0x0000), "DeviceTypeList"},
+    {name_key(0x001D, 0x0001), "ServerList"},
+    {name_key(0x001D, 0x0002), "ClientList"},
+    {name_key(0x001D, 0x0003), "PartsList"},
+    /* Access Control */
+    {name_key(0x001F, 0x0000), "ACL"},
+    {name_key(0x001F, 0x0001), "Extension"},
+    {name_key(0x001F, 0x0002), "SubjectsPerAccessControlEntry"},
+    {name_key(0x001F, 0x0003), "TargetsPerAccessControlEntry"},
+    {name_key(0x001F, 0x0004), "AccessControlEntriesPerFabric"},
+    /* Basic Information */
+    {name_key(0x0028, 0x0000), "DataModelRevision"},
+    {name_key(0x0028, 0x0001), "VendorName"},
+    {name_key(0x0028, 0x0002), "VendorID"},
+    {name_key(0x0028, 0x0003), "ProductName"},
+    {name_key(0x0028, 0x0004), "ProductID"},
+    {name_key(0x0028, 0x0005), "NodeLabel"},
+    {name_key(0x0028, 0x0006), "Location"},
+    {name_key(0x0028, 0x0007), "HardwareVersion"},
+    {name_key(0x0028, 0x0008), "HardwareVersionString"},
+    {name_key(0x0028, 0x0009), "SoftwareVersion"},
+    {name_key(0x0028, 0x000A), "SoftwareVersionString"},
+    {name_key(0x0028, 0x000B), "ManufacturingDate"},
+    {name_key(0x0028, 0x000C), "PartNumber"},
+    {name_key(0x0028, 0x000D), "ProductURL"},
+    {name_key(0x0028, 0x000E), "ProductLabel"},
+    {name_key(0x0028, 0x000F), "SerialNumber"},
+    {name_key(0x0028, 0x0010), "LocalConfigDisabled"},
+    {name_key(0x0028, 0x0011), "Reachable"},
+    {name_key(0x0028, 0x0012), "UniqueID"},
+    {name_key(0x0028, 0x0013), "CapabilityMinima"},
+    /* General Commisioning */
+    {name_key(0x0030, 0x0000), "Breadcrumb"},
+    {name_key(0x0030, 0x0001), "BasicCommisioningInfo"},
+    {name_key(0x0030, 0x0002), "RegulatoryConfig"},
+    {name_key(0x0030, 0x0003), "LocationCapability"},
+    {name_key(0x0030, 0x0004), "SupportsConcurrentConnection"},
+    /* Bridged Device Basic Information */
+    {name_key(0x0039, 0x0000), "DataModelRevision"},
+    {name_key(0x0039, 0x0001), "VendorName"},
+    {name_key(0x0039, 0x0002), "VendorID"},
+    {name_key(0x0039, 0x0003), "ProductName"},
+    {name_key(0x0039, 0x0004), "ProductID"},
+    {name_key(0x0039, 0x0005), "NodeLabel"},
+    {name_key(0x0039, 0x0006), "Location"},
+    {name_key(0x0039, 0x0007), "HardwareVersion"},
+    {name_key(0x0039, 0x0008), "HardwareVersionString"},
+    {name_key(0x0039, 0x0009), "SoftwareVersion"},
+    {name_key(0x0039, 0x000A), "SoftwareVersionString"},
+    {name_key(0x0039, 0x000B), "ManufacturingDate"},
+    {name_key(0x0039, 0x000C), "PartNumber"},
+    {name_key(0x0039, 0x000D), "ProductURL"},
+    {name_key(0x0039, 0x000E), "ProductLabel"},
+    {name_key(0x0039, 0x000F), "SerialNumber"},
+    {name_key(0x0039, 0x0010), "LocalConfigDisabled"},
+    {name_key(0x0039, 0x0011), "Reachable"},
+    {name_key(0x0039, 0x0012), "UniqueID"},
+    {name_key(0x0039, 0x0013), "CapabilityMinima"},
+    /* Color Control */
+    {name_key(0x0300, 0x0000), "CurrentHue"},
+    {name_key(0x0300, 0x0001), "CurrentSaturation"},
+    {name_key(0x0300, 0x0002), "RemainingTime"},
+    {name_key(0x0300, 0x0003), "CurrentX"},
+    {name_key(0x0300, 0x0004), "CurrentY"},
+    {name_key(0x0300, 0x0005), "DriftCompensation"},
+    {name_key(0x0300, 0x0006), "CompensationText"},
+    {name_key(0x0300, 0x0007), "ColorTemperatureMireds"},
+    {name_key(0x0300, 0x0008), "ColorMode"},
+    {name_key(0x0300, 0x000F), "Options"},
+    {name_key(0x0300, 0x0010), "NumberOfPrimaries"},
+    {name_key(0x0300, 0x0011), "Primary1X"},
+    {name_key(0x0300, 0x0012), "Primary1Y"},
+    {name_key(0x0300, 0x0013), "Primary1Intensity"},
+    {name_key(0x0300, 0x0015), "Primary2X"},
+    {name_key(0x0300, 0x0016), "Primary2Y"},
+    {name_key(0x0300, 0x0017), "Primary2Intensity"},
+    {name_key(0x0300, 0x0019), "Primary3X"},
+    {name_key(0x0300, 0x001A), "Primary3Y"},
+    {name_key(0x0300, 0x001B), "Primary3Intensity"},
+    {name_key(0x0300, 0x0020), "Primary4X"},
+    {name_key(0x0300, 0x0021), "Primary4Y"},
+    {name_key(0x0300, 0x0022), "Primary4Intensity"},
+    {name_key(0x0300, 0x0024), "Primary5X"},
+    {name_key(0x0300, 0x0025), "Primary5Y"},
+    {name_key(0x0300, 0x0026), "Primary5Intensity"},
+    {name_key(0x0300, 0x0028), "Primary6X"},
+    {name_key(0x0300, 0x0029), "Primary6Y"},
+    {name_key(0x0300, 0x002A), "Primary6Intensity"},
+    {name_key(0x0300, 0x0030), "WhitePointX"},
+    {name_key(0x0300, 0x0031), "WhitePointY"},
+    {name_key(0x0300, 0x0032), "ColorPointRX"},
+    {name_key(0x0300, 0x0033), "ColorPointRY"},
+    {name_key(0x0300, 0x0034), "ColorPointRIntensity"},
+    {name_key(0x0300, 0x0036), "ColorPointGX"},
+    {name_key(0x0300, 0x0037), "ColorPointGY"},
+    {name_key(0x0300, 0x0038), "ColorPointGIntensity"},
+    {name_key(0x0300, 0x003A), "ColorPointBX"},
+    {name_key(0x0300, 0x003B), "ColorPointBY"},
+    {name_key(0x0300, 0x003C), "ColorPointBIntensity"},
+    {name_key(0x0300, 0x4000), "EnhancedCurrentHue"},
+    {name_key(0x0300, 0x4001), "EnhancedColorMode"},
+    {name_key(0x0300, 0x4002), "ColorLoopActive"},
+    {name_key(0x0300, 0x4003), "ColorLoopDirection"},
+    {name_key(0x0300, 0x4004), "ColorLoopTime"},
+    {name_key(0x0300, 0x4005), "ColorLoopStartEnhancedHue"},
+    {name_key(0x0300, 0x4006), "ColorLoopStoredEnhancedHue"},
+    {name_key(0x0300, 0x400A), "ColorCapabilities"},
+    {name_key(0x0300, 0x400B), "ColorTempPhysicalMinMireds"},
+    {name_key(0x0300, 0x400C), "ColorTempPhysicalMaxMireds"},
+    {name_key(0x0300, 0x400D), "CoupleColorTempToLevelMinMireds"},
+    {name_key(0x0300, 0x4010), "StartUpColorTemperatureMireds"},
+    /* 0x301 */
+    {name_key(0x0301, 0x0000), "PhysicalMinLevel"},
+    {name_key(0x0301, 0x0001), "PhysicalMaxLevel"},
+    {name_key(0x0301, 0x0002), "BallastStatus"},
+    {name_key(0x0301, 0x0010), "MinLevel"},
+    {name_key(0x0301, 0x0011), "MaxLevel"},
+    {name_key(0x0301, 0x0012), "PowerOnLevel"},
+    {name_key(0x0301, 0x0013), "PowerOnFadeTime"},
+    {name_key(0x0301, 0x0014), "IntrinsicBallastFactor"},
+    {name_key(0x0301, 0x0015), "BallastFactorAdjustment"},
+    {name_key(0x0301, 0x0020), "LampQuantity"},
+    {name_key(0x0301, 0x0030), "LampType"},
+    {name_key(0x0301, 0x0031), "LampManufacturer"},
+    {name_key(0x0301, 0x0032), "LampRatedHours"},
+    {name_key(0x0301, 0x0033), "LampBurnHours"},
+    {name_key(0x0301, 0x0034), "LampAlarmMode"},
+    {name_key(0x0301, 0x0035), "LampBurnHoursTripPoint"},
+    /* Illuminance Measurement */
+    {name_key(0x0400, 0x0000), "MeasuredValue"},
+    {name_key(0x0400, 0x0001), "MinMeasuredValue"},
+    {name_key(0x0400, 0x0002), "MaxMeasuredValue"},
+    {name_key(0x0400, 0x0003), "Tolerance"},
+    {name_key(0x0400, 0x0004), "LightSensorType"},
+    /* Temperature Measurement */
+    {name_key(0x0402, 0x0000), "MeasuredValue"},
+    {name_key(0x0402, 0x0001), "MinMeasuredValue"},
+    {name_key(0x0402, 0x0002), "MaxMeasuredValue"},
+    {name_key(0x0402, 0x0003), "Tolerance"},
+    /* Pressure Measurement */
+    {name_key(0x0403, 0x0000), "MeasuredValue"},
+    {name_key(0x0403, 0x0001), "MinMeasuredValue"},
+    {name_key(0x0403, 0x0002), "MaxMeasuredValue"},
+    {name_key(0x0403, 0x0003), "Tolerance"},
+    {name_key(0x0403, 0x0010), "ScaledValue"},
+    {name_key(0x0403, 0x0011), "MinScaledValue"},
+    {name_key(0x0403, 0x0012), "MaxScaledValue"},
+    {name_key(0x0403, 0x0013), "ScaledTolerance"},
+    {name_key(0x0403, 0x0014), "Scale"},
+    /* Flow Measurement */
+    {name_key(0x0404, 0x0000), "MeasuredValue"},
+    {name_key(0x0404, 0x0001), "MinMeasuredValue"},
+    {name_key(0x0404, 0x0002), "MaxMeasuredValue"},
+    {name_key(0x0404, 0x0003), "Tolerance"},
+    /* Relative Humidity Measurement */
+    {name_key(0x0405, 0x0000), "MeasuredValue"},
+    {name_key(0x0405, 0x0001), "MinMeasuredValue"},
+    {name_key(0x0405, 0x0002), "MaxMeasuredValue"},
+    {name_key(0x0405, 0x0003), "Tolerance"},
+    /* Occupancy Sensing */
+    {name_key(0x0406, 0x0000), "Occupancy"},
+    {name_key(0x0406, 0x0001), "OccupancySensorType"},
+    {name_key(0x0406, 0x0002), "OccupancySensorTypeBitmap"},
+    {name_key(0x0406, 0x0010), "PIROccupiedToUnoccupiedDelay"},
+    {name_key(0x0406, 0x0011), "PIRUnoccupiedToOccupiedDelay"},
+    {name_key(0x0406, 0x0012), "PIRUnoccupiedToOccupiedThreshold"},
+    {name_key(0x0406, 0x0020), "UltrasonicOccupiedToUnoccupiedDelay"},
+    {name_key(0x0406, 0x0021), "UltrasonicUnoccupiedToOccupiedDelay"},
+    {name_key(0x0406, 0x0022), "UltrasonicUnoccupiedToOccupiedThreshold"},
+    {name_key(0x0406, 0x0030), "PhysicalContactOccupiedToUnoccupiedDelay"},
+    {name_key(0x0406, 0x0031), "PhysicalContactUnoccupiedToOccupiedDelay"},
+    {name_key(0x0406, 0x0032), "PhysicalContactUnoccupiedToOccupiedThreshold"},
+    /* 0x407 */
+    {name_key(0x0407, 0x0000), "MeasuredValue"},
+    {name_key(0x0407, 0x0001), "MinMeasuredValue"},
+    {name_key(0x0407, 0x0002), "MaxMeasuredValue"},
+    {name_key(0x0407, 0x0003), "Tolerance"},
+    /* 0x408 */
+    {name_key(0x0408, 0x0000), "MeasuredValue"},
+    {name_key(0x0408, 0x0001), "MinMeasuredValue"},
+    {name_key(0x0408, 0x0002), "MaxMeasuredValue"},
+    {name_key(0x0408, 0x0003), "Tolerance"},
+};
+static_assert(is_sorted_by_key(matter_attribute_names), "matter_attribute_names should be sorted by key");
+
+static constexpr matter_name_t matter_command_names[] = {
+    /* Identify */
+    {name_key(0x0003, 0x00), "Itentify"},
+    {name_key(0x0003, 0x01), "IdentifyQuery"},
+    {name_key(0x0003, 0x40), "TriggerEffect"},
+    /* On/Off */
+    {name_key(0x0006, 0x00), "Off"},
+    {name_key(0x0006, 0x01), "On"},
+    {name_key(0x0006, 0x02), "Toggle"},
+    {name_key(0x0006, 0x40), "OffWithEffect"},
+    {name_key(0x0006, 0x41), "OnWithRecallGlobalScene"},
+    {name_key(0x0006, 0x42), "OnWithTimedOff"},
+    /* Level Control */
+    {name_key(0x0008, 0x00), "MoveToLevel"},
+    {name_key(0x0008, 0x01), "Move"},
+    {name_key(0x0008, 0x02), "Step"},
+    {name_key(0x0008, 0x03), "Stop"},
+    {name_key(0x0008, 0x04), "MoveToLevelWithOnOff"},
+    {name_key(0x0008, 0x05), "MoveWithOnOff"},
+    {name_key(0x0008, 0x06), "StepWithOnOff"},
+    {name_key(0x0008, 0x07), "StopWithOnOff"},
+    {name_key(0x0008, 0x08), "MoveToClosestFrequency"},
+    /* Color Control */
+    {name_key(0x0300, 0x00), "MoveToHue"},
+    {name_key(0x0300, 0x01), "MoveHue"},
+    {name_key(0x0300, 0x02), "StepHue"},
+    {name_key(0x0300, 0x03), "MoveToSaturation"},
+    {name_key(0x0300, 0x04), "MoveSaturation"},
+    {name_key(0x0300, 0x05), "StepSaturation"},
+    {name_key(0x0300, 0x06), "MoveToHueAndSaturation"},
+    {name_key(0x0300, 0x07), "MoveToColor"},
+    {name_key(0x0300, 0x08), "MoveColor"},
+    {name_key(0x0300, 0x09), "StepColor"},
+    {name_key(0x0300, 0x0A), "MoveToColorTemperature"},
+    {name_key(0x0300, 0x40), "EnhancedMoveToHue"},
+    {name_key(0x0300, 0x41), "EnhancedMoveHue"},
+    {name_key(0x0300, 0x42), "EnhancedStepHue"},
+    {name_key(0x0300, 0x43), "EnhancedMoveToHueAndSaturation"},
+    {name_key(0x0300, 0x44), "ColorLoopSet"},
+    {name_key(0x0300, 0x47), "StopMoveStep"},
+    {name_key(0x0300, 0x4B), "MoveColorTemperature"},
+    {name_key(0x0300, 0x4C), "StepColorTemperature"},
+};
+static_assert(is_sorted_by_key(matter_command_names), "matter_command_names should be sorted by key");
+#endif
+
+const char* get_matter_device_name(uint16_t device_id)
+{
+#if MATTER_NAME_LOOKUP_ENABLE
+    const char *name = find_name(matter_device_names, device_id);
+    if (name)
+        return name;
+#endif
+    return "?";
+}
+
+const char* get_matter_cluster_name(uint32_t cluster_id)
+{
+#if MATTER_NAME_LOOKUP_ENABLE
+    const char *name = find_name(matter_cluster_names, cluster_id);
+    if (name)
+        return name;
+#endif
+    return "?";
+}
+
+const char* get_matter_attribute_name(uint32_t cluster_id, uint32_t attribute_id)
+{
+#if MATTER_NAME_LOOKUP_ENABLE
+    if (cluster_id > 0xFFFF || attribute_id > 0xFFFF)
+        return "?";
+    const char *name = find_name(matter_global_attribute_names, attribute_id);
+    if (!name) {
+        name = find_name(matter_attribute_names, name_key(cluster_id, attribute_id));
+    }
+    if (name)
+        return name;
+#endif
+    return "?";
+}
+
+const char* get_matter_command_name(uint32_t cluster_id, uint32_t command_id)
+{
+#if MATTER_NAME_LOOKUP_ENABLE
+    if (cluster_id > 0xFFFF || command_id > 0xFFFF)
+        return "?";
+    const char *name = find_name(matter_command_names, name_key(cluster_id, command_id));
+    if (name)
+        return name;
+#endif
+    return "?";
+}
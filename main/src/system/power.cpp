@@ -0,0 +1,258 @@
+#include "power.h"
+#include "logger.h"
+#include "definition.h"
+#include "scd41.h"
+#include "filter.h"
+#include "sampler.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <esp_rom_crc.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;               // crc32 of the fields below
+    uint32_t sequence;          // samples retained since the block was created
+    filter_snapshot_t filter;
+    sampler_snapshot_t sampler;
+} power_retained_t;
+
+// survives deep sleep and software resets (RTC slow memory, not initialized at boot)
+RTC_NOINIT_ATTR static power_retained_t rtc_retained;
+
+CPowerManager* CPowerManager::_instance = nullptr;
+
+static uint32_t retained_crc(const power_retained_t *retained)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&retained->sequence, sizeof(power_retained_t) - offsetof(power_retained_t, sequence));
+}
+
+CPowerManager::CPowerManager()
+{
+    m_mode = PowerModeAlwaysOn;
+    m_pm_lock = nullptr;
+    m_retained_valid = false;
+    m_sensor_sleep_since_us = 0;
+    reset_stats();
+}
+
+CPowerManager::~CPowerManager()
+{
+}
+
+CPowerManager* CPowerManager::Instance()
+{
+    if (!_instance) {
+        _instance = new CPowerManager();
+    }
+
+    return _instance;
+}
+
+bool CPowerManager::initialize()
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    m_retained_valid = rtc_retained.magic == POWER_RETAIN_MAGIC && rtc_retained.crc == retained_crc(&rtc_retained) &&
+        (reason == ESP_RST_DEEPSLEEP || reason == ESP_RST_SW);
+    if (!m_retained_valid) {
+        rtc_retained.magic = 0;
+    }
+
+    // held while active in battery mode, automatic light sleep is entered otherwise
+    esp_err_t ret = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "measure", &m_pm_lock);
+    if (ret != ESP_OK) {
+        GetLogger(eLogType::Warning)->Log("Power management is not available (ret: %d), battery mode keeps the cpu awake", ret);
+        m_pm_lock = nullptr;
+    }
+
+    GetLogger(eLogType::Info)->Log("Initialized (retained state: %s)", m_retained_valid ? "valid" : "none");
+    return true;
+}
+
+bool CPowerManager::set_mode(ePowerMode mode)
+{
+    int freq_max = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = freq_max,
+        .min_freq_mhz = mode == PowerModeBattery ? POWER_CPU_FREQ_MIN_MHZ : freq_max,
+        .light_sleep_enable = mode == PowerModeBattery,
+    };
+    esp_err_t ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK && mode == PowerModeBattery) {
+        GetLogger(eLogType::Warning)->Log("Failed to enable automatic light sleep (ret: %d)", ret);
+    }
+
+    if (mode != PowerModeBattery) {
+        // retained block is only valid while it is refreshed after every sample
+        rtc_retained.magic = 0;
+    }
+    if (m_mode != mode) {
+        GetLogger(eLogType::Info)->Log("Power mode changed (%d -> %d)", m_mode.load(), mode);
+    }
+    m_mode = mode;
+
+    return ret == ESP_OK;
+}
+
+/**
+ * @brief keep the cpu awake for a while, reports and subscription traffic of the last sample are served meanwhile
+ */
+void CPowerManager::stay_active(uint32_t duration_ms)
+{
+    if (m_mode != PowerModeBattery) {
+        return;
+    }
+    if (m_pm_lock) {
+        esp_pm_lock_acquire(m_pm_lock);
+    }
+    vTaskDelay(pdMS_TO_TICKS(duration_ms));
+    if (m_pm_lock) {
+        esp_pm_lock_release(m_pm_lock);
+    }
+}
+
+/**
+ * @brief sleeping pays off when the idle current saved over a period exceeds the charge of the discarded first shot after wake up
+ */
+bool CPowerManager::should_sleep_sensor(uint32_t period_ms)
+{
+    if (m_mode != PowerModeBattery || period_ms <= 2 * ENERGY_SENSOR_SHOT_MS) {
+        return false;
+    }
+    uint64_t saved = (uint64_t)(ENERGY_SENSOR_IDLE_UA - ENERGY_SENSOR_SLEEP_UA) * (period_ms - 2 * ENERGY_SENSOR_SHOT_MS);
+    uint64_t cost = (uint64_t)(ENERGY_SENSOR_MEASURING_UA + ENERGY_SENSOR_IDLE_UA) * ENERGY_SENSOR_SHOT_MS;
+
+    return saved > cost;
+}
+
+bool CPowerManager::sensor_sleep(int64_t now_us)
+{
+    if (GetScd41Ctrl()->get_power_state() != Scd4xPowerIdle || !GetScd41Ctrl()->sleep_module()) {
+        return false;
+    }
+    m_sensor_sleep_since_us = now_us;
+    m_sensor_sleeps++;
+
+    return true;
+}
+
+bool CPowerManager::sensor_wake(int64_t now_us)
+{
+    int64_t since_us = m_sensor_sleep_since_us.exchange(0);
+    if (since_us > 0 && now_us > since_us) {
+        m_sensor_sleep_us += now_us - since_us;
+    }
+
+    return GetScd41Ctrl()->wakeup_module();
+}
+
+/**
+ * @brief copy the pipeline state to RTC memory after a published sample (battery mode)
+ * @note measurement history is already persisted in the history partition, only the filter and sampler states are kept here
+ */
+void CPowerManager::retain()
+{
+    if (m_mode != PowerModeBattery) {
+        return;
+    }
+    uint32_t sequence = rtc_retained.magic == POWER_RETAIN_MAGIC ? rtc_retained.sequence + 1 : 1;
+    rtc_retained.magic = 0;
+    rtc_retained.sequence = sequence;
+    GetMeasurementFilter()->save(&rtc_retained.filter);
+    GetAdaptiveSampler()->save(&rtc_retained.sampler);
+    rtc_retained.crc = retained_crc(&rtc_retained);
+    rtc_retained.magic = POWER_RETAIN_MAGIC;
+    m_retains++;
+}
+
+/**
+ * @brief continue the filter and sampler of the previous session, once at boot after they are configured
+ */
+bool CPowerManager::restore()
+{
+    if (!m_retained_valid) {
+        return false;
+    }
+    m_retained_valid = false;
+    if (!GetMeasurementFilter()->restore(&rtc_retained.filter)) {
+        GetLogger(eLogType::Info)->Log("Retained filter state ignored (configuration changed)");
+    }
+    GetAdaptiveSampler()->restore(&rtc_retained.sampler);
+    m_restores++;
+    GetLogger(eLogType::Info)->Log("Pipeline state restored (sequence: %" PRIu32 ")", rtc_retained.sequence);
+
+    return true;
+}
+
+void CPowerManager::print_status(uint32_t capacity_mah)
+{
+    static const char *mode_names[] = {"always-on", "battery"};
+    CEnergyMonitor *energy = GetEnergyMonitor();
+    int64_t now_us = esp_timer_get_time();
+    int64_t elapsed_ms = (now_us - energy->get_since_us()) / 1000;
+    int64_t sensor_sleep_since_us = m_sensor_sleep_since_us;
+    if (GetScd41Ctrl()->get_power_state() != Scd4xPowerSleep) {
+        sensor_sleep_since_us = 0;      // woken up by supervisor recovery
+    }
+    int64_t awake_ms = energy->get_active_us(EnergyCpuAwake, now_us) / 1000;
+    int64_t sensor_sleep_ms = (m_sensor_sleep_us + (sensor_sleep_since_us > 0 ? now_us - sensor_sleep_since_us : 0)) / 1000;
+    uint32_t shots = m_shots;
+    uint32_t samples = m_samples;
+
+    if (elapsed_ms <= 0) {
+        return;
+    }
+    // the window is the one of the energy monitor, "energy reset" alone does not clear the sensor sleep time
+    sensor_sleep_ms = MIN(sensor_sleep_ms, elapsed_ms);
+    // charges in mA.s, sleep floor + active states of the energy monitor
+    double esp_charge = (double)elapsed_ms * ENERGY_ESP_SLEEP_UA / 1e6 + energy->get_charge_mas(EnergyI2CBusy, now_us) +
+        energy->get_charge_mas(EnergyWifiTx, now_us);
+    if (m_mode != PowerModeBattery) {
+        // light sleep disabled, the cpu is never idle
+        awake_ms = elapsed_ms;
+        esp_charge += (double)elapsed_ms * energy->get_current(EnergyCpuAwake) / 1e6;
+    } else {
+        esp_charge += energy->get_charge_mas(EnergyCpuAwake, now_us);
+    }
+    double sensor_charge = ((double)(elapsed_ms - sensor_sleep_ms) * ENERGY_SENSOR_IDLE_UA + (double)sensor_sleep_ms * ENERGY_SENSOR_SLEEP_UA) / 1e6 +
+        energy->get_charge_mas(EnergySensorMeasuring, now_us) + energy->get_charge_mas(EnergySensorLowPower, now_us);
+    double average_ma = (esp_charge + sensor_charge) / ((double)elapsed_ms / 1000.0);
+
+    printf("mode: %s, light sleep: %s, icd idle: sampling period, active window: %d ms\n", mode_names[m_mode],
+        m_pm_lock ? "available" : "unavailable", POWER_ACTIVE_WINDOW_MS);
+    printf("elapsed: %" PRId64 " s, awake: %" PRId64 " s (%.1f%%), sensor sleep: %" PRId64 " s (%" PRIu32 " times)\n",
+        elapsed_ms / 1000, awake_ms / 1000, awake_ms * 100.0 / elapsed_ms, sensor_sleep_ms / 1000, m_sensor_sleeps.load());
+    printf("shots: %" PRIu32 ", samples: %" PRIu32 ", retained: %" PRIu32 ", restored: %" PRIu32 "\n",
+        shots, samples, m_retains.load(), m_restores.load());
+    printf("charge: esp %.1f mA.s, sensor %.1f mA.s, average %.3f mA\n", esp_charge, sensor_charge, average_ma);
+    if (samples > 0) {
+        printf("per sample: %.2f mA.s (awake %.0f ms)\n", (esp_charge + sensor_charge) / samples, (double)awake_ms / samples);
+    }
+    if (capacity_mah > 0 && average_ma > 0.0) {
+        printf("battery life (%" PRIu32 " mAh): %.1f days\n", capacity_mah, capacity_mah / average_ma / 24.0);
+    }
+}
+
+/**
+ * @brief the energy monitor is reset too, the report covers its window
+ */
+void CPowerManager::reset_stats()
+{
+    int64_t now_us = esp_timer_get_time();
+    GetEnergyMonitor()->reset_stats();
+    // running intervals restart now
+    if (m_sensor_sleep_since_us != 0) {
+        m_sensor_sleep_since_us = now_us;
+    }
+    m_sensor_sleep_us = 0;
+    m_shots = 0;
+    m_samples = 0;
+    m_sensor_sleeps = 0;
+    m_retains = 0;
+    m_restores = 0;
+}
@@ -0,0 +1,268 @@
+#include "rolling.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+typedef struct {
+    const char *name;
+    int64_t length_us;
+} rolling_window_param_t;
+
+static const rolling_window_param_t window_params[RollingWindowMax] = {
+    {"5min", 5LL * 60 * 1000000},
+    {"1h",   60LL * 60 * 1000000},
+    {"24h",  24LL * 60 * 60 * 1000000},
+};
+static const char *channel_names[FilterChannelMax] = {"co2", "temperature", "humidity"};
+static const double channel_scales[FilterChannelMax] = {1.0, 100.0, 100.0};     // published units to ppm, degC, %RH
+
+CRollingStats* CRollingStats::_instance = nullptr;
+
+CRollingStats::CRollingStats()
+{
+    m_mutex = xSemaphoreCreateMutex();
+    reset();
+}
+
+CRollingStats::~CRollingStats()
+{
+    if (m_mutex) {
+        vSemaphoreDelete(m_mutex);
+    }
+}
+
+CRollingStats* CRollingStats::Instance()
+{
+    if (!_instance) {
+        _instance = new CRollingStats();
+    }
+
+    return _instance;
+}
+
+int64_t CRollingStats::bucket_us(eRollingWindow window)
+{
+    return window_params[window].length_us / ROLLING_BUCKETS;
+}
+
+void CRollingStats::clear_bucket(rolling_bucket_t *bucket)
+{
+    bucket->count = 0;
+    bucket->min = INT32_MAX;
+    bucket->max = INT32_MIN;
+    bucket->mean = 0.f;
+    bucket->m2 = 0.f;
+}
+
+/**
+ * @brief moves the head to the bucket of now_us, returns true when buckets were dropped
+ */
+bool CRollingStats::rotate(eRollingWindow window, int64_t now_us)
+{
+    rolling_window_t *w = &m_windows[window];
+    int64_t span_us = bucket_us(window);
+
+    if (w->used == 0) {
+        w->bucket_start_us = now_us;
+        w->used = 1;
+        return false;
+    }
+    if (now_us < w->bucket_start_us + span_us) {
+        return false;
+    }
+    int64_t steps = (now_us - w->bucket_start_us) / span_us;
+    if (steps > ROLLING_BUCKETS) {
+        steps = ROLLING_BUCKETS;    // idle for longer than the window, everything is dropped
+    }
+    for (int64_t i = 0; i < steps; i++) {
+        w->head = (w->head + 1) % ROLLING_BUCKETS;
+        for (int c = 0; c < FilterChannelMax; c++) {
+            clear_bucket(&w->buckets[w->head][c]);
+        }
+    }
+    w->bucket_start_us += ((now_us - w->bucket_start_us) / span_us) * span_us;
+    w->used = (uint8_t)(w->used + steps > ROLLING_BUCKETS ? ROLLING_BUCKETS : w->used + steps);
+
+    return true;
+}
+
+void CRollingStats::rebuild_range(eRollingWindow window)
+{
+    rolling_window_t *w = &m_windows[window];
+
+    for (int c = 0; c < FilterChannelMax; c++) {
+        w->min[c] = INT32_MAX;
+        w->max[c] = INT32_MIN;
+        for (int i = 0; i < ROLLING_BUCKETS; i++) {
+            if (w->buckets[i][c].count > 0) {
+                w->min[c] = w->buckets[i][c].min < w->min[c] ? w->buckets[i][c].min : w->min[c];
+                w->max[c] = w->buckets[i][c].max > w->max[c] ? w->buckets[i][c].max : w->max[c];
+            }
+        }
+    }
+}
+
+/**
+ * @brief values: one per eFilterChannel, returns a bit per window (1 << eRollingWindow) whose min/max range changed
+ */
+uint32_t CRollingStats::add(const int32_t *values, int64_t now_us)
+{
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    uint32_t changed = m_queried_rotations;
+    m_queried_rotations = 0;
+    for (int i = 0; i < RollingWindowMax; i++) {
+        rolling_window_t *w = &m_windows[i];
+        int32_t prev_min[FilterChannelMax];
+        int32_t prev_max[FilterChannelMax];
+        memcpy(prev_min, w->min, sizeof(prev_min));
+        memcpy(prev_max, w->max, sizeof(prev_max));
+
+        if (rotate((eRollingWindow)i, now_us)) {
+            rebuild_range((eRollingWindow)i);
+        }
+        for (int c = 0; c < FilterChannelMax; c++) {
+            rolling_bucket_t *bucket = &w->buckets[w->head][c];
+            int32_t value = values[c];
+            // Welford
+            bucket->count++;
+            float delta = (float)value - bucket->mean;
+            bucket->mean += delta / (float)bucket->count;
+            bucket->m2 += delta * ((float)value - bucket->mean);
+            bucket->min = value < bucket->min ? value : bucket->min;
+            bucket->max = value > bucket->max ? value : bucket->max;
+            w->min[c] = value < w->min[c] ? value : w->min[c];
+            w->max[c] = value > w->max[c] ? value : w->max[c];
+        }
+        if (memcmp(prev_min, w->min, sizeof(prev_min)) != 0 || memcmp(prev_max, w->max, sizeof(prev_max)) != 0) {
+            changed |= 1 << i;
+        }
+    }
+    xSemaphoreGive(m_mutex);
+
+    return changed;
+}
+
+/**
+ * @brief merges the buckets of a window (parallel variance), false if the window has no sample
+ */
+bool CRollingStats::get(eRollingWindow window, eFilterChannel channel, rolling_result_t *result)
+{
+    uint32_t count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+
+    if (window >= RollingWindowMax || channel >= FilterChannelMax) {
+        return false;
+    }
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    rolling_window_t *w = &m_windows[window];
+    int64_t now_us = esp_timer_get_time();
+    // drop expired buckets when no sample came in meanwhile (sensor fault)
+    if (w->used > 0 && rotate(window, now_us)) {
+        rebuild_range(window);
+        m_queried_rotations |= 1 << window;     // reported by the next add()
+    }
+    for (int i = 0; i < ROLLING_BUCKETS; i++) {
+        const rolling_bucket_t *bucket = &w->buckets[i][channel];
+        if (bucket->count == 0) {
+            continue;
+        }
+        uint32_t total = count + bucket->count;
+        double delta = (double)bucket->mean - mean;
+        mean += delta * bucket->count / total;
+        m2 += (double)bucket->m2 + delta * delta * count * bucket->count / total;
+        count = total;
+    }
+    result->count = count;
+    result->min = w->min[channel];
+    result->max = w->max[channel];
+    result->mean = mean;
+    result->stddev = count > 1 ? sqrt(m2 / (count - 1)) : 0.0;
+    result->span_us = w->used > 0 ? (w->used - 1) * bucket_us(window) + (now_us - w->bucket_start_us) : 0;
+    xSemaphoreGive(m_mutex);
+
+    return count > 0;
+}
+
+bool CRollingStats::get_range(eRollingWindow window, eFilterChannel channel, int32_t *min, int32_t *max)
+{
+    if (window >= RollingWindowMax || channel >= FilterChannelMax) {
+        return false;
+    }
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    *min = m_windows[window].min[channel];
+    *max = m_windows[window].max[channel];
+    xSemaphoreGive(m_mutex);
+
+    return *min <= *max;
+}
+
+void CRollingStats::reset()
+{
+    xSemaphoreTake(m_mutex, portMAX_DELAY);
+    for (int i = 0; i < RollingWindowMax; i++) {
+        rolling_window_t *w = &m_windows[i];
+        for (int b = 0; b < ROLLING_BUCKETS; b++) {
+            for (int c = 0; c < FilterChannelMax; c++) {
+                clear_bucket(&w->buckets[b][c]);
+            }
+        }
+        w->head = 0;
+        w->used = 0;
+        w->bucket_start_us = 0;
+        rebuild_range((eRollingWindow)i);
+    }
+    m_queried_rotations = 0;
+    xSemaphoreGive(m_mutex);
+}
+
+const char* CRollingStats::get_window_name(eRollingWindow window)
+{
+    return window < RollingWindowMax ? window_params[window].name : "?";
+}
+
+void CRollingStats::print_status()
+{
+    rolling_result_t result;
+
+    printf("%-6s %-12s %8s %10s %10s %10s %10s %8s\n", "window", "channel", "count", "min", "max", "mean", "stddev", "span (s)");
+    for (int i = 0; i < RollingWindowMax; i++) {
+        for (int c = 0; c < FilterChannelMax; c++) {
+            if (!get((eRollingWindow)i, (eFilterChannel)c, &result)) {
+                printf("%-6s %-12s %8d %10s %10s %10s %10s %8s\n", window_params[i].name, channel_names[c], 0, "-", "-", "-", "-", "-");
+                continue;
+            }
+            printf("%-6s %-12s %8" PRIu32 " %10.2f %10.2f %10.2f %10.3f %8" PRId64 "\n", window_params[i].name, channel_names[c], result.count,
+                result.min / channel_scales[c], result.max / channel_scales[c], result.mean / channel_scales[c], result.stddev / channel_scales[c],
+                result.span_us / 1000000);
+        }
+    }
+}
+
+void CRollingStats::write_report_json(CJsonWriter *writer)
+{
+    rolling_result_t result;
+
+    writer->begin_object();
+    for (int i = 0; i < RollingWindowMax; i++) {
+        writer->begin_object(window_params[i].name);
+        for (int c = 0; c < FilterChannelMax; c++) {
+            writer->begin_object(channel_names[c]);
+            if (get((eRollingWindow)i, (eFilterChannel)c, &result)) {
+                writer->add_uint("count", result.count);
+                writer->add_double("min", result.min / channel_scales[c]);
+                writer->add_double("max", result.max / channel_scales[c]);
+                writer->add_double("mean", result.mean / channel_scales[c]);
+                writer->add_double("stddev", result.stddev / channel_scales[c]);
+                writer->add_int("span_us", result.span_us);
+            } else {
+                writer->add_uint("count", 0);
+            }
+            writer->end_object();
+        }
+        writer->end_object();
+    }
+    writer->end_object();
+}
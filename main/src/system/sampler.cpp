@@ -0,0 +1,167 @@
+#include "sampler.h"
+#include "logger.h"
+#include "definition.h"
+#include <stdio.h>
+#include <math.h>
+#include <inttypes.h>
+
+CAdaptiveSampler* CAdaptiveSampler::_instance = nullptr;
+
+CAdaptiveSampler::CAdaptiveSampler()
+{
+    m_enabled = true;
+    m_period_min_ms = SAMPLER_PERIOD_MIN_MS;
+    m_period_max_ms = SAMPLER_PERIOD_MAX_MS;
+    m_period_ms = SAMPLER_PERIOD_MIN_MS;
+    reset();
+    reset_stats();
+}
+
+CAdaptiveSampler::~CAdaptiveSampler()
+{
+}
+
+CAdaptiveSampler* CAdaptiveSampler::Instance()
+{
+    if (!_instance) {
+        _instance = new CAdaptiveSampler();
+    }
+
+    return _instance;
+}
+
+void CAdaptiveSampler::set_enabled(bool enabled)
+{
+    if (m_enabled != enabled) {
+        GetLogger(eLogType::Info)->Log("Adaptive sampling %s", enabled ? "enabled" : "disabled");
+    }
+    m_enabled = enabled;
+}
+
+bool CAdaptiveSampler::set_period_range(uint32_t min_ms, uint32_t max_ms)
+{
+    if (min_ms < SAMPLER_PERIOD_MIN_MS || max_ms > SAMPLER_PERIOD_LIMIT_MS || min_ms > max_ms) {
+        GetLogger(eLogType::Error)->Log("Invalid sampling period range (%" PRIu32 " ~ %" PRIu32 " ms)", min_ms, max_ms);
+        return false;
+    }
+    m_period_min_ms = min_ms;
+    m_period_max_ms = max_ms;
+    // takes effect from the next shot
+    m_period_ms = min_ms;
+    GetLogger(eLogType::Info)->Log("Sampling period range set as %" PRIu32 " ~ %" PRIu32 " ms", min_ms, max_ms);
+    return true;
+}
+
+/**
+ * @brief 새 측정값으로 다음 single shot 까지의 주기를 계산
+ * @note target period keeps the change between two samples within SAMPLER_*_STEP for the current rate of change
+ */
+uint32_t CAdaptiveSampler::update(uint16_t co2ppm, float humidity, int64_t now_us)
+{
+    uint32_t period_min = m_period_min_ms;
+    uint32_t period_max = m_period_max_ms;
+    uint32_t period = m_period_ms;
+
+    if (m_has_prev && now_us > m_prev_tick_us) {
+        float dt = (float)(now_us - m_prev_tick_us) / 1e6f;
+        float co2_delta = fabsf((float)co2ppm - (float)m_prev_co2ppm) - SAMPLER_CO2_NOISE_PPM;
+        float humidity_delta = fabsf(humidity - m_prev_humidity) - SAMPLER_HUMIDITY_NOISE;
+        m_co2_rate = filter_rate(co2_delta > 0.f ? co2_delta / dt : 0.f, m_co2_rate);
+        m_humidity_rate = filter_rate(humidity_delta > 0.f ? humidity_delta / dt : 0.f, m_humidity_rate);
+
+        float target = (float)period_max;
+        if (m_co2_rate > 0.f) {
+            target = fminf(target, SAMPLER_CO2_STEP_PPM / m_co2_rate * 1000.f);
+        }
+        if (m_humidity_rate > 0.f) {
+            target = fminf(target, SAMPLER_HUMIDITY_STEP / m_humidity_rate * 1000.f);
+        }
+        // fast attack, slow release
+        if (target < (float)period) {
+            m_speedups++;
+        } else {
+            target = fminf(target, (float)period * SAMPLER_BACKOFF_RATIO);
+        }
+        period = (uint32_t)fmaxf(target, (float)period_min);
+    }
+    if (period < period_min) {
+        period = period_min;
+    } else if (period > period_max) {
+        period = period_max;
+    }
+
+    m_has_prev = true;
+    m_prev_co2ppm = co2ppm;
+    m_prev_humidity = humidity;
+    m_prev_tick_us = now_us;
+    m_period_ms = period;
+
+    m_updates++;
+    if (period == period_min) {
+        m_updates_at_min++;
+    } else if (period == period_max) {
+        m_updates_at_max++;
+    }
+
+    return period;
+}
+
+/**
+ * @brief forget the previous sample (measurement mode change, sensor recovery), restarts at the min period
+ */
+void CAdaptiveSampler::reset()
+{
+    m_has_prev = false;
+    m_prev_co2ppm = 0;
+    m_prev_humidity = 0.f;
+    m_prev_tick_us = 0;
+    m_co2_rate = 0.f;
+    m_humidity_rate = 0.f;
+    m_period_ms = m_period_min_ms.load();
+}
+
+void CAdaptiveSampler::save(sampler_snapshot_t *snapshot)
+{
+    snapshot->period_ms = m_period_ms;
+    snapshot->co2_rate = m_co2_rate;
+    snapshot->humidity_rate = m_humidity_rate;
+}
+
+/**
+ * @brief continue from a retained state, rates are kept and the next sample starts a new delta (timer restarts after deep sleep)
+ */
+void CAdaptiveSampler::restore(const sampler_snapshot_t *snapshot)
+{
+    reset();
+    if (!isfinite(snapshot->co2_rate) || !isfinite(snapshot->humidity_rate) || snapshot->co2_rate < 0.f || snapshot->humidity_rate < 0.f) {
+        return;
+    }
+    m_co2_rate = snapshot->co2_rate;
+    m_humidity_rate = snapshot->humidity_rate;
+    m_period_ms = MIN(MAX(snapshot->period_ms, m_period_min_ms.load()), m_period_max_ms.load());
+}
+
+float CAdaptiveSampler::filter_rate(float rate, float current)
+{
+    if (rate >= current) {
+        return rate;
+    }
+    return current + SAMPLER_RATE_DECAY * (rate - current);
+}
+
+void CAdaptiveSampler::print_status()
+{
+    printf("adaptive sampling: %s, period: %" PRIu32 " ms (range: %" PRIu32 " ~ %" PRIu32 " ms)\n", m_enabled ? "on" : "off",
+        m_period_ms.load(), m_period_min_ms.load(), m_period_max_ms.load());
+    printf("rate of change: co2 %.2f ppm/min, humidity %.3f %%RH/min\n", m_co2_rate * 60.f, m_humidity_rate * 60.f);
+    printf("updates: %" PRIu32 " (at min: %" PRIu32 ", at max: %" PRIu32 ", speedups: %" PRIu32 ")\n",
+        m_updates.load(), m_updates_at_min.load(), m_updates_at_max.load(), m_speedups.load());
+}
+
+void CAdaptiveSampler::reset_stats()
+{
+    m_updates = 0;
+    m_updates_at_min = 0;
+    m_updates_at_max = 0;
+    m_speedups = 0;
+}
@@ -0,0 +1,272 @@
+#include "supervisor.h"
+#include "scd41.h"
+#include "logger.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+typedef enum {
+    ActionEnd = 0,
+    ActionStopPeriodic,
+    ActionReinit,
+    ActionWakeup,
+    ActionStartSelfTest,
+    ActionReadSelfTest,
+    ActionFactoryReset
+} eRecoveryAction;
+
+#define RECOVERY_ACTION_MAX     4
+
+static const char *step_names[RecoveryStepMax] = {"reinit", "wakeup", "self-test", "factory-reset"};
+static const char *health_names[] = {"ok", "recovering", "verifying", "failed"};
+// sensor commands of each escalation step, the sensor accepts these only in idle state
+static const uint8_t step_actions[RecoveryStepMax][RECOVERY_ACTION_MAX] = {
+    {ActionStopPeriodic, ActionReinit, ActionEnd},
+    {ActionWakeup, ActionStopPeriodic, ActionEnd},
+    {ActionStopPeriodic, ActionStartSelfTest, ActionReadSelfTest, ActionEnd},
+    {ActionStopPeriodic, ActionFactoryReset, ActionReinit, ActionEnd}
+};
+
+static uint32_t action_wait_ms(int action)
+{
+    switch (action) {
+    case ActionStopPeriodic: return SCD4X_STOP_PERIODIC_TIME_MS;
+    case ActionReinit: return SCD4X_REINIT_TIME_MS;
+    case ActionWakeup: return SCD4X_WAKE_UP_TIME_MS;
+    case ActionStartSelfTest: return SCD4X_SELF_TEST_TIME_MS;
+    case ActionFactoryReset: return SCD4X_FACTORY_RESET_TIME_MS;
+    default: return 0;
+    }
+}
+
+CHealthSupervisor* CHealthSupervisor::_instance = nullptr;
+
+CHealthSupervisor::CHealthSupervisor()
+{
+    m_health = SensorHealthOk;
+    m_fault_changed = false;
+    m_factory_reset_done = false;
+    m_stale_limit_ms = 0;
+    m_consecutive_failures = 0;
+    m_last_success_us = 0;
+    m_fault_start_us = 0;
+    m_deadline_us = 0;
+    m_step = 0;
+    m_action = 0;
+    m_self_test_failed = false;
+    set_expected_interval_ms(10000);
+    reset_stats();
+}
+
+CHealthSupervisor::~CHealthSupervisor()
+{
+}
+
+CHealthSupervisor* CHealthSupervisor::Instance()
+{
+    if (!_instance) {
+        _instance = new CHealthSupervisor();
+    }
+
+    return _instance;
+}
+
+void CHealthSupervisor::set_expected_interval_ms(uint32_t interval_ms)
+{
+    m_stale_limit_ms = interval_ms * HEALTH_STALE_INTERVALS + HEALTH_STALE_MARGIN_MS;
+}
+
+void CHealthSupervisor::report_success(int64_t now_us)
+{
+    m_last_success_us = now_us;
+    m_consecutive_failures = 0;
+    if (m_health == SensorHealthOk)
+        return;
+
+    int64_t elapsed_us = now_us - m_fault_start_us;
+    m_hist_recovery.record(elapsed_us);
+    if (m_health == SensorHealthVerifying) {
+        m_step_recoveries[m_step]++;
+    }
+    GetLogger(eLogType::Info)->Log("Sensor recovered after %" PRId64 " ms (step: %s)", elapsed_us / 1000, 
+        m_health == SensorHealthVerifying ? step_names[m_step] : "none");
+    m_health = SensorHealthOk;
+    m_fault_changed = true;
+}
+
+void CHealthSupervisor::report_failure(int64_t now_us)
+{
+    m_consecutive_failures++;
+}
+
+eSupervisorAction CHealthSupervisor::process(int64_t now_us)
+{
+    if (m_last_success_us == 0) {
+        m_last_success_us = now_us;
+    }
+
+    switch (m_health.load()) {
+    case SensorHealthOk:
+        if (m_consecutive_failures >= HEALTH_FAILURE_THRESHOLD) {
+            start_recovery(now_us, "consecutive failures");
+            return SupervisorBusy;
+        }
+        if (now_us - m_last_success_us > (int64_t)m_stale_limit_ms * 1000) {
+            start_recovery(now_us, "stale data");
+            return SupervisorBusy;
+        }
+        return SupervisorIdle;
+    case SensorHealthRecovering: {
+        if (now_us < m_deadline_us)
+            return SupervisorBusy;
+        int action = step_actions[m_step][m_action];
+        if (action == ActionEnd) {
+            m_health = SensorHealthVerifying;
+            m_consecutive_failures = 0;
+            m_deadline_us = now_us + (int64_t)m_stale_limit_ms * 1000;
+            return SupervisorResume;
+        }
+        uint32_t wait_ms = 0;
+        if (!run_action(action, &wait_ms)) {
+            next_step(now_us);
+            return SupervisorBusy;
+        }
+        m_action++;
+        m_deadline_us = now_us + (int64_t)wait_ms * 1000;
+        return SupervisorBusy;
+    }
+    case SensorHealthVerifying:
+        if (now_us >= m_deadline_us || m_consecutive_failures >= HEALTH_FAILURE_THRESHOLD) {
+            next_step(now_us);
+            return SupervisorBusy;
+        }
+        return SupervisorIdle;
+    case SensorHealthFailed:
+        if (now_us >= m_deadline_us) {
+            start_recovery(now_us, "retry");
+            return SupervisorBusy;
+        }
+        return SupervisorIdle;
+    }
+
+    return SupervisorIdle;
+}
+
+bool CHealthSupervisor::take_fault_changed()
+{
+    return m_fault_changed.exchange(false);
+}
+
+/**
+ * @brief true once after a factory reset step, owners of the sensor settings drop what they know about the EEPROM
+ */
+bool CHealthSupervisor::take_factory_reset_done()
+{
+    return m_factory_reset_done.exchange(false);
+}
+
+/**
+ * @brief upper bound of the time from the fault detection to the end of the last escalation step
+ */
+uint32_t CHealthSupervisor::get_worst_case_recovery_ms()
+{
+    uint32_t total = 0;
+    for (int step = 0; step < RecoveryStepMax; step++) {
+        for (int i = 0; i < RECOVERY_ACTION_MAX && step_actions[step][i] != ActionEnd; i++) {
+            total += action_wait_ms(step_actions[step][i]);
+        }
+        total += m_stale_limit_ms;
+    }
+    return total;
+}
+
+void CHealthSupervisor::start_recovery(int64_t now_us, const char *reason)
+{
+    if (m_health == SensorHealthOk) {
+        m_fault_start_us = now_us;
+        m_faults++;
+        m_fault_changed = true;
+    }
+    GetLogger(eLogType::Warning)->Log("Sensor recovery started (reason: %s, failures: %" PRIu32 ", data age: %" PRId64 " ms, bound: %" PRIu32 " ms)",
+        reason, m_consecutive_failures, (now_us - m_last_success_us) / 1000, get_worst_case_recovery_ms());
+    m_health = SensorHealthRecovering;
+    m_self_test_failed = false;
+    m_step = 0;
+    m_action = 0;
+    m_deadline_us = now_us;
+    m_step_runs[m_step]++;
+}
+
+void CHealthSupervisor::next_step(int64_t now_us)
+{
+    GetLogger(eLogType::Warning)->Log("Recovery step %s did not recover the sensor", step_names[m_step]);
+    m_step++;
+    if (m_step >= RecoveryStepMax) {
+        m_health = SensorHealthFailed;
+        m_failed_escalations++;
+        m_deadline_us = now_us + (int64_t)HEALTH_RETRY_MS * 1000;
+        GetLogger(eLogType::Error)->Log("Sensor recovery failed, retry after %d ms", HEALTH_RETRY_MS);
+        return;
+    }
+    m_health = SensorHealthRecovering;
+    m_action = 0;
+    m_deadline_us = now_us;
+    m_step_runs[m_step]++;
+}
+
+bool CHealthSupervisor::run_action(int action, uint32_t *wait_ms)
+{
+    CScd41Ctrl *sensor = GetScd41Ctrl();
+    bool passed = false;
+
+    *wait_ms = action_wait_ms(action);
+    switch (action) {
+    case ActionStopPeriodic:
+        return sensor->stop_periodic_measure(false);
+    case ActionReinit:
+        return sensor->reinit_module(false);
+    case ActionWakeup:
+        // wake up command is not acknowledged by the sensor
+        sensor->wakeup_module(false);
+        return true;
+    case ActionStartSelfTest:
+        return sensor->start_self_test();
+    case ActionReadSelfTest:
+        if (!sensor->read_self_test_result(&passed))
+            return false;
+        m_self_test_failed = !passed;
+        // a malfunction is not fixed by waiting for a sample, go to factory reset directly
+        return passed;
+    case ActionFactoryReset:
+        if (!sensor->perform_factory_reset(false))
+            return false;
+        m_factory_reset_done = true;
+        return true;
+    default:
+        return false;
+    }
+}
+
+void CHealthSupervisor::reset_stats()
+{
+    m_faults = 0;
+    m_failed_escalations = 0;
+    for (int i = 0; i < RecoveryStepMax; i++) {
+        m_step_runs[i] = 0;
+        m_step_recoveries[i] = 0;
+    }
+    m_hist_recovery.reset();
+}
+
+void CHealthSupervisor::print_status()
+{
+    eSensorHealth health = m_health.load();
+    printf("health: %s, faults: %" PRIu32 ", failed escalations: %" PRIu32 ", worst case recovery: %" PRIu32 " ms\n",
+        health_names[health], m_faults.load(), m_failed_escalations.load(), get_worst_case_recovery_ms());
+    if (health == SensorHealthRecovering || health == SensorHealthVerifying) {
+        printf("current step: %s%s\n", step_names[m_step], m_self_test_failed ? " (self test failed)" : "");
+    }
+    for (int i = 0; i < RecoveryStepMax; i++) {
+        printf("  %-14s runs=%" PRIu32 ", recovered=%" PRIu32 "\n", step_names[i], m_step_runs[i].load(), m_step_recoveries[i].load());
+    }
+    m_hist_recovery.print("recovery time");
+}
@@ -7,16 +7,36 @@
 #include <esp_app_desc.h>
 #include <app/server/Server.h>
 #include <esp_matter_providers.h>
-#include "cJSON.h"
 #include "util.h"
 #include "logger.h"
 #include "definition.h"
 #include "scd41.h"
+#include "i2cdetector.h"
+#include "history.h"
+#include "console.h"
+#include "crashlog.h"
+#include "supervisor.h"
+#include "compensation.h"
+#include "calibration.h"
+#include "sampler.h"
+#include "config.h"
+#include "filter.h"
+#include "power.h"
+#include "energy.h"
+#include "derived.h"
+#include "alarm.h"
+#include "rolling.h"
 #include "airqualitysensor.h"
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
 
-#define TASK_TIMER_STACK_DEPTH  3072
+#define TASK_TIMER_STACK_DEPTH  6144    // Log() formatting (floats), flash history, NVS, filter, rolling and alarm work
+#define TASK_TIMER_STACK_MARGIN 768     // warned once when the free stack ever gets below this (bytes)
 #define TASK_TIMER_PRIORITY     5
-#define MEASURE_PERIOD_US       10000000
+#define REQUEST_QUEUE_LENGTH    8
+#define PERIODIC_INTERVAL_MS    5000
+#define LOW_POWER_INTERVAL_MS   30000
 
 CSystem* CSystem::_instance = nullptr;
 bool CSystem::m_default_btn_pressed_long = false;
@@ -30,12 +50,25 @@ typedef struct matter_node {
 CSystem::CSystem() 
 {
     m_i2c_master = nullptr;
+    m_co2_sensor_available = false;
     m_root_node = nullptr;
     m_handle_default_btn = nullptr;
     m_device_list.clear();
     m_keepalive = true;
     m_initialized = false;
+    m_measure_period_ms = MEASURE_PERIOD_MS;
+    m_measure_mode = MeasureModeSingleShot;
+    m_self_test_state = SelfTestIdle;
+    m_self_test_prev_mode = MeasureModeSingleShot;
+    m_self_test_deadline_us = 0;
+    memset(&m_config, 0, sizeof(system_config_t));
+    for (int i = 0; i < FilterChannelMax; i++) {
+        m_published[i] = INT32_MIN;
+    }
+    m_request_queue = xQueueCreate(REQUEST_QUEUE_LENGTH, sizeof(system_request_t));
+    reset_measurement_stats();
 
+    m_task_timer_handle = nullptr;
     xTaskCreate(task_timer_function, "TASK_TIMER", TASK_TIMER_STACK_DEPTH, this, TASK_TIMER_PRIORITY, &m_task_timer_handle);
 }
 
@@ -58,6 +91,8 @@ CSystem* CSystem::Instance()
 
 bool CSystem::initialize()
 {
+    // first, so that the previous session logs are saved before they are overwritten
+    GetCrashLog()->initialize();
     GetLogger(eLogType::Info)->Log("Start Initializing System");
  
     esp_err_t ret = nvs_flash_init();
@@ -70,14 +105,50 @@ bool CSystem::initialize()
         return false;
     }
 
+    // runtime configuration, measurement mode is applied by the measurement task once initialized
+    GetConfig()->initialize();
+    GetConfig()->get(&m_config);
+    m_measure_period_ms = m_config.measure_period_ms;
+    GetAdaptiveSampler()->set_period_range(m_config.adaptive_min_ms, m_config.adaptive_max_ms);
+    GetAdaptiveSampler()->set_enabled(m_config.adaptive_sampling != 0);
+    GetMeasurementFilter()->configure((eFilterMode)m_config.filter_mode, m_config.filter_window, m_config.filter_alpha, m_config.filter_gate);
+    GetAlarmEngine()->configure(m_config.alarm_co2_ppm, m_config.alarm_hyst_ppm, m_config.alarm_hold_s);
+    m_config.measure_mode = MeasureModeSingleShot;
+    GetPowerManager()->initialize();
+    GetPowerManager()->restore();
+    GetPowerManager()->set_mode((ePowerMode)m_config.power_mode);
+
+    if (!GetHistory()->initialize()) {
+        GetLogger(eLogType::Warning)->Log("Failed to initialize measurement history");
+    }
+
     if (!init_default_button()) {
         GetLogger(eLogType::Warning)->Log("Failed to init default on-board button");
     }
 
     m_i2c_master = GetI2CMaster();
-    m_i2c_master->initialize(I2C_PORT_NUM, GPIO_PIN_I2C_SCL, GPIO_PIN_I2C_SDA, I2C_MASTER_FREQ);
+    m_i2c_master->initialize(I2C_PORT_NUM, m_config.i2c_gpio_scl, m_config.i2c_gpio_sda, m_config.i2c_freq);
 
-    GetScd41Ctrl()->initialize(m_i2c_master);
+    // instantiate drivers of detected parts only
+    GetI2CDetector()->detect(m_i2c_master);
+    for (int i = 0; i < GetI2CDetector()->get_device_count(); i++) {
+        const i2c_detected_device_t *device = GetI2CDetector()->get_device(i);
+        if (device->part == I2CPartSCD4x) {
+            m_co2_sensor_available = GetScd41Ctrl()->initialize(m_i2c_master);
+            if (m_co2_sensor_available && !GetCompensation()->initialize()) {
+                GetLogger(eLogType::Warning)->Log("Failed to initialize compensation settings");
+            }
+            if (m_co2_sensor_available) {
+                GetCalibration()->initialize();
+                GetCalibration()->set_result_callback(callback_calibration_result, this);
+            }
+        } else if (device->part != I2CPartUnknown) {
+            GetLogger(eLogType::Warning)->Log("No driver for %s (0x%02X), ignored", CI2CDetector::get_part_name(device), device->address);
+        }
+    }
+    if (!m_co2_sensor_available) {
+        GetLogger(eLogType::Error)->Log("CO2 sensor is not detected");
+    }
     
     // create matter root node
     esp_matter::node::config_t node_config;
@@ -88,6 +159,9 @@ bool CSystem::initialize()
         return false;
     }
     GetLogger(eLogType::Info)->Log("Root node (endpoint 0) added");
+    if (!matter_create_config_cluster()) {
+        GetLogger(eLogType::Warning)->Log("Failed to create configuration cluster");
+    }
 
     // start matter
     ret = esp_matter::start(matter_event_callback);
@@ -100,16 +174,27 @@ bool CSystem::initialize()
     GetLogger(eLogType::Info)->Log("Matter started");
 
     // add airquality sensor endpoint
-    CAirQualitySensor *sensor = new CAirQualitySensor();
-    if (sensor && sensor->matter_init_endpoint()) {
-        m_device_list.push_back(sensor);
-        sensor->set_carbon_dioxide_concentration_measurement_min_measured_value(400.f);
-        sensor->set_carbon_dioxide_concentration_measurement_max_measured_value(5000.f);
-        sensor->set_carbon_dioxide_concentration_measurement_measurement_unit(eMeasurementUnit::PPM);
-    } else {
-        return false;
+    if (m_co2_sensor_available) {
+        CAirQualitySensor *sensor = new CAirQualitySensor();
+        if (sensor && sensor->matter_init_endpoint()) {
+            m_device_list.push_back(sensor);
+            sensor->set_carbon_dioxide_concentration_measurement_min_measured_value((float)m_config.co2_min_ppm);
+            sensor->set_carbon_dioxide_concentration_measurement_max_measured_value((float)m_config.co2_max_ppm);
+            sensor->set_carbon_dioxide_concentration_measurement_measurement_unit(eMeasurementUnit::PPM);
+        } else {
+            return false;
+        }
     }
 
+#if CONFIG_ENABLE_CHIP_SHELL
+    if (!GetConsole()->initialize()) {
+        GetLogger(eLogType::Warning)->Log("Failed to initialize console");
+    }
+#endif
+
+    GetConfig()->set_changed_callback(callback_config_changed, this);
+    post_request(RequestApplyConfig);
+
     m_initialized = true;
     GetLogger(eLogType::Info)->Log("Initialized");
     // print_system_info();
@@ -307,11 +392,9 @@ void CSystem::print_matter_endpoints_info()
     esp_matter::endpoint_t *endpoint = esp_matter::endpoint::get_first(m_root_node);
     while (endpoint != nullptr) {
         endpoint_id = esp_matter::endpoint::get_id(endpoint);
-        cJSON *json = dump_matter_endpoint_info(endpoint_id);
-        char *string = cJSON_PrintUnformatted(json);
-        printf(string);
-        cJSON_Delete(json);
-        free(string);
+        CJsonWriter writer(CJsonWriter::sink_stdout, nullptr);
+        dump_matter_endpoint_info(endpoint_id, &writer);
+        writer.flush();
         printf("\n");
         endpoint = esp_matter::endpoint::get_next(endpoint);
     }
@@ -405,6 +488,9 @@ esp_err_t CSystem::matter_identification_callback(esp_matter::identification::ca
 
 esp_err_t CSystem::matter_attribute_update_callback(esp_matter::attribute::callback_type_t type, uint16_t endpoint_id, uint32_t cluster_id, uint32_t attribute_id, esp_matter_attr_val_t *val, void *priv_data)
 {
+    if (endpoint_id == 0 && cluster_id == CONFIG_CLUSTER_ID) {
+        return matter_on_change_config_attribute(type, attribute_id, val);
+    }
     CDevice *device = GetSystem()->find_device_by_endpoint_id(endpoint_id);
     if (device){
         device->matter_on_change_attribute_value(type, cluster_id, attribute_id, val);
@@ -413,53 +499,680 @@ esp_err_t CSystem::matter_attribute_update_callback(esp_matter::attribute::callb
     return ESP_OK;
 }
 
-void CSystem::task_timer_function(void *param)
+bool CSystem::post_request(eSystemRequestType type, int32_t arg/*=0*/)
+{
+    system_request_t request = {type, arg};
+
+    // never wait here: callers (console, matter) must not be blocked by the measurement task
+    if (!m_request_queue || xQueueSend(m_request_queue, &request, 0) != pdTRUE) {
+        m_stats.requests_dropped++;
+        return false;
+    }
+
+    return true;
+}
+
+bool CSystem::process_requests()
+{
+    system_request_t request;
+    bool pipeline_reset = false;
+
+    while (xQueueReceive(m_request_queue, &request, 0) == pdTRUE) {
+        switch (request.type) {
+        case RequestApplyConfig:
+            pipeline_reset |= apply_config();
+            break;
+        case RequestForcedRecalibration:
+            // runs over several minutes in the calibration scheduler (periodic warmup, stop, recalibrate, restore)
+            if (GetCalibration()->start_frc((uint16_t)request.arg, m_measure_mode, esp_timer_get_time())) {
+                publish_calibration_status();
+            }
+            break;
+        case RequestSelfTest:
+            // runs over several loop iterations (stop, 10 s self test, restore) in step_self_test()
+            pipeline_reset |= start_self_test(esp_timer_get_time());
+            break;
+        case RequestI2CScan:
+            print_i2c_scan();
+            break;
+        default:
+            break;
+        }
+    }
+
+    return pipeline_reset;
+}
+
+void CSystem::print_i2c_scan()
+{
+    uint8_t found[I2C_DETECT_MAX_DEVICES];
+
+    // scan switches the bus clock, the next transaction selects the device clock again
+    int count = m_i2c_master->scan(found, I2C_DETECT_MAX_DEVICES);
+    for (int i = 0; i < count; i++) {
+        printf("0x%02X%s", found[i], i == count - 1 ? "\n" : " ");
+    }
+    printf("%d device(s)\n", count);
+}
+
+/**
+ * @brief applies the fields changed since the last call, runs in the measurement task (bus owner)
+ * @note called only while no single shot is in flight, the sensor accepts idle mode commands
+ */
+bool CSystem::apply_config()
+{
+    system_config_t config;
+    bool pipeline_reset = false;
+
+    GetConfig()->get(&config);
+    if (config.measure_period_ms != m_config.measure_period_ms) {
+        m_measure_period_ms = MAX(config.measure_period_ms, (uint32_t)MEASURE_PERIOD_MIN_MS);
+        GetLogger(eLogType::Info)->Log("Measure period set as %" PRIu32 " ms", m_measure_period_ms);
+    }
+    if (config.adaptive_min_ms != m_config.adaptive_min_ms || config.adaptive_max_ms != m_config.adaptive_max_ms) {
+        GetAdaptiveSampler()->set_period_range(config.adaptive_min_ms, config.adaptive_max_ms);
+    }
+    GetAdaptiveSampler()->set_enabled(config.adaptive_sampling != 0);
+    if (config.i2c_gpio_scl != m_config.i2c_gpio_scl || config.i2c_gpio_sda != m_config.i2c_gpio_sda || config.i2c_freq != m_config.i2c_freq) {
+        // sensor state is kept, measuring restarts from the next period
+        m_i2c_master->release();
+        if (!m_i2c_master->initialize(I2C_PORT_NUM, config.i2c_gpio_scl, config.i2c_gpio_sda, config.i2c_freq)) {
+            GetLogger(eLogType::Error)->Log("Failed to reinitialize I2C bus with new configuration");
+        }
+        pipeline_reset = true;
+    }
+    if (config.filter_mode != m_config.filter_mode || config.filter_window != m_config.filter_window ||
+        config.filter_alpha != m_config.filter_alpha || config.filter_gate != m_config.filter_gate) {
+        GetMeasurementFilter()->configure((eFilterMode)config.filter_mode, config.filter_window, config.filter_alpha, config.filter_gate);
+    }
+    if (config.co2_min_ppm != m_config.co2_min_ppm || config.co2_max_ppm != m_config.co2_max_ppm || config.range_window != m_config.range_window) {
+        if (config.range_window != m_config.range_window) {
+            GetLogger(eLogType::Info)->Log("Measured value ranges follow %s", config.range_window > 0 ?
+                CRollingStats::get_window_name((eRollingWindow)(config.range_window - 1)) : "the configuration");
+        }
+        publish_measured_value_ranges(&config);
+    }
+    if (config.alarm_co2_ppm != m_config.alarm_co2_ppm || config.alarm_hyst_ppm != m_config.alarm_hyst_ppm ||
+        config.alarm_hold_s != m_config.alarm_hold_s) {
+        if (GetAlarmEngine()->configure(config.alarm_co2_ppm, config.alarm_hyst_ppm, config.alarm_hold_s)) {
+            publish_alarm_state();
+        }
+    }
+    if (config.power_mode != m_config.power_mode) {
+        GetPowerManager()->set_mode((ePowerMode)config.power_mode);
+        if (config.power_mode != PowerModeBattery && GetScd41Ctrl()->get_power_state() == Scd4xPowerSleep) {
+            GetPowerManager()->sensor_wake(esp_timer_get_time());
+            pipeline_reset = true;
+        }
+    }
+    if (config.measure_mode != m_config.measure_mode) {
+        if (!apply_measure_mode((eMeasureMode)config.measure_mode)) {
+            // data ready never comes if the sensor refused the command, the supervisor recovers it
+            GetLogger(eLogType::Error)->Log("Failed to apply measure mode %d", config.measure_mode);
+            GetHealthSupervisor()->report_failure(esp_timer_get_time());
+        }
+        pipeline_reset = true;
+    }
+    m_config = config;
+    matter_update_config_attributes();
+
+    return pipeline_reset;
+}
+
+bool CSystem::apply_measure_mode(eMeasureMode mode)
+{
+    bool result = true;
+
+    if (GetScd41Ctrl()->get_power_state() == Scd4xPowerSleep) {
+        // idle mode commands are not acknowledged while sleeping (battery mode)
+        result &= GetPowerManager()->sensor_wake(esp_timer_get_time());
+    }
+    if (m_measure_mode != MeasureModeSingleShot) {
+        result &= GetScd41Ctrl()->stop_periodic_measure();
+    }
+    // idle window, settings that require idle mode are applied here
+    if (GetCompensation()->is_work_due(esp_timer_get_time())) {
+        GetCompensation()->apply_pending(esp_timer_get_time());
+    }
+    if (GetCalibration()->is_work_due()) {
+        GetCalibration()->apply_pending();
+        publish_calibration_status();
+    }
+    switch (mode) {
+    case MeasureModePeriodic:
+        result &= GetScd41Ctrl()->start_periodic_measure();
+        break;
+    case MeasureModeLowPowerPeriodic:
+        result &= GetScd41Ctrl()->start_low_power_periodic_measure();
+        break;
+    default:
+        mode = MeasureModeSingleShot;
+        break;
+    }
+    if (m_measure_mode != mode) {
+        GetLogger(eLogType::Info)->Log("Measure mode changed (%d -> %d)", m_measure_mode, mode);
+        GetAdaptiveSampler()->reset();
+    }
+    m_measure_mode = mode;
+
+    return result;
+}
+
+/**
+ * @brief the sensor only takes the self test command in idle mode, periodic measurement is stopped without waiting
+ */
+bool CSystem::start_self_test(int64_t now_us)
+{
+    if (m_self_test_state != SelfTestIdle) {
+        GetLogger(eLogType::Warning)->Log("Self test already running");
+        return false;
+    }
+    if (GetCalibration()->get_frc_state() != FrcStateIdle) {
+        GetLogger(eLogType::Warning)->Log("Self test rejected during forced recalibration");
+        return false;
+    }
+
+    m_self_test_prev_mode = m_measure_mode;
+    m_self_test_deadline_us = now_us;
+    if (GetScd41Ctrl()->get_power_state() == Scd4xPowerSleep) {
+        GetPowerManager()->sensor_wake(now_us);
+    }
+    if (m_measure_mode != MeasureModeSingleShot) {
+        GetScd41Ctrl()->stop_periodic_measure(false);
+        m_measure_mode = MeasureModeSingleShot;
+        m_self_test_deadline_us = now_us + (int64_t)SCD4X_STOP_PERIODIC_TIME_MS * 1000;
+    }
+    m_self_test_state = SelfTestStopping;
+    GetLogger(eLogType::Info)->Log("Self test started (mode before: %d)", m_self_test_prev_mode);
+
+    return true;
+}
+
+/**
+ * @brief stepped by the measurement task, true while the self test owns the sensor
+ */
+bool CSystem::step_self_test(int64_t now_us)
+{
+    bool passed = false;
+
+    switch (m_self_test_state) {
+    case SelfTestStopping:
+        if (now_us < m_self_test_deadline_us)
+            return true;
+        if (!GetScd41Ctrl()->start_self_test()) {
+            finish_self_test(0);
+            return false;
+        }
+        m_self_test_state = SelfTestRunning;
+        m_self_test_deadline_us = now_us + (int64_t)SCD4X_SELF_TEST_TIME_MS * 1000;
+        return true;
+    case SelfTestRunning:
+        if (now_us < m_self_test_deadline_us)
+            return true;
+        finish_self_test(GetScd41Ctrl()->read_self_test_result(&passed) && passed ? 1 : 0);
+        return false;
+    default:
+        return false;
+    }
+}
+
+void CSystem::finish_self_test(int32_t result)
+{
+    m_self_test_state = SelfTestIdle;
+    m_stats.self_test_result = result;
+    m_stats.self_test_count++;
+    GetLogger(result ? eLogType::Info : eLogType::Warning)->Log("Self test %s", result ? "passed" : "failed");
+    apply_measure_mode(m_self_test_prev_mode);
+}
+
+bool CSystem::read_and_publish_measurement()
 {
-    CSystem *obj = static_cast<CSystem *>(param);
-    int64_t current_tick_us;
-    int64_t last_tick_us = 0;
     CDevice * dev;
     uint16_t co2ppm = 0;
     float temperature = 0.f;
     float humidity = 0.f;
+
+    int64_t tick_us = esp_timer_get_time();
+    bool wake_shot = GetScd41Ctrl()->is_wake_shot();
+    bool result = GetScd41Ctrl()->read_measurement(&co2ppm, &temperature, &humidity);
+    m_hist_read.record(esp_timer_get_time() - tick_us);
+    if (!result) {
+        m_stats.read_failures++;
+        GetHealthSupervisor()->report_failure(esp_timer_get_time());
+        return false;
+    }
+    m_stats.samples++;
+    GetHealthSupervisor()->report_success(esp_timer_get_time());
+    GetCompensation()->feed_ambient_pressure();
+    if (wake_shot) {
+        // read anyway to clear data ready, the value is neither filtered, published nor kept in history
+        m_stats.discarded_samples++;
+        GetLogger(eLogType::Info)->Log("First sample after wake up discarded (CO2 PPM: %u, Temperature: %g, Humidity: %g)",
+            co2ppm, temperature, humidity);
+        return true;
+    }
+
+    // history keeps raw readings, filtered ones are published (units of the matter attributes)
+    CMeasurementFilter *filter = GetMeasurementFilter();
+    int32_t co2_filtered = filter->process(FilterChannelCo2, co2ppm);
+    float temperature_filtered = (float)filter->process(FilterChannelTemperature, (int32_t)lroundf(temperature * 100.f)) / 100.f;
+    float humidity_filtered = (float)filter->process(FilterChannelHumidity, (int32_t)lroundf(humidity * 100.f)) / 100.f;
+    if (m_measure_mode == MeasureModeSingleShot) {
+        GetAdaptiveSampler()->update((uint16_t)co2_filtered, humidity_filtered, tick_us);
+    }
+
+    dev = find_device_by_endpoint_id(1);
+    if (dev) {
+        dev->update_measured_value_co2ppm((float)co2_filtered);
+        dev->update_measured_value_temperature(temperature_filtered);
+        dev->update_measured_value_humidity(humidity_filtered);
+    }
+    int32_t published[FilterChannelMax] = {co2_filtered, (int32_t)lroundf(temperature_filtered * 100.f), (int32_t)lroundf(humidity_filtered * 100.f)};
+    if (memcmp(published, m_published, sizeof(published)) != 0) {
+        // radio time is not observable from here, estimated per reported sample
+        GetEnergyMonitor()->add(EnergyWifiTx, ENERGY_WIFI_TX_REPORT_US);
+        memcpy(m_published, published, sizeof(published));
+    }
+    // dew point / absolute humidity follow the published temperature and humidity
+    if (GetDerivedChannels()->update(published[FilterChannelTemperature], published[FilterChannelHumidity]) && dev) {
+        dev->update_derived_values(GetDerivedChannels()->get_dew_point(), GetDerivedChannels()->get_absolute_humidity());
+    }
+    // Min/MaxMeasuredValue follow the observed range when configured, updated only when the range of that window changes
+    uint32_t range_changed = GetRollingStats()->add(published, tick_us);
+    if (m_config.range_window > 0 && (range_changed & (1u << (m_config.range_window - 1)))) {
+        publish_measured_value_ranges(&m_config);
+    }
+    // constant work per sample, devices are only involved on a transition
+    if (GetAlarmEngine()->process(co2_filtered, tick_us)) {
+        publish_alarm_state();
+    }
+    GetHistory()->append_sample(co2ppm, temperature, humidity);
+    GetPowerManager()->record_sample();
+    GetLogger(eLogType::Info)->Log("CO2 PPM: %u (%" PRId32 "), Temperature: %g (%g), Humidity: %g (%g)", co2ppm, co2_filtered,
+        temperature, temperature_filtered, humidity, humidity_filtered);
+
+    return true;
+}
+
+uint32_t CSystem::get_single_shot_period_ms()
+{
+    CAdaptiveSampler *sampler = GetAdaptiveSampler();
+    return sampler->is_enabled() ? sampler->get_period_ms() : m_measure_period_ms;
+}
+
+void CSystem::publish_sensor_fault(bool fault)
+{
+    for (auto & dev : m_device_list) {
+        dev->update_sensor_fault(fault);
+    }
+}
+
+void CSystem::publish_calibration_status()
+{
+    CCalibration *calibration = GetCalibration();
+    for (auto & dev : m_device_list) {
+        dev->update_calibration_status(calibration->get_frc_state(), calibration->get_last_result(), calibration->get_last_correction(), calibration->get_auto_calibration());
+    }
+}
+
+/**
+ * @brief configured CO2 range (temperature / humidity: null) or the range observed over config->range_window
+ * @note the observed range is not the measurable range of the spec, it is opt-in for controllers that display it
+ */
+void CSystem::publish_measured_value_ranges(const system_config_t *config)
+{
+    float min_values[FilterChannelMax] = {(float)config->co2_min_ppm, NAN, NAN};
+    float max_values[FilterChannelMax] = {(float)config->co2_max_ppm, NAN, NAN};
+    int32_t min_value, max_value;
+
+    if (config->range_window > 0) {
+        for (int i = 0; i < FilterChannelMax; i++) {
+            if (!GetRollingStats()->get_range((eRollingWindow)(config->range_window - 1), (eFilterChannel)i, &min_value, &max_value)) {
+                return;     // no sample yet
+            }
+            // min must be below max
+            max_value = MAX(max_value, min_value + 1);
+            min_values[i] = i == FilterChannelCo2 ? (float)min_value : (float)min_value / 100.f;
+            max_values[i] = i == FilterChannelCo2 ? (float)max_value : (float)max_value / 100.f;
+        }
+    }
+    for (auto & dev : m_device_list) {
+        dev->update_co2_measured_value_range(min_values[FilterChannelCo2], max_values[FilterChannelCo2]);
+        dev->update_temperature_measured_value_range(min_values[FilterChannelTemperature], max_values[FilterChannelTemperature]);
+        dev->update_humidity_measured_value_range(min_values[FilterChannelHumidity], max_values[FilterChannelHumidity]);
+    }
+}
+
+void CSystem::publish_alarm_state()
+{
+    bool active = GetAlarmEngine()->is_active();
+    for (auto & dev : m_device_list) {
+        dev->update_alarm_state(active);
+    }
+}
+
+void CSystem::callback_calibration_result(eFrcResult result, int16_t correction, void *arg)
+{
+    CSystem *obj = static_cast<CSystem *>(arg);
+    obj->publish_calibration_status();
+}
+
+void CSystem::callback_config_changed(void *arg)
+{
+    CSystem *obj = static_cast<CSystem *>(arg);
+    if (!obj->post_request(RequestApplyConfig)) {
+        GetLogger(eLogType::Warning)->Log("Request queue is full, configuration is applied later");
+    }
+}
+
+static esp_matter_attr_val_t config_to_attr_val(eConfigField field, int32_t value)
+{
+    switch (CConfig::get_field(field)->type) {
+    case ConfigTypeBool:
+        return esp_matter_bool(value != 0);
+    case ConfigTypeEnum8:
+        return esp_matter_enum8((uint8_t)value);
+    case ConfigTypeU8:
+        return esp_matter_uint8((uint8_t)value);
+    case ConfigTypeU16:
+        return esp_matter_uint16((uint16_t)value);
+    default:
+        return esp_matter_uint32((uint32_t)value);
+    }
+}
+
+static int32_t config_from_attr_val(eConfigField field, const esp_matter_attr_val_t *val)
+{
+    switch (CConfig::get_field(field)->type) {
+    case ConfigTypeBool:
+        return val->val.b ? 1 : 0;
+    case ConfigTypeEnum8:
+    case ConfigTypeU8:
+        return val->val.u8;
+    case ConfigTypeU16:
+        return val->val.u16;
+    default:
+        return (int32_t)val->val.u32;
+    }
+}
+
+/**
+ * @brief writable attributes mirroring the configuration fields (attribute id: eConfigField), i2c settings are console only
+ */
+bool CSystem::matter_create_config_cluster()
+{
+    system_config_t config;
+    esp_matter::endpoint_t *root = esp_matter::endpoint::get(m_root_node, 0);
+    if (!root) {
+        return false;
+    }
+    esp_matter::cluster_t *cluster = esp_matter::cluster::create(root, CONFIG_CLUSTER_ID, esp_matter::cluster_flags::CLUSTER_FLAG_SERVER);
+    if (!cluster) {
+        return false;
+    }
+    esp_matter::cluster::global::attribute::create_cluster_revision(cluster, 1);
+    esp_matter::cluster::global::attribute::create_feature_map(cluster, 0);
+
+    GetConfig()->get(&config);
+    for (int i = 0; i < CONFIG_MATTER_FIELD_COUNT; i++) {
+        eConfigField field = (eConfigField)i;
+        uint8_t flags = esp_matter::attribute_flags::ATTRIBUTE_FLAG_WRITABLE;
+        if (!esp_matter::attribute::create(cluster, (uint32_t)field, flags, config_to_attr_val(field, CConfig::get_value(&config, field)))) {
+            GetLogger(eLogType::Error)->Log("Failed to create <%s> configuration attribute", CConfig::get_field(field)->name);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void CSystem::matter_update_config_attributes()
+{
+    system_config_t config;
+    esp_matter_attr_val_t val;
+
+    GetConfig()->get(&config);
+    for (int i = 0; i < CONFIG_MATTER_FIELD_COUNT; i++) {
+        eConfigField field = (eConfigField)i;
+        esp_matter::attribute_t *attribute = esp_matter::attribute::get(0, CONFIG_CLUSTER_ID, (uint32_t)field);
+        int32_t value = CConfig::get_value(&config, field);
+        val = esp_matter_invalid(nullptr);
+        if (!attribute || esp_matter::attribute::get_val(attribute, &val) != ESP_OK || config_from_attr_val(field, &val) == value) {
+            continue;
+        }
+        val = config_to_attr_val(field, value);
+        esp_matter::attribute::update(0, CONFIG_CLUSTER_ID, (uint32_t)field, &val);
+    }
+}
+
+/**
+ * @brief writes are validated and persisted before they are accepted, rejected values keep the attribute unchanged
+ */
+esp_err_t CSystem::matter_on_change_config_attribute(esp_matter::attribute::callback_type_t type, uint32_t attribute_id, esp_matter_attr_val_t *val)
+{
+    if (type != esp_matter::attribute::PRE_UPDATE || attribute_id >= CONFIG_MATTER_FIELD_COUNT) {
+        return ESP_OK;
+    }
+    eConfigField field = (eConfigField)attribute_id;
+    if (!GetConfig()->set(field, config_from_attr_val(field, val))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+void CSystem::print_measurement_stats()
+{
+    static const char *mode_names[] = {"single-shot", "periodic", "low-power-periodic"};
+    static const char *power_names[] = {"idle", "measuring", "sleep"};
+    printf("mode: %s, period: %" PRIu32 " ms%s, sensor: %s\n", mode_names[m_measure_mode], get_single_shot_period_ms(),
+        GetAdaptiveSampler()->is_enabled() ? " (adaptive)" : "", power_names[GetScd41Ctrl()->get_power_state()]);
+    printf("samples: %" PRIu32 ", discarded: %" PRIu32 ", read failures: %" PRIu32 ", data ready timeouts: %" PRIu32 ", dropped requests: %" PRIu32 "\n",
+        m_stats.samples.load(), m_stats.discarded_samples.load(), m_stats.read_failures.load(), m_stats.ready_timeouts.load(), m_stats.requests_dropped.load());
+    GetCalibration()->print_status();
+    printf("self test: %" PRIu32 " (last result: %s)\n", m_stats.self_test_count.load(),
+        m_stats.self_test_result < 0 ? "none" : (m_stats.self_test_result ? "passed" : "failed"));
+    if (m_task_timer_handle) {
+        printf("measurement task stack: %u bytes, minimum free: %u bytes\n", TASK_TIMER_STACK_DEPTH,
+            (unsigned)uxTaskGetStackHighWaterMark(m_task_timer_handle));
+    }
+    m_hist_data_ready.print("shot to data ready");
+    m_hist_read.print("read measurement");
+}
+
+void CSystem::reset_measurement_stats()
+{
+    m_stats.samples = 0;
+    m_stats.read_failures = 0;
+    m_stats.discarded_samples = 0;
+    m_stats.ready_timeouts = 0;
+    m_stats.requests_dropped = 0;
+    m_stats.self_test_count = 0;
+    m_stats.self_test_result = -1;
+    m_hist_data_ready.reset();
+    m_hist_read.reset();
+}
+
+void CSystem::task_timer_function(void *param)
+{
+    CSystem *obj = static_cast<CSystem *>(param);
+    int64_t current_tick_us;
+    int64_t last_tick_us = 0;
+    int64_t interval_us;
     bool measure_shot = false;
+    bool requests_deferred;
+    bool stack_warned = false;
+    uint32_t wait_ms;
+    system_request_t request;
+    CHealthSupervisor *supervisor = GetHealthSupervisor();
+    CPowerManager *power = GetPowerManager();
+    CEnergyMonitor *energy = GetEnergyMonitor();
 
     GetLogger(eLogType::Info)->Log("Realtime task (timer) started");
     while (obj->m_keepalive) {
-        if (obj->m_initialized) {
-            if (!measure_shot) {
-                current_tick_us = esp_timer_get_time();
-                if (current_tick_us - last_tick_us >= MEASURE_PERIOD_US) {
-                    GetScd41Ctrl()->measure_single_shot();
+        wait_ms = 50;
+        requests_deferred = false;
+        energy->begin(EnergyCpuAwake, esp_timer_get_time());
+        if (obj->m_initialized && obj->m_co2_sensor_available) {
+            current_tick_us = esp_timer_get_time();
+            if (obj->m_measure_mode == MeasureModeSingleShot) {
+                interval_us = (int64_t)obj->get_single_shot_period_ms() * 1000;
+            } else if (obj->m_measure_mode == MeasureModePeriodic) {
+                interval_us = (int64_t)PERIODIC_INTERVAL_MS * 1000;
+            } else {
+                interval_us = (int64_t)LOW_POWER_INTERVAL_MS * 1000;
+            }
+
+            // recovery commands are spread over loop iterations, requests wait in the queue meanwhile
+            supervisor->set_expected_interval_ms((uint32_t)(interval_us / 1000));
+            eSupervisorAction action = supervisor->process(current_tick_us);
+            if (supervisor->take_fault_changed()) {
+                obj->publish_sensor_fault(supervisor->is_fault());
+            }
+            if (action == SupervisorBusy) {
+                energy->end(EnergyCpuAwake, esp_timer_get_time());
+                vTaskDelay(pdMS_TO_TICKS(50));
+                continue;
+            }
+            if (action == SupervisorResume) {
+                // the sensor was reinitialized, a self test in flight is lost
+                if (obj->m_self_test_state != SelfTestIdle) {
+                    obj->m_self_test_state = SelfTestIdle;
+                    obj->m_measure_mode = obj->m_self_test_prev_mode;
+                }
+                GetCompensation()->invalidate();
+                GetCalibration()->invalidate();
+                if (supervisor->take_factory_reset_done()) {
+                    GetCompensation()->factory_reset_done();
+                    GetCalibration()->factory_reset_done();
+                    obj->publish_calibration_status();
+                }
+                GetAdaptiveSampler()->reset();
+                GetMeasurementFilter()->reset();
+                obj->apply_measure_mode(obj->m_measure_mode);
+                measure_shot = false;
+                last_tick_us = esp_timer_get_time();
+            }
+
+            // self test steps (stop, 10 s test, restore) never block, requests and FRC wait until it is done
+            if (obj->m_self_test_state != SelfTestIdle) {
+                if (obj->step_self_test(current_tick_us)) {
+                    energy->end(EnergyCpuAwake, esp_timer_get_time());
+                    vTaskDelay(pdMS_TO_TICKS(50));
+                    continue;
+                }
+                measure_shot = false;
+                last_tick_us = esp_timer_get_time();
+            }
+
+            // a single shot in flight is read first, the sensor does not accept mode commands while measuring
+            eCalibrationAction calibration = measure_shot ? CalibrationActionNone : GetCalibration()->process(obj->m_measure_mode, current_tick_us);
+            if (calibration == CalibrationActionBusy) {
+                energy->end(EnergyCpuAwake, esp_timer_get_time());
+                vTaskDelay(pdMS_TO_TICKS(50));
+                continue;
+            }
+            if (calibration == CalibrationActionSetMode) {
+                if (!obj->apply_measure_mode((eMeasureMode)GetCalibration()->get_requested_mode()) &&
+                    GetCalibration()->report_mode_failure() == CalibrationActionSetMode) {
+                    obj->apply_measure_mode((eMeasureMode)GetCalibration()->get_requested_mode());
+                }
+                obj->publish_calibration_status();
+                measure_shot = false;
+                last_tick_us = esp_timer_get_time();
+            }
+
+            // requests (self test, idle only settings) wait in the queue until the single shot in flight is read
+            requests_deferred = measure_shot && uxQueueMessagesWaiting(obj->m_request_queue) > 0;
+            if (!measure_shot && obj->process_requests()) {
+                last_tick_us = esp_timer_get_time();
+            }
+
+            current_tick_us = esp_timer_get_time();
+            if (obj->m_measure_mode == MeasureModeSingleShot && !measure_shot) {
+                if (current_tick_us - last_tick_us >= interval_us) {
+                    if (GetScd41Ctrl()->get_power_state() == Scd4xPowerSleep) {
+                        power->sensor_wake(current_tick_us);
+                    }
+                    // the task does not block in the driver while the sensor is measuring (cpu sleeps in battery mode)
+                    if (!GetScd41Ctrl()->measure_single_shot(false)) {
+                        supervisor->report_failure(current_tick_us);
+                    }
+                    power->record_shot();
                     measure_shot = true;
                     last_tick_us = current_tick_us;
                 }
-            } else {
+            } else if ((obj->m_measure_mode == MeasureModeSingleShot && current_tick_us - last_tick_us >= (int64_t)SCD4X_SINGLE_SHOT_TIME_MS * 1000) ||
+                (obj->m_measure_mode != MeasureModeSingleShot && current_tick_us - last_tick_us >= interval_us - 500000)) {
+                // single shot: poll once the measurement time has elapsed
+                // periodic modes: sensor updates data by itself, poll only near the end of the update interval
                 if (!GetScd41Ctrl()->is_measurement_data_ready()) {
+                    energy->end(EnergyCpuAwake, esp_timer_get_time());
                     vTaskDelay(pdMS_TO_TICKS(100));
                     current_tick_us = esp_timer_get_time();
-                    if (current_tick_us - last_tick_us >= MEASURE_PERIOD_US) {
+                    if (current_tick_us - last_tick_us >= (obj->m_measure_mode == MeasureModeSingleShot ? interval_us : interval_us * 2)) {
+                        obj->m_stats.ready_timeouts++;
+                        supervisor->report_failure(current_tick_us);
                         measure_shot = false;
                         last_tick_us = current_tick_us;
                     }
                     continue;
                 }
 
-                if (GetScd41Ctrl()->read_measurement(&co2ppm, &temperature, &humidity)) {
-                    dev = obj->find_device_by_endpoint_id(1);
-                    if (dev) {
-                        dev->update_measured_value_co2ppm((float)co2ppm);
-                        dev->update_measured_value_temperature(temperature);
-                        dev->update_measured_value_humidity(humidity);
-                    }
+                bool wake_shot = GetScd41Ctrl()->is_wake_shot();
+                if (obj->m_measure_mode == MeasureModeSingleShot) {
+                    obj->m_hist_data_ready.record(esp_timer_get_time() - last_tick_us);
+                } else {
+                    last_tick_us = esp_timer_get_time();
                 }
+                obj->read_and_publish_measurement();
                 measure_shot = false;
-                GetLogger(eLogType::Info)->Log("CO2 PPM: %u, Temperature: %g, Humidity: %g", co2ppm, temperature, humidity);
+                if (!stack_warned && uxTaskGetStackHighWaterMark(nullptr) < TASK_TIMER_STACK_MARGIN) {
+                    GetLogger(eLogType::Warning)->Log("Stack margin low (free: %u bytes)", (unsigned)uxTaskGetStackHighWaterMark(nullptr));
+                    stack_warned = true;
+                }
+                bool discarded = wake_shot && !GetScd41Ctrl()->is_wake_shot();
+                if (discarded) {
+                    // discarded, the follow-up shot is issued right away instead of after a full period
+                    last_tick_us = esp_timer_get_time() - interval_us;
+                }
+
+                // sensor is idle until the next shot in single shot mode, periodic modes are stopped and restarted
+                if (GetCompensation()->is_work_due(esp_timer_get_time()) || GetCalibration()->is_work_due()) {
+                    obj->apply_measure_mode(obj->m_measure_mode);
+                    if (obj->m_measure_mode != MeasureModeSingleShot) {
+                        last_tick_us = esp_timer_get_time();
+                    }
+                }
+
+                if (power->get_mode() == PowerModeBattery && !discarded) {
+                    power->retain();
+                    power->stay_active(POWER_ACTIVE_WINDOW_MS);
+                    if (power->should_sleep_sensor(obj->get_single_shot_period_ms())) {
+                        power->sensor_sleep(esp_timer_get_time());
+                    }
+                }
+            }
+
+            // battery mode: block until the next shot or data ready (or a request), the cpu light sleeps meanwhile
+            if (power->get_mode() == PowerModeBattery && obj->m_measure_mode == MeasureModeSingleShot) {
+                int64_t due_us = last_tick_us + (measure_shot ? (int64_t)SCD4X_SINGLE_SHOT_TIME_MS * 1000 : interval_us);
+                int64_t remain_ms = (due_us - esp_timer_get_time()) / 1000;
+                wait_ms = (uint32_t)MAX(remain_ms, (int64_t)50);
             }
         }
 
-        vTaskDelay(pdMS_TO_TICKS(50));
+        energy->end(EnergyCpuAwake, esp_timer_get_time());
+        if (wait_ms > 50) {
+            if (requests_deferred) {
+                vTaskDelay(pdMS_TO_TICKS(wait_ms));     // a queued request would end the wait right away
+            } else {
+                xQueuePeek(obj->m_request_queue, &request, pdMS_TO_TICKS(wait_ms));
+            }
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(wait_ms));
+        }
     }
     GetLogger(eLogType::Info)->Log("Realtime task (timer) terminated");
     vTaskDelete(nullptr);
-}
\ No newline at end of file
+}
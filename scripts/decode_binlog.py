@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# decode_binlog.py
+# purpose: decode binary log records (LOGGER_BINARY_ENABLE=1) using the firmware ELF
+# usage: idf.py monitor | python3 decode_binlog.py build/yogyui-matter-esp32-scd41.elf
+#        python3 decode_binlog.py build/yogyui-matter-esp32-scd41.elf captured.log
+# requires pyelftools (installed with ESP-IDF python environment)
+
+import re
+import struct
+import sys
+from elftools.elf.elffile import ELFFile
+from elftools.elf.constants import SH_FLAGS
+
+LOG_ITEM_TYPE_MASK = 0x0F
+LOG_ITEM_CALLSITE = 0x40
+LOG_LETTERS = {0: 'I', 1: 'W', 2: 'E', 3: 'D', 4: 'E'}
+RE_RECORD = re.compile(r'#B([0-9a-f]+)')
+RE_SPEC = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|j|z|t|L)?([diuxXocfFeEgGaAspn%])')
+
+
+class StringTable:
+    def __init__(self, path):
+        self.sections = []
+        with open(path, 'rb') as f:
+            elf = ELFFile(f)
+            for section in elf.iter_sections():
+                if section['sh_flags'] & SH_FLAGS.SHF_ALLOC and section['sh_type'] != 'SHT_NOBITS':
+                    self.sections.append((section['sh_addr'], section.data()))
+        self.cache = {}
+
+    def get(self, address):
+        if address in self.cache:
+            return self.cache[address]
+        for base, data in self.sections:
+            if base <= address < base + len(data):
+                end = data.find(b'\0', address - base)
+                text = data[address - base:end if end >= 0 else len(data)].decode('utf-8', 'replace')
+                self.cache[address] = text
+                return text
+        return '<unknown 0x%08x>' % address
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def unpack(self, fmt):
+        size = struct.calcsize(fmt)
+        if self.pos + size > len(self.data):
+            raise EOFError
+        value = struct.unpack_from(fmt, self.data, self.pos)[0]
+        self.pos += size
+        return value
+
+    def string(self):
+        end = self.data.find(b'\0', self.pos)
+        if end < 0:
+            raise EOFError
+        value = self.data[self.pos:end].decode('utf-8', 'replace')
+        self.pos = end + 1
+        return value
+
+
+def format_message(fmt, reader):
+    def replace(m):
+        flags, width, precision, length, conv = m.groups()
+        if conv == '%':
+            return '%'
+        if width == '*':
+            width = str(reader.unpack('<i'))
+        if precision == '*':
+            precision = str(reader.unpack('<i'))
+        spec = '%' + flags + (width or '') + ('.' + precision if precision is not None else '')
+        signed = conv in 'di'
+        if conv in 'diuxXoc':
+            if length in ('ll', 'j'):
+                value = reader.unpack('<q' if signed else '<Q')
+            else:
+                value = reader.unpack('<i' if signed else '<I')
+            if conv == 'c':
+                return chr(value & 0xFF)
+            return (spec + conv) % value
+        if conv in 'fFeEgG':
+            return (spec + conv) % reader.unpack('<d')
+        if conv in 'aA':
+            return float.hex(reader.unpack('<d'))
+        if conv == 's':
+            return (spec + 's') % reader.string()
+        if conv == 'p':
+            return '0x%08x' % reader.unpack('<I')
+        reader.unpack('<I')     # %n
+        return ''
+
+    try:
+        return RE_SPEC.sub(replace, fmt)
+    except EOFError:
+        return fmt + ' <truncated>'
+
+
+def decode(table, data):
+    reader = Reader(data)
+    try:
+        rtype = reader.unpack('<B')
+        timestamp = reader.unpack('<I')
+        fmt = table.get(reader.unpack('<I'))
+        callsite = None
+        if rtype & LOG_ITEM_CALLSITE:
+            funcname = table.get(reader.unpack('<I')).split('(')[0]
+            filename = table.get(reader.unpack('<I'))
+            callsite = (funcname, filename, reader.unpack('<H'))
+    except EOFError:
+        return '<invalid record %s>' % data.hex()
+
+    message = format_message(fmt, reader)
+    if callsite:
+        message = '[%s] %s [%s:%d]' % (callsite[0], message, callsite[1], callsite[2])
+    letter = LOG_LETTERS.get(rtype & LOG_ITEM_TYPE_MASK, 'I')
+    return '%s (%d) logger: %s' % (letter, timestamp, message)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('usage: %s <elf> [log file]' % sys.argv[0], file=sys.stderr)
+        return 1
+    table = StringTable(sys.argv[1])
+    stream = open(sys.argv[2], 'r', errors='replace') if len(sys.argv) > 2 else sys.stdin
+    for line in stream:
+        m = RE_RECORD.search(line)
+        if not m or len(m.group(1)) % 2:
+            sys.stdout.write(line)
+            continue
+        sys.stdout.write(line[:m.start()] + decode(table, bytes.fromhex(m.group(1))) + '\n')
+        sys.stdout.flush()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+# simulate_derived.py
+# purpose: compare the fixed point dew point / absolute humidity (CDerivedChannels::calculate) against the double precision Magnus formula
+# usage: python3 simulate_derived.py [--step-t 10] [--step-rh 10]     (grid steps in 0.01 degC / 0.01 %RH)
+#        python3 simulate_derived.py --tables                           (print the lookup tables of derived.cpp)
+# integer arithmetic mirrors main/src/system/derived.cpp, keep both in sync (test/derived_test.cpp checks the C++ itself)
+
+import argparse
+import math
+import os
+import re
+import sys
+
+HEADER_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'main', 'include', 'system', 'derived.h')
+RE_DEFINE = re.compile(r'#define\s+(DERIVED_\w+)\s+(-?\d+)')
+
+LN2_Q16 = 45426
+INV_LN2_Q16 = 94548
+LN_10000_Q16 = 603609
+ABS_HUMIDITY_K = 13244704
+
+# (name, temperature range, humidity range) in 0.01 units
+RANGES = [
+    ('scd41 operating', (-1000, 6000), (0, 10000)),
+    ('indoor', (1500, 3500), (2000, 8000)),
+    ('coefficients', (-4500, 6000), (100, 10000)),
+]
+
+
+def load_constants(path):
+    constants = {}
+    with open(path) as f:
+        for line in f:
+            m = RE_DEFINE.match(line.strip())
+            if m:
+                constants[m.group(1)] = int(m.group(2))
+    return constants
+
+
+def make_tables(bits):
+    n = 1 << bits
+    ln_table = [round(math.log(1 + i / n) * 65536) for i in range(n + 1)]
+    exp2_table = [round(2 ** (i / n) * 65536) for i in range(n + 1)]
+    return ln_table, exp2_table
+
+
+def div_round(num, den):
+    return (num + den // 2) // den if num >= 0 else -((-num + den // 2) // den)
+
+
+class Derived:
+    # mirror of CDerivedChannels::calculate()
+    def __init__(self, c):
+        self.c = c
+        self.bits = c['DERIVED_LUT_BITS']
+        self.ln_table, self.exp2_table = make_tables(self.bits)
+
+    def lookup(self, table, frac):
+        shift = 16 - self.bits
+        idx = frac >> shift
+        rem = frac & ((1 << shift) - 1)
+        return table[idx] + (((table[idx + 1] - table[idx]) * rem + (1 << (shift - 1))) >> shift)
+
+    def ln_q16(self, x):
+        e = x.bit_length() - 1
+        return e * LN2_Q16 + self.lookup(self.ln_table, ((x << 16) >> e) - 65536)
+
+    def calculate(self, temperature, humidity):
+        c = self.c
+        t = min(max(temperature, c['DERIVED_TEMPERATURE_MIN']), c['DERIVED_TEMPERATURE_MAX'])
+        rh = min(max(humidity, c['DERIVED_HUMIDITY_MIN']), c['DERIVED_HUMIDITY_MAX'])
+        b, cc = c['DERIVED_MAGNUS_B_Q16'], c['DERIVED_MAGNUS_C_X100']
+        f_q16 = div_round(b * t, cc + t)
+        gamma_q16 = self.ln_q16(rh) - LN_10000_Q16 + f_q16
+        dew_point = div_round(cc * gamma_q16, b - gamma_q16)
+        log2_q16 = (f_q16 * INV_LN2_Q16) >> 16
+        k = log2_q16 >> 16
+        num = ABS_HUMIDITY_K * rh * self.lookup(self.exp2_table, log2_q16 & 0xFFFF)
+        den = 10000 * 65536 * (27315 + t)
+        if k >= 0:
+            num <<= k
+        else:
+            den <<= -k
+        return dew_point, div_round(num, den)
+
+
+def reference(temperature, humidity):
+    t = temperature / 100.0
+    rh = max(humidity, 1) / 100.0
+    f = 17.62 * t / (243.12 + t)
+    gamma = math.log(rh / 100.0) + f
+    return 243.12 * gamma / (17.62 - gamma), 216.7 * rh / 100.0 * 6.112 * math.exp(f) / (273.15 + t)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='derived channel accuracy against double precision')
+    parser.add_argument('--step-t', type=int, default=10, help='temperature grid step (0.01 degC)')
+    parser.add_argument('--step-rh', type=int, default=10, help='humidity grid step (0.01 %%RH)')
+    parser.add_argument('--tables', action='store_true', help='print the lookup tables')
+    args = parser.parse_args()
+
+    c = load_constants(HEADER_PATH)
+    derived = Derived(c)
+    if args.tables:
+        for name, table in (('ln_table', derived.ln_table), ('exp2_table', derived.exp2_table)):
+            print('%s: %s' % (name, ', '.join(str(v) for v in table)))
+        return 0
+
+    print('%-16s %9s %12s %12s %12s %12s' % ('range', 'points', 'dew max', 'dew mean', 'abs max', 'abs mean'))
+    for name, (t_min, t_max), (rh_min, rh_max) in RANGES:
+        n = 0
+        dew_max = dew_sum = abs_max = abs_sum = 0.0
+        for t in range(t_min, t_max + 1, args.step_t):
+            for rh in range(rh_min, rh_max + 1, args.step_rh):
+                dew_point, absolute_humidity = derived.calculate(t, rh)
+                ref_dew_point, ref_absolute_humidity = reference(t, rh)
+                dew_error = abs(dew_point / 100.0 - ref_dew_point)
+                abs_error = abs(absolute_humidity / 100.0 - ref_absolute_humidity)
+                dew_max, abs_max = max(dew_max, dew_error), max(abs_max, abs_error)
+                dew_sum += dew_error
+                abs_sum += abs_error
+                n += 1
+        print('%-16s %9d %9.4f C %9.4f C %7.4f g/m3 %7.4f g/m3' % (name, n, dew_max, dew_sum / n, abs_max, abs_sum / n))
+    print('output resolution: 0.01 C, 0.01 g/m3 (rounding alone contributes up to 0.005)')
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+# simulate_energy.py
+# purpose: estimate charge per sample and battery life of the power modes (CPowerManager) for a set of sampling periods
+# usage: python3 simulate_energy.py [--period 10,60,300,900] [--awake 400] [--capacity 2500]
+#        python3 simulate_energy.py --synthetic [--hours 24]     (adaptive sampling periods on a synthetic trace)
+# --awake: measured awake time per sample, "per sample ... (awake N ms)" of "matter sensor power"
+# model constants are read from main/include/system/energy.h (CEnergyMonitor, CPowerManager) so that the estimate follows the firmware
+
+import argparse
+import os
+import random
+import re
+import sys
+
+from simulate_sampling import AdaptiveSampler, Truth, load_constants as load_sampler_constants, simulate, synthetic_trace
+from simulate_sampling import HEADER_PATH as SAMPLER_HEADER_PATH
+
+HEADER_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'main', 'include', 'system', 'energy.h')
+RE_DEFINE = re.compile(r'#define\s+(ENERGY_\w+)\s+(\d+)')
+
+
+def load_constants(path):
+    constants = {}
+    with open(path) as f:
+        for line in f:
+            m = RE_DEFINE.match(line.strip())
+            if m:
+                constants[m.group(1)] = int(m.group(2))
+    return constants
+
+
+def should_sleep_sensor(c, period_ms):
+    # mirror of CPowerManager::should_sleep_sensor()
+    if period_ms <= 2 * c['ENERGY_SENSOR_SHOT_MS']:
+        return False
+    saved = (c['ENERGY_SENSOR_IDLE_UA'] - c['ENERGY_SENSOR_SLEEP_UA']) * (period_ms - 2 * c['ENERGY_SENSOR_SHOT_MS'])
+    return saved > (c['ENERGY_SENSOR_MEASURING_UA'] + c['ENERGY_SENSOR_IDLE_UA']) * c['ENERGY_SENSOR_SHOT_MS']
+
+
+def sample_charge(c, mode, period_ms, awake_ms, reconnect_ms):
+    # charge of one sampling period in uA x ms, returns (esp, sensor)
+    # CPowerManager::print_status(): sleep floor + cpu awake and one report (wifi_tx) of the energy monitor states
+    shot_ms = c['ENERGY_SENSOR_SHOT_MS']
+    esp_active_ua = c['ENERGY_ESP_SLEEP_UA'] + c['ENERGY_CPU_AWAKE_UA']
+    report = c['ENERGY_WIFI_TX_REPORT_US'] // 1000 * c['ENERGY_WIFI_TX_UA']
+    shots = 1
+    sensor_sleep_ms = 0
+    if mode == 'always-on':
+        esp = period_ms * esp_active_ua + report
+    elif mode == 'deep-sleep':
+        # boot, Wi-Fi association and CASE session re-establishment on every sample, sensor sleeps in between
+        awake = min(awake_ms + reconnect_ms, period_ms)
+        esp = awake * esp_active_ua + (period_ms - awake) * c['ENERGY_ESP_DEEP_SLEEP_UA'] + report
+        shots, sensor_sleep_ms = 2, period_ms - 2 * shot_ms
+    else:
+        awake = min(awake_ms, period_ms)
+        esp = awake * esp_active_ua + (period_ms - awake) * c['ENERGY_ESP_SLEEP_UA'] + report
+        if mode == 'battery' and should_sleep_sensor(c, period_ms):
+            shots, sensor_sleep_ms = 2, period_ms - 2 * shot_ms
+    measuring_ms = min(shots * shot_ms, period_ms)
+    sensor_sleep_ms = max(0, min(sensor_sleep_ms, period_ms - measuring_ms))
+    idle_ms = period_ms - measuring_ms - sensor_sleep_ms
+    sensor = measuring_ms * (c['ENERGY_SENSOR_MEASURING_UA'] + c['ENERGY_SENSOR_IDLE_UA']) + idle_ms * c['ENERGY_SENSOR_IDLE_UA'] + \
+        sensor_sleep_ms * c['ENERGY_SENSOR_SLEEP_UA']
+    return esp, sensor
+
+
+def main():
+    parser = argparse.ArgumentParser(description='power mode energy model')
+    parser.add_argument('--period', default='10,60,300,900', help='comma separated sampling periods (sec)')
+    parser.add_argument('--synthetic', action='store_true', help='add a row for adaptive sampling on a synthetic trace')
+    parser.add_argument('--hours', type=float, default=24.0, help='synthetic trace length')
+    parser.add_argument('--awake', type=float, default=400.0, help='awake time per sample in battery mode (ms)')
+    parser.add_argument('--reconnect', type=float, default=4000.0, help='deep sleep: boot + Wi-Fi + session setup per sample (ms)')
+    parser.add_argument('--deep-sleep-ua', type=int, default=10, help='ESP32 deep sleep current (uA)')
+    parser.add_argument('--capacity', type=float, default=2500.0, help='battery capacity (mAh)')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    c = load_constants(HEADER_PATH)
+    c['ENERGY_ESP_DEEP_SLEEP_UA'] = args.deep_sleep_ua
+    rows = [('fixed %g s' % float(p), [int(float(p) * 1000)]) for p in args.period.split(',') if p]
+    if args.synthetic:
+        sc = load_sampler_constants(SAMPLER_HEADER_PATH)
+        times, co2, humidity, _ = synthetic_trace(args.hours, args.seed)
+        sampler = AdaptiveSampler(sc, int(sc['SAMPLER_PERIOD_MIN_MS']), int(sc['SAMPLER_PERIOD_MAX_MS']))
+        periods = []
+
+        def next_period(co2_value, humidity_value, now_ms):
+            period = sampler.update(co2_value, humidity_value, now_ms)
+            periods.append(period)
+            return period
+        simulate(Truth(times, co2, humidity), int(times[-1] * 1000), next_period, 5.0, random.Random(args.seed))
+        rows.append(('adaptive (%d shots)' % len(periods), periods))
+
+    modes = ['always-on', 'light-sleep', 'battery', 'deep-sleep']
+    print('mA.s per sample / average mA / battery life (days, %g mAh), awake %g ms per sample' % (args.capacity, args.awake))
+    print('%-22s' % '' + ''.join('%28s' % m for m in modes))
+    for name, periods in rows:
+        cells = []
+        for mode in modes:
+            total = sum(sum(sample_charge(c, mode, p, args.awake, args.reconnect)) for p in periods)
+            per_sample = total / len(periods) / 1e6
+            average_ma = total / sum(periods) / 1000.0
+            cells.append('%9.2f %8.3f %8.1f' % (per_sample, average_ma, args.capacity / average_ma / 24.0))
+        print('%-22s' % name + ''.join('%28s' % cell for cell in cells))
+    print('light-sleep: battery mode with the sensor kept idle, battery: sensor sleeps when should_sleep_sensor() (period > %.0f s)' %
+          next(p / 1000.0 for p in range(10000, 3600000, 1000) if should_sleep_sensor(c, p)))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+# simulate_filter.py
+# purpose: replay a recorded or synthetic trace through the measurement filter (CMeasurementFilter) and count published updates
+# usage: python3 simulate_filter.py trace.csv [--mode ema|kalman|off] [--window 3] [--alpha 50] [--gate 30]
+#        python3 simulate_filter.py --synthetic [--hours 24] [--spikes 0.005] [--export trace.csv]
+# trace.csv: output of "matter sensor history raw <seconds> csv" (timestamp,co2,temperature,humidity)
+# integer arithmetic mirrors main/src/system/filter.cpp, keep both in sync
+
+import argparse
+import math
+import os
+import random
+import re
+import sys
+
+from simulate_sampling import load_trace, synthetic_trace
+
+HEADER_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'main', 'include', 'system', 'filter.h')
+RE_DEFINE = re.compile(r'#define\s+(FILTER_\w+)\s+(\d+)')
+
+MODES = {'off': 0, 'ema': 1, 'kalman': 2}
+# name, gate_min_dev, kalman_q, kalman_r, median, follow_dev (filter.cpp channel_params)
+CHANNELS = [
+    ('co2', 50, 4 * 256, 100 * 256, True, 0),
+    ('temperature', 100, 4 * 256, 100 * 256, True, 0),
+    ('humidity', 500, 100 * 256, 2500 * 256, False, 40),
+]
+
+
+def load_constants(path):
+    constants = {}
+    with open(path) as f:
+        for line in f:
+            m = RE_DEFINE.match(line.strip())
+            if m:
+                constants[m.group(1)] = int(m.group(2))
+    return constants
+
+
+def c_div(a, b):
+    # C integer division truncates toward zero
+    q = abs(a) // abs(b)
+    return q if (a >= 0) == (b >= 0) else -q
+
+
+def median(values):
+    s = sorted(values)
+    n = len(s)
+    if n & 1:
+        return s[n // 2]
+    return c_div(s[n // 2 - 1] + s[n // 2], 2)
+
+
+class Channel:
+    def __init__(self, c, param, mode, window, alpha, gate):
+        self.c = c
+        self.name, self.min_dev, self.q, self.r, self.use_median, self.follow_dev = param
+        self.mode, self.window, self.alpha, self.gate = mode, window, alpha, gate
+        self.values = []
+        self.rejects = 0
+        self.initialized = False
+        self.estimate = 0
+        self.variance = 0
+        self.last_raw = self.last_output = 0
+        self.raw_changes = self.output_changes = self.outliers = self.level_changes = 0
+
+    def push(self, value):
+        self.values.append(value)
+        if len(self.values) > self.window:
+            self.values.pop(0)
+
+    def is_outlier(self, value):
+        if self.gate == 0 or len(self.values) < 3:
+            return False
+        center = median(self.values)
+        mad = median([abs(v - center) for v in self.values])
+        threshold = max(c_div(self.gate * mad * self.c['FILTER_MAD_SCALE'], 10000), self.min_dev)
+        return abs(value - center) > threshold
+
+    def smooth(self, value):
+        error = value * 256 - self.estimate
+        if self.follow_dev and abs(error) > self.follow_dev * 256:
+            self.level_changes += 1
+            self.estimate = value * 256
+            self.variance = self.r
+            return value
+        if self.mode == MODES['kalman']:
+            p = self.variance + self.q
+            innovation = (error * error) >> 8
+            if innovation > 9 * (p + self.r):
+                p = min(innovation, 0x7FFFFFFF // 2)
+            gain = (p << 16) // (p + self.r)
+            self.estimate += (error * gain) >> 16
+            self.variance = (p * (65536 - gain)) >> 16
+        else:
+            self.estimate += (error * self.alpha) >> 16
+        return (self.estimate + 128) >> 8
+
+    def process(self, value):
+        if not self.initialized:
+            self.push(value)
+            self.estimate = value * 256
+            self.variance = self.r
+            self.last_raw = self.last_output = value
+            self.initialized = True
+            self.raw_changes += 1
+            self.output_changes += 1
+            return value
+        if value != self.last_raw:
+            self.raw_changes += 1
+        self.last_raw = value
+        if self.mode == MODES['off']:
+            output = value
+        elif not self.use_median:
+            output = self.smooth(value)
+        elif self.is_outlier(value):
+            self.rejects += 1
+            if self.rejects < self.c['FILTER_REJECT_LIMIT']:
+                self.outliers += 1
+                return self.last_output
+            self.level_changes += 1
+            self.values = []
+            self.rejects = 0
+            self.push(value)
+            self.estimate = value * 256
+            self.variance = self.r
+            output = value
+        else:
+            self.rejects = 0
+            self.push(value)
+            output = self.smooth(median(self.values))
+        if output != self.last_output:
+            self.output_changes += 1
+        self.last_output = output
+        return output
+
+
+def main():
+    parser = argparse.ArgumentParser(description='measurement filter replay')
+    parser.add_argument('trace', nargs='?', help='history raw csv export')
+    parser.add_argument('--synthetic', action='store_true', help='generate a trace with sensor noise and spikes')
+    parser.add_argument('--hours', type=float, default=24.0, help='synthetic trace length')
+    parser.add_argument('--period', type=float, default=10.0, help='synthetic sampling period (sec)')
+    parser.add_argument('--spikes', type=float, default=0.005, help='synthetic CO2 spike probability per sample')
+    parser.add_argument('--mode', choices=MODES.keys(), default='ema')
+    parser.add_argument('--window', type=int, default=3)
+    parser.add_argument('--alpha', type=int, default=50, help='EMA weight of the newest sample (%%)')
+    parser.add_argument('--gate', type=int, default=30, help='outlier gate (x0.1 MAD), 0: disabled')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--export', help='write the synthetic samples as a history raw csv (test/data/filter_trace.csv)')
+    args = parser.parse_args()
+
+    c = load_constants(HEADER_PATH)
+    truth = None
+    if args.synthetic:
+        times, co2, humidity, rnd = synthetic_trace(args.hours, args.seed)
+        step = int(args.period)
+        truth = [(co2[i], 2300.0, humidity[i] * 100.0) for i in range(0, len(times), step)]
+        samples = []
+        for t_co2, t_temp, t_hum in truth:
+            value = t_co2 + rnd.gauss(0.0, 5.0)
+            if rnd.random() < args.spikes:
+                value += rnd.uniform(150.0, 400.0)
+            samples.append((int(round(value)), int(round(t_temp + rnd.gauss(0.0, 3.0))), int(round(t_hum + rnd.gauss(0.0, 10.0)))))
+        if args.export:
+            with open(args.export, 'w') as f:
+                f.write('timestamp,co2,temperature,humidity\n')
+                for i, (s_co2, s_temp, s_hum) in enumerate(samples):
+                    f.write('%d,%d,%.2f,%.2f\n' % (i * step, s_co2, s_temp / 100.0, s_hum / 100.0))
+                f.write('# %d records\n' % len(samples))
+    elif args.trace:
+        times, co2, humidity = load_trace(args.trace)
+        temperature = []
+        with open(args.trace) as f:
+            for line in f:
+                fields = line.strip().split(',')
+                if len(fields) >= 4 and not line.startswith(('#', 'timestamp')):
+                    temperature.append(float(fields[2]))
+        samples = [(int(round(co2[i])), int(round(temperature[i] * 100.0)), int(round(humidity[i] * 100.0))) for i in range(len(times))]
+    else:
+        parser.error('trace file or --synthetic is required')
+
+    window = max(1, min(args.window, c['FILTER_WINDOW_MAX'])) | 1
+    alpha = (max(1, min(args.alpha, 100)) * 65536 + 50) // 100
+    channels = [Channel(c, param, MODES[args.mode], window, alpha, args.gate) for param in CHANNELS]
+    outputs = [[channels[i].process(sample[i]) for i in range(3)] for sample in samples]
+
+    print('samples: %d, mode: %s, window: %d, alpha: %d%%, gate: %.1f MAD' % (len(samples), args.mode, window, args.alpha, args.gate / 10.0))
+    print('%-12s %12s %12s %10s %10s' % ('', 'unfiltered', 'published', 'outliers', 'levels'))
+    for ch in channels:
+        print('%-12s %12d %12d %10d %10d' % (ch.name, ch.raw_changes, ch.output_changes, ch.outliers, ch.level_changes))
+    if truth:
+        for i, name in enumerate(['co2', 'temperature', 'humidity']):
+            raw = [s[i] - t[i] for s, t in zip(samples, truth)]
+            out = [o[i] - t[i] for o, t in zip(outputs, truth)]
+            rmse = lambda e: math.sqrt(sum(x * x for x in e) / len(e))
+            print('%-12s rmse raw %8.2f filtered %8.2f, max raw %8.1f filtered %8.1f' % (name, rmse(raw), rmse(out),
+                  max(abs(x) for x in raw), max(abs(x) for x in out)))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+# simulate_sampling.py
+# purpose: compare adaptive single shot sampling (CAdaptiveSampler) with fixed rate sampling on a recorded or synthetic trace
+# usage: python3 simulate_sampling.py trace.csv [--fixed 10] [--min 5] [--max 60]
+#        python3 simulate_sampling.py --synthetic [--hours 24]
+# trace.csv: output of "matter sensor history raw <seconds> csv" (timestamp,co2,temperature,humidity)
+# controller constants are read from main/include/system/sampler.h so that the model follows the firmware
+
+import argparse
+import bisect
+import math
+import os
+import random
+import re
+import sys
+
+HEADER_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'main', 'include', 'system', 'sampler.h')
+RE_DEFINE = re.compile(r'#define\s+(SAMPLER_\w+)\s+([0-9.]+)f?')
+
+SINGLE_SHOT_MS = 5000       # sensor is measuring (on) for this long after each shot
+READY_POLL_MS = 150         # measurement task polls data ready every 100 ms + 50 ms loop delay
+TRANSACTIONS_PER_POLL = 1   # get_data_ready_status (write and read)
+TRANSACTIONS_PER_SHOT = 2   # measure_single_shot + read_measurement
+
+
+def load_constants(path):
+    constants = {}
+    with open(path) as f:
+        for line in f:
+            m = RE_DEFINE.match(line.strip())
+            if m:
+                constants[m.group(1)] = float(m.group(2))
+    return constants
+
+
+def load_trace(path):
+    times, co2, humidity = [], [], []
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith('#') or line.startswith('timestamp'):
+                continue
+            fields = line.split(',')
+            if len(fields) < 4:
+                continue
+            times.append(float(fields[0]))
+            co2.append(float(fields[1]))
+            humidity.append(float(fields[3]))
+    if len(times) < 2:
+        sys.exit('trace has less than 2 samples')
+    t0 = times[0]
+    return [t - t0 for t in times], co2, humidity
+
+
+def synthetic_trace(hours, seed):
+    # occupancy build-up, window opening and a shower, 1 sec resolution
+    rnd = random.Random(seed)
+    times, co2, humidity = [], [], []
+    level, rh = 450.0, 45.0
+    for t in range(int(hours * 3600)):
+        hour = (t / 3600.0) % 24
+        occupied = 8 <= hour < 12 or 13 <= hour < 18 or 20 <= hour < 23
+        window = 12 <= hour < 12.25 or 18 <= hour < 18.2
+        target = 1400.0 if occupied else 450.0
+        tau = 180.0 if window else 1800.0
+        if window:
+            target = 420.0
+        level += (target - level) / tau
+        rh_target = 85.0 if 7 <= hour < 7.2 else 45.0
+        rh += (rh_target - rh) / (120.0 if rh_target > rh else 900.0)
+        times.append(float(t))
+        co2.append(level)
+        humidity.append(rh)
+    return times, co2, humidity, rnd
+
+
+class Truth:
+    def __init__(self, times, co2, humidity):
+        self.times, self.co2, self.humidity = times, co2, humidity
+
+    def at(self, t):
+        i = bisect.bisect_right(self.times, t)
+        if i <= 0:
+            return self.co2[0], self.humidity[0]
+        if i >= len(self.times):
+            return self.co2[-1], self.humidity[-1]
+        t0, t1 = self.times[i - 1], self.times[i]
+        w = (t - t0) / (t1 - t0) if t1 > t0 else 0.0
+        return (self.co2[i - 1] + w * (self.co2[i] - self.co2[i - 1]),
+                self.humidity[i - 1] + w * (self.humidity[i] - self.humidity[i - 1]))
+
+
+class AdaptiveSampler:
+    # mirror of CAdaptiveSampler::update()
+    def __init__(self, c, min_ms, max_ms):
+        self.c = c
+        self.min_ms, self.max_ms = min_ms, max_ms
+        self.period = min_ms
+        self.prev = None
+        self.co2_rate = 0.0
+        self.humidity_rate = 0.0
+
+    def filter_rate(self, rate, current):
+        if rate >= current:
+            return rate
+        return current + self.c['SAMPLER_RATE_DECAY'] * (rate - current)
+
+    def update(self, co2, humidity, now_ms):
+        period = self.period
+        if self.prev is not None and now_ms > self.prev[2]:
+            dt = (now_ms - self.prev[2]) / 1000.0
+            co2_delta = abs(co2 - self.prev[0]) - self.c['SAMPLER_CO2_NOISE_PPM']
+            humidity_delta = abs(humidity - self.prev[1]) - self.c['SAMPLER_HUMIDITY_NOISE']
+            self.co2_rate = self.filter_rate(co2_delta / dt if co2_delta > 0 else 0.0, self.co2_rate)
+            self.humidity_rate = self.filter_rate(humidity_delta / dt if humidity_delta > 0 else 0.0, self.humidity_rate)
+            target = float(self.max_ms)
+            if self.co2_rate > 0:
+                target = min(target, self.c['SAMPLER_CO2_STEP_PPM'] / self.co2_rate * 1000.0)
+            if self.humidity_rate > 0:
+                target = min(target, self.c['SAMPLER_HUMIDITY_STEP'] / self.humidity_rate * 1000.0)
+            if target >= period:
+                target = min(target, period * self.c['SAMPLER_BACKOFF_RATIO'])
+            period = int(max(target, self.min_ms))
+        self.period = min(max(period, self.min_ms), self.max_ms)
+        self.prev = (co2, humidity, now_ms)
+        return self.period
+
+
+def simulate(truth, duration_ms, next_period, noise, rnd):
+    # measurement task: shot at t, data read at t + 5 s, next shot at t + period
+    samples = []
+    t = 0
+    while t + SINGLE_SHOT_MS <= duration_ms:
+        read_ms = t + SINGLE_SHOT_MS
+        co2, humidity = truth.at(read_ms / 1000.0)
+        co2 = round(co2 + rnd.gauss(0.0, noise))
+        humidity = humidity + rnd.gauss(0.0, noise / 100.0)
+        samples.append((read_ms, co2, humidity))
+        t += max(next_period(co2, humidity, read_ms), SINGLE_SHOT_MS)
+    return samples
+
+
+def evaluate(truth, samples, duration_ms):
+    # published value is held until the next sample (matter attribute), compared against the trace every second
+    co2_sq = humidity_sq = 0.0
+    co2_max = humidity_max = 0.0
+    count = 0
+    index = 0
+    for t_ms in range(samples[0][0], duration_ms, 1000):
+        while index + 1 < len(samples) and samples[index + 1][0] <= t_ms:
+            index += 1
+        co2, humidity = truth.at(t_ms / 1000.0)
+        e_co2 = samples[index][1] - co2
+        e_humidity = samples[index][2] - humidity
+        co2_sq += e_co2 * e_co2
+        humidity_sq += e_humidity * e_humidity
+        co2_max = max(co2_max, abs(e_co2))
+        humidity_max = max(humidity_max, abs(e_humidity))
+        count += 1
+    polls = math.ceil(SINGLE_SHOT_MS / READY_POLL_MS)
+    return {
+        'shots': len(samples),
+        'on_s': len(samples) * SINGLE_SHOT_MS / 1000.0,
+        'i2c': len(samples) * (TRANSACTIONS_PER_SHOT + polls * TRANSACTIONS_PER_POLL),
+        'co2_rmse': math.sqrt(co2_sq / count) if count else 0.0,
+        'co2_max': co2_max,
+        'hum_rmse': math.sqrt(humidity_sq / count) if count else 0.0,
+        'hum_max': humidity_max,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description='adaptive sampling simulation')
+    parser.add_argument('trace', nargs='?', help='history raw csv export')
+    parser.add_argument('--synthetic', action='store_true', help='generate an occupancy/window/shower trace')
+    parser.add_argument('--hours', type=float, default=24.0, help='synthetic trace length')
+    parser.add_argument('--fixed', type=float, default=10.0, help='fixed sampling period (sec)')
+    parser.add_argument('--min', type=float, default=None, help='adaptive min period (sec)')
+    parser.add_argument('--max', type=float, default=None, help='adaptive max period (sec)')
+    parser.add_argument('--noise', type=float, default=5.0, help='sensor noise, CO2 ppm (humidity: 1/100 of it)')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    c = load_constants(HEADER_PATH)
+    if args.synthetic:
+        times, co2, humidity, rnd = synthetic_trace(args.hours, args.seed)
+    elif args.trace:
+        times, co2, humidity = load_trace(args.trace)
+        rnd = random.Random(args.seed)
+        args.noise = 0.0    # recorded values are already noisy
+    else:
+        parser.error('trace file or --synthetic is required')
+    truth = Truth(times, co2, humidity)
+    duration_ms = int(times[-1] * 1000)
+    min_ms = int(args.min * 1000) if args.min else int(c['SAMPLER_PERIOD_MIN_MS'])
+    max_ms = int(args.max * 1000) if args.max else int(c['SAMPLER_PERIOD_MAX_MS'])
+
+    fixed_ms = int(args.fixed * 1000)
+    sampler = AdaptiveSampler(c, min_ms, max_ms)
+    results = [
+        ('fixed %g s' % args.fixed, evaluate(truth, simulate(truth, duration_ms, lambda *_: fixed_ms, args.noise, random.Random(args.seed)), duration_ms)),
+        ('adaptive %g~%g s' % (min_ms / 1000, max_ms / 1000), evaluate(truth, simulate(truth, duration_ms, sampler.update, args.noise, random.Random(args.seed)), duration_ms)),
+    ]
+
+    print('trace: %.1f h, %d points' % (duration_ms / 3600000.0, len(times)))
+    print('%-20s %8s %10s %8s %10s %10s %10s %10s' % ('', 'shots', 'on (s)', 'duty', 'i2c', 'co2 rmse', 'co2 max', 'rh rmse'))
+    for name, r in results:
+        print('%-20s %8d %10.0f %7.1f%% %10d %10.1f %10.1f %10.2f' % (name, r['shots'], r['on_s'], r['on_s'] * 100000.0 / duration_ms,
+              r['i2c'], r['co2_rmse'], r['co2_max'], r['hum_rmse']))
+
+
+if __name__ == '__main__':
+    main()
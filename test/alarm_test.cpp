@@ -0,0 +1,331 @@
+// alarm_test.cpp
+// purpose: CO2 alarm transitions of CAlarmEngine (main/src/system/alarm.cpp) with hold time and hysteresis on a virtual clock,
+//          and migration of version 3 / 4 configuration records (CConfig, main/src/system/config.cpp) to the alarm fields
+// usage: make -C test build/alarm_test && test/build/alarm_test
+
+#include "alarm.h"
+#include "config.h"
+#include "definition.h"
+#include "nvs.h"
+#include "esp_rom_crc.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#define TEST_PERIOD_S       10          // one published sample per measurement period
+
+static int64_t virtual_us = 0;
+static int failures = 0;
+
+int64_t esp_timer_get_time()
+{
+    return virtual_us;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+/* nvs: one in-memory namespace */
+static std::map<std::string, std::vector<uint8_t>> nvs_blobs;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    auto it = nvs_blobs.find(key);
+    if (it == nvs_blobs.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (out_value) {
+        if (*length < it->second.size())
+            return ESP_ERR_INVALID_SIZE;
+        memcpy(out_value, it->second.data(), it->second.size());
+    }
+    *length = it->second.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    nvs_blobs[key].assign((const uint8_t *)value, (const uint8_t *)value + length);
+    return ESP_OK;
+}
+
+static void expect(const char *what, int64_t actual, int64_t expected)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (expected %" PRId64 ")\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+/**
+ * @brief counters of print_status(), the engine has no other accessor for them
+ */
+static int64_t alarm_stat(CAlarmEngine *alarm, const char *key)
+{
+    FILE *tmp = tmpfile();
+    char line[256];
+    int64_t value = -1;
+
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(tmp), STDOUT_FILENO);
+    alarm->print_status();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    rewind(tmp);
+    while (fgets(line, sizeof(line), tmp)) {
+        uint32_t samples, raised, cleared, debounced;
+        if (sscanf(line, "samples: %" SCNu32 ", raised: %" SCNu32 ", cleared: %" SCNu32 ", debounced: %" SCNu32,
+                &samples, &raised, &cleared, &debounced) == 4) {
+            value = strcmp(key, "raised") == 0 ? raised : strcmp(key, "cleared") == 0 ? cleared : debounced;
+        }
+    }
+    fclose(tmp);
+    return value;
+}
+
+/**
+ * @brief feeds value for duration_s, returns the number of transitions, *at_s: seconds into the run of the last one
+ */
+static int feed(CAlarmEngine *alarm, int32_t co2ppm, int duration_s, int *at_s = nullptr)
+{
+    int transitions = 0;
+    for (int t = 0; t < duration_s; t += TEST_PERIOD_S) {
+        if (alarm->process(co2ppm, virtual_us)) {
+            transitions++;
+            if (at_s) {
+                *at_s = t;
+            }
+        }
+        virtual_us += TEST_PERIOD_S * 1000000LL;
+    }
+    return transitions;
+}
+
+static void test_hold()
+{
+    fprintf(stderr, "-- hold time (threshold 1500, hysteresis 100, hold 60 s)\n");
+    CAlarmEngine alarm;
+    alarm.configure(1500, 100, 60);
+    int at_s = -1;
+
+    feed(&alarm, 800, 300);
+    expect("below threshold", alarm.is_active(), false);
+    expect("raised after the hold time", feed(&alarm, 1600, 120, &at_s), 1);
+    expect("raised at (s)", at_s, 60);
+    expect("active", alarm.is_active(), true);
+    expect("cleared after the hold time", feed(&alarm, 1000, 120, &at_s), 1);
+    expect("cleared at (s)", at_s, 60);
+    expect("active", alarm.is_active(), false);
+
+    // crossings shorter than the hold time are debounced in both directions
+    expect("50 s above threshold", feed(&alarm, 1600, 50), 0);
+    expect("back below", feed(&alarm, 1000, 60), 0);
+    feed(&alarm, 1600, 120);
+    expect("50 s below the clear level", feed(&alarm, 1000, 50), 0);
+    expect("back above", feed(&alarm, 1600, 60), 0);
+    expect("active", alarm.is_active(), true);
+    expect("raised", alarm_stat(&alarm, "raised"), 2);
+    expect("cleared", alarm_stat(&alarm, "cleared"), 1);
+    expect("debounced", alarm_stat(&alarm, "debounced"), 2);
+}
+
+static void test_hysteresis()
+{
+    fprintf(stderr, "-- hysteresis\n");
+    CAlarmEngine alarm;
+    alarm.configure(1500, 100, 60);
+
+    // noise around the threshold: no sample run lasts the hold time
+    int transitions = 0;
+    for (int i = 0; i < 360; i++) {
+        transitions += feed(&alarm, i % 3 ? 1510 : 1490, TEST_PERIOD_S);
+    }
+    expect("noise around the threshold, transitions", transitions, 0);
+
+    feed(&alarm, 1600, 120);
+    expect("active", alarm.is_active(), true);
+    // between the clear level (1400) and the threshold the alarm stays active without a pending clear
+    expect("1450 ppm for an hour", feed(&alarm, 1450, 3600), 0);
+    expect("active", alarm.is_active(), true);
+    expect("exactly at the clear level", feed(&alarm, 1400, 600), 0);
+    expect("below the clear level", feed(&alarm, 1399, 120), 1);
+    expect("active", alarm.is_active(), false);
+    expect("exactly at the threshold", feed(&alarm, 1500, 120), 1);
+}
+
+static void test_configure()
+{
+    fprintf(stderr, "-- configuration changes\n");
+    CAlarmEngine alarm;
+
+    alarm.configure(1500, 100, 0);
+    expect("hold 0: raised on the first sample", feed(&alarm, 1500, TEST_PERIOD_S), 1);
+    expect("disabling an active alarm clears it", alarm.configure(0, 100, 60), true);
+    expect("active", alarm.is_active(), false);
+    expect("disabled: no transitions", feed(&alarm, 5000, 600), 0);
+
+    alarm.configure(1000, 1000, 0);
+    feed(&alarm, 1200, TEST_PERIOD_S);
+    expect("hysteresis >= threshold is ignored", feed(&alarm, 999, TEST_PERIOD_S), 1);
+
+    alarm.configure(1000, 100, 60);
+    feed(&alarm, 1200, 120);
+    feed(&alarm, 500, 30);
+    alarm.configure(1000, 100, 60);
+    expect("a pending clear restarts with the new settings", feed(&alarm, 500, 50), 0);
+    expect("active", alarm.is_active(), true);
+    expect("cleared after a full hold time", feed(&alarm, 500, 20), 1);
+}
+
+/**
+ * @brief version 3 record: the layout before the alarm fields, ends in padding where alarm_co2_ppm starts
+ */
+typedef struct {
+    uint32_t measure_period_ms;
+    uint8_t measure_mode;
+    uint8_t adaptive_sampling;
+    uint8_t i2c_gpio_scl;
+    uint8_t i2c_gpio_sda;
+    uint32_t i2c_freq;
+    uint32_t adaptive_min_ms;
+    uint32_t adaptive_max_ms;
+    uint16_t co2_min_ppm;
+    uint16_t co2_max_ppm;
+    uint8_t filter_mode;
+    uint8_t filter_window;
+    uint8_t filter_alpha;
+    uint8_t filter_gate;
+    uint8_t power_mode;
+} config_v3_t;
+
+static void store_record(uint16_t version, const void *payload, size_t size)
+{
+    std::vector<uint8_t> blob(sizeof(config_header_t) + size);
+    config_header_t header = {CONFIG_MAGIC, version, (uint16_t)size, 0, esp_rom_crc32_le(0, (const uint8_t *)payload, size)};
+
+    memcpy(blob.data(), &header, sizeof(header));
+    memcpy(blob.data() + sizeof(header), payload, size);
+    nvs_blobs["system"] = blob;
+}
+
+static uint16_t stored_version()
+{
+    config_header_t header;
+    memcpy(&header, nvs_blobs["system"].data(), sizeof(header));
+    return header.version;
+}
+
+static void test_migration()
+{
+    fprintf(stderr, "-- version 3 record with non-zero padding\n");
+    uint8_t raw[sizeof(config_v3_t)];
+    config_v3_t v3;
+    memset(raw, 0xA5, sizeof(raw));
+    memcpy(&v3, raw, sizeof(v3));
+    v3.measure_period_ms = 30000;
+    v3.measure_mode = 0;
+    v3.adaptive_sampling = 1;
+    v3.i2c_gpio_scl = 4;
+    v3.i2c_gpio_sda = 5;
+    v3.i2c_freq = 100000;
+    v3.adaptive_min_ms = 10000;
+    v3.adaptive_max_ms = 120000;
+    v3.co2_min_ppm = 400;
+    v3.co2_max_ppm = 5000;
+    v3.filter_mode = 2;
+    v3.filter_window = 5;
+    v3.filter_alpha = 30;
+    v3.filter_gate = 40;
+    v3.power_mode = 1;
+    expect("padding overlaps alarm_co2", sizeof(config_v3_t) > offsetof(system_config_t, alarm_co2_ppm), true);
+    store_record(3, &v3, sizeof(v3));
+
+    CConfig config;
+    config.initialize();
+    system_config_t c;
+    config.get(&c);
+    expect("period", c.measure_period_ms, 30000);
+    expect("adaptive", c.adaptive_sampling, 1);
+    expect("i2c", c.i2c_gpio_scl * 100 + c.i2c_gpio_sda, 405);
+    expect("adaptive max", c.adaptive_max_ms, 120000);
+    expect("co2 max", c.co2_max_ppm, 5000);
+    expect("filter gate", c.filter_gate, 40);
+    expect("power", c.power_mode, 1);
+    expect("alarm_co2 (default, not padding)", c.alarm_co2_ppm, ALARM_CO2_THRESHOLD_PPM);
+    expect("alarm_hyst", c.alarm_hyst_ppm, ALARM_CO2_HYSTERESIS_PPM);
+    expect("alarm_hold", c.alarm_hold_s, ALARM_HOLD_S);
+    expect("range_window", c.range_window, 0);
+    expect("record rewritten as", stored_version(), CONFIG_VERSION);
+
+    fprintf(stderr, "-- version 4 record\n");
+    system_config_t v4;
+    memcpy(&v4, &c, sizeof(v4));
+    v4.alarm_co2_ppm = 2000;
+    v4.alarm_hyst_ppm = 250;
+    v4.alarm_hold_s = 300;
+    store_record(4, &v4, offsetof(system_config_t, range_window));
+    CConfig config4;
+    config4.initialize();
+    config4.get(&c);
+    expect("alarm_co2", c.alarm_co2_ppm, 2000);
+    expect("alarm_hyst", c.alarm_hyst_ppm, 250);
+    expect("alarm_hold", c.alarm_hold_s, 300);
+    expect("range_window (default)", c.range_window, 0);
+    expect("record rewritten as", stored_version(), CONFIG_VERSION);
+
+    fprintf(stderr, "-- version 3 record with an inconsistent value\n");
+    v3.filter_window = 4;
+    store_record(3, &v3, sizeof(v3));
+    CConfig config_bad;
+    config_bad.initialize();
+    config_bad.get(&c);
+    expect("defaults used", c.measure_period_ms, MEASURE_PERIOD_MS);
+    expect("record kept", stored_version(), 3);
+}
+
+int main()
+{
+    // log lines (drain task) go to stdout, results to stderr
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+
+    test_hold();
+    test_hysteresis();
+    test_configure();
+    test_migration();
+
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,505 @@
+// console_test.cpp
+// purpose: argument parsing of the "matter sensor|log|i2c|config ..." console commands (CConsole handlers and parse_long)
+//          through the registered command tables, with the configuration (CConfig) and the statistics modules linked in
+//          and the modules that own hardware (measurement task, history, crash log, I2C) replaced by call recorders
+// usage: make -C test console_test && test/build/console_test
+
+#include "console.h"
+#include "system.h"
+#include "history.h"
+#include "crashlog.h"
+#include "supervisor.h"
+#include "compensation.h"
+#include "calibration.h"
+#include "power.h"
+#include "i2cdetector.h"
+#include "config.h"
+#include "alarm.h"
+#include "definition.h"
+#include "nvs.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include <esp_matter_console.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+
+static std::string calls;           // calls into the replaced modules, "name(args);"
+static int failures = 0;
+
+static void record(const char *format, ...)
+{
+    char buffer[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    calls += buffer;
+    calls += ";";
+}
+
+int64_t esp_timer_get_time()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+/* nvs: one in-memory namespace */
+static std::map<std::string, std::vector<uint8_t>> nvs_blobs;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    auto it = nvs_blobs.find(key);
+    if (it == nvs_blobs.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (out_value) {
+        if (*length < it->second.size())
+            return ESP_ERR_INVALID_SIZE;
+        memcpy(out_value, it->second.data(), it->second.size());
+    }
+    *length = it->second.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    nvs_blobs[key].assign((const uint8_t *)value, (const uint8_t *)value + length);
+    return ESP_OK;
+}
+
+/* esp-matter console: the engine dispatches argv[0] and passes the rest to the handler */
+static esp_matter::console::engine root_console;
+
+void esp_matter::console::engine::for_each_command(command_iterator_t *on_command, void *arg)
+{
+    for (unsigned i = 0; i < _command_set_count; i++) {
+        for (unsigned j = 0; j < _command_set_size[i]; j++) {
+            on_command(&_command_set[i][j], arg);
+        }
+    }
+}
+
+esp_err_t esp_matter::console::engine::exec_command(int argc, char *argv[])
+{
+    for (unsigned i = 0; i < _command_set_count; i++) {
+        for (unsigned j = 0; j < _command_set_size[i]; j++) {
+            if (strcmp(argv[0], _command_set[i][j].name) == 0 && _command_set[i][j].handler) {
+                return _command_set[i][j].handler(argc - 1, &argv[1]);
+            }
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_matter::console::engine::register_commands(const command_t *command_set, unsigned count)
+{
+    if (_command_set_count >= CONSOLE_MAX_COMMANDS_SUPPORTED)
+        return ESP_FAIL;
+    _command_set[_command_set_count] = command_set;
+    _command_set_size[_command_set_count] = count;
+    _command_set_count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_matter::console::add_commands(const command_t *command, uint8_t count)
+{
+    return root_console.register_commands(command, count);
+}
+
+esp_err_t esp_matter::console::diagnostics_register_commands()
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_matter::console::init()
+{
+    return ESP_OK;
+}
+
+/* modules owning hardware or the measurement task */
+CSystem::CSystem()
+{
+    m_measure_mode = MeasureModeSingleShot;
+}
+
+CSystem::~CSystem()
+{
+}
+
+CSystem* CSystem::Instance()
+{
+    static CSystem instance;
+    return &instance;
+}
+
+bool CSystem::post_request(eSystemRequestType type, int32_t arg)
+{
+    record("post_request(%d,%" PRId32 ")", type, arg);
+    return true;
+}
+
+uint32_t CSystem::get_single_shot_period_ms()
+{
+    return MEASURE_PERIOD_MS;
+}
+
+void CSystem::print_measurement_stats()
+{
+    record("print_measurement_stats()");
+}
+
+void CSystem::reset_measurement_stats()
+{
+    record("reset_measurement_stats()");
+}
+
+#define FAKE_SINGLETON(cls) \
+    cls::cls() {} \
+    cls::~cls() {} \
+    cls* cls::Instance() { static cls instance; return &instance; }
+
+FAKE_SINGLETON(CHistory)
+FAKE_SINGLETON(CCrashLog)
+FAKE_SINGLETON(CHealthSupervisor)
+FAKE_SINGLETON(CCompensation)
+FAKE_SINGLETON(CCalibration)
+FAKE_SINGLETON(CPowerManager)
+FAKE_SINGLETON(CI2CDetector)
+FAKE_SINGLETON(CI2CMaster)
+
+uint32_t CHistory::get_timestamp()
+{
+    return 100000;
+}
+
+size_t CHistory::query_samples(uint32_t ts_from, uint32_t ts_to, history_sample_cb_t callback, void *arg)
+{
+    record("query_samples(%" PRIu32 ",%" PRIu32 ")", ts_from, ts_to);
+    return 0;
+}
+
+size_t CHistory::query_buckets(eHistoryTier tier, uint32_t ts_from, uint32_t ts_to, history_bucket_cb_t callback, void *arg)
+{
+    record("query_buckets(%d,%" PRIu32 ",%" PRIu32 ")", tier, ts_from, ts_to);
+    return 0;
+}
+
+bool CCrashLog::clear()
+{
+    record("crash_clear()");
+    return true;
+}
+
+size_t CCrashLog::print(bool current)
+{
+    record("crash_print(%d)", current);
+    return 0;
+}
+
+void CHealthSupervisor::print_status()
+{
+    record("health_print()");
+}
+
+void CHealthSupervisor::reset_stats()
+{
+    record("health_reset()");
+}
+
+bool CCompensation::set_temperature_offset(float offset)
+{
+    record("set_temperature_offset(%.2f)", offset);
+    return true;
+}
+
+bool CCompensation::set_altitude(uint16_t altitude)
+{
+    record("set_altitude(%u)", altitude);
+    return true;
+}
+
+bool CCompensation::set_ambient_pressure(float pressure_hpa)
+{
+    record("set_ambient_pressure(%.1f)", pressure_hpa);
+    return true;
+}
+
+void CCompensation::print_status()
+{
+    record("compensation_print()");
+}
+
+bool CCalibration::set_auto_calibration(bool enabled)
+{
+    record("set_auto_calibration(%d)", enabled);
+    return true;
+}
+
+void CCalibration::print_status()
+{
+    record("calibration_print()");
+}
+
+void CPowerManager::print_status(uint32_t capacity_mah)
+{
+    record("power_print(%" PRIu32 ")", capacity_mah);
+}
+
+void CPowerManager::reset_stats()
+{
+    record("power_reset()");
+}
+
+void CI2CDetector::print()
+{
+    record("i2c_detector_print()");
+}
+
+void CI2CMaster::print_stats()
+{
+    record("i2c_print()");
+}
+
+void CI2CMaster::reset_stats()
+{
+    record("i2c_reset()");
+}
+
+void CI2CMaster::write_stats_json(CJsonWriter *writer)
+{
+    record("i2c_json()");
+}
+
+/**
+ * @brief splits the line on spaces (no quoting) and runs it as "matter <line>"
+ */
+static esp_err_t run(const char *line)
+{
+    std::vector<std::string> words;
+    std::vector<char *> argv;
+    std::string word;
+
+    for (const char *p = line;; p++) {
+        if (*p == ' ' || *p == '\0') {
+            if (!word.empty()) {
+                words.push_back(word);
+            }
+            word.clear();
+            if (*p == '\0')
+                break;
+        } else {
+            word += *p;
+        }
+    }
+    for (auto &w : words) {
+        argv.push_back(&w[0]);
+    }
+    argv.push_back(nullptr);
+    calls.clear();
+    return root_console.exec_command((int)words.size(), argv.data());
+}
+
+static void expect(const char *line, esp_err_t expected, const char *expected_calls = "")
+{
+    esp_err_t ret = run(line);
+    bool ok = ret == expected && calls == expected_calls;
+    fprintf(stderr, "%-4s %-44s ret %5d (expected %5d) %s\n", ok ? "ok" : "FAIL", line, ret, expected, calls.c_str());
+    if (!ok) {
+        failures++;
+        if (calls != expected_calls) {
+            fprintf(stderr, "     calls expected: %s\n", expected_calls);
+        }
+    }
+}
+
+static void expect_config(const char *what, eConfigField field, int32_t expected)
+{
+    system_config_t config;
+    GetConfig()->get(&config);
+    int32_t actual = CConfig::get_value(&config, field);
+    fprintf(stderr, "%-4s %-44s %10" PRId32 " (expected %" PRId32 ")\n", actual == expected ? "ok" : "FAIL", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+int main()
+{
+    // handler output (status prints, command lists) goes to stdout, results to stderr
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+    GetConfig()->initialize();
+    if (!GetConsole()->initialize()) {
+        fprintf(stderr, "failed to register commands\n");
+        return 1;
+    }
+
+    fprintf(stderr, "-- dispatch\n");
+    expect("sensor", ESP_OK);
+    expect("sensor unknown", ESP_ERR_INVALID_ARG);
+    expect("log", ESP_OK);
+    expect("i2c", ESP_OK);
+    expect("config", ESP_OK);
+
+    fprintf(stderr, "-- parse_long (through sensor frc)\n");
+    expect("sensor frc 450", ESP_OK, "post_request(1,450);");
+    expect("sensor frc 0x1c2", ESP_OK, "post_request(1,450);");
+    expect("sensor frc 0700", ESP_OK, "post_request(1,448);");
+    expect("sensor frc +2000", ESP_OK, "post_request(1,2000);");
+    expect("sensor frc 399", ESP_ERR_INVALID_ARG);
+    expect("sensor frc 2001", ESP_ERR_INVALID_ARG);
+    expect("sensor frc 450ppm", ESP_ERR_INVALID_ARG);
+    expect("sensor frc 4.5e2", ESP_ERR_INVALID_ARG);
+    expect("sensor frc -", ESP_ERR_INVALID_ARG);
+    expect("sensor frc 0x", ESP_ERR_INVALID_ARG);
+    expect("sensor frc", ESP_ERR_INVALID_ARG);
+    expect("sensor frc 450 450", ESP_ERR_INVALID_ARG);
+    expect("sensor frc 99999999999999999999", ESP_ERR_INVALID_ARG);
+
+    fprintf(stderr, "-- values wider than int32_t are rejected, not truncated\n");
+    expect("config set period 4294977296", ESP_ERR_INVALID_ARG);
+    expect_config("period unchanged", ConfigFieldMeasurePeriod, MEASURE_PERIOD_MS);
+    expect("config set alarm_co2 -4294966296", ESP_ERR_INVALID_ARG);
+    expect_config("alarm_co2 unchanged", ConfigFieldAlarmCo2, ALARM_CO2_THRESHOLD_PPM);
+
+    fprintf(stderr, "-- sensor\n");
+    expect("sensor period", ESP_OK);
+    expect("sensor adaptive on", ESP_OK);
+    expect("sensor period 6000", ESP_OK);
+    expect_config("period", ConfigFieldMeasurePeriod, 6000);
+    expect_config("adaptive (turned off by a fixed period)", ConfigFieldAdaptiveSampling, 0);
+    expect("sensor period 0", ESP_ERR_INVALID_ARG);
+    expect("sensor period 1000", ESP_ERR_INVALID_ARG);
+    expect_config("period below the minimum is rejected", ConfigFieldMeasurePeriod, 6000);
+    expect("sensor period 6000 7000", ESP_ERR_INVALID_ARG);
+    expect("sensor mode periodic", ESP_OK);
+    expect_config("mode", ConfigFieldMeasureMode, MeasureModePeriodic);
+    expect("sensor mode fast", ESP_ERR_INVALID_ARG);
+    expect("sensor mode", ESP_OK);
+    expect("sensor selftest", ESP_OK, "post_request(2,0);");
+    expect("sensor stats", ESP_OK, "print_measurement_stats();");
+    expect("sensor stats reset", ESP_OK, "reset_measurement_stats();");
+    expect("sensor history raw", ESP_OK, "query_samples(96400,100000);");
+    expect("sensor history hour 200000 bin", ESP_OK, "query_buckets(2,0,100000);");
+    expect("sensor history minute 60 csv", ESP_OK, "query_buckets(1,99940,100000);");
+    expect("sensor history", ESP_ERR_INVALID_ARG);
+    expect("sensor history week", ESP_ERR_INVALID_ARG);
+    expect("sensor history raw 0", ESP_ERR_INVALID_ARG);
+    expect("sensor history raw 60 xml", ESP_ERR_INVALID_ARG);
+    expect("sensor history raw 60 csv 1", ESP_ERR_INVALID_ARG);
+    expect("sensor health", ESP_OK, "health_print();");
+    expect("sensor health reset", ESP_OK, "health_reset();");
+    expect("sensor comp", ESP_OK, "compensation_print();");
+    expect("sensor comp offset 1.5", ESP_OK, "set_temperature_offset(1.50);");
+    expect("sensor comp altitude 250", ESP_OK, "set_altitude(250);");
+    expect("sensor comp altitude -1", ESP_ERR_INVALID_ARG);
+    expect("sensor comp pressure 1013.2", ESP_OK, "set_ambient_pressure(1013.2);");
+    expect("sensor comp pressure off", ESP_OK, "set_ambient_pressure(0.0);");
+    expect("sensor comp offset off", ESP_ERR_INVALID_ARG);
+    expect("sensor comp offset 1.5C", ESP_ERR_INVALID_ARG);
+    expect("sensor comp humidity 1", ESP_ERR_INVALID_ARG);
+    expect("sensor comp offset", ESP_ERR_INVALID_ARG);
+    expect("sensor calib", ESP_OK, "calibration_print();");
+    expect("sensor calib asc on", ESP_OK, "set_auto_calibration(1);");
+    expect("sensor calib asc off", ESP_OK, "set_auto_calibration(0);");
+    expect("sensor calib asc maybe", ESP_ERR_INVALID_ARG);
+    expect("sensor calib frc on", ESP_ERR_INVALID_ARG);
+    expect("sensor adaptive on", ESP_OK);
+    expect_config("adaptive", ConfigFieldAdaptiveSampling, 1);
+    expect("sensor adaptive off", ESP_OK);
+    expect_config("adaptive", ConfigFieldAdaptiveSampling, 0);
+    expect("sensor adaptive range 10000 60000", ESP_OK);
+    expect_config("adaptive_min", ConfigFieldAdaptiveMin, 10000);
+    expect_config("adaptive_max", ConfigFieldAdaptiveMax, 60000);
+    expect("sensor adaptive range 10000", ESP_ERR_INVALID_ARG);
+    expect("sensor adaptive range 0 60000", ESP_ERR_INVALID_ARG);
+    expect("sensor adaptive range 10000 x", ESP_ERR_INVALID_ARG);
+    expect("sensor adaptive maybe", ESP_ERR_INVALID_ARG);
+    expect("sensor filter", ESP_OK);
+    expect("sensor filter 1", ESP_ERR_INVALID_ARG);
+    expect("sensor power", ESP_OK, "power_print(0);");
+    expect("sensor power 2000", ESP_OK, "power_print(2000);");
+    expect("sensor power reset", ESP_OK, "power_reset();");
+    expect("sensor power 0", ESP_ERR_INVALID_ARG);
+    expect("sensor power 2000 1", ESP_ERR_INVALID_ARG);
+    expect("sensor energy", ESP_OK);
+    expect("sensor energy json", ESP_OK);
+    expect("sensor energy current cpu 20000", ESP_OK);
+    expect("sensor energy current gps 20000", ESP_ERR_INVALID_ARG);
+    expect("sensor energy current cpu -1", ESP_ERR_INVALID_ARG);
+    expect("sensor energy current cpu", ESP_ERR_INVALID_ARG);
+    expect("sensor derived", ESP_OK);
+    expect("sensor derived 1", ESP_ERR_INVALID_ARG);
+    expect("sensor alarm", ESP_OK);
+    expect("sensor alarm reset", ESP_OK);
+    expect("sensor alarm on", ESP_ERR_INVALID_ARG);
+    expect("sensor rolling json", ESP_OK);
+    expect("sensor rolling 5min", ESP_ERR_INVALID_ARG);
+
+    fprintf(stderr, "-- log\n");
+    expect("log crash", ESP_OK, "crash_print(0);");
+    expect("log crash current", ESP_OK, "crash_print(1);");
+    expect("log crash clear", ESP_OK, "crash_clear();");
+    expect("log crash all", ESP_ERR_INVALID_ARG);
+    expect("log crash clear current", ESP_ERR_INVALID_ARG);
+
+    fprintf(stderr, "-- i2c\n");
+    expect("i2c stats", ESP_OK, "i2c_print();");
+    expect("i2c stats json", ESP_OK, "i2c_json();");
+    expect("i2c stats reset", ESP_OK, "i2c_reset();");
+    expect("i2c stats reset json", ESP_ERR_INVALID_ARG);
+    expect("i2c scan", ESP_OK, "i2c_detector_print();");
+    expect("i2c scan probe", ESP_OK, "post_request(3,0);");
+    expect("i2c scan all", ESP_ERR_INVALID_ARG);
+
+    fprintf(stderr, "-- config\n");
+    expect("config show", ESP_OK);
+    expect("config set period 20000 mode 2", ESP_OK);
+    expect_config("period", ConfigFieldMeasurePeriod, 20000);
+    expect_config("mode", ConfigFieldMeasureMode, MeasureModeLowPowerPeriodic);
+    expect("config set period 30000 mode 3", ESP_ERR_INVALID_ARG);
+    expect_config("period (items are applied together or not at all)", ConfigFieldMeasurePeriod, 20000);
+    expect("config set period", ESP_ERR_INVALID_ARG);
+    expect("config set speed 1", ESP_ERR_INVALID_ARG);
+    expect("config set period 0x7530", ESP_OK);
+    expect_config("period", ConfigFieldMeasurePeriod, 30000);
+    expect("config set", ESP_ERR_INVALID_ARG);
+    expect("config reset", ESP_OK);
+    expect_config("period after reset", ConfigFieldMeasurePeriod, MEASURE_PERIOD_MS);
+
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+// derived_test.cpp
+// purpose: fixed point dew point / absolute humidity (CDerivedChannels::calculate, main/src/system/derived.cpp)
+//          against the double precision Magnus formula (libm) over the temperature / humidity grid,
+//          per call time of both paths and the recompute-on-change rule of update()
+// usage: make -C test build/derived_test && test/build/derived_test [grid step in 0.01 units]
+
+#include "derived.h"
+#include <chrono>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define DEW_POINT_BOUND         0.010       // degC, output resolution 0.01 (rounding alone contributes up to 0.005)
+#define ABSOLUTE_HUMIDITY_BOUND 0.015       // g/m3
+#define BENCH_ROUNDS            20
+
+// (name, temperature range, humidity range) in 0.01 units, same as scripts/simulate_derived.py
+static const struct {
+    const char *name;
+    int32_t t_min, t_max;
+    int32_t rh_min, rh_max;
+} ranges[] = {
+    {"scd41 operating", -1000, 6000, 0, 10000},
+    {"indoor", 1500, 3500, 2000, 8000},
+    {"coefficients", DERIVED_TEMPERATURE_MIN, DERIVED_TEMPERATURE_MAX, 100, DERIVED_HUMIDITY_MAX},
+};
+
+static int failures = 0;
+
+static void expect(const char *what, int64_t actual, int64_t expected)
+{
+    printf("%-56s %8" PRId64 " (expected %" PRId64 ")\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+static void expect_le(const char *what, double actual, double bound)
+{
+    printf("%-56s %8.4f (bound %.4f)\n", what, actual, bound);
+    if (actual > bound) {
+        failures++;
+    }
+}
+
+static void reference(int32_t temperature, int32_t humidity, double *dew_point, double *absolute_humidity)
+{
+    double t = temperature / 100.0;
+    double rh = (humidity < DERIVED_HUMIDITY_MIN ? DERIVED_HUMIDITY_MIN : humidity) / 100.0;
+    double f = 17.62 * t / (243.12 + t);
+    double gamma = log(rh / 100.0) + f;
+
+    *dew_point = 243.12 * gamma / (17.62 - gamma);
+    *absolute_humidity = 216.7 * rh / 100.0 * 6.112 * exp(f) / (273.15 + t);
+}
+
+static void test_accuracy(int32_t step)
+{
+    printf("-- accuracy against libm Magnus (grid step %" PRId32 ")\n", step);
+    for (auto &range : ranges) {
+        long points = 0;
+        double dew_max = 0, dew_sum = 0, abs_max = 0, abs_sum = 0;
+        for (int32_t t = range.t_min; t <= range.t_max; t += step) {
+            for (int32_t rh = range.rh_min; rh <= range.rh_max; rh += step) {
+                int16_t dew_point;
+                uint16_t absolute_humidity;
+                double ref_dew_point, ref_absolute_humidity;
+                CDerivedChannels::calculate(t, rh, &dew_point, &absolute_humidity);
+                reference(t, rh, &ref_dew_point, &ref_absolute_humidity);
+                double dew_error = fabs(dew_point / 100.0 - ref_dew_point);
+                double abs_error = fabs(absolute_humidity / 100.0 - ref_absolute_humidity);
+                dew_max = dew_error > dew_max ? dew_error : dew_max;
+                abs_max = abs_error > abs_max ? abs_error : abs_max;
+                dew_sum += dew_error;
+                abs_sum += abs_error;
+                points++;
+            }
+        }
+        printf("%s: %ld points, dew point mean %.4f degC, absolute humidity mean %.4f g/m3\n",
+            range.name, points, dew_sum / points, abs_sum / points);
+        char what[64];
+        snprintf(what, sizeof(what), "%s: dew point max error (degC)", range.name);
+        expect_le(what, dew_max, DEW_POINT_BOUND);
+        snprintf(what, sizeof(what), "%s: absolute humidity max error (g/m3)", range.name);
+        expect_le(what, abs_max, ABSOLUTE_HUMIDITY_BOUND);
+    }
+}
+
+static void test_clamp()
+{
+    int16_t dew_point, clamped_dew_point;
+    uint16_t absolute_humidity, clamped_absolute_humidity;
+
+    printf("-- inputs outside the range of the coefficients\n");
+    CDerivedChannels::calculate(DERIVED_TEMPERATURE_MAX + 2000, 5000, &dew_point, &absolute_humidity);
+    CDerivedChannels::calculate(DERIVED_TEMPERATURE_MAX, 5000, &clamped_dew_point, &clamped_absolute_humidity);
+    expect("temperature above max (dew point)", dew_point, clamped_dew_point);
+    expect("temperature above max (absolute humidity)", absolute_humidity, clamped_absolute_humidity);
+    CDerivedChannels::calculate(2500, 0, &dew_point, &absolute_humidity);
+    CDerivedChannels::calculate(2500, DERIVED_HUMIDITY_MIN, &clamped_dew_point, &clamped_absolute_humidity);
+    expect("humidity 0 (dew point)", dew_point, clamped_dew_point);
+    expect("humidity 0 (absolute humidity)", absolute_humidity, clamped_absolute_humidity);
+}
+
+static void test_update()
+{
+    CDerivedChannels derived;
+
+    printf("-- update() returns true only when a derived value changes\n");
+    expect("first update", derived.update(2500, 5000), true);
+    expect("same inputs", derived.update(2500, 5000), false);
+    expect("temperature changed", derived.update(2510, 5000), true);
+    expect("humidity changed", derived.update(2510, 5100), true);
+    expect("humidity change below the output resolution", derived.update(2510, 5101), false);
+    int16_t dew_point;
+    uint16_t absolute_humidity;
+    CDerivedChannels::calculate(2510, 5101, &dew_point, &absolute_humidity);
+    expect("dew point", derived.get_dew_point(), dew_point);
+    expect("absolute humidity", derived.get_absolute_humidity(), absolute_humidity);
+}
+
+static void test_speed()
+{
+    std::vector<std::pair<int32_t, int32_t>> inputs;
+    for (int32_t t = -1000; t <= 6000; t += 70) {
+        for (int32_t rh = 0; rh <= 10000; rh += 100) {
+            inputs.emplace_back(t, rh);
+        }
+    }
+
+    // sums keep the loops from being optimized away
+    int64_t fixed_sum = 0;
+    double double_sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (auto &in : inputs) {
+            int16_t dew_point;
+            uint16_t absolute_humidity;
+            CDerivedChannels::calculate(in.first, in.second, &dew_point, &absolute_humidity);
+            fixed_sum += dew_point + absolute_humidity;
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (auto &in : inputs) {
+            double dew_point, absolute_humidity;
+            reference(in.first, in.second, &dew_point, &absolute_humidity);
+            double_sum += dew_point + absolute_humidity;
+        }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    double calls = (double)inputs.size() * BENCH_ROUNDS;
+    printf("-- per call time, %.0f calls (checksum %" PRId64 " / %.1f)\n", calls, fixed_sum, double_sum);
+    printf("fixed point: %.1f ns, double / libm: %.1f ns\n",
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / calls,
+        std::chrono::duration<double, std::nano>(t2 - t1).count() / calls);
+}
+
+int main(int argc, char *argv[])
+{
+    int32_t step = argc > 1 ? atoi(argv[1]) : 10;
+    if (step <= 0) {
+        fprintf(stderr, "usage: %s [grid step in 0.01 units]\n", argv[0]);
+        return 1;
+    }
+
+    test_accuracy(step);
+    test_clamp();
+    test_update();
+    test_speed();
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,214 @@
+// energy_test.cpp
+// purpose: CEnergyMonitor (main/src/system/energy.cpp) replaying one hour of 10 s single shots on a virtual clock:
+//          active time / charge per state against the hooks that were called, text and JSON reports agree,
+//          begin() of an active state / end() of an inactive state ignored, running intervals across reset_stats()
+// usage: make -C test build/energy_test && test/build/energy_test
+
+#include "energy.h"
+#include "jsonwriter.h"
+#include <string>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#define TEST_PERIOD_US      10000000LL
+#define TEST_SHOTS          360             // one hour
+#define TEST_CPU_US         3000            // task awake to issue the shot and to read the result
+#define TEST_I2C_US         500             // per transaction (single shot, data ready, read measurement)
+
+static int64_t virtual_us = 0;
+static int failures = 0;
+
+int64_t esp_timer_get_time()
+{
+    return virtual_us;
+}
+
+static void expect(const char *what, int64_t actual, int64_t expected)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (expected %" PRId64 ")\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+static void expect_near(const char *what, double actual, double expected, double tolerance)
+{
+    fprintf(stderr, "%-56s %10.4f (expected %.4f)\n", what, actual, expected);
+    if (fabs(actual - expected) > tolerance) {
+        failures++;
+    }
+}
+
+static void sink_string(const char *data, size_t len, void *arg)
+{
+    ((std::string *)arg)->append(data, len);
+}
+
+static std::string capture_report(CEnergyMonitor *monitor)
+{
+    FILE *tmp = tmpfile();
+    char line[256];
+    std::string text;
+
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(tmp), STDOUT_FILENO);
+    monitor->print_report();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    rewind(tmp);
+    while (fgets(line, sizeof(line), tmp)) {
+        text += line;
+    }
+    fclose(tmp);
+    return text;
+}
+
+/**
+ * @brief number after key in text, NAN if not found
+ */
+static double find_number(const std::string &text, const char *key, size_t from = 0)
+{
+    size_t pos = text.find(key, from);
+    if (pos == std::string::npos)
+        return NAN;
+    return strtod(text.c_str() + pos + strlen(key), nullptr);
+}
+
+static void test_replay()
+{
+    fprintf(stderr, "-- one hour of 10 s single shots\n");
+    CEnergyMonitor monitor;
+    virtual_us = 1000000;
+    monitor.reset_stats();
+    int64_t start_us = virtual_us;
+
+    for (int i = 0; i < TEST_SHOTS; i++) {
+        int64_t shot_us = start_us + i * TEST_PERIOD_US;
+        // issue the shot
+        virtual_us = shot_us;
+        monitor.begin(EnergyCpuAwake, virtual_us);
+        monitor.add(EnergyI2CBusy, TEST_I2C_US);
+        monitor.begin(EnergySensorMeasuring, virtual_us);
+        virtual_us += TEST_CPU_US;
+        monitor.end(EnergyCpuAwake, virtual_us);
+        // read after the measurement time, publish the sample
+        virtual_us = shot_us + ENERGY_SENSOR_SHOT_MS * 1000LL;
+        monitor.begin(EnergyCpuAwake, virtual_us);
+        monitor.add(EnergyI2CBusy, TEST_I2C_US);
+        monitor.add(EnergyI2CBusy, TEST_I2C_US);
+        monitor.end(EnergySensorMeasuring, virtual_us);
+        monitor.add(EnergyWifiTx, ENERGY_WIFI_TX_REPORT_US);
+        virtual_us += TEST_CPU_US;
+        monitor.end(EnergyCpuAwake, virtual_us);
+    }
+    virtual_us = start_us + TEST_SHOTS * TEST_PERIOD_US;
+
+    const struct {
+        eEnergyState state;
+        const char *name;
+        int64_t active_us;
+        int64_t count;
+    } expected[] = {
+        {EnergySensorMeasuring, "sensor", TEST_SHOTS * ENERGY_SENSOR_SHOT_MS * 1000LL, TEST_SHOTS},
+        {EnergySensorLowPower, "sensor_lp", 0, 0},
+        {EnergyI2CBusy, "i2c", TEST_SHOTS * 3LL * TEST_I2C_US, TEST_SHOTS * 3},
+        {EnergyCpuAwake, "cpu", TEST_SHOTS * 2LL * TEST_CPU_US, TEST_SHOTS * 2},
+        {EnergyWifiTx, "wifi_tx", TEST_SHOTS * (int64_t)ENERGY_WIFI_TX_REPORT_US, TEST_SHOTS},
+    };
+    std::string json;
+    CJsonWriter writer(sink_string, &json);
+    monitor.write_report_json(&writer);
+    writer.flush();
+    std::string text = capture_report(&monitor);
+
+    double total_mas = 0.0;
+    for (auto &e : expected) {
+        double charge_mas = e.active_us / 1e6 * monitor.get_current(e.state) / 1000.0;
+        total_mas += charge_mas;
+        std::string what = std::string(e.name) + ": active (us)";
+        expect(what.c_str(), monitor.get_active_us(e.state, virtual_us), e.active_us);
+        what = std::string(e.name) + ": charge (mA.s)";
+        expect_near(what.c_str(), monitor.get_charge_mas(e.state, virtual_us), charge_mas, 1e-9);
+
+        // per state: JSON object of the state and the text row of the state
+        char key[64];
+        snprintf(key, sizeof(key), "\"name\":\"%s\"", e.name);
+        size_t pos = json.find(key);
+        what = std::string(e.name) + ": json count";
+        expect(what.c_str(), (int64_t)find_number(json, "\"count\":", pos), e.count);
+        what = std::string(e.name) + ": json charge (mA.s)";
+        expect_near(what.c_str(), find_number(json, "\"charge_mas\":", pos), charge_mas, 1e-6);
+        snprintf(key, sizeof(key), "\n%-10s ", e.name);
+        pos = text.find(key);
+        what = std::string(e.name) + ": text charge (mA.s, 0.1 resolution)";
+        double text_charge = NAN;
+        if (pos != std::string::npos) {
+            // state, active (s), duty %, count, current uA, charge mA.s
+            char name[16], duty[16], unit[8];
+            double active_s;
+            uint32_t count, current;
+            sscanf(text.c_str() + pos + 1, "%15s %lf %15s %" SCNu32 " %" SCNu32 " %7s %lf", name, &active_s, duty, &count, &current, unit, &text_charge);
+        }
+        expect_near(what.c_str(), text_charge, charge_mas, 0.05);
+    }
+
+    double mah_per_hour = total_mas / 3600.0;
+    size_t total_pos = json.rfind("\"charge_mas\":");
+    expect_near("json total charge (mA.s)", find_number(json, "\"charge_mas\":", total_pos), total_mas, 1e-6);
+    expect_near("json mAh per hour", find_number(json, "\"mah_per_hour\":", total_pos), mah_per_hour, 1e-9);
+    expect_near("text total charge (mA.s)", find_number(text, "total: "), total_mas, 0.05);
+    expect_near("text mAh per hour", find_number(text, "mA.s, "), mah_per_hour, 0.0005);
+    expect("json elapsed (us)", (int64_t)find_number(json, "\"elapsed_us\":"), TEST_SHOTS * TEST_PERIOD_US);
+}
+
+static void test_hooks()
+{
+    fprintf(stderr, "-- hook rules\n");
+    CEnergyMonitor monitor;
+    virtual_us = 1000000;
+    monitor.reset_stats();
+
+    monitor.begin(EnergyCpuAwake, virtual_us);
+    monitor.begin(EnergyCpuAwake, virtual_us + 1000);
+    monitor.end(EnergyCpuAwake, virtual_us + 2000);
+    monitor.end(EnergyCpuAwake, virtual_us + 5000);
+    expect("begin of an active state is ignored (us)", monitor.get_active_us(EnergyCpuAwake, virtual_us + 5000), 2000);
+
+    monitor.begin(EnergySensorMeasuring, virtual_us);
+    expect("running interval counted (us)", monitor.get_active_us(EnergySensorMeasuring, virtual_us + 3000), 3000);
+    virtual_us += 4000;
+    monitor.reset_stats();
+    monitor.end(EnergySensorMeasuring, virtual_us + 1000);
+    expect("running interval restarts at reset_stats() (us)", monitor.get_active_us(EnergySensorMeasuring, virtual_us + 1000), 1000);
+    expect("stopped state after reset (us)",monitor.get_active_us(EnergyCpuAwake, virtual_us), 0);
+
+    monitor.add(EnergyWifiTx, 0);
+    monitor.add(EnergyWifiTx, -5);
+    expect("add() of a non-positive duration (us)", monitor.get_active_us(EnergyWifiTx, virtual_us), 0);
+    expect("set_current() of an invalid state", monitor.set_current(EnergyStateMax, 1), false);
+    monitor.set_current(EnergyWifiTx, 100000);
+    monitor.add(EnergyWifiTx, 1000000);
+    expect_near("charge with a configured current (mA.s)", monitor.get_charge_mas(EnergyWifiTx, virtual_us), 100.0, 1e-9);
+}
+
+int main()
+{
+    // log lines (drain task) go to stdout, results to stderr
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+
+    test_replay();
+    test_hooks();
+
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+// filter_test.cpp
+// purpose: replay a committed trace (test/data/filter_trace.csv) through CMeasurementFilter (main/src/system/filter.cpp)
+//          in every mode, outliers / level changes / published updates against the unfiltered baseline
+// usage: make -C test build/filter_test && test/build/filter_test [trace.csv]
+// trace: history raw csv (timestamp,co2,temperature,humidity), scripts/simulate_filter.py --synthetic --export
+//        24 h at 10 s with CO2 spikes, occupancy ramps, window openings and a shower
+
+#include "filter.h"
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#define TRACE_PATH      "../data/filter_trace.csv"      // relative to the test binary
+#define TRACE_SAMPLES   8640
+#define FILTER_WINDOW   3                               // configuration defaults (CConfig::set_defaults)
+#define FILTER_ALPHA    50
+#define FILTER_GATE     30
+
+typedef struct {
+    int64_t unfiltered;
+    int64_t published;
+    int64_t outliers;
+    int64_t level_changes;
+} channel_stats_t;
+
+static const char *channel_names[FilterChannelMax] = {"co2", "temperature", "humidity"};
+static int failures = 0;
+
+static void expect(const char *what, int64_t actual, int64_t expected)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (expected %" PRId64 ")\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+static void expect_le(const char *what, int64_t actual, int64_t bound)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (bound %" PRId64 ")\n", what, actual, bound);
+    if (actual > bound) {
+        failures++;
+    }
+}
+
+static bool load_trace(const char *path, std::vector<std::vector<int32_t>> *samples)
+{
+    FILE *fp = fopen(path, "r");
+    char line[128];
+
+    if (!fp)
+        return false;
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long timestamp;
+        int co2;
+        float temperature, humidity;
+        if (sscanf(line, "%lu,%d,%f,%f", &timestamp, &co2, &temperature, &humidity) != 4)
+            continue;
+        samples->push_back({co2, (int32_t)lroundf(temperature * 100.f), (int32_t)lroundf(humidity * 100.f)});
+    }
+    fclose(fp);
+    return true;
+}
+
+/**
+ * @brief counters of print_status(), the filter has no other accessor for them
+ */
+static void read_stats(CMeasurementFilter *filter, channel_stats_t *stats)
+{
+    FILE *tmp = tmpfile();
+    char line[256];
+
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(tmp), STDOUT_FILENO);
+    filter->print_status();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    memset(stats, 0xFF, sizeof(channel_stats_t) * FilterChannelMax);
+    rewind(tmp);
+    while (fgets(line, sizeof(line), tmp)) {
+        for (int i = 0; i < FilterChannelMax; i++) {
+            size_t len = strlen(channel_names[i]);
+            if (strncmp(line, channel_names[i], len) != 0 || line[len] != ' ')
+                continue;
+            sscanf(line + len, " updates: %" SCNd64 " (unfiltered: %" SCNd64 "), outliers: %" SCNd64 ", level changes: %" SCNd64,
+                &stats[i].published, &stats[i].unfiltered, &stats[i].outliers, &stats[i].level_changes);
+        }
+    }
+    fclose(tmp);
+}
+
+static void replay(eFilterMode mode, const std::vector<std::vector<int32_t>> &samples, channel_stats_t *stats)
+{
+    CMeasurementFilter filter;
+
+    filter.configure(mode, FILTER_WINDOW, FILTER_ALPHA, FILTER_GATE);
+    for (auto &sample : samples) {
+        for (int i = 0; i < FilterChannelMax; i++) {
+            filter.process((eFilterChannel)i, sample[i]);
+        }
+    }
+    read_stats(&filter, stats);
+}
+
+static void check_channel(const char *mode, int channel, const channel_stats_t &stats, const channel_stats_t &expected)
+{
+    std::string prefix = std::string(mode) + " " + channel_names[channel];
+    expect((prefix + ": unfiltered").c_str(), stats.unfiltered, expected.unfiltered);
+    expect((prefix + ": published").c_str(), stats.published, expected.published);
+    expect((prefix + ": outliers").c_str(), stats.outliers, expected.outliers);
+    expect((prefix + ": level changes").c_str(), stats.level_changes, expected.level_changes);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string path = argc > 1 ? argv[1] : std::string(argv[0]).substr(0, std::string(argv[0]).find_last_of('/') + 1) + TRACE_PATH;
+    std::vector<std::vector<int32_t>> samples;
+
+    if (!load_trace(path.c_str(), &samples)) {
+        fprintf(stderr, "failed to open %s\n", path.c_str());
+        return 1;
+    }
+    // log lines (drain task) go to stdout, results to stderr
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+
+    fprintf(stderr, "-- trace %s\n", path.c_str());
+    expect("samples", (int64_t)samples.size(), TRACE_SAMPLES);
+
+    // off: every change of the raw value is published, nothing is rejected
+    channel_stats_t baseline[FilterChannelMax];
+    replay(FilterModeOff, samples, baseline);
+    const channel_stats_t expected_off[FilterChannelMax] = {
+        {8155, 8155, 0, 0},
+        {7912, 7912, 0, 0},
+        {8417, 8417, 0, 0},
+    };
+    for (int i = 0; i < FilterChannelMax; i++) {
+        check_channel("off", i, baseline[i], expected_off[i]);
+    }
+
+    // counts of scripts/simulate_filter.py on the same trace (bit exact mirror of filter.cpp)
+    // co2: spikes are held back as outliers, humidity follows steps beyond follow_dev as level changes
+    const struct {
+        eFilterMode mode;
+        const char *name;
+        channel_stats_t expected[FilterChannelMax];
+    } modes[] = {
+        {FilterModeEma, "ema", {{8155, 6357, 44, 3}, {7912, 5078, 0, 0}, {8417, 8062, 0, 81}}},
+        {FilterModeKalman, "kalman", {{8155, 4641, 44, 3}, {7912, 2483, 0, 0}, {8417, 6913, 0, 86}}},
+    };
+    for (auto &m : modes) {
+        channel_stats_t stats[FilterChannelMax];
+        replay(m.mode, samples, stats);
+        for (int i = 0; i < FilterChannelMax; i++) {
+            check_channel(m.name, i, stats[i], m.expected[i]);
+            std::string what = std::string(m.name) + " " + channel_names[i] + ": published against the baseline";
+            expect_le(what.c_str(), stats[i].published, baseline[i].published);
+        }
+    }
+
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,528 @@
+// i2c_fault_test.cpp
+// purpose: fault injection into the i2c_master_* calls under CI2CMaster (NACK, timeout, SDA held low by a slave)
+//          and the bounds of retry, bus recovery, circuit breaker backoff and the worst case blocking time per call
+// usage: make -C test i2c_fault_test && test/build/i2c_fault_test
+// the bus runs on a virtual clock (esp_timer_get_time), a timeout consumes exactly its ticks (1 tick = 1 ms)
+
+#include "I2CMaster.h"
+#include "driver/i2c.h"
+#include "driver/gpio.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <map>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define TEST_PORT           0
+#define TEST_GPIO_SCL       19
+#define TEST_GPIO_SDA       18
+#define TEST_CLOCK          400000
+#define TEST_TIMEOUT_MS     1000    // default timeout of CI2CMaster::write_bytes / read_bytes
+#define RECOVERY_MAX_US     1000    // 9 clock pulses + STOP at 5 us per level, rounded up
+
+typedef enum {
+    FaultNone = 0,
+    FaultNack,          // address not acknowledged (device absent or busy)
+    FaultTimeout,       // bus busy until the timeout (clock stretching, arbitration)
+    FaultStuckSda       // a slave holds SDA low until it is clocked out
+} eFault;
+
+static struct {
+    eFault fault;
+    int release_pulses;     // FaultStuckSda: SCL pulses until SDA is released, -1: never
+    int transactions;       // bus transactions issued by CI2CMaster (write, read, write_read)
+    int driver_deletes;     // recover_bus() and release()
+    int pulses;             // SCL rising edges while the slave holds SDA low (master releases it)
+    int scl_level;
+    int sda_level;          // driven by the master (open drain)
+    bool sda_low;           // held by the slave
+    uint32_t clk_speed;
+    int64_t last_timeout_ms;
+} bus;
+
+static int64_t virtual_us = 1000000;
+static std::map<std::string, uint32_t> nvs_u32;
+static int failures = 0;
+
+int64_t esp_timer_get_time()
+{
+    return virtual_us;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    virtual_us += us;
+}
+
+static void set_fault(eFault fault, int release_pulses = -1)
+{
+    bus.fault = fault;
+    bus.release_pulses = release_pulses;
+    bus.sda_low = fault == FaultStuckSda;
+    bus.pulses = 0;
+}
+
+/**
+ * @brief a bus transaction: bits on the wire at the configured clock, or the injected fault
+ */
+static esp_err_t transaction(size_t bytes, TickType_t ticks_to_wait)
+{
+    bus.transactions++;
+    bus.last_timeout_ms = ticks_to_wait * portTICK_PERIOD_MS;
+    if (bus.sda_low || bus.fault == FaultTimeout) {
+        virtual_us += (int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000;
+        return ESP_ERR_TIMEOUT;
+    }
+    if (bus.fault == FaultNack) {
+        virtual_us += 9 * 1000000LL / bus.clk_speed;
+        return ESP_FAIL;
+    }
+    virtual_us += (int64_t)(bytes + 1) * 9 * 1000000LL / bus.clk_speed;
+    return ESP_OK;
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+    bus.clk_speed = i2c_conf->master.clk_speed;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num)
+{
+    bus.driver_deletes++;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_to_device(i2c_port_t i2c_num, uint8_t device_address, const uint8_t *write_buffer, size_t write_size, TickType_t ticks_to_wait)
+{
+    return transaction(write_size, ticks_to_wait);
+}
+
+esp_err_t i2c_master_read_from_device(i2c_port_t i2c_num, uint8_t device_address, uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait)
+{
+    if (bus.fault == FaultNone && !bus.sda_low) {
+        memset(read_buffer, 0, read_size);
+    }
+    return transaction(read_size, ticks_to_wait);
+}
+
+esp_err_t i2c_master_write_read_device(i2c_port_t i2c_num, uint8_t device_address, const uint8_t *write_buffer, size_t write_size,
+    uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait)
+{
+    if (bus.fault == FaultNone && !bus.sda_low) {
+        memset(read_buffer, 0, read_size);
+    }
+    return transaction(write_size + read_size + 1, ticks_to_wait);
+}
+
+static struct {
+    size_t bytes;
+    bool ack_check;
+} cmd_link;
+
+i2c_cmd_handle_t i2c_cmd_link_create()
+{
+    cmd_link.bytes = 0;
+    cmd_link.ack_check = false;
+    return &cmd_link;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    cmd_link.bytes++;
+    cmd_link.ack_check |= ack_en;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en)
+{
+    cmd_link.bytes += data_len;
+    cmd_link.ack_check |= ack_en;
+    return ESP_OK;
+}
+
+/**
+ * @brief command link (probe, write without acknowledge check), not counted as a transaction of the device
+ */
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    if (bus.sda_low || bus.fault == FaultTimeout) {
+        virtual_us += (int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000;
+        return ESP_ERR_TIMEOUT;
+    }
+    virtual_us += (int64_t)cmd_link.bytes * 9 * 1000000LL / bus.clk_speed;
+    return bus.fault == FaultNack && cmd_link.ack_check ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num == TEST_GPIO_SCL) {
+        if (bus.sda_low && bus.sda_level == 1 && bus.scl_level == 0 && level == 1) {
+            bus.pulses++;
+            if (bus.release_pulses >= 0 && bus.pulses >= bus.release_pulses) {
+                bus.sda_low = false;
+            }
+        }
+        bus.scl_level = level;
+    } else if (gpio_num == TEST_GPIO_SDA) {
+        bus.sda_level = level;
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return gpio_num == TEST_GPIO_SDA && bus.sda_low ? 0 : 1;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    auto it = nvs_u32.find(key);
+    if (it == nvs_u32.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    *out_value = it->second;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    nvs_u32[key] = value;
+    return ESP_OK;
+}
+
+static void sink_string(const char *data, size_t len, void *arg)
+{
+    ((std::string *)arg)->append(data, len);
+}
+
+/**
+ * @brief a member of the device object in write_stats_json(), -1 if not found
+ */
+static int64_t device_stat(CI2CMaster *master, uint8_t address, const char *key)
+{
+    std::string json;
+    CJsonWriter writer(sink_string, &json);
+    master->write_stats_json(&writer);
+    writer.flush();
+
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"address\":\"0x%02x\"", address);
+    size_t pos = json.find(pattern);
+    if (pos == std::string::npos)
+        return -1;
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    pos = json.find(pattern, pos);
+    if (pos == std::string::npos)
+        return -1;
+    pos += strlen(pattern);
+    if (json[pos] == '"') {
+        // breaker state
+        static const char *names[] = {"\"closed\"", "\"open\"", "\"half-open\""};
+        for (int i = 0; i < 3; i++) {
+            if (json.compare(pos, strlen(names[i]), names[i]) == 0)
+                return i;
+        }
+        return -1;
+    }
+    return strtoll(json.c_str() + pos, nullptr, 10);
+}
+
+static void expect(const char *what, int64_t actual, int64_t expected)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (expected %" PRId64 ")\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+static void expect_le(const char *what, int64_t actual, int64_t bound)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (bound %" PRId64 ")\n", what, actual, bound);
+    if (actual > bound) {
+        failures++;
+    }
+}
+
+/**
+ * @brief blocking time of one call, the bus clock included
+ */
+static int64_t timed_write(CI2CMaster *master, uint8_t address, bool *result, uint32_t timeout_ms = TEST_TIMEOUT_MS)
+{
+    uint8_t data[2] = {0x21, 0xB1};
+    int64_t start_us = virtual_us;
+    *result = master->write_bytes(address, data, sizeof(data), timeout_ms);
+    return virtual_us - start_us;
+}
+
+static CI2CMaster* new_master()
+{
+    set_fault(FaultNone);
+    bus.transactions = 0;
+    bus.driver_deletes = 0;
+    nvs_u32.clear();
+    CI2CMaster *master = new CI2CMaster();
+    master->initialize(TEST_PORT, TEST_GPIO_SCL, TEST_GPIO_SDA, TEST_CLOCK);
+    return master;
+}
+
+static void test_nack_retry()
+{
+    CI2CMaster *master = new_master();
+    bool result;
+
+    fprintf(stderr, "-- nack\n");
+    set_fault(FaultNack);
+    timed_write(master, 0x62, &result);
+    expect("result", result, false);
+    expect("transactions (1 + I2C_RETRY_COUNT)", bus.transactions, 1 + I2C_RETRY_COUNT);
+    expect("retry timeout (ms)", bus.last_timeout_ms, I2C_RETRY_TIMEOUT_MS);
+    expect("bus recoveries (a nack is not a bus fault)", bus.driver_deletes, 0);
+    expect("retries", device_stat(master, 0x62, "retries"), I2C_RETRY_COUNT);
+    delete master;
+}
+
+static void test_timeout_recovery()
+{
+    CI2CMaster *master = new_master();
+    bool result;
+
+    fprintf(stderr, "-- timeout\n");
+    set_fault(FaultTimeout);
+    int64_t elapsed_us = timed_write(master, 0x62, &result);
+    expect("result", result, false);
+    expect("transactions (1 + I2C_RETRY_COUNT)", bus.transactions, 1 + I2C_RETRY_COUNT);
+    expect("bus recoveries (one per retry)", bus.driver_deletes, I2C_RETRY_COUNT);
+    expect_le("blocking time (us)", elapsed_us,
+        (TEST_TIMEOUT_MS + I2C_RETRY_COUNT * I2C_RETRY_TIMEOUT_MS) * 1000LL + I2C_RETRY_COUNT * RECOVERY_MAX_US);
+    delete master;
+}
+
+static void test_stuck_sda()
+{
+    CI2CMaster *master = new_master();
+    bool result;
+
+    fprintf(stderr, "-- sda held low, released after 5 clock pulses\n");
+    set_fault(FaultStuckSda, 5);
+    timed_write(master, 0x62, &result);
+    expect("result (second attempt after recovery)", result, true);
+    expect("clock pulses", bus.pulses, 5);
+    expect("bus recoveries", bus.driver_deletes, 1);
+    expect("breaker", device_stat(master, 0x62, "breaker"), I2CBreakerClosed);
+
+    fprintf(stderr, "-- sda held low, never released\n");
+    set_fault(FaultStuckSda, -1);
+    int64_t elapsed_us = timed_write(master, 0x62, &result);
+    expect("result", result, false);
+    expect_le("clock pulses per recovery", bus.pulses, 9 * I2C_RETRY_COUNT);
+    expect_le("blocking time (us)", elapsed_us,
+        (TEST_TIMEOUT_MS + I2C_RETRY_COUNT * I2C_RETRY_TIMEOUT_MS) * 1000LL + I2C_RETRY_COUNT * RECOVERY_MAX_US);
+    delete master;
+}
+
+static void test_breaker_backoff()
+{
+    CI2CMaster *master = new_master();
+    bool result;
+
+    fprintf(stderr, "-- breaker\n");
+    set_fault(FaultNack);
+    for (int i = 0; i < I2C_BREAKER_THRESHOLD - 1; i++) {
+        timed_write(master, 0x62, &result);
+    }
+    expect("breaker below the threshold", device_stat(master, 0x62, "breaker"), I2CBreakerClosed);
+    timed_write(master, 0x62, &result);
+    expect("breaker at the threshold", device_stat(master, 0x62, "breaker"), I2CBreakerOpen);
+
+    // backoff doubles per failed probe up to I2C_BACKOFF_MAX_MS, calls in between cost no bus time
+    int64_t backoff_ms = I2C_BACKOFF_BASE_MS;
+    int skipped_ok = 1, probes_ok = 1, cost_ok = 1;
+    for (int round = 0; round < 10; round++) {
+        int transactions = bus.transactions;
+        int64_t opened_us = virtual_us;
+        virtual_us = opened_us + (backoff_ms - 1) * 1000;
+        if (timed_write(master, 0x62, &result) != 0 || bus.transactions != transactions) {
+            cost_ok = 0;
+        }
+        skipped_ok &= !result;
+        virtual_us = opened_us + backoff_ms * 1000;
+        timed_write(master, 0x62, &result);
+        // half-open allows one probe call (with its retries), the failure opens the circuit again
+        probes_ok &= bus.transactions - transactions == 1 + I2C_RETRY_COUNT;
+        probes_ok &= device_stat(master, 0x62, "breaker") == I2CBreakerOpen;
+        backoff_ms = backoff_ms * 2 > I2C_BACKOFF_MAX_MS ? I2C_BACKOFF_MAX_MS : backoff_ms * 2;
+    }
+    expect("calls skipped before retry_at", skipped_ok, 1);
+    expect("skipped calls without bus time", cost_ok, 1);
+    expect("one probe per half-open", probes_ok, 1);
+    expect("skipped", device_stat(master, 0x62, "skipped"), 10);
+
+    // the backoff stays capped
+    int transactions = bus.transactions;
+    int64_t opened_us = virtual_us;
+    virtual_us = opened_us + (I2C_BACKOFF_MAX_MS - 1) * 1000LL;
+    timed_write(master, 0x62, &result);
+    expect("transactions before the capped backoff", bus.transactions - transactions, 0);
+    virtual_us = opened_us + I2C_BACKOFF_MAX_MS * 1000LL;
+
+    // the device comes back, the probe closes the circuit
+    set_fault(FaultNone);
+    timed_write(master, 0x62, &result);
+    expect("result after recovery", result, true);
+    expect("breaker after recovery", device_stat(master, 0x62, "breaker"), I2CBreakerClosed);
+    expect("clock changes (an outage keeps the clock)", device_stat(master, 0x62, "clock_changes"), 0);
+    delete master;
+}
+
+/**
+ * @brief measurement loop with the sensor gone: a command write and a read per iteration (SCD4x read_measurement)
+ */
+static void test_loop_latency()
+{
+    CI2CMaster *master = new_master();
+    uint8_t data[9];
+    int64_t worst_us = 0;
+    int64_t total_us = 0;
+    const int iterations = 600;     // 10 s period, 100 minutes
+
+    fprintf(stderr, "-- measurement loop, sensor timing out\n");
+    set_fault(FaultTimeout);
+    for (int i = 0; i < iterations; i++) {
+        bool result;
+        int64_t start_us = virtual_us;
+        timed_write(master, 0x62, &result);
+        if (result) {
+            master->read_bytes(0x62, data, sizeof(data));
+        }
+        int64_t elapsed_us = virtual_us - start_us;
+        worst_us = elapsed_us > worst_us ? elapsed_us : worst_us;
+        total_us += elapsed_us;
+        virtual_us = start_us + 10000000;
+    }
+    int64_t bound_us = (TEST_TIMEOUT_MS + I2C_RETRY_COUNT * I2C_RETRY_TIMEOUT_MS) * 1000LL + I2C_RETRY_COUNT * RECOVERY_MAX_US;
+    expect_le("worst iteration (us)", worst_us, bound_us);
+    // closed: I2C_BREAKER_THRESHOLD calls, then one probe per backoff (capped at 60 s, i.e. every 6th iteration)
+    int64_t max_calls = I2C_BREAKER_THRESHOLD + 1 + 2 + 4 + (iterations * 10000LL) / I2C_BACKOFF_MAX_MS;
+    expect_le("bus time in total (us)", total_us, max_calls * bound_us);
+    fprintf(stderr, "%-56s %8.2f %%\n", "bus time share", total_us * 100.0 / (iterations * 10000000.0));
+    delete master;
+}
+
+/**
+ * @brief SCD4x wake_up is not acknowledged, it must not count against the device (clock, retries, breaker)
+ */
+static void test_write_no_ack()
+{
+    CI2CMaster *master = new_master();
+    uint8_t wake_up[2] = {0x36, 0xF6};
+    int wake_ok = 0, write_ok = 0;
+    bool result;
+
+    fprintf(stderr, "-- write without acknowledge check\n");
+    for (int i = 0; i < 200; i++) {
+        set_fault(FaultNack);
+        wake_ok += master->write_bytes_no_ack(0x62, wake_up, sizeof(wake_up));
+        set_fault(FaultNone);
+        timed_write(master, 0x62, &result);
+        write_ok += result;
+    }
+    expect("wake_up results (false only on bus errors)", wake_ok, 200);
+    expect("writes after wake_up", write_ok, 200);
+    expect("transactions (wake_up is not one)", bus.transactions, 200);
+    expect("retries", device_stat(master, 0x62, "retries"), 0);
+    expect("clock changes", device_stat(master, 0x62, "clock_changes"), 0);
+    expect("clock", device_stat(master, 0x62, "clock"), TEST_CLOCK);
+    delete master;
+}
+
+/**
+ * @brief id commands of the detector rejected by a part (SCD4x in periodic measurement after an ESP reset)
+ */
+static void test_probe_rejected()
+{
+    CI2CMaster *master = new_master();
+    uint8_t command[2] = {0x36, 0x82};
+    uint8_t response[9];
+    int probe_ok = 0, write_ok = 0;
+    bool result;
+
+    fprintf(stderr, "-- rejected id commands\n");
+    for (int i = 0; i < 200; i++) {
+        set_fault(FaultNack);
+        probe_ok += master->probe_write(0x62, command, sizeof(command));
+        probe_ok += master->probe_read(0x62, response, sizeof(response));
+        set_fault(FaultNone);
+        timed_write(master, 0x62, &result);
+        write_ok += result;
+    }
+    expect("probe results", probe_ok, 0);
+    expect("writes after rejected probes", write_ok, 200);
+    expect("transactions (no retries)", bus.transactions, 600);
+    expect("retries", device_stat(master, 0x62, "retries"), 0);
+    expect("clock changes", device_stat(master, 0x62, "clock_changes"), 0);
+    expect("clock", device_stat(master, 0x62, "clock"), TEST_CLOCK);
+    expect("clock persisted", nvs_u32.count("dev_62"), 0);
+    delete master;
+}
+
+int main()
+{
+    // log lines (drain task) go to stdout, results to stderr
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+
+    test_nack_retry();
+    test_timeout_recovery();
+    test_stuck_sda();
+    test_breaker_backoff();
+    test_loop_latency();
+    test_write_no_ack();
+    test_probe_rejected();
+
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,301 @@
+// json_bench.cpp
+// purpose: peak heap and time of the endpoint dump, streaming CJsonWriter (dump_matter_endpoint_info) against the
+//          cJSON tree + cJSON_PrintUnformatted it replaced, on synthetic endpoints of growing size
+// usage: make -C test json_bench && test/build/json_bench [repeat]
+//        make -C test CJSON_DIR=$IDF_PATH/components/json/cJSON json_bench     (real cJSON instead of test/reference/cjson_model.h)
+// heap is counted by wrapping malloc/calloc/realloc/free of the linked objects (-Wl,--wrap), a realloc is counted as
+// malloc + copy + free (old and new block live at the same time, as when the block cannot grow in place).
+// sizes are host sizes: a cJSON node is 64 bytes on x86-64 and 40 bytes on the ESP32 (plus heap block overhead)
+
+#include "jsonwriter.h"
+#include "matternames.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#ifdef HAVE_CJSON
+#include "cJSON.h"
+#define CJSON_SOURCE    "cJSON"
+#else
+#include "reference/cjson_model.h"
+#define CJSON_SOURCE    "cJSON allocation model (test/reference/cjson_model.h)"
+#endif
+
+/* heap accounting */
+#define HEAP_HEADER     16
+
+static size_t heap_current = 0;
+static size_t heap_peak = 0;
+static size_t heap_allocs = 0;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void __real_free(void *ptr);
+
+void* __wrap_malloc(size_t size)
+{
+    uint8_t *block = (uint8_t *)__real_malloc(size + HEAP_HEADER);
+    if (!block)
+        return nullptr;
+    *(size_t *)block = size;
+    heap_current += size;
+    heap_peak = std::max(heap_peak, heap_current);
+    heap_allocs++;
+    return block + HEAP_HEADER;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (!ptr)
+        return;
+    uint8_t *block = (uint8_t *)ptr - HEAP_HEADER;
+    heap_current -= *(size_t *)block;
+    __real_free(block);
+}
+
+// gcc turns malloc + memset into calloc
+void* __wrap_calloc(size_t count, size_t size)
+{
+    void *result = __wrap_malloc(count * size);
+    if (result) {
+        memset(result, 0, count * size);
+    }
+    return result;
+}
+
+void* __wrap_realloc(void *ptr, size_t size)
+{
+    void *result = __wrap_malloc(size);
+    if (result && ptr) {
+        size_t old_size = *(size_t *)((uint8_t *)ptr - HEAP_HEADER);
+        memcpy(result, ptr, std::min(old_size, size));
+        __wrap_free(ptr);
+    }
+    return result;
+}
+}
+
+static void heap_reset()
+{
+    heap_peak = heap_current;
+    heap_allocs = 0;
+}
+
+/* synthetic endpoint, same shape and value types as a matter endpoint dump */
+typedef struct {
+    const char *name;
+    int device_types;
+    int clusters;
+    int attributes;     // per cluster
+    int commands;       // per cluster
+} endpoint_shape_t;
+
+static const endpoint_shape_t shapes[] = {
+    {"small",   1,   8,  8,  4},
+    {"root",    1,  16, 16,  8},
+    {"large",   2,  64, 32, 16},
+    {"huge",    4, 256, 64, 32},
+};
+
+static const uint32_t device_type_ids[] = {0x0016, 0x002C, 0x0100, 0x0011};
+
+typedef struct {
+    uint32_t hash;      // FNV-1a of the output
+    size_t length;
+} output_digest_t;
+
+static void digest(output_digest_t *d, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        d->hash = (d->hash ^ (uint8_t)data[i]) * 16777619u;
+    }
+    d->length += len;
+}
+
+static void sink_digest(const char *data, size_t len, void *arg)
+{
+    digest((output_digest_t *)arg, data, len);
+}
+
+/**
+ * @brief dump_matter_endpoint_info() (util.cpp) on the synthetic endpoint
+ */
+static void dump_writer(const endpoint_shape_t *shape, CJsonWriter *writer)
+{
+    char temp[24];
+
+    writer->begin_object();
+    writer->add_uint("endpoint_id", 1);
+    writer->begin_array("device_type");
+    for (int i = 0; i < shape->device_types; i++) {
+        writer->begin_object();
+        snprintf(temp, sizeof(temp), "0x%04X", (unsigned)device_type_ids[i]);
+        writer->add_string("id", temp);
+        writer->add_string("name", get_matter_device_name(device_type_ids[i]));
+        writer->end_object();
+    }
+    writer->end_array();
+    writer->begin_array("clusters");
+    for (uint32_t cluster_id = 0; cluster_id < (uint32_t)shape->clusters; cluster_id++) {
+        writer->begin_object();
+        snprintf(temp, sizeof(temp), "0x%08X", (unsigned)cluster_id);
+        writer->add_string("id", temp);
+        writer->add_string("name", get_matter_cluster_name(cluster_id));
+        writer->begin_array("attributes");
+        for (uint32_t attr_id = 0; attr_id < (uint32_t)shape->attributes; attr_id++) {
+            writer->begin_object();
+            snprintf(temp, sizeof(temp), "0x%08X", (unsigned)attr_id);
+            writer->add_string("id", temp);
+            writer->add_string("name", get_matter_attribute_name(cluster_id, attr_id));
+            switch (attr_id % 4) {
+            case 0: writer->add_bool("value", attr_id & 4); break;
+            case 1: writer->add_uint("value", attr_id * 37); break;
+            case 2: snprintf(temp, sizeof(temp), "value %u", (unsigned)attr_id); writer->add_string("value", temp); break;
+            default: writer->add_int("value", -(int32_t)attr_id); break;
+            }
+            writer->end_object();
+        }
+        writer->end_array();
+        writer->begin_array("commands");
+        for (uint32_t cmd_id = 0; cmd_id < (uint32_t)shape->commands; cmd_id++) {
+            writer->begin_object();
+            snprintf(temp, sizeof(temp), "0x%02X", (unsigned)cmd_id);
+            writer->add_string("id", temp);
+            writer->add_string("name", get_matter_command_name(cluster_id, cmd_id));
+            writer->end_object();
+        }
+        writer->end_array();
+        writer->end_object();
+    }
+    writer->end_array();
+    writer->end_object();
+    writer->flush();
+}
+
+/**
+ * @brief the cJSON version of dump_matter_endpoint_info() before the streaming writer, printed as a whole
+ */
+static void dump_cjson(const endpoint_shape_t *shape, output_digest_t *d)
+{
+    char temp[64];
+    cJSON *item, *item2;
+    cJSON *root = cJSON_CreateObject();
+
+    cJSON_AddNumberToObject(root, "endpoint_id", 1);
+    cJSON *array_device_type = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "device_type", array_device_type);
+    for (int i = 0; i < shape->device_types; i++) {
+        item = cJSON_CreateObject();
+        cJSON_AddItemToArray(array_device_type, item);
+        snprintf(temp, sizeof(temp), "0x%04X", (unsigned)device_type_ids[i]);
+        cJSON_AddStringToObject(item, "id", temp);
+        cJSON_AddStringToObject(item, "name", get_matter_device_name(device_type_ids[i]));
+    }
+    cJSON *array_cluster = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "clusters", array_cluster);
+    for (uint32_t cluster_id = 0; cluster_id < (uint32_t)shape->clusters; cluster_id++) {
+        item = cJSON_CreateObject();
+        cJSON_AddItemToArray(array_cluster, item);
+        snprintf(temp, sizeof(temp), "0x%08X", (unsigned)cluster_id);
+        cJSON_AddStringToObject(item, "id", temp);
+        cJSON_AddStringToObject(item, "name", get_matter_cluster_name(cluster_id));
+        cJSON *array_attribute = cJSON_CreateArray();
+        cJSON_AddItemToObject(item, "attributes", array_attribute);
+        for (uint32_t attr_id = 0; attr_id < (uint32_t)shape->attributes; attr_id++) {
+            item2 = cJSON_CreateObject();
+            cJSON_AddItemToArray(array_attribute, item2);
+            snprintf(temp, sizeof(temp), "0x%08X", (unsigned)attr_id);
+            cJSON_AddStringToObject(item2, "id", temp);
+            cJSON_AddStringToObject(item2, "name", get_matter_attribute_name(cluster_id, attr_id));
+            cJSON *item3;
+            switch (attr_id % 4) {
+            case 0: item3 = cJSON_CreateBool(attr_id & 4); break;
+            case 1: item3 = cJSON_CreateNumber(attr_id * 37); break;
+            case 2: snprintf(temp, sizeof(temp), "value %u", (unsigned)attr_id); item3 = cJSON_CreateString(temp); break;
+            default: item3 = cJSON_CreateNumber(-(int32_t)attr_id); break;
+            }
+            cJSON_AddItemToObject(item2, "value", item3);
+        }
+        cJSON *array_command = cJSON_CreateArray();
+        cJSON_AddItemToObject(item, "commands", array_command);
+        for (uint32_t cmd_id = 0; cmd_id < (uint32_t)shape->commands; cmd_id++) {
+            item2 = cJSON_CreateObject();
+            cJSON_AddItemToArray(array_command, item2);
+            snprintf(temp, sizeof(temp), "0x%02X", (unsigned)cmd_id);
+            cJSON_AddStringToObject(item2, "id", temp);
+            cJSON_AddStringToObject(item2, "name", get_matter_command_name(cluster_id, cmd_id));
+        }
+    }
+
+    char *string = cJSON_PrintUnformatted(root);
+    digest(d, string, strlen(string));
+    cJSON_Delete(root);
+    free(string);
+}
+
+typedef struct {
+    output_digest_t output;
+    size_t peak;
+    size_t allocs;
+    double median_us;
+} bench_result_t;
+
+template <typename F>
+static void run(F dump, int repeat, bench_result_t *result)
+{
+    std::vector<double> times;
+
+    for (int i = 0; i < repeat; i++) {
+        output_digest_t d = {2166136261u, 0};
+        heap_reset();
+        auto start = std::chrono::steady_clock::now();
+        dump(&d);
+        times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        if (i == 0) {
+            result->output = d;
+            result->peak = heap_peak - heap_current;
+            result->allocs = heap_allocs;
+        }
+    }
+    std::sort(times.begin(), times.end());
+    result->median_us = times[times.size() / 2];
+}
+
+int main(int argc, char **argv)
+{
+    int repeat = argc > 1 ? atoi(argv[1]) : 51;
+    int failures = 0;
+
+    if (repeat <= 0) {
+        fprintf(stderr, "usage: %s [repeat]\n", argv[0]);
+        return 1;
+    }
+    printf("reference: %s, CJsonWriter: %zu bytes (stack), median of %d runs\n", CJSON_SOURCE, sizeof(CJsonWriter), repeat);
+    printf("%-6s %8s %9s | %10s %7s %9s | %10s %7s %9s | %s\n", "shape", "nodes", "output",
+        "peak heap", "allocs", "time (us)", "peak heap", "allocs", "time (us)", "output");
+    printf("%-6s %8s %9s | %-28s | %-28s |\n", "", "", "(bytes)", "CJsonWriter", "cJSON tree + print");
+    for (const endpoint_shape_t &shape : shapes) {
+        bench_result_t writer_result = {}, cjson_result = {};
+        size_t nodes = 4 + shape.device_types * 3 + shape.clusters * (5 + shape.attributes * 4 + shape.commands * 3);
+
+        run([&](output_digest_t *d) {
+            CJsonWriter writer(sink_digest, d);
+            dump_writer(&shape, &writer);
+        }, repeat, &writer_result);
+        run([&](output_digest_t *d) {
+            dump_cjson(&shape, d);
+        }, repeat, &cjson_result);
+
+        bool identical = writer_result.output.hash == cjson_result.output.hash && writer_result.output.length == cjson_result.output.length;
+        failures += !identical || writer_result.allocs != 0;
+        printf("%-6s %8zu %9zu | %10zu %7zu %9.1f | %10zu %7zu %9.1f | %s\n", shape.name, nodes, writer_result.output.length,
+            writer_result.peak, writer_result.allocs, writer_result.median_us,
+            cjson_result.peak, cjson_result.allocs, cjson_result.median_us, identical ? "identical" : "DIFFERENT");
+    }
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+// log_burst_test.cpp
+// purpose: per call site rate limit of CLogger, a burst beyond LOG_RATE_BURST is suppressed and the
+//          "suppressed N similar messages" summary is printed by the drain task once the call site goes quiet
+// usage: make -C test log_burst_test && test/build/log_burst_test
+
+#include "logger.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BURST_COUNT     20
+
+static char path[] = "/tmp/log_burst_XXXXXX";
+static int failures = 0;
+
+static std::string read_output()
+{
+    std::string content;
+    char chunk[4096];
+    size_t n;
+
+    fflush(stdout);
+    FILE *f = fopen(path, "r");
+    while (f && (n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        content.append(chunk, n);
+    }
+    if (f) {
+        fclose(f);
+    }
+    return content;
+}
+
+static int count_lines(const std::string &content, const char *text)
+{
+    int count = 0;
+    for (size_t pos = content.find(text); pos != std::string::npos; pos = content.find(text, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief waits for the drain task until text appears expected times (or the timeout)
+ */
+static int wait_lines(const char *text, int expected, int timeout_ms)
+{
+    int count = 0;
+    for (int elapsed = 0; elapsed <= timeout_ms; elapsed += 10) {
+        count = count_lines(read_output(), text);
+        if (count >= expected)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return count;
+}
+
+static void expect(const char *what, int actual, int expected)
+{
+    fprintf(stderr, "%-44s %4d (expected %d)\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+static void log_warning(int i)
+{
+    GetLogger(eLogType::Warning)->Log("burst warning %d", i);
+}
+
+int main()
+{
+    int fd = mkstemp(path);
+    if (fd < 0 || !freopen(path, "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+    close(fd);
+
+    // info is never rate limited
+    for (int i = 0; i < BURST_COUNT; i++) {
+        GetLogger(eLogType::Info)->Log("burst info %d", i);
+    }
+    expect("info lines", wait_lines("burst info", BURST_COUNT, 1000), BURST_COUNT);
+
+    for (int i = 0; i < BURST_COUNT; i++) {
+        log_warning(i);
+    }
+    expect("warning lines passed", wait_lines("burst warning", LOG_RATE_BURST, 1000), LOG_RATE_BURST);
+    expect("suppressed count", (int)CLogger::GetSuppressedCount(), BURST_COUNT - LOG_RATE_BURST);
+    expect("summary before the call site is quiet", count_lines(read_output(), "similar messages"), 0);
+
+    // nothing is logged at the call site anymore, the drain task owes the summary
+    char summary[64];
+    snprintf(summary, sizeof(summary), "suppressed %d similar messages [log_burst_test.cpp:", BURST_COUNT - LOG_RATE_BURST);
+    expect("summary after the call site went quiet", wait_lines(summary, 1, LOG_RATE_REFILL_MS * 3), 1);
+
+    // the next message of the call site passes without repeating the summary
+    log_warning(BURST_COUNT);
+    expect("warning lines after refill", wait_lines("burst warning", LOG_RATE_BURST + 1, 1000), LOG_RATE_BURST + 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(LOG_RATE_REFILL_MS * 2));
+    expect("summaries in total", count_lines(read_output(), "similar messages"), 1);
+
+    unlink(path);
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
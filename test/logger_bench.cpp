@@ -0,0 +1,151 @@
+// logger_bench.cpp
+// purpose: host stress test of CLogger (ring buffer + drain task) under concurrent callers
+//          per call latency of Log(), torn / reordered messages, sent = received + dropped
+// usage: make -C test logger_bench && test/build/logger_bench [threads] [messages per thread]
+
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PAYLOAD_LEN     48
+
+static std::atomic<bool> start_flag(false);
+
+static void run_thread(int id, int count, std::vector<int64_t> *latency)
+{
+    char payload[PAYLOAD_LEN + 1];
+    memset(payload, 'a' + id % 26, PAYLOAD_LEN);
+    payload[PAYLOAD_LEN] = '\0';
+    latency->reserve(count);
+
+    while (!start_flag.load()) {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < count; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        GetLogger(eLogType::Info)->Log("bench thread=%d seq=%d value=%.3f payload=%s", id, i, i * 0.5, payload);
+        auto t1 = std::chrono::steady_clock::now();
+        latency->push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+    }
+}
+
+/**
+ * @brief returns false if the line is not exactly what thread/seq logged
+ */
+static bool check_line(const char *line, int threads, int *id, int *seq)
+{
+    const char *p = strstr(line, "bench thread=");
+    double value;
+    int consumed = 0;
+
+    if (strncmp(line, "[I] [", 5) != 0 || !p)
+        return false;
+    if (sscanf(p, "bench thread=%d seq=%d value=%lf payload=%n", id, seq, &value, &consumed) != 3 || consumed == 0)
+        return false;
+    if (*id < 0 || *id >= threads || value != *seq * 0.5)
+        return false;
+    p += consumed;
+    for (int i = 0; i < PAYLOAD_LEN; i++) {
+        if (p[i] != 'a' + *id % 26)
+            return false;
+    }
+    p += PAYLOAD_LEN;
+    return strncmp(p, " [logger_bench.cpp:", 19) == 0 && p[strlen(p) - 1] == ']';
+}
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int count = argc > 2 ? atoi(argv[2]) : 20000;
+    char path[] = "/tmp/logger_bench_XXXXXX";
+
+    // the drain task prints to stdout, results go to stderr
+    int fd = mkstemp(path);
+    if (fd < 0 || !freopen(path, "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+    close(fd);
+
+    std::vector<std::vector<int64_t>> latency(threads);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(run_thread, i, count, &latency[i]);
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    start_flag = true;
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    // wait for the drain task to print everything up to the marker (retried if the ring is full)
+    std::string content;
+    for (int retry = 0; retry < 500 && content.find("bench done") == std::string::npos; retry++) {
+        GetLogger(eLogType::Info)->Log("bench done");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        fflush(stdout);
+        FILE *f = fopen(path, "r");
+        content.clear();
+        char chunk[4096];
+        size_t n;
+        while (f && (n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+            content.append(chunk, n);
+        }
+        if (f) {
+            fclose(f);
+        }
+    }
+    unlink(path);
+
+    std::vector<int> last_seq(threads, -1);
+    long received = 0, torn = 0, reordered = 0;
+    size_t pos = 0;
+    while (pos < content.size()) {
+        size_t end = content.find('\n', pos);
+        if (end == std::string::npos)
+            end = content.size();
+        std::string line = content.substr(pos, end - pos);
+        pos = end + 1;
+        if (line.find("bench done") != std::string::npos || line.find("log messages dropped") != std::string::npos)
+            continue;
+        int id, seq;
+        if (!check_line(line.c_str(), threads, &id, &seq)) {
+            if (torn++ < 5) {
+                fprintf(stderr, "torn: %s\n", line.c_str());
+            }
+            continue;
+        }
+        if (seq <= last_seq[id]) {
+            reordered++;
+        }
+        last_seq[id] = seq;
+        received++;
+    }
+
+    std::vector<int64_t> all;
+    for (auto &v : latency) {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) { return all[(size_t)(p * (all.size() - 1))]; };
+    long sent = (long)threads * count;
+    // dropped also counts "bench done" markers that did not fit
+    long dropped = (long)CLogger::GetDroppedCount();
+
+    fprintf(stderr, "threads: %d, messages: %ld, elapsed: %.1f ms (%.0f msg/s)\n", threads, sent, elapsed_ms, sent / elapsed_ms * 1000.0);
+    fprintf(stderr, "Log() latency (ns): p50 %lld, p99 %lld, p99.9 %lld, max %lld\n", (long long)percentile(0.5), (long long)percentile(0.99),
+        (long long)percentile(0.999), (long long)all.back());
+    fprintf(stderr, "received: %ld, dropped (ring full): %ld, torn: %ld, reordered: %ld\n", received, dropped, torn, reordered);
+
+    bool ok = torn == 0 && reordered == 0 && received <= sent && received + dropped >= sent && content.find("bench done") != std::string::npos;
+    fprintf(stderr, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
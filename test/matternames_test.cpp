@@ -0,0 +1,59 @@
+// matternames_test.cpp
+// purpose: the sorted name tables (main/src/system/matternames.cpp) return the same names as the switch
+//          statements they replaced (test/reference/matternames_switch.inc) for every id in range
+// usage: make -C test matternames_test && test/build/matternames_test
+
+#include "matternames.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace reference {
+#include "reference/matternames_switch.inc"
+}
+
+#define CLUSTER_ID_LAST     0x0810      // above the highest standard cluster with names
+#define COMMAND_ID_LAST     0x00FF
+
+static long mismatches = 0;
+
+static void check(const char *what, uint32_t cluster_id, uint32_t id, const char *expected, const char *actual)
+{
+    if (strcmp(expected, actual) == 0)
+        return;
+    if (mismatches++ < 10) {
+        printf("%s 0x%04X/0x%04X: expected \"%s\", got \"%s\"\n", what, cluster_id, id, expected, actual);
+    }
+}
+
+int main()
+{
+    long lookups = 0;
+
+    for (uint32_t id = 0; id <= 0xFFFF; id++) {
+        check("device", 0, id, reference::get_matter_device_name((uint16_t)id), get_matter_device_name((uint16_t)id));
+        check("cluster", id, 0, reference::get_matter_cluster_name(id), get_matter_cluster_name(id));
+        lookups += 2;
+    }
+    for (uint32_t cluster_id = 0; cluster_id <= CLUSTER_ID_LAST; cluster_id++) {
+        for (uint32_t id = 0; id <= 0xFFFF; id++) {
+            check("attribute", cluster_id, id, reference::get_matter_attribute_name(cluster_id, id), get_matter_attribute_name(cluster_id, id));
+            lookups++;
+        }
+        for (uint32_t id = 0; id <= COMMAND_ID_LAST; id++) {
+            check("command", cluster_id, id, reference::get_matter_command_name(cluster_id, id), get_matter_command_name(cluster_id, id));
+            lookups++;
+        }
+    }
+    // ids above 16 bit never match (the tables key on cluster << 16 | id)
+    const uint32_t wide_ids[] = {0x10000, 0x10006, 0x00060000, 0xFFF1FC12, 0xFFFFFFFF};
+    for (uint32_t id : wide_ids) {
+        check("cluster", id, 0, reference::get_matter_cluster_name(id), get_matter_cluster_name(id));
+        check("attribute", id, 0, reference::get_matter_attribute_name(id, 0), get_matter_attribute_name(id, 0));
+        check("attribute", 0x0006, id, reference::get_matter_attribute_name(0x0006, id), get_matter_attribute_name(0x0006, id));
+        check("command", 0x0006, id, reference::get_matter_command_name(0x0006, id), get_matter_command_name(0x0006, id));
+        lookups += 4;
+    }
+
+    printf("lookups: %ld, mismatches: %ld\n%s\n", lookups, mismatches, mismatches ? "FAIL" : "PASS");
+    return mismatches ? 1 : 0;
+}
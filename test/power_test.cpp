@@ -0,0 +1,319 @@
+// power_test.cpp
+// purpose: CPowerManager (main/src/system/power.cpp) battery mode: filter and sampler state retained across a reboot
+//          (continues bit exact against a filter that never rebooted), reset reasons and mode / configuration changes that
+//          invalidate it, the sensor sleep break-even period and the sensor sleep time of the report
+// usage: make -C test build/power_test && test/build/power_test
+// the fake CScd41Ctrl below only tracks the power state, RTC memory is process memory (stubs/esp_attr.h)
+
+#include "power.h"
+#include "scd41.h"
+#include "filter.h"
+#include "sampler.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <esp_rom_crc.h>
+#include <string>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#define TEST_SAMPLES        200         // before the reboot
+#define TEST_CONTINUE       200         // after the reboot, compared with the filter that kept running
+#define TEST_PERIOD_MS      60000
+#define FILTER_WINDOW       3           // configuration defaults (CConfig::set_defaults)
+#define FILTER_ALPHA        50
+#define FILTER_GATE         30
+#define SLEEP_BREAK_EVEN_MS 513356      // (IDLE - SLEEP) * (period - 2 shots) > (MEASURING + IDLE) * shot, energy.h currents
+
+static int64_t virtual_us = 1000000;
+static esp_reset_reason_t reset_reason = ESP_RST_POWERON;
+static int pm_locks_held = 0;
+static int sensor_sleeps = 0;
+static int failures = 0;
+
+int64_t esp_timer_get_time()
+{
+    return virtual_us;
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return reset_reason;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+esp_err_t esp_pm_configure(const void *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle)
+{
+    static int lock;
+    *out_handle = (esp_pm_lock_handle_t)&lock;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    pm_locks_held++;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    pm_locks_held--;
+    return ESP_OK;
+}
+
+// fake SCD41 driver: power state only
+CScd41Ctrl::CScd41Ctrl() { m_power_state = Scd4xPowerIdle; }
+CScd41Ctrl::~CScd41Ctrl() {}
+CScd41Ctrl* CScd41Ctrl::Instance() { static CScd41Ctrl instance; return &instance; }
+
+bool CScd41Ctrl::sleep_module()
+{
+    if (m_power_state == Scd4xPowerPeriodic)
+        return false;
+    m_power_state = Scd4xPowerSleep;
+    sensor_sleeps++;
+    return true;
+}
+
+bool CScd41Ctrl::wakeup_module(bool wait)
+{
+    m_power_state = Scd4xPowerIdle;
+    return true;
+}
+
+static void expect(const char *what, int64_t actual, int64_t expected)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (expected %" PRId64 ")\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+static std::string capture_status(CPowerManager *power)
+{
+    FILE *tmp = tmpfile();
+    char line[256];
+    std::string text;
+
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(tmp), STDOUT_FILENO);
+    power->print_status(0);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    rewind(tmp);
+    while (fgets(line, sizeof(line), tmp)) {
+        text += line;
+    }
+    fclose(tmp);
+    return text;
+}
+
+/**
+ * @brief deterministic sample i: occupancy ramps, a spike every 37 samples, humidity steps
+ */
+static void sample(int i, int32_t *values)
+{
+    values[FilterChannelCo2] = 600 + (i % 90) * 6 + (i % 37 == 0 ? 900 : 0) + (i * 7919) % 13;
+    values[FilterChannelTemperature] = 2200 + (int32_t)lround(80.0 * sin(i / 25.0)) + (i * 104729) % 7;
+    values[FilterChannelHumidity] = 4500 + (i / 50 % 2) * 600 + (i * 15485863) % 21;
+}
+
+static void feed(CMeasurementFilter *filter, CAdaptiveSampler *sampler, int i, int32_t *outputs)
+{
+    int32_t values[FilterChannelMax];
+
+    sample(i, values);
+    for (int c = 0; c < FilterChannelMax; c++) {
+        outputs[c] = filter->process((eFilterChannel)c, values[c]);
+    }
+    sampler->update((uint16_t)values[FilterChannelCo2], values[FilterChannelHumidity] / 100.f, virtual_us);
+}
+
+/**
+ * @brief boot: fresh pipeline state in the singletons, retained block checked against the reset reason
+ */
+static bool reboot(CPowerManager *power, esp_reset_reason_t reason, eFilterMode mode)
+{
+    reset_reason = reason;
+    GetMeasurementFilter()->configure(mode, FILTER_WINDOW, FILTER_ALPHA, FILTER_GATE);
+    GetMeasurementFilter()->reset();
+    GetAdaptiveSampler()->reset();
+    power->initialize();
+    power->set_mode(PowerModeBattery);
+    return power->restore();
+}
+
+static void test_retain(eFilterMode mode, const char *name)
+{
+    CPowerManager before;
+    CMeasurementFilter reference, cold;
+    CAdaptiveSampler reference_sampler, cold_sampler;
+    int32_t outputs[FilterChannelMax], expected[FilterChannelMax], cold_outputs[FilterChannelMax];
+
+    fprintf(stderr, "-- retained state, %s\n", name);
+    reset_reason = ESP_RST_POWERON;
+    GetMeasurementFilter()->configure(mode, FILTER_WINDOW, FILTER_ALPHA, FILTER_GATE);
+    GetMeasurementFilter()->reset();
+    GetAdaptiveSampler()->reset();
+    reference.configure(mode, FILTER_WINDOW, FILTER_ALPHA, FILTER_GATE);
+    before.initialize();
+    before.set_mode(PowerModeBattery);
+    for (int i = 0; i < TEST_SAMPLES; i++) {
+        virtual_us += TEST_PERIOD_MS * 1000LL;
+        feed(GetMeasurementFilter(), GetAdaptiveSampler(), i, outputs);
+        feed(&reference, &reference_sampler, i, expected);
+        before.retain();
+    }
+
+    // software reset (or deep sleep): the timer restarts, the rest of the pipeline continues
+    CPowerManager after;
+    expect("restored after a software reset", reboot(&after, ESP_RST_SW, mode), true);
+    expect("restored once", after.restore(), false);
+    expect("sampler period continues (ms)", GetAdaptiveSampler()->get_period_ms(), reference_sampler.get_period_ms());
+    cold.configure(mode, FILTER_WINDOW, FILTER_ALPHA, FILTER_GATE);
+    int mismatches = 0, cold_mismatches = 0;
+    for (int i = TEST_SAMPLES; i < TEST_SAMPLES + TEST_CONTINUE; i++) {
+        virtual_us += TEST_PERIOD_MS * 1000LL;
+        feed(GetMeasurementFilter(), GetAdaptiveSampler(), i, outputs);
+        feed(&reference, &reference_sampler, i, expected);
+        feed(&cold, &cold_sampler, i, cold_outputs);
+        for (int c = 0; c < FilterChannelMax; c++) {
+            mismatches += outputs[c] != expected[c];
+            cold_mismatches += cold_outputs[c] != expected[c];
+        }
+    }
+    expect("outputs differing from the filter that kept running", mismatches, 0);
+    // without the retained state the filter restarts from the raw value
+    expect("outputs of a cold start differ", cold_mismatches > 0, 1);
+}
+
+static void test_invalidate()
+{
+    CPowerManager power;
+    int32_t outputs[FilterChannelMax];
+
+    fprintf(stderr, "-- retained state not used\n");
+    reboot(&power, ESP_RST_POWERON, FilterModeEma);
+    feed(GetMeasurementFilter(), GetAdaptiveSampler(), 0, outputs);
+    power.retain();
+
+    CPowerManager power_on;
+    expect("power on reset", reboot(&power_on, ESP_RST_POWERON, FilterModeEma), false);
+    power_on.retain();
+    CPowerManager panic;
+    expect("panic reset", reboot(&panic, ESP_RST_PANIC, FilterModeEma), false);
+    panic.retain();
+    CPowerManager deep_sleep;
+    expect("deep sleep wake up", reboot(&deep_sleep, ESP_RST_DEEPSLEEP, FilterModeEma), true);
+
+    // switching to always-on drops the block, it is not refreshed any more
+    deep_sleep.retain();
+    deep_sleep.set_mode(PowerModeAlwaysOn);
+    deep_sleep.retain();
+    CPowerManager after_mode;
+    expect("after always-on mode", reboot(&after_mode, ESP_RST_SW, FilterModeEma), false);
+
+    // filter configuration changed: the filter starts over, the sampler still continues
+    for (int i = 0; i < 5; i++) {
+        virtual_us += GetAdaptiveSampler()->get_period_ms() * 1000LL;
+        GetAdaptiveSampler()->update(600, 45.f, virtual_us);
+    }
+    after_mode.retain();
+    uint32_t period_ms = GetAdaptiveSampler()->get_period_ms();
+    CPowerManager changed;
+    expect("filter mode changed: sampler restored", reboot(&changed, ESP_RST_SW, FilterModeKalman), true);
+    expect("filter mode changed: sampler period (ms)", GetAdaptiveSampler()->get_period_ms(), period_ms);
+    filter_snapshot_t snapshot;
+    GetMeasurementFilter()->save(&snapshot);
+    expect("filter mode changed: filter starts over", snapshot.state[FilterChannelCo2].initialized, false);
+}
+
+static void test_sensor_sleep()
+{
+    CPowerManager power;
+
+    fprintf(stderr, "-- sensor sleep\n");
+    expect("always-on: sensor not put to sleep", power.should_sleep_sensor(3600000), false);
+    power.set_mode(PowerModeBattery);
+    expect("below the break-even period", power.should_sleep_sensor(SLEEP_BREAK_EVEN_MS - 1), false);
+    expect("at the break-even period", power.should_sleep_sensor(SLEEP_BREAK_EVEN_MS), true);
+    expect("two shots long period", power.should_sleep_sensor(2 * ENERGY_SENSOR_SHOT_MS), false);
+
+    GetScd41Ctrl()->wakeup_module();
+    power.reset_stats();
+    int sleeps = sensor_sleeps;
+    for (int i = 0; i < 10; i++) {
+        // shot, then sleep until the next one
+        virtual_us += ENERGY_SENSOR_SHOT_MS * 1000LL;
+        power.sensor_sleep(virtual_us);
+        virtual_us += 600000000LL;
+        power.sensor_wake(virtual_us);
+    }
+    expect("sensor put to sleep", sensor_sleeps - sleeps, 10);
+    virtual_us += ENERGY_SENSOR_SHOT_MS * 1000LL;
+    power.sensor_sleep(virtual_us);
+    virtual_us += 300000000LL;
+    std::string text = capture_status(&power);
+    int64_t elapsed_s = -1, sleep_s = -1;
+    size_t pos = text.find("elapsed: ");
+    if (pos != std::string::npos) {
+        sscanf(text.c_str() + pos, "elapsed: %" SCNd64 " s", &elapsed_s);
+    }
+    pos = text.find("sensor sleep: ");
+    if (pos != std::string::npos) {
+        sscanf(text.c_str() + pos, "sensor sleep: %" SCNd64 " s", &sleep_s);
+    }
+    expect("report: elapsed (s)", elapsed_s, 11 * 5 + 10 * 600 + 300);
+    expect("report: sensor sleep including the running one (s)", sleep_s, 10 * 600 + 300);
+
+    // supervisor recovery woke the sensor behind the power manager's back
+    GetScd41Ctrl()->wakeup_module();
+    text = capture_status(&power);
+    pos = text.find("sensor sleep: ");
+    sleep_s = -1;
+    if (pos != std::string::npos) {
+        sscanf(text.c_str() + pos, "sensor sleep: %" SCNd64 " s", &sleep_s);
+    }
+    expect("report: woken sensor not counted as asleep (s)", sleep_s, 10 * 600);
+
+    power.stay_active(1);
+    expect("active window releases the pm lock", pm_locks_held, 0);
+}
+
+int main()
+{
+    // log lines (drain task) go to stdout, results to stderr
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+
+    test_retain(FilterModeEma, "ema");
+    test_retain(FilterModeKalman, "kalman");
+    test_invalidate();
+    test_sensor_sleep();
+
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+// allocation model of the cJSON calls the endpoint dump used before CJsonWriter (cJSON 1.7.x as shipped in esp-idf components/json)
+// reference for test/json_bench.cpp when cJSON itself is not available (make -C test CJSON_DIR=<dir with cJSON.c>), do not edit
+// kept: node layout, one allocation per node, strdup of every key and string value, and the print buffer policy
+// (256 bytes, realloc to twice the needed size, shrink to the output length at the end)
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define cJSON_False     (1 << 0)
+#define cJSON_True      (1 << 1)
+#define cJSON_Number    (1 << 3)
+#define cJSON_String    (1 << 4)
+#define cJSON_Array     (1 << 5)
+#define cJSON_Object    (1 << 6)
+
+typedef struct cJSON {
+    struct cJSON *next;
+    struct cJSON *prev;
+    struct cJSON *child;
+    int type;
+    char *valuestring;
+    int valueint;
+    double valuedouble;
+    char *string;
+} cJSON;
+
+typedef struct {
+    char *buffer;
+    size_t length;
+    size_t offset;
+} cjson_printbuffer_t;
+
+static char* cjson_strdup(const char *string)
+{
+    size_t length = strlen(string) + 1;
+    char *copy = (char *)malloc(length);
+    if (copy) {
+        memcpy(copy, string, length);
+    }
+    return copy;
+}
+
+static cJSON* cjson_new_item(int type)
+{
+    cJSON *item = (cJSON *)malloc(sizeof(cJSON));
+    if (item) {
+        memset(item, 0, sizeof(cJSON));
+        item->type = type;
+    }
+    return item;
+}
+
+static cJSON* cJSON_CreateObject() { return cjson_new_item(cJSON_Object); }
+static cJSON* cJSON_CreateArray() { return cjson_new_item(cJSON_Array); }
+static cJSON* cJSON_CreateBool(int boolean) { return cjson_new_item(boolean ? cJSON_True : cJSON_False); }
+
+static cJSON* cJSON_CreateNumber(double num)
+{
+    cJSON *item = cjson_new_item(cJSON_Number);
+    if (item) {
+        item->valuedouble = num;
+        item->valueint = num >= INT_MAX ? INT_MAX : num <= (double)INT_MIN ? INT_MIN : (int)num;
+    }
+    return item;
+}
+
+static cJSON* cJSON_CreateString(const char *string)
+{
+    cJSON *item = cjson_new_item(cJSON_String);
+    if (item) {
+        item->valuestring = cjson_strdup(string);
+    }
+    return item;
+}
+
+static void cJSON_AddItemToArray(cJSON *array, cJSON *item)
+{
+    cJSON *child = array->child;
+    if (!child) {
+        array->child = item;
+        item->prev = item;
+    } else {
+        // the first child keeps the last one in prev
+        child->prev->next = item;
+        item->prev = child->prev;
+        child->prev = item;
+    }
+}
+
+static void cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item)
+{
+    item->string = cjson_strdup(string);
+    cJSON_AddItemToArray(object, item);
+}
+
+static void cJSON_AddStringToObject(cJSON *object, const char *name, const char *string)
+{
+    cJSON_AddItemToObject(object, name, cJSON_CreateString(string));
+}
+
+static void cJSON_AddNumberToObject(cJSON *object, const char *name, double number)
+{
+    cJSON_AddItemToObject(object, name, cJSON_CreateNumber(number));
+}
+
+static void cJSON_Delete(cJSON *item)
+{
+    while (item) {
+        cJSON *next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+static char* cjson_ensure(cjson_printbuffer_t *p, size_t needed)
+{
+    needed += p->offset + 1;
+    if (needed <= p->length) {
+        return p->buffer + p->offset;
+    }
+    size_t newsize = needed > INT_MAX / 2 ? INT_MAX : needed * 2;
+    char *newbuffer = (char *)realloc(p->buffer, newsize);
+    if (!newbuffer) {
+        free(p->buffer);
+        p->buffer = nullptr;
+        return nullptr;
+    }
+    p->buffer = newbuffer;
+    p->length = newsize;
+    return p->buffer + p->offset;
+}
+
+static bool cjson_print_string(const char *string, cjson_printbuffer_t *p)
+{
+    size_t length = strlen(string);     // the dump has no characters to escape
+    char *output = cjson_ensure(p, length + sizeof("\"\""));
+    if (!output)
+        return false;
+    output[0] = '"';
+    memcpy(output + 1, string, length);
+    output[length + 1] = '"';
+    output[length + 2] = '\0';
+    p->offset += length + 2;
+    return true;
+}
+
+static bool cjson_print_value(const cJSON *item, cjson_printbuffer_t *p)
+{
+    char number[26];
+    char *output;
+    int length;
+
+    switch (item->type) {
+    case cJSON_False:
+    case cJSON_True:
+        output = cjson_ensure(p, 6);
+        if (!output)
+            return false;
+        strcpy(output, item->type == cJSON_True ? "true" : "false");
+        p->offset += strlen(output);
+        return true;
+    case cJSON_Number:
+        if (isnan(item->valuedouble) || isinf(item->valuedouble)) {
+            length = snprintf(number, sizeof(number), "null");
+        } else if (item->valuedouble == (double)item->valueint) {
+            length = snprintf(number, sizeof(number), "%d", item->valueint);
+        } else {
+            length = snprintf(number, sizeof(number), "%1.15g", item->valuedouble);
+        }
+        output = cjson_ensure(p, (size_t)length + 1);
+        if (!output)
+            return false;
+        memcpy(output, number, (size_t)length + 1);
+        p->offset += (size_t)length;
+        return true;
+    case cJSON_String:
+        return cjson_print_string(item->valuestring, p);
+    case cJSON_Array:
+    case cJSON_Object:
+        output = cjson_ensure(p, 1);
+        if (!output)
+            return false;
+        *output = item->type == cJSON_Array ? '[' : '{';
+        p->offset++;
+        for (const cJSON *child = item->child; child; child = child->next) {
+            if (item->type == cJSON_Object) {
+                if (!cjson_print_string(child->string, p) || !(output = cjson_ensure(p, 1)))
+                    return false;
+                *output = ':';
+                p->offset++;
+            }
+            if (!cjson_print_value(child, p))
+                return false;
+            if (child->next) {
+                if (!(output = cjson_ensure(p, 1)))
+                    return false;
+                *output = ',';
+                p->offset++;
+            }
+        }
+        output = cjson_ensure(p, 2);
+        if (!output)
+            return false;
+        output[0] = item->type == cJSON_Array ? ']' : '}';
+        output[1] = '\0';
+        p->offset++;
+        return true;
+    }
+    return false;
+}
+
+static char* cJSON_PrintUnformatted(const cJSON *item)
+{
+    cjson_printbuffer_t p = {(char *)malloc(256), 256, 0};
+    if (!p.buffer)
+        return nullptr;
+    if (!cjson_print_value(item, &p)) {
+        free(p.buffer);
+        return nullptr;
+    }
+    return (char *)realloc(p.buffer, p.offset + 1);
+}
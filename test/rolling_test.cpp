@@ -0,0 +1,231 @@
+// rolling_test.cpp
+// purpose: CRollingStats (main/src/system/rolling.cpp) against a brute force double precision reference over the same
+//          bucket aligned windows: irregular sample intervals with gaps longer than a window, queries between samples,
+//          count / min / max exact, mean / stddev error, range change bits of add() and the per call time of add()
+// usage: make -C test build/rolling_test && test/build/rolling_test [samples] [seed]
+
+#include "rolling.h"
+#include <chrono>
+#include <random>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define TEST_SAMPLES        30000
+#define QUERY_EVERY         97          // samples between full queries
+#define MEAN_BOUND          5e-3        // published units (ppm, 0.01 degC, 0.01 %RH), float bucket accumulators
+#define STDDEV_BOUND        5e-3
+#define BENCH_CALLS         200000
+
+static const int64_t window_us[RollingWindowMax] = {5LL * 60 * 1000000, 60LL * 60 * 1000000, 24LL * 60 * 60 * 1000000};
+
+static int64_t virtual_us = 0;
+static int failures = 0;
+
+int64_t esp_timer_get_time()
+{
+    return virtual_us;
+}
+
+typedef struct {
+    int64_t at_us;
+    int32_t values[FilterChannelMax];
+} sample_t;
+
+static std::vector<sample_t> samples;
+
+static void expect(const char *what, int64_t actual, int64_t expected)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (expected %" PRId64 ")\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+static void expect_le(const char *what, double actual, double bound)
+{
+    fprintf(stderr, "%-56s %8.2g (bound %.2g)\n", what, actual, bound);
+    if (actual > bound) {
+        failures++;
+    }
+}
+
+/**
+ * @brief samples in the window at now_us: buckets are aligned to the first sample, the last ROLLING_BUCKETS buckets count
+ */
+static void reference(eRollingWindow window, eFilterChannel channel, int64_t now_us, rolling_result_t *result)
+{
+    int64_t span_us = window_us[window] / ROLLING_BUCKETS;
+    int64_t origin_us = samples.empty() ? 0 : samples[0].at_us;
+    int64_t oldest = (now_us - origin_us) / span_us - (ROLLING_BUCKETS - 1);
+    double sum = 0.0;
+
+    result->count = 0;
+    result->min = INT32_MAX;
+    result->max = INT32_MIN;
+    for (auto it = samples.rbegin(); it != samples.rend() && (it->at_us - origin_us) / span_us >= oldest; ++it) {
+        int32_t value = it->values[channel];
+        result->count++;
+        result->min = value < result->min ? value : result->min;
+        result->max = value > result->max ? value : result->max;
+        sum += value;
+    }
+    result->mean = result->count ? sum / result->count : 0.0;
+    double m2 = 0.0;
+    uint32_t n = 0;
+    for (auto it = samples.rbegin(); n < result->count; ++it, n++) {
+        double d = it->values[channel] - result->mean;
+        m2 += d * d;
+    }
+    result->stddev = result->count > 1 ? sqrt(m2 / (result->count - 1)) : 0.0;
+}
+
+static void query_all(CRollingStats *stats, int64_t at_us, long *queries, long *count_mismatches, long *range_mismatches,
+    double *mean_error, double *stddev_error)
+{
+    int64_t now_us = virtual_us;
+
+    virtual_us = at_us;
+    for (int w = 0; w < RollingWindowMax; w++) {
+        for (int c = 0; c < FilterChannelMax; c++) {
+            rolling_result_t result, ref;
+            bool valid = stats->get((eRollingWindow)w, (eFilterChannel)c, &result);
+            reference((eRollingWindow)w, (eFilterChannel)c, at_us, &ref);
+            (*queries)++;
+            if (valid != (ref.count > 0) || result.count != ref.count) {
+                (*count_mismatches)++;
+                continue;
+            }
+            if (!valid)
+                continue;
+            if (result.min != ref.min || result.max != ref.max) {
+                (*range_mismatches)++;
+            }
+            *mean_error = fmax(*mean_error, fabs(result.mean - ref.mean));
+            *stddev_error = fmax(*stddev_error, fabs(result.stddev - ref.stddev));
+        }
+    }
+    virtual_us = now_us;
+}
+
+static void test_reference(int count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> interval_s(1, 60);
+    std::uniform_int_distribution<int> gap(0, 999);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    CRollingStats stats;
+    double level[FilterChannelMax] = {600.0, 2200.0, 4500.0};
+    const double step[FilterChannelMax] = {8.0, 3.0, 15.0};
+    const int32_t limit[FilterChannelMax][2] = {{400, 5000}, {-1000, 6000}, {0, 10000}};
+    int32_t prev_min[RollingWindowMax][FilterChannelMax], prev_max[RollingWindowMax][FilterChannelMax];
+    long queries = 0, count_mismatches = 0, range_mismatches = 0, missed_changes = 0, gaps = 0;
+    double mean_error = 0.0, stddev_error = 0.0;
+
+    fprintf(stderr, "-- %d samples (seed %u), queried every %d samples and between samples\n", count, seed, QUERY_EVERY);
+    for (int w = 0; w < RollingWindowMax; w++) {
+        for (int c = 0; c < FilterChannelMax; c++) {
+            prev_min[w][c] = INT32_MAX;
+            prev_max[w][c] = INT32_MIN;
+        }
+    }
+    virtual_us = 1000000;
+    for (int i = 0; i < count; i++) {
+        // irregular period, sometimes a sensor fault longer than the 5 min / 1 h windows
+        int g = gap(rng);
+        virtual_us += g < 2 ? (g == 0 ? 7200LL : 1800LL) * 1000000 : interval_s(rng) * 1000000LL;
+        gaps += g < 2;
+        sample_t sample;
+        sample.at_us = virtual_us;
+        for (int c = 0; c < FilterChannelMax; c++) {
+            level[c] += step[c] * noise(rng);
+            level[c] = level[c] < limit[c][0] ? limit[c][0] : (level[c] > limit[c][1] ? limit[c][1] : level[c]);
+            sample.values[c] = (int32_t)lround(level[c]);
+        }
+        // every QUERY_EVERY samples: query halfway since the previous sample (buckets may expire without a sample) and at the sample
+        int64_t prev_us = samples.empty() ? virtual_us : samples.back().at_us;
+        bool query = i % QUERY_EVERY == 0;
+        if (query) {
+            query_all(&stats, prev_us + (virtual_us - prev_us) / 2, &queries, &count_mismatches, &range_mismatches, &mean_error, &stddev_error);
+        }
+        samples.push_back(sample);
+        uint32_t changed = stats.add(sample.values, virtual_us);
+
+        // a change of the reference range must be reported (MinMeasuredValue / MaxMeasuredValue publish)
+        for (int w = 0; w < RollingWindowMax; w++) {
+            bool range_changed = false;
+            for (int c = 0; c < FilterChannelMax; c++) {
+                rolling_result_t ref;
+                reference((eRollingWindow)w, (eFilterChannel)c, virtual_us, &ref);
+                range_changed |= ref.min != prev_min[w][c] || ref.max != prev_max[w][c];
+                prev_min[w][c] = ref.min;
+                prev_max[w][c] = ref.max;
+            }
+            if (range_changed && !(changed & (1 << w))) {
+                missed_changes++;
+            }
+        }
+        if (query) {
+            query_all(&stats, virtual_us, &queries, &count_mismatches, &range_mismatches, &mean_error, &stddev_error);
+        }
+    }
+
+    fprintf(stderr, "queries: %ld, gaps longer than 5 min: %ld\n", queries, gaps);
+    expect("count mismatches", count_mismatches, 0);
+    expect("min/max mismatches", range_mismatches, 0);
+    expect("range changes not reported by add()", missed_changes, 0);
+    expect_le("mean max error (published units)", mean_error, MEAN_BOUND);
+    expect_le("stddev max error (published units)", stddev_error, STDDEV_BOUND);
+}
+
+static void test_idle()
+{
+    CRollingStats stats;
+    rolling_result_t result;
+    int32_t values[FilterChannelMax] = {800, 2300, 4000};
+
+    fprintf(stderr, "-- no sample for longer than the window\n");
+    virtual_us = 1000000;
+    stats.add(values, virtual_us);
+    virtual_us += window_us[RollingWindow5Min] + window_us[RollingWindow5Min] / ROLLING_BUCKETS;
+    expect("5 min window after 5 min 25 s", stats.get(RollingWindow5Min, FilterChannelCo2, &result), false);
+    expect("1 h window keeps the sample", stats.get(RollingWindow1Hour, FilterChannelCo2, &result) ? result.count : 0, 1);
+    int32_t min, max;
+    expect("5 min range is empty", stats.get_range(RollingWindow5Min, FilterChannelCo2, &min, &max), false);
+    values[FilterChannelCo2] = 900;
+    expect("next add() reports the dropped range", stats.add(values, virtual_us) & (1 << RollingWindow5Min), 1 << RollingWindow5Min);
+}
+
+static void test_speed()
+{
+    CRollingStats stats;
+    int32_t values[FilterChannelMax] = {800, 2300, 4000};
+    uint32_t changes = 0;
+
+    virtual_us = 1000000;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_CALLS; i++) {
+        values[FilterChannelCo2] = 800 + (i * 7) % 50;
+        values[FilterChannelHumidity] = 4000 + (i * 13) % 100;
+        changes += stats.add(values, virtual_us) != 0;
+        virtual_us += 10000000;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    fprintf(stderr, "-- add(): %.1f ns per call (%d calls at 10 s, %" PRIu32 " range changes)\n",
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / BENCH_CALLS, BENCH_CALLS, changes);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : TEST_SAMPLES;
+    unsigned seed = argc > 2 ? (unsigned)atoi(argv[2]) : 1;
+
+    test_reference(count, seed);
+    test_idle();
+    test_speed();
+
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
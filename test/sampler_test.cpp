@@ -0,0 +1,251 @@
+// sampler_test.cpp
+// purpose: CAdaptiveSampler (main/src/system/sampler.cpp) period control: stays within the configured range, drops at once
+//          on a step (to the period that keeps the seen rate within a step), grows back by at most SAMPLER_BACKOFF_RATIO
+//          per sample while flat,
+//          range / snapshot validation and shots against a fixed 10 s rate on the committed trace (test/data/filter_trace.csv)
+// usage: make -C test build/sampler_test && test/build/sampler_test [trace.csv]
+
+#include "sampler.h"
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#define TRACE_PATH          "../data/filter_trace.csv"      // relative to the test binary
+#define TRACE_STEP_S        10                              // trace resolution
+#define FIXED_PERIOD_MS     10000                           // MEASURE_PERIOD_MS, adaptive sampling off
+#define SHOT_RATIO_BOUND    30                              // adaptive shots against fixed rate shots (%)
+#define RAMP_TOLERANCE_MS   1000                            // integer ppm readings of the ramp
+
+typedef struct {
+    int64_t updates;
+    int64_t at_min;
+    int64_t at_max;
+    int64_t speedups;
+} sampler_stats_t;
+
+static int failures = 0;
+
+static void expect(const char *what, int64_t actual, int64_t expected)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (expected %" PRId64 ")\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+static void expect_le(const char *what, int64_t actual, int64_t bound)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (bound %" PRId64 ")\n", what, actual, bound);
+    if (actual > bound) {
+        failures++;
+    }
+}
+
+static bool load_trace(const char *path, std::vector<std::pair<uint16_t, float>> *samples)
+{
+    FILE *fp = fopen(path, "r");
+    char line[128];
+
+    if (!fp)
+        return false;
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long timestamp;
+        int co2;
+        float temperature, humidity;
+        if (sscanf(line, "%lu,%d,%f,%f", &timestamp, &co2, &temperature, &humidity) != 4)
+            continue;
+        samples->push_back({(uint16_t)co2, humidity});
+    }
+    fclose(fp);
+    return true;
+}
+
+/**
+ * @brief counters of print_status(), the sampler has no other accessor for them
+ */
+static void read_stats(CAdaptiveSampler *sampler, sampler_stats_t *stats)
+{
+    FILE *tmp = tmpfile();
+    char line[256];
+
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(tmp), STDOUT_FILENO);
+    sampler->print_status();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    memset(stats, 0xFF, sizeof(sampler_stats_t));
+    rewind(tmp);
+    while (fgets(line, sizeof(line), tmp)) {
+        sscanf(line, "updates: %" SCNd64 " (at min: %" SCNd64 ", at max: %" SCNd64 ", speedups: %" SCNd64,
+            &stats->updates, &stats->at_min, &stats->at_max, &stats->speedups);
+    }
+    fclose(tmp);
+}
+
+/**
+ * @brief period of update() for a single change (beyond the repeatability) seen over interval_ms
+ */
+static uint32_t step_period_ms(float step, float delta, uint32_t interval_ms)
+{
+    return (uint32_t)fmaxf(step / (delta / (interval_ms / 1000.f)) * 1000.f, (float)SAMPLER_PERIOD_MIN_MS);
+}
+
+static void test_step()
+{
+    CAdaptiveSampler sampler;
+    int64_t now_us = 0;
+    uint32_t period = 0, prev = 0;
+    int growth_violations = 0, samples_to_max = 0;
+
+    fprintf(stderr, "-- flat, step, flat\n");
+    period = sampler.update(800, 45.f, now_us);
+    expect("first sample: min period (ms)", period, SAMPLER_PERIOD_MIN_MS);
+
+    // flat (within the repeatability): grows back towards the max period
+    for (int i = 0; i < 40 && period < SAMPLER_PERIOD_MAX_MS; i++) {
+        prev = period;
+        now_us += period * 1000LL;
+        period = sampler.update(800 + (i & 1) * 5, 45.f + (i & 1) * 0.1f, now_us);
+        growth_violations += period > (uint32_t)(prev * SAMPLER_BACKOFF_RATIO) + 1 || period < prev;
+        samples_to_max++;
+    }
+    expect("flat: reaches the max period (ms)", period, SAMPLER_PERIOD_MAX_MS);
+    expect("flat: growth beyond the backoff ratio", growth_violations, 0);
+    // 5 s * 1.5^n >= 60 s
+    expect_le("flat: samples to the max period", samples_to_max, (int64_t)ceil(log(12.0) / log(SAMPLER_BACKOFF_RATIO)));
+
+    // CO2 step of an occupancy: on the next sample the period drops at once to the one that keeps the seen rate within a step
+    now_us += period * 1000LL;
+    period = sampler.update(1100, 45.f, now_us);
+    expect("co2 step 300 ppm in 60 s: period (ms)", period, step_period_ms(SAMPLER_CO2_STEP_PPM, 300.f - SAMPLER_CO2_NOISE_PPM, 60000));
+    now_us += period * 1000LL;
+    period = sampler.update(1400, 45.f, now_us);
+    expect("co2 still rising: min period (ms)", period, SAMPLER_PERIOD_MIN_MS);
+
+    // humidity step (shower) from the max period
+    sampler.reset();
+    now_us += 1000000;
+    sampler.update(800, 45.f, now_us);
+    for (int i = 0; i < 40; i++) {
+        now_us += sampler.get_period_ms() * 1000LL;
+        sampler.update(800, 45.f, now_us);
+    }
+    expect("flat after reset: max period (ms)", sampler.get_period_ms(), SAMPLER_PERIOD_MAX_MS);
+    now_us += sampler.get_period_ms() * 1000LL;
+    period = sampler.update(800, 55.f, now_us);
+    expect("humidity step 10 %RH in 60 s: period (ms)", period, step_period_ms(SAMPLER_HUMIDITY_STEP, 10.f - SAMPLER_HUMIDITY_NOISE, 60000));
+
+    // a steady ramp settles where the change between samples is the step plus the ignored repeatability: 40 ppm at 1.5 ppm/s
+    sampler.reset();
+    now_us += 1000000;
+    float co2 = 800.f;
+    sampler.update((uint16_t)co2, 45.f, now_us);
+    for (int i = 0; i < 40; i++) {
+        uint32_t p = sampler.get_period_ms();
+        now_us += p * 1000LL;
+        co2 += 1.5f * p / 1000.f;
+        sampler.update((uint16_t)lroundf(co2), 45.f, now_us);
+    }
+    int64_t settled_ms = (int64_t)((SAMPLER_CO2_STEP_PPM + SAMPLER_CO2_NOISE_PPM) / 1.5f * 1000.f);
+    expect_le("ramp 1.5 ppm/s: period from the settled one (ms)", llabs((int64_t)sampler.get_period_ms() - settled_ms), RAMP_TOLERANCE_MS);
+}
+
+static void test_range()
+{
+    CAdaptiveSampler sampler;
+    sampler_snapshot_t snapshot;
+
+    fprintf(stderr, "-- range and snapshot\n");
+    expect("range below the single shot time", sampler.set_period_range(SAMPLER_PERIOD_MIN_MS - 1, 30000), false);
+    expect("range above the limit", sampler.set_period_range(10000, SAMPLER_PERIOD_LIMIT_MS + 1), false);
+    expect("min above max", sampler.set_period_range(30000, 20000), false);
+    expect("range 10 ~ 30 s", sampler.set_period_range(10000, 30000), true);
+    expect("range restarts at the min period (ms)", sampler.get_period_ms(), 10000);
+
+    int64_t now_us = 0;
+    uint32_t lowest = UINT32_MAX, highest = 0;
+    for (int i = 0; i < 200; i++) {
+        // alternating flat stretches and steps
+        uint16_t co2 = (i / 20) & 1 ? 1500 : 600;
+        now_us += sampler.get_period_ms() * 1000LL;
+        uint32_t period = sampler.update(co2, 50.f, now_us);
+        lowest = period < lowest ? period : lowest;
+        highest = period > highest ? period : highest;
+    }
+    expect("lowest period within 10 ~ 30 s (ms)", lowest, 10000);
+    expect("highest period within 10 ~ 30 s (ms)", highest, 30000);
+
+    sampler.save(&snapshot);
+    CAdaptiveSampler restored;
+    restored.set_period_range(10000, 30000);
+    restored.restore(&snapshot);
+    expect("restored period (ms)", restored.get_period_ms(), snapshot.period_ms);
+    snapshot.period_ms = 1000000;
+    restored.restore(&snapshot);
+    expect("restored period clamped to the max (ms)", restored.get_period_ms(), 30000);
+    snapshot.period_ms = 20000;
+    snapshot.co2_rate = NAN;
+    restored.restore(&snapshot);
+    expect("invalid snapshot: min period (ms)", restored.get_period_ms(), 10000);
+}
+
+static void test_trace(const std::vector<std::pair<uint16_t, float>> &samples)
+{
+    CAdaptiveSampler sampler;
+    sampler_stats_t stats;
+    int64_t end_us = (int64_t)samples.size() * TRACE_STEP_S * 1000000LL;
+    int64_t shots = 0, out_of_range = 0;
+    uint32_t min_ms = SAMPLER_PERIOD_MIN_MS, max_ms = SAMPLER_PERIOD_MAX_MS;
+
+    fprintf(stderr, "-- trace, %zu samples at %d s\n", samples.size(), TRACE_STEP_S);
+    for (int64_t now_us = 0; now_us < end_us; shots++) {
+        // zero order hold of the trace
+        auto &sample = samples[now_us / (TRACE_STEP_S * 1000000LL)];
+        uint32_t period = sampler.update(sample.first, sample.second, now_us);
+        out_of_range += period < min_ms || period > max_ms;
+        now_us += period * 1000LL;
+    }
+    read_stats(&sampler, &stats);
+
+    int64_t fixed_shots = end_us / (FIXED_PERIOD_MS * 1000LL);
+    expect("periods outside the range", out_of_range, 0);
+    expect("updates", stats.updates, shots);
+    expect_le("shots against the fixed 10 s rate (%)", shots * 100 / fixed_shots, SHOT_RATIO_BOUND);
+    fprintf(stderr, "shots: %" PRId64 " (fixed: %" PRId64 "), at min: %" PRId64 ", at max: %" PRId64 ", speedups: %" PRId64 "\n",
+        shots, fixed_shots, stats.at_min, stats.at_max, stats.speedups);
+    // events of the trace (spikes, occupancy, window, shower) must bring the period down
+    expect("speedups on the trace", stats.speedups > 0, 1);
+    expect("samples at the min period", stats.at_min > 0, 1);
+    expect("samples at the max period", stats.at_max > 0, 1);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string path = argc > 1 ? argv[1] : std::string(argv[0]).substr(0, std::string(argv[0]).find_last_of('/') + 1) + TRACE_PATH;
+    std::vector<std::pair<uint16_t, float>> samples;
+
+    if (!load_trace(path.c_str(), &samples) || samples.empty()) {
+        fprintf(stderr, "failed to open %s\n", path.c_str());
+        return 1;
+    }
+    // log lines (drain task) go to stdout, results to stderr
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+
+    test_step();
+    test_range();
+    test_trace(samples);
+
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
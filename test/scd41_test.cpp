@@ -0,0 +1,310 @@
+// scd41_test.cpp
+// purpose: CScd41Ctrl (main/src/peripheral/scd41.cpp) power state and wake shot flag against a fake SCD41 behind a fake
+//          CI2CMaster: the first single shot after wake_up is flagged, the next one is not, power_down is refused
+//          (not sent) during periodic measurement, wake_up sent without ack check while the sensor sleeps
+// usage: make -C test build/scd41_test && test/build/scd41_test
+// the blocking waits of initialize() / stop_periodic_measure() run on the real clock (about 1.5 s), the rest is virtual
+
+#include "scd41.h"
+#include "energy.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define SCD4X_I2C_ADDR      0x62
+
+typedef enum {
+    SensorIdle = 0,
+    SensorPeriodic,
+    SensorSleep
+} eSensorState;
+
+// fake SCD41: commands it accepted (in order) and its actual mode
+static struct {
+    eSensorState state;
+    std::string commands;
+    int nacked;
+} sensor;
+
+static int64_t virtual_us = 1000000;
+static int failures = 0;
+
+int64_t esp_timer_get_time()
+{
+    return virtual_us;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    virtual_us += us;
+}
+
+static uint8_t crc8(uint16_t word)
+{
+    uint8_t crc = 0xFF;
+    uint8_t buf[2] = {(uint8_t)(word >> 8), (uint8_t)(word & 0xFF)};
+    for (int i = 0; i < 2; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x80 ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void fill_words(uint8_t *data, size_t len, const uint16_t *words)
+{
+    for (size_t i = 0; i + 2 < len; i += 3) {
+        data[i] = (uint8_t)(words[i / 3] >> 8);
+        data[i + 1] = (uint8_t)(words[i / 3] & 0xFF);
+        data[i + 2] = crc8(words[i / 3]);
+    }
+}
+
+/**
+ * @brief a command as the sensor sees it, false if it is not acknowledged (sleep: only wake_up gets through, without ack)
+ */
+static bool sensor_command(const uint8_t *data, size_t len)
+{
+    uint16_t command = len >= 2 ? (uint16_t)((data[0] << 8) | data[1]) : 0;
+    const char *name = "?";
+
+    if (sensor.state == SensorSleep) {
+        if (command == 0x36F6) {
+            sensor.state = SensorIdle;
+            sensor.commands += "wake_up;";
+        }
+        sensor.nacked++;
+        return false;
+    }
+    switch (command) {
+    case 0x36F6: name = "wake_up"; break;
+    case 0x36E0: name = "power_down"; sensor.state = SensorSleep; break;
+    case 0x21B1: name = "start_periodic"; sensor.state = SensorPeriodic; break;
+    case 0x21AC: name = "start_low_power"; sensor.state = SensorPeriodic; break;
+    case 0x3F86: name = "stop_periodic"; sensor.state = SensorIdle; break;
+    case 0x219D: name = "single_shot"; break;
+    case 0xEC05: name = "read_measurement"; break;
+    case 0xE4B8: name = "data_ready"; break;
+    case 0x3682: name = "serial_number"; break;
+    default: break;
+    }
+    sensor.commands += name;
+    sensor.commands += ";";
+    return true;
+}
+
+static void sensor_read(uint16_t command, uint8_t *data, size_t len)
+{
+    uint16_t words[3] = {0, 0, 0};
+
+    if (command == 0xEC05) {
+        words[0] = 800;
+        words[1] = 0x6666;      // 25 degC
+        words[2] = 0x8000;      // 50 %RH
+    } else if (command == 0xE4B8) {
+        words[0] = 0x8006;
+    } else if (command == 0x3682) {
+        words[0] = 0xBE02;
+        words[1] = 0x7F07;
+        words[2] = 0x3BFB;
+    }
+    fill_words(data, len, words);
+}
+
+// fake CI2CMaster: the bus is the fake sensor, no retries or clock tracking
+CI2CMaster::CI2CMaster()
+{
+}
+
+CI2CMaster::~CI2CMaster()
+{
+}
+
+bool CI2CMaster::write_bytes(uint8_t dev_addr, uint8_t *data, size_t data_len, uint32_t timeout_ms)
+{
+    return dev_addr == SCD4X_I2C_ADDR && sensor_command(data, data_len);
+}
+
+bool CI2CMaster::read_bytes(uint8_t dev_addr, uint8_t *data, size_t data_len, uint32_t timeout_ms)
+{
+    if (dev_addr != SCD4X_I2C_ADDR || sensor.state == SensorSleep)
+        return false;
+    sensor_read(0, data, data_len);
+    return true;
+}
+
+bool CI2CMaster::write_and_read_bytes(uint8_t dev_addr, uint8_t *data_write, size_t data_write_len, uint8_t *data_read, size_t data_read_len,
+    uint32_t timeout_ms)
+{
+    if (dev_addr != SCD4X_I2C_ADDR || !sensor_command(data_write, data_write_len))
+        return false;
+    sensor_read((uint16_t)((data_write[0] << 8) | data_write[1]), data_read, data_read_len);
+    return true;
+}
+
+bool CI2CMaster::write_bytes_no_ack(uint8_t dev_addr, const uint8_t *data, size_t data_len, uint32_t timeout_ms)
+{
+    // acknowledged or not, only bus errors fail
+    sensor_command(data, data_len);
+    return dev_addr == SCD4X_I2C_ADDR;
+}
+
+void CI2CMaster::set_device_clock_range(uint8_t dev_addr, uint32_t min_hz, uint32_t max_hz)
+{
+}
+
+void CI2CMaster::report_crc_error(uint8_t dev_addr)
+{
+}
+
+static void expect(const char *what, int64_t actual, int64_t expected)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (expected %" PRId64 ")\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+static void expect_str(const char *what, const std::string &actual, const char *expected)
+{
+    fprintf(stderr, "%-56s \"%s\" (expected \"%s\")\n", what, actual.c_str(), expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+/**
+ * @brief single shot and read as the measurement task does it (no blocking wait), returns is_wake_shot() of the shot
+ */
+static bool shot(CScd41Ctrl *ctrl, bool *read_ok)
+{
+    uint16_t co2ppm = 0;
+    float temperature = 0.f, humidity = 0.f;
+
+    ctrl->measure_single_shot(false);
+    bool wake_shot = ctrl->is_wake_shot();
+    virtual_us += SCD4X_SINGLE_SHOT_TIME_MS * 1000LL;
+    *read_ok = ctrl->is_measurement_data_ready() && ctrl->read_measurement(&co2ppm, &temperature, &humidity) && co2ppm == 800;
+    return wake_shot;
+}
+
+static void test_wake_shot(CI2CMaster *i2c)
+{
+    CScd41Ctrl ctrl;
+    bool read_ok = false;
+
+    fprintf(stderr, "-- wake shot\n");
+    sensor = {};
+    sensor.state = SensorSleep;
+    ctrl.initialize(i2c);
+    expect("initialize: sensor idle", sensor.state, SensorIdle);
+    expect("initialize: power state", ctrl.get_power_state(), Scd4xPowerIdle);
+    expect("initialize: no shot flagged yet", ctrl.is_wake_shot(), false);
+
+    expect("first shot after wake_up: flagged", shot(&ctrl, &read_ok), true);
+    expect("first shot: read", read_ok, true);
+    expect("flag cleared by read_measurement", ctrl.is_wake_shot(), false);
+    expect("second shot: not flagged", shot(&ctrl, &read_ok), false);
+    expect("third shot: not flagged", shot(&ctrl, &read_ok), false);
+
+    // power down and wake again (supervisor recovery, power saving)
+    expect("power_down in idle", ctrl.sleep_module(), true);
+    expect("power state after power_down", ctrl.get_power_state(), Scd4xPowerSleep);
+    expect("sensor asleep", sensor.state, SensorSleep);
+    int nacked = sensor.nacked;
+    expect("wake_up (not acknowledged)", ctrl.wakeup_module(), true);
+    expect("wake_up got a nack", sensor.nacked - nacked, 1);
+    expect("power state after wake_up", ctrl.get_power_state(), Scd4xPowerIdle);
+    expect("first shot after the second wake_up: flagged", shot(&ctrl, &read_ok), true);
+    expect("next shot: not flagged", shot(&ctrl, &read_ok), false);
+
+    // a shot issued but not read before the next wake_up does not carry the flag over
+    ctrl.wakeup_module();
+    ctrl.measure_single_shot(false);
+    expect("shot pending after wake_up: flagged", ctrl.is_wake_shot(), true);
+    ctrl.wakeup_module();
+    expect("wake_up clears the pending flag", ctrl.is_wake_shot(), false);
+    expect("shot after the repeated wake_up: flagged", shot(&ctrl, &read_ok), true);
+
+    // periodic measurement in between: no single shot after wake_up remains to discard
+    ctrl.sleep_module();
+    ctrl.wakeup_module();
+    ctrl.start_periodic_measure();
+    ctrl.stop_periodic_measure(false);
+    expect("shot after periodic measurement: not flagged", shot(&ctrl, &read_ok), false);
+}
+
+static void test_power_state(CI2CMaster *i2c)
+{
+    CScd41Ctrl ctrl;
+
+    fprintf(stderr, "-- power state\n");
+    sensor = {};
+    ctrl.initialize(i2c);
+    expect("start periodic", ctrl.start_periodic_measure(), true);
+    expect("power state: periodic", ctrl.get_power_state(), Scd4xPowerPeriodic);
+    sensor.commands.clear();
+    expect("power_down during periodic measurement", ctrl.sleep_module(), false);
+    expect_str("power_down not sent", sensor.commands, "");
+    expect("sensor keeps measuring", sensor.state, SensorPeriodic);
+    expect("stop periodic", ctrl.stop_periodic_measure(false), true);
+    expect("power state: idle", ctrl.get_power_state(), Scd4xPowerIdle);
+    expect("power_down after stop", ctrl.sleep_module(), true);
+    expect("power state: sleep", ctrl.get_power_state(), Scd4xPowerSleep);
+
+    // low power periodic counts as periodic
+    ctrl.wakeup_module();
+    ctrl.start_low_power_periodic_measure();
+    expect("power state: low power periodic", ctrl.get_power_state(), Scd4xPowerPeriodic);
+    expect("power_down during low power periodic", ctrl.sleep_module(), false);
+    ctrl.stop_periodic_measure(false);
+
+    // a failed command keeps the tracked state of the last command the sensor accepted
+    ctrl.sleep_module();
+    expect("start periodic while asleep", ctrl.start_periodic_measure(), false);
+    expect("power state stays sleep", ctrl.get_power_state(), Scd4xPowerSleep);
+    expect("stop periodic while asleep", ctrl.stop_periodic_measure(false), false);
+    expect("power state stays sleep after stop", ctrl.get_power_state(), Scd4xPowerSleep);
+}
+
+static void test_energy(CI2CMaster *i2c)
+{
+    CScd41Ctrl ctrl;
+    bool read_ok = false;
+
+    fprintf(stderr, "-- measuring time\n");
+    sensor = {};
+    ctrl.initialize(i2c);
+    GetEnergyMonitor()->reset_stats();
+    shot(&ctrl, &read_ok);
+    expect("single shot: measuring from command to read (us)",
+        GetEnergyMonitor()->get_active_us(EnergySensorMeasuring, virtual_us), SCD4X_SINGLE_SHOT_TIME_MS * 1000LL);
+    ctrl.start_periodic_measure();
+    virtual_us += 30000000;
+    ctrl.stop_periodic_measure(false);
+    virtual_us += 10000000;
+    expect("periodic: measuring from start to stop (us)",
+        GetEnergyMonitor()->get_active_us(EnergySensorMeasuring, virtual_us), (SCD4X_SINGLE_SHOT_TIME_MS + 30000) * 1000LL);
+}
+
+int main()
+{
+    CI2CMaster i2c;
+
+    // log lines (drain task) go to stdout, results to stderr
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+
+    test_wake_shot(&i2c);
+    test_power_state(&i2c);
+    test_energy(&i2c);
+
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// RTC memory is ordinary memory on the host, it survives a "reboot" as long as the process runs
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+// opaque matter types, enough for headers that keep pointers or pass them through callbacks
+typedef struct {
+    int type;
+    union {
+        bool b;
+        int32_t i32;
+        uint32_t u32;
+        int64_t i64;
+        float f;
+    } val;
+} esp_matter_attr_val_t;
+struct ChipDeviceEvent;
+
+namespace esp_matter {
+
+typedef struct node_t node_t;
+typedef struct endpoint_t endpoint_t;
+typedef struct cluster_t cluster_t;
+typedef struct attribute_t attribute_t;
+
+namespace attribute {
+typedef enum {
+    PRE_UPDATE,
+    POST_UPDATE,
+    READ,
+    WRITE
+} callback_type_t;
+} // namespace attribute
+
+namespace identification {
+typedef enum {
+    START,
+    STOP,
+    EFFECT
+} callback_type_t;
+} // namespace identification
+
+} // namespace esp_matter
@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+// defined by each host test that needs it (exec_command passes argc - 1, argv + 1 to the handler as esp-matter does)
+namespace esp_matter {
+namespace console {
+
+#define CONSOLE_MAX_COMMANDS_SUPPORTED  32
+
+typedef esp_err_t (*command_handler_t)(int argc, char **argv);
+typedef struct {
+    const char *name;
+    const char *description;
+    command_handler_t handler;
+} command_t;
+typedef esp_err_t command_iterator_t(const command_t *command, void *arg);
+
+class engine
+{
+public:
+    void for_each_command(command_iterator_t *on_command, void *arg);
+    esp_err_t exec_command(int argc, char *argv[]);
+    esp_err_t register_commands(const command_t *command_set, unsigned count);
+
+private:
+    const command_t *_command_set[CONSOLE_MAX_COMMANDS_SUPPORTED] = {};
+    unsigned _command_set_size[CONSOLE_MAX_COMMANDS_SUPPORTED] = {};
+    unsigned _command_set_count = 0;
+};
+
+esp_err_t add_commands(const command_t *command, uint8_t count);
+esp_err_t diagnostics_register_commands();
+esp_err_t init();
+
+} // namespace console
+} // namespace esp_matter
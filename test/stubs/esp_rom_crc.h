@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+// defined by each host test that needs it
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len);
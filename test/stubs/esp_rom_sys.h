@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+// defined by each host test that needs it
+void esp_rom_delay_us(uint32_t us);
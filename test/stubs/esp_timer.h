@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+// defined by each host test (real or virtual clock)
+int64_t esp_timer_get_time();
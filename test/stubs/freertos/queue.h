@@ -0,0 +1,71 @@
+#pragma once
+#include "FreeRTOS.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+typedef struct {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+} host_queue_t;
+typedef host_queue_t* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t queue = new host_queue_t();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+inline bool host_queue_wait(QueueHandle_t queue, std::unique_lock<std::mutex> &lock, TickType_t ticks)
+{
+    auto ready = [queue] { return !queue->items.empty(); };
+    if (ticks == portMAX_DELAY) {
+        queue->cv.wait(lock, ready);
+        return true;
+    }
+    return queue->cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (queue->items.size() >= queue->length)
+        return pdFALSE;
+    const uint8_t *data = (const uint8_t *)item;
+    queue->items.emplace_back(data, data + queue->item_size);
+    queue->cv.notify_all();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!host_queue_wait(queue, lock, ticks))
+        return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!host_queue_wait(queue, lock, ticks))
+        return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return (UBaseType_t)queue->items.size();
+}
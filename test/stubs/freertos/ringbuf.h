@@ -0,0 +1,88 @@
+#pragma once
+#include "FreeRTOS.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <vector>
+
+// no-split ring buffer: an item takes an 8 byte header plus its size rounded up to 4 bytes,
+// received items keep their space until they are returned. the state is never freed, a detached
+// task may still wait on it while static objects are destroyed at exit
+typedef enum {
+    RINGBUF_TYPE_NOSPLIT = 0
+} RingbufferType_t;
+
+typedef struct {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    std::list<std::vector<uint8_t>> received;
+    size_t capacity;
+    size_t used;
+} host_ringbuf_t;
+typedef struct {
+    host_ringbuf_t *ring;
+} StaticRingbuffer_t;
+typedef host_ringbuf_t* RingbufHandle_t;
+
+inline size_t host_ringbuf_item_size(size_t size)
+{
+    return 8 + ((size + 3) & ~(size_t)3);
+}
+
+inline RingbufHandle_t xRingbufferCreateStatic(size_t size, RingbufferType_t type, uint8_t *storage, StaticRingbuffer_t *buffer)
+{
+    RingbufHandle_t ring = new host_ringbuf_t();
+    ring->capacity = size;
+    ring->used = 0;
+    buffer->ring = ring;
+    return ring;
+}
+
+inline void vRingbufferDelete(RingbufHandle_t ring)
+{
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    ring->items.clear();
+    ring->received.clear();
+    ring->used = 0;
+}
+
+inline BaseType_t xRingbufferSend(RingbufHandle_t ring, const void *data, size_t size, TickType_t ticks)
+{
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    if (ring->used + host_ringbuf_item_size(size) > ring->capacity)
+        return pdFALSE;
+    ring->used += host_ringbuf_item_size(size);
+    ring->items.emplace_back((const uint8_t *)data, (const uint8_t *)data + size);
+    ring->cv.notify_one();
+    return pdTRUE;
+}
+
+inline void* xRingbufferReceive(RingbufHandle_t ring, size_t *size, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(ring->mutex);
+    auto ready = [ring] { return !ring->items.empty(); };
+    if (ticks == portMAX_DELAY) {
+        ring->cv.wait(lock, ready);
+    } else if (!ring->cv.wait_for(lock, std::chrono::milliseconds(ticks), ready)) {
+        return nullptr;
+    }
+    ring->received.push_back(std::move(ring->items.front()));
+    ring->items.pop_front();
+    *size = ring->received.back().size();
+    return ring->received.back().data();
+}
+
+inline void vRingbufferReturnItem(RingbufHandle_t ring, void *item)
+{
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    for (auto it = ring->received.begin(); it != ring->received.end(); ++it) {
+        if (it->data() == item) {
+            ring->used -= host_ringbuf_item_size(it->size());
+            ring->received.erase(it);
+            return;
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "FreeRTOS.h"
+#include <chrono>
+#include <thread>
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct {
+    int unused;
+} StaticTask_t;
+typedef void* TaskHandle_t;
+
+// tasks are detached threads, they are not deleted before the process exits
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param, UBaseType_t priority, TaskHandle_t *handle)
+{
+    static int handles;
+    std::thread(function, param).detach();
+    if (handle) {
+        *handle = &handles;
+    }
+    return pdPASS;
+}
+
+inline TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param, UBaseType_t priority,
+    StackType_t *stack, StaticTask_t *task)
+{
+    std::thread(function, param).detach();
+    return task;
+}
+
+inline void vTaskDelete(TaskHandle_t handle)
+{
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline TickType_t xTaskGetTickCount()
+{
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle)
+{
+    return 0;
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+typedef void* button_handle_t;
@@ -0,0 +1,340 @@
+// supervisor_test.cpp
+// purpose: escalation ladder of CHealthSupervisor (main/src/system/supervisor.cpp) driven like the measurement task
+//          (process() every 50 ms, a measurement every interval) against a fake SCD4x: detection by failures and by
+//          stale data, recovery at each step, full escalation to failed and retry, command spacing and the worst case bound
+// usage: make -C test build/supervisor_test && test/build/supervisor_test
+
+#include "supervisor.h"
+#include "scd41.h"
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#define TEST_INTERVAL_MS    10000
+#define TEST_LOOP_MS        50          // vTaskDelay of the measurement task while the supervisor is busy
+
+static int64_t virtual_us = 0;
+static int64_t last_success_us = 0;
+static int failure_reports = 0;
+static int failures = 0;
+
+/* fake sensor: commands are recorded with the virtual time they were sent */
+typedef struct {
+    std::string command;
+    int64_t at_us;
+    uint32_t exec_ms;
+} sensor_call_t;
+
+static struct {
+    bool healthy;               // measurements succeed
+    bool nack;                  // acknowledged commands fail (sensor gone from the bus)
+    bool self_test_passed;
+    std::string fixed_by;       // command that makes the sensor healthy again
+    std::vector<sensor_call_t> calls;
+} sensor;
+
+static bool sensor_command(const char *command, uint32_t exec_ms, bool acknowledged = true)
+{
+    sensor.calls.push_back({command, virtual_us, exec_ms});
+    if (acknowledged && sensor.nack)
+        return false;
+    if (sensor.fixed_by == command) {
+        sensor.healthy = true;
+    }
+    return true;
+}
+
+CScd41Ctrl::CScd41Ctrl() {}
+CScd41Ctrl::~CScd41Ctrl() {}
+CScd41Ctrl* CScd41Ctrl::Instance() { static CScd41Ctrl instance; return &instance; }
+
+bool CScd41Ctrl::stop_periodic_measure(bool wait) { return sensor_command("stop", SCD4X_STOP_PERIODIC_TIME_MS); }
+bool CScd41Ctrl::reinit_module(bool wait) { return sensor_command("reinit", SCD4X_REINIT_TIME_MS); }
+bool CScd41Ctrl::wakeup_module(bool wait) { return sensor_command("wakeup", SCD4X_WAKE_UP_TIME_MS, false); }
+bool CScd41Ctrl::start_self_test() { return sensor_command("self_test", SCD4X_SELF_TEST_TIME_MS); }
+bool CScd41Ctrl::perform_factory_reset(bool wait) { return sensor_command("factory_reset", SCD4X_FACTORY_RESET_TIME_MS); }
+
+bool CScd41Ctrl::read_self_test_result(bool *passed)
+{
+    if (!sensor_command("read_self_test", 0))
+        return false;
+    *passed = sensor.self_test_passed;
+    return true;
+}
+
+static void expect(const char *what, int64_t actual, int64_t expected)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (expected %" PRId64 ")\n", what, actual, expected);
+    if (actual != expected) {
+        failures++;
+    }
+}
+
+static void expect_le(const char *what, int64_t actual, int64_t bound)
+{
+    fprintf(stderr, "%-56s %8" PRId64 " (bound %" PRId64 ")\n", what, actual, bound);
+    if (actual > bound) {
+        failures++;
+    }
+}
+
+static void expect_str(const char *what, const std::string &actual, const char *expected)
+{
+    fprintf(stderr, "%-56s %s\n", what, actual == expected ? "ok" : "MISMATCH");
+    if (actual != expected) {
+        fprintf(stderr, "  actual:   %s\n  expected: %s\n", actual.c_str(), expected);
+        failures++;
+    }
+}
+
+static void reset_sensor()
+{
+    sensor.healthy = true;
+    sensor.nack = false;
+    sensor.self_test_passed = true;
+    sensor.fixed_by.clear();
+    sensor.calls.clear();
+}
+
+static std::string call_sequence()
+{
+    std::string sequence;
+    for (auto &call : sensor.calls) {
+        sequence += call.command + ";";
+    }
+    return sequence;
+}
+
+/**
+ * @brief 1 when every command was sent after the execution time of the previous one
+ */
+static int64_t commands_spaced()
+{
+    for (size_t i = 1; i < sensor.calls.size(); i++) {
+        if (sensor.calls[i].at_us - sensor.calls[i - 1].at_us < (int64_t)sensor.calls[i - 1].exec_ms * 1000)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief runs/recovered counters of a step from print_status(), the supervisor has no other accessor for them
+ */
+static int64_t step_stat(CHealthSupervisor *supervisor, const char *step, const char *key)
+{
+    FILE *tmp = tmpfile();
+    char line[256];
+    int64_t value = -1;
+
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(tmp), STDOUT_FILENO);
+    supervisor->print_status();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    rewind(tmp);
+    while (fgets(line, sizeof(line), tmp)) {
+        char name[32];
+        uint32_t runs, recovered;
+        if (sscanf(line, " %31s runs=%" SCNu32 ", recovered=%" SCNu32, name, &runs, &recovered) == 3 && strcmp(name, step) == 0) {
+            value = strcmp(key, "runs") == 0 ? runs : recovered;
+        }
+    }
+    fclose(tmp);
+    return value;
+}
+
+/**
+ * @brief measurement task loop: process() every TEST_LOOP_MS, a measurement every interval unless the supervisor is busy
+ * @return virtual time when until(health) became true, -1 on timeout
+ */
+static int64_t run(CHealthSupervisor *supervisor, int64_t duration_ms, bool (*until)(eSensorHealth) = nullptr, bool measure = true)
+{
+    static int64_t next_measure_us = 0;
+    int64_t end_us = virtual_us + duration_ms * 1000;
+
+    if (next_measure_us < virtual_us) {
+        next_measure_us = virtual_us;
+    }
+    for (; virtual_us < end_us; virtual_us += TEST_LOOP_MS * 1000) {
+        eSupervisorAction action = supervisor->process(virtual_us);
+        if (until && until(supervisor->get_health()))
+            return virtual_us;
+        if (action == SupervisorBusy)
+            continue;
+        if (action == SupervisorResume) {
+            next_measure_us = virtual_us;
+        }
+        if (measure && virtual_us >= next_measure_us) {
+            next_measure_us += TEST_INTERVAL_MS * 1000;
+            if (sensor.healthy) {
+                supervisor->report_success(virtual_us);
+                last_success_us = virtual_us;
+            } else {
+                supervisor->report_failure(virtual_us);
+                failure_reports++;
+            }
+        }
+    }
+    return -1;
+}
+
+static bool is_ok(eSensorHealth health) { return health == SensorHealthOk; }
+static bool is_not_ok(eSensorHealth health) { return health != SensorHealthOk; }
+static bool is_failed(eSensorHealth health) { return health == SensorHealthFailed; }
+static bool is_recovering(eSensorHealth health) { return health == SensorHealthRecovering; }
+
+static CHealthSupervisor *new_supervisor()
+{
+    CHealthSupervisor *supervisor = new CHealthSupervisor();
+    supervisor->set_expected_interval_ms(TEST_INTERVAL_MS);
+    reset_sensor();
+    run(supervisor, 60000);
+    return supervisor;
+}
+
+static void test_healthy()
+{
+    fprintf(stderr, "-- healthy sensor\n");
+    CHealthSupervisor *supervisor = new_supervisor();
+    run(supervisor, 3600 * 1000);
+    expect("health", supervisor->get_health(), SensorHealthOk);
+    expect("sensor commands", sensor.calls.size(), 0);
+    expect("fault changed", supervisor->take_fault_changed(), false);
+    delete supervisor;
+}
+
+static void test_recover_at_step(const char *fixed_by, const char *step, const char *expected_sequence)
+{
+    fprintf(stderr, "-- failures, fixed by %s\n", fixed_by);
+    CHealthSupervisor *supervisor = new_supervisor();
+    sensor.healthy = false;
+    sensor.fixed_by = fixed_by;
+    failure_reports = 0;
+    int64_t detected_us = run(supervisor, 60000, is_not_ok);
+    expect("failed measurements before recovery starts", failure_reports, HEALTH_FAILURE_THRESHOLD);
+    int64_t recovered_us = run(supervisor, 600000, is_ok);
+
+    expect("recovered", recovered_us >= 0, true);
+    expect_str("sensor commands", call_sequence(), expected_sequence);
+    expect("commands sent after the previous execution time", commands_spaced(), 1);
+    expect_le("recovery time (ms)", (recovered_us - detected_us) / 1000, supervisor->get_worst_case_recovery_ms());
+    expect("fault changed", supervisor->take_fault_changed(), true);
+    expect((std::string(step) + " runs").c_str(), step_stat(supervisor, step, "runs"), 1);
+    expect((std::string(step) + " recovered").c_str(), step_stat(supervisor, step, "recovered"), 1);
+    expect("factory reset done", supervisor->take_factory_reset_done(), strcmp(step, "factory-reset") == 0);
+    delete supervisor;
+}
+
+static void test_full_escalation()
+{
+    fprintf(stderr, "-- sensor never recovers, commands acknowledged\n");
+    CHealthSupervisor *supervisor = new_supervisor();
+    sensor.healthy = false;
+    int64_t detected_us = run(supervisor, 60000, is_not_ok);
+    int64_t failed_us = run(supervisor, 600000, is_failed);
+
+    expect("failed", failed_us >= 0, true);
+    expect_str("sensor commands", call_sequence(),
+        "stop;reinit;wakeup;stop;stop;self_test;read_self_test;stop;factory_reset;reinit;");
+    expect("commands sent after the previous execution time", commands_spaced(), 1);
+    expect_le("time to failed (ms)", (failed_us - detected_us) / 1000, supervisor->get_worst_case_recovery_ms());
+    expect("factory reset done", supervisor->take_factory_reset_done(), true);
+    for (const char *step : {"reinit", "wakeup", "self-test", "factory-reset"}) {
+        expect((std::string(step) + " runs").c_str(), step_stat(supervisor, step, "runs"), 1);
+    }
+
+    // failed: no commands until the retry
+    sensor.calls.clear();
+    int64_t retry_us = run(supervisor, HEALTH_RETRY_MS + 60000, is_recovering);
+    expect("commands while failed", sensor.calls.size(), 0);
+    expect("retry after (ms)", (retry_us - failed_us) / 1000, HEALTH_RETRY_MS);
+    sensor.healthy = true;
+    run(supervisor, 60000, is_ok);
+    expect("health after the retry", supervisor->get_health(), SensorHealthOk);
+    expect("reinit recovered", step_stat(supervisor, "reinit", "recovered"), 1);
+    delete supervisor;
+}
+
+static void test_no_ack()
+{
+    fprintf(stderr, "-- sensor gone from the bus, every command nacked\n");
+    CHealthSupervisor *supervisor = new_supervisor();
+    sensor.healthy = false;
+    sensor.nack = true;
+    int64_t detected_us = run(supervisor, 60000, is_not_ok);
+    int64_t failed_us = run(supervisor, 600000, is_failed);
+
+    // a rejected command ends its step at once, one loop per step
+    expect_str("sensor commands", call_sequence(), "stop;wakeup;stop;stop;stop;");
+    expect_le("time to failed (ms)", (failed_us - detected_us) / 1000, RecoveryStepMax * TEST_LOOP_MS);
+    expect("factory reset done", supervisor->take_factory_reset_done(), false);
+    delete supervisor;
+}
+
+static void test_self_test_malfunction()
+{
+    fprintf(stderr, "-- self test reports a malfunction, fixed by factory_reset\n");
+    CHealthSupervisor *supervisor = new_supervisor();
+    sensor.healthy = false;
+    sensor.self_test_passed = false;
+    sensor.fixed_by = "factory_reset";
+    run(supervisor, 60000, is_not_ok);
+    run(supervisor, 600000, is_ok);
+
+    expect_str("sensor commands", call_sequence(),
+        "stop;reinit;wakeup;stop;stop;self_test;read_self_test;stop;factory_reset;reinit;");
+    if (sensor.calls.size() < 8) {
+        delete supervisor;
+        return;
+    }
+    // the failed self test goes to the next step without waiting for a sample
+    size_t read = 6;
+    expect_le("read_self_test -> stop of the next step (ms)", (sensor.calls[read + 1].at_us - sensor.calls[read].at_us) / 1000, TEST_LOOP_MS);
+    expect("self-test recovered", step_stat(supervisor, "self-test", "recovered"), 0);
+    expect("factory-reset recovered", step_stat(supervisor, "factory-reset", "recovered"), 1);
+    expect("factory reset done", supervisor->take_factory_reset_done(), true);
+    delete supervisor;
+}
+
+static void test_stale()
+{
+    fprintf(stderr, "-- no samples at all (task stuck on the data ready poll)\n");
+    CHealthSupervisor *supervisor = new_supervisor();
+    int64_t detected_us = run(supervisor, 120000, is_not_ok, false);
+    int64_t stale_ms = (int64_t)TEST_INTERVAL_MS * HEALTH_STALE_INTERVALS + HEALTH_STALE_MARGIN_MS;
+
+    expect("recovery started", detected_us >= 0, true);
+    expect_le("stale limit (ms) <= data age at detection", stale_ms, (detected_us - last_success_us) / 1000);
+    expect_le("data age at detection (ms)", (detected_us - last_success_us) / 1000, stale_ms + TEST_LOOP_MS);
+    expect("sensor commands before detection", sensor.calls.size() > 0 && sensor.calls[0].at_us < detected_us, false);
+    delete supervisor;
+}
+
+int main()
+{
+    // log lines (drain task) go to stdout, results to stderr
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "failed to redirect stdout\n");
+        return 1;
+    }
+
+    test_healthy();
+    test_recover_at_step("reinit", "reinit", "stop;reinit;");
+    test_recover_at_step("wakeup", "wakeup", "stop;reinit;wakeup;stop;");
+    test_recover_at_step("self_test", "self-test", "stop;reinit;wakeup;stop;stop;self_test;read_self_test;");
+    test_recover_at_step("factory_reset", "factory-reset",
+        "stop;reinit;wakeup;stop;stop;self_test;read_self_test;stop;factory_reset;reinit;");
+    test_self_test_malfunction();
+    test_full_escalation();
+    test_no_ack();
+    test_stale();
+
+    fprintf(stderr, "%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}